@@ -8,6 +8,14 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include "shader.h"
+#include "meshData.h"
+#include "glResource.h"
+#include "textureFeedback.h"
+#include "vertexFormat.h"
+#include "meshOptimizer.h"
+#include "meshlet.h"
+#include "retainedGeometry.h"
+#include "parametricSurface.h"
 
 # define PI 3.1416
 
@@ -22,22 +30,52 @@ public:
     glm::vec4 specular;
     float shininess;
     unsigned int texture;
+    bool backfaceClusterCulling = false;   // only for surfaces never seen from behind
     // ctor/dtor
-    BezierCurve(GLfloat controlpoints[], int size, unsigned int tex, glm::vec4 amb = glm::vec4(1.0, 0.0, 0.0, 1.0f), glm::vec4 diff = glm::vec4(1.0, 0.0, 0.0, 1.0f), glm::vec4 spec = glm::vec4(0.1f, 0.1f, 0.1f, 0.5f), float shiny = 32.0f)
+    BezierCurve(GLfloat controlpoints[], int size, unsigned int tex, glm::vec4 amb = glm::vec4(1.0, 0.0, 0.0, 1.0f), glm::vec4 diff = glm::vec4(1.0, 0.0, 0.0, 1.0f), glm::vec4 spec = glm::vec4(0.1f, 0.1f, 0.1f, 0.5f), float shiny = 32.0f, int nt = 40, int ntheta = 20, bool gpuTessellated = false, bool editable = false)
     {
-        for (int i = 0; i < size; i++)
-        {
-            this->cntrlPoints.push_back(controlpoints[i]);
-        }
-        this->ambient = amb;
-        this->diffuse = diff;
-        this->specular = spec;
-        this->shininess = shiny;
-        this->texture = tex;
-        sphereVAO = hollowBezier(cntrlPoints.data(), ((unsigned int)cntrlPoints.size() / 3) - 1);
+        setProperties(controlpoints, size, tex, amb, diff, spec, shiny, nt, ntheta);
+        this->gpuTessellated = gpuTessellated;
+        this->editable = editable;
+        if (gpuTessellated)
+            patchVAO = setUpTessellationPatch(cntrlPoints.data(), ((unsigned int)cntrlPoints.size() / 3) - 1);
+        else
+            sphereVAO = hollowBezier(cntrlPoints.data(), ((unsigned int)cntrlPoints.size() / 3) - 1);
 
     }
-    ~BezierCurve() {}
+    // upload a surface made by buildGeometry() with the same nt/ntheta, which may have run on a worker thread
+    BezierCurve(MeshData mesh, GLfloat controlpoints[], int size, unsigned int tex, glm::vec4 amb = glm::vec4(1.0, 0.0, 0.0, 1.0f), glm::vec4 diff = glm::vec4(1.0, 0.0, 0.0, 1.0f), glm::vec4 spec = glm::vec4(0.1f, 0.1f, 0.1f, 0.5f), float shiny = 32.0f, int nt = 40, int ntheta = 20, bool editable = false)
+    {
+        setProperties(controlpoints, size, tex, amb, diff, spec, shiny, nt, ntheta);
+        this->editable = editable;
+        vertices = std::move(mesh.vertices);
+        indices = std::move(mesh.indices);
+        // edits compare against the uploaded profile, which is cheap next to the surface
+        if (editable)
+            buildProfile(cntrlPoints.data(), ((unsigned int)cntrlPoints.size() / 3) - 1);
+        sphereVAO = uploadSurface();
+    }
+    // CPU half of the constructor: no GL calls, safe on any thread
+    static MeshData buildGeometry(GLfloat controlpoints[], int size, int nt = 40, int ntheta = 20)
+    {
+        BezierCurve surface;
+        surface.cntrlPoints.assign(controlpoints, controlpoints + size);
+        surface.nt = nt;
+        surface.ntheta = ntheta;
+        surface.buildSurface(surface.cntrlPoints.data(), ((unsigned int)surface.cntrlPoints.size() / 3) - 1);
+
+        MeshData mesh;
+        mesh.vertices = std::move(surface.vertices);
+        mesh.indices = std::move(surface.indices);
+
+        // the editable roof rewrites vertex spans in stack order, so only the
+        // triangle order is optimised here
+        MeshOptimizeOptions options;
+        options.weld = false;
+        options.reorderVertices = false;
+        optimizeMesh(mesh, "roof", options);
+        return mesh;
+    }
     // draw in VertexArray mode
     void drawBezierCurve(Shader& lightingShader, glm::mat4 model) const      // draw surface
     {
@@ -47,22 +85,205 @@ public:
         lightingShader.setVec3("material.diffuse", glm::vec3(0.969, 0.776, 0.561));
         lightingShader.setVec3("material.specular", glm::vec3(1.0f, 1.0f, 1.0f));
         lightingShader.setFloat("material.shininess", 32.0f);
-        lightingShader.setMat4("model", model);
+        lightingShader.setMat4("model", model * layout.dequantize());
 
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_2D, texture);
 
-        glBindVertexArray(sphereVAO);
+        glBindVertexArray(sphereVAO.get());
         glDrawElements(GL_TRIANGLES,                    // primitive type
-            (unsigned int)indices.size(),          // # of indices
-            GL_UNSIGNED_INT,                 // data type
+            indexCount,                      // # of indices
+            layout.indexType,                // data type
             (void*)0);                       // offset to indices
 
         // unbind VAO
         glBindVertexArray(0);
+        textureFeedbackLog().record(texture, sphereVAO.get(), indexCount, layout.indexType, model * layout.dequantize());
+    }
+
+    // same, but only the meshlets inside the view frustum are submitted. the roof is
+    // open and seen from inside and out, so meshlets facing away are kept unless
+    // backfaceClusterCulling says the surface is only ever seen from its front
+    void drawBezierCurve(Shader& lightingShader, glm::mat4 model, const glm::mat4& view, const glm::mat4& projection, glm::vec3 cameraPos)
+    {
+        lightingShader.use();
+        lightingShader.setVec3("material.ambient", glm::vec3(0.969, 0.776, 0.561));
+        lightingShader.setVec3("material.diffuse", glm::vec3(0.969, 0.776, 0.561));
+        lightingShader.setVec3("material.specular", glm::vec3(1.0f, 1.0f, 1.0f));
+        lightingShader.setFloat("material.shininess", 32.0f);
+        lightingShader.setMat4("model", model * layout.dequantize());
+
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, texture);
+
+        // meshlet bounds are in the surface's own space, before quantisation
+        glm::vec3 cameraInObject = glm::vec3(glm::inverse(model) * glm::vec4(cameraPos, 1.0f));
+        cullMeshlets(meshlets, projection * view * model, cameraInObject, backfaceClusterCulling, layout.indexSize(), drawList);
+
+        glBindVertexArray(sphereVAO.get());
+        drawMeshlets(drawList, layout.indexType);
+        glBindVertexArray(0);
+        // replayed whole; what the meshlets culled here add lies outside the view
+        textureFeedbackLog().record(texture, sphereVAO.get(), indexCount, layout.indexType, model * layout.dequantize());
+    }
+
+    const MeshletDrawList& getMeshletDrawList() const
+    {
+        return drawList;
+    }
+
+    // the CPU copy kept under the retention policy, for picking and collision. an
+    // editable roof keeps its full surface for edits instead and leaves this empty
+    const RetainedGeometry& getRetainedGeometry() const
+    {
+        return retained;
+    }
+
+    void setRetention(MeshRetention retention)
+    {
+        retained.setRetention(retention);
+    }
+
+    // GL 4.x path: the profile control points are the only vertex data, every angular
+    // sector is one instance of the patch and the tessellation control shader sizes it
+    // from its screen-space edge lengths
+    void drawBezierCurveTessellated(Shader& tessellationShader, glm::mat4 model, float viewportWidth, float viewportHeight) const
+    {
+        tessellationShader.use();
+        tessellationShader.setVec3("material.ambient", glm::vec3(0.969, 0.776, 0.561));
+        tessellationShader.setVec3("material.diffuse", glm::vec3(0.969, 0.776, 0.561));
+        tessellationShader.setVec3("material.specular", glm::vec3(1.0f, 1.0f, 1.0f));
+        tessellationShader.setFloat("material.shininess", 32.0f);
+        tessellationShader.setMat4("model", model);
+
+        tessellationShader.setVec2("viewportSize", viewportWidth, viewportHeight);
+        tessellationShader.setFloat("pixelsPerSegment", pixelsPerSegment);
+        tessellationShader.setInt("sectorCount", patchSectors);
+        tessellationShader.setFloat("normalSign", normalSign);
+
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, texture);
+
+        glBindVertexArray(patchVAO.get());
+        glPatchParameteri(GL_PATCH_VERTICES, patchVertices);
+        glDrawArraysInstanced(GL_PATCHES, 0, patchVertices, patchSectors);
+        glBindVertexArray(0);
+        // patches cannot be replayed by the feedback pass
+        textureFeedbackLog().requestFullDetail(texture);
+    }
+
+    bool isGpuTessellated() const
+    {
+        return gpuTessellated;
+    }
+
+    int getControlPointCount() const
+    {
+        return (int)cntrlPoints.size() / 3;
+    }
+
+    glm::vec2 getControlPoint(int index) const
+    {
+        return glm::vec2(cntrlPoints[index * 3], cntrlPoints[(index * 3) + 1]);
+    }
+
+    // editable mode: moves one profile control point and re-tessellates only the stacks
+    // it visibly changes, patching them into the existing vertex buffer in place.
+    // the index buffer and the VAO are reused untouched
+    bool setControlPoint(int index, float x, float y)
+    {
+        if (!editable || index < 0 || index >= getControlPointCount())
+            return false;
+
+        cntrlPoints[index * 3] = x;
+        cntrlPoints[(index * 3) + 1] = y;
+
+        int L = ((unsigned int)cntrlPoints.size() / 3) - 1;
+        if (gpuTessellated)
+        {
+            normalSign = profileNormalSign(cntrlPoints.data(), L);
+            if (index < patchVertices)
+            {
+                float point[2] = { x, y };
+                glBindBuffer(GL_ARRAY_BUFFER, patchVBO.get());
+                glBufferSubData(GL_ARRAY_BUFFER, index * sizeof(point), sizeof(point), point);
+                glBindBuffer(GL_ARRAY_BUFFER, 0);
+            }
+            return true;
+        }
+
+        // the normal orientation is a property of the whole profile; if an edit flips it
+        // every stack changes and the span below covers the full surface
+        normalSign = profileNormalSign(cntrlPoints.data(), L);
+
+        // re-evaluating the profile is O(nt * L); the ring rebuild and upload is the
+        // expensive part, so only stacks that moved beyond the tolerance are rebuilt
+        int first = -1, last = -1;
+        float profile[4];
+        for (int i = 0; i <= nt; ++i)
+        {
+            evaluateProfile(i, cntrlPoints.data(), L, profile);
+            float* uploaded = &stackProfiles[i * 4];
+            bool moved = fabs(profile[0] - uploaded[0]) > positionTolerance || fabs(profile[1] - uploaded[1]) > positionTolerance ||
+                fabs(profile[2] - uploaded[2]) > normalTolerance || fabs(profile[3] - uploaded[3]) > normalTolerance;
+            if (!moved)
+                continue;
+            if (first < 0)
+                first = i;
+            last = i;
+        }
+        if (first < 0)
+            return true;
+
+        // the Bernstein basis is unimodal, so the moved stacks form one contiguous span
+        for (int i = first; i <= last; ++i)
+            evaluateProfile(i, cntrlPoints.data(), L, &stackProfiles[i * 4]);
+        size_t stackVertices = (size_t)(ntheta + 1);
+        sweptSurface().writeVertices(&vertices[first * stackVertices * 8], first, last);
+
+        // the span is packed into the uploaded layout before it goes to the buffer
+        size_t spanVertices = (last - first + 1) * stackVertices;
+        packedSpan.resize(spanVertices * layout.stride);
+        packVertices(layout, &vertices[first * stackVertices * 8], spanVertices, packedSpan.data());
+
+        glBindBuffer(GL_ARRAY_BUFFER, bezierVBO.get());
+        glBufferSubData(GL_ARRAY_BUFFER,
+            first * stackVertices * layout.stride,
+            packedSpan.size(),
+            packedSpan.data());
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        // the moved stacks stretch the culling bounds of the meshlets on them
+        unsigned int spanBegin = (unsigned int)(first * stackVertices), spanEnd = (unsigned int)((last + 1) * stackVertices);
+        for (Meshlet& meshlet : meshlets)
+        {
+            const unsigned int* begin = &indices[meshlet.firstIndex];
+            const unsigned int* end = begin + meshlet.indexCount;
+            if (std::any_of(begin, end, [&](unsigned int v) { return v >= spanBegin && v < spanEnd; }))
+                computeMeshletBounds(vertices.data(), 8, indices.data(), meshlet);
+        }
+
+        return true;
     }
 
 private:
+    BezierCurve() {}
+
+    void setProperties(GLfloat controlpoints[], int size, unsigned int tex, glm::vec4 amb, glm::vec4 diff, glm::vec4 spec, float shiny, int nt, int ntheta)
+    {
+        for (int i = 0; i < size; i++)
+        {
+            this->cntrlPoints.push_back(controlpoints[i]);
+        }
+        this->ambient = amb;
+        this->diffuse = diff;
+        this->specular = spec;
+        this->shininess = shiny;
+        this->texture = tex;
+        this->nt = nt;
+        this->ntheta = ntheta;
+    }
+
     // member functions
     long long nCr(int n, int r)
     {
@@ -79,178 +300,306 @@ private:
 
         return ans;
     }
-    //polynomial interpretation for N points
-    void BezierCurveFN(double t, float xy[2], GLfloat ctrlpoints[], int L)
+
+    // Bernstein basis of degree L (and of degree L - 1 for the derivative)
+    // sampled once at every t_i = i / nt, so evaluating a stack is a dot product
+    // with the control points instead of nCr + two pow() calls per point
+    void buildBernsteinTables(int L)
     {
-        double y = 0;
-        double x = 0;
-        t = t > 1.0 ? 1.0 : t;
-        for (int i = 0; i < L + 1; i++)
+        vector<float> binomial(L + 1), binomialDeriv(L > 0 ? L : 1);
+        for (int k = 0; k <= L; k++)
+            binomial[k] = (float)nCr(L, k);
+        for (int k = 0; k < L; k++)
+            binomialDeriv[k] = (float)nCr(L - 1, k);
+
+        bernstein.assign((nt + 1) * (L + 1), 0.0f);
+        bernsteinDeriv.assign((nt + 1) * L, 0.0f);
+
+        vector<float> tPow(L + 1), sPow(L + 1);
+        for (int i = 0; i <= nt; i++)
         {
-            long long ncr = nCr(L, i);
-            double oneMinusTpow = pow(1 - t, double(L - i));
-            double tPow = pow(t, double(i));
-            double coef = oneMinusTpow * tPow * ncr;
-            x += coef * ctrlpoints[i * 3];
-            y += coef * ctrlpoints[(i * 3) + 1];
+            float t = (float)i / nt;
+            float s = 1.0f - t;
+            tPow[0] = sPow[0] = 1.0f;
+            for (int k = 1; k <= L; k++)
+            {
+                tPow[k] = tPow[k - 1] * t;
+                sPow[k] = sPow[k - 1] * s;
+            }
+
+            float* b = &bernstein[i * (L + 1)];
+            for (int k = 0; k <= L; k++)
+                b[k] = binomial[k] * tPow[k] * sPow[L - k];
 
+            float* db = L > 0 ? &bernsteinDeriv[i * L] : nullptr;
+            for (int k = 0; k < L; k++)
+                db[k] = binomialDeriv[k] * tPow[k] * sPow[L - 1 - k];
         }
-        xy[0] = float(x);
-        xy[1] = float(y);
     }
 
-
-    unsigned int hollowBezier(GLfloat ctrlpoints[], int L)
+    // unit circle shared by every stack, advanced with a rotation recurrence
+    // instead of a cos/sin pair per vertex
+    void buildRingTable()
     {
-        int i, j;   
-        float x, y, z, r;                //current coordinates
-        float theta;
-        float nx, ny, nz, lengthInv;    // vertex normal
-        float s, t1; // texturecoord
+        ringSin.resize(ntheta + 1);
+        ringCos.resize(ntheta + 1);
+
+        const double dtheta = 2 * pi / ntheta;
+        const double cosStep = cos(dtheta);
+        const double sinStep = sin(dtheta);
+        double c = 1.0, s = 0.0;
+        for (int j = 0; j < ntheta; j++)
+        {
+            ringCos[j] = (float)c;
+            ringSin[j] = (float)s;
+            double cNext = c * cosStep - s * sinStep;
+            s = s * cosStep + c * sinStep;
+            c = cNext;
+        }
+        // close the seam exactly
+        ringCos[ntheta] = 1.0f;
+        ringSin[ntheta] = 0.0f;
+    }
 
-        const float dtheta = 2 * pi / ntheta;        //angular step size
+    // profile point (r, y) and its unit normal (nr, ny) in the (radius, height) plane at t_i
+    void evaluateProfile(int i, GLfloat ctrlpoints[], int L, float out[4]) const
+    {
+        const float* b = &bernstein[i * (L + 1)];
+        float r = 0.0f, y = 0.0f;
+        for (int k = 0; k <= L; k++)
+        {
+            r += b[k] * ctrlpoints[k * 3];
+            y += b[k] * ctrlpoints[(k * 3) + 1];
+        }
 
-        float t = 0;
-        float dt = 1.0 / nt;
-        float xy[2];
+        // C'(t) = L * sum (P[k + 1] - P[k]) * B[k, L - 1](t)
+        float dr = 0.0f, dy = 0.0f;
+        for (int k = 0; k < L; k++)
+        {
+            float db = bernsteinDeriv[i * L + k];
+            dr += db * (ctrlpoints[(k + 1) * 3] - ctrlpoints[k * 3]);
+            dy += db * (ctrlpoints[((k + 1) * 3) + 1] - ctrlpoints[(k * 3) + 1]);
+        }
 
-        for (i = 0; i <= nt; ++i)              //step through y
+        // the surface normal lies in the plane of the radial direction and the axis,
+        // perpendicular to the profile tangent (dr, dy)
+        float nr = normalSign * dy;
+        float ny = -normalSign * dr;
+        float len = sqrt(nr * nr + ny * ny);
+        if (len > 1e-8f)
         {
-            BezierCurveFN(t, xy, ctrlpoints, L);
-            r = xy[0];
-            y = xy[1];
-            theta = 0;
-            t += dt;
-            lengthInv = 1.0 / r;
-            //u = 0;
-            //v = 0.025 * (nt - i);//(1/40)
-
-            for (j = 0; j <= ntheta; ++j)
-            {
-                double cosa = cos(theta);
-                double sina = sin(theta);
-                z = r * cosa;
-                x = r * sina;
-
-                coordinates.push_back(x);
-                coordinates.push_back(y);
-                coordinates.push_back(z);
-
-                // normalized vertex normal (nx, ny, nz)
-                // center point of the circle (0,y,0)
-                nx = (x - 0) * lengthInv;
-                ny = (y - y) * lengthInv;
-                nz = (z - 0) * lengthInv;
-
-                normals.push_back(nx);
-                normals.push_back(ny);
-                normals.push_back(nz);
-
-                s = (float)j / ntheta; // U-coordinate
-                t1 = (float)i / nt; // V-coordinate
-                texCoords.push_back(s);
-                texCoords.push_back(t1);
-
-                theta += dtheta;
-            }
+            nr /= len;
+            ny /= len;
+        }
+        else
+        {
+            nr = 1.0f;
+            ny = 0.0f;
         }
 
-        // generate index list of triangles
-        // k1--k1+1
-        // |  / |
-        // | /  |
-        // k2--k2+1
+        out[0] = r;
+        out[1] = y;
+        out[2] = nr;
+        out[3] = ny;
+    }
+
+    // vertex (i, j) of the swept surface: the profile of stack i turned to ring angle j
+    struct SweptVertex
+    {
+        const float* stackProfiles;
+        const float* ringSin;
+        const float* ringCos;
+        int nt;
+        int ntheta;
 
-        int k1, k2;
-        for (int i = 0; i < nt; ++i)
+        void operator()(int i, int j, float* v) const
         {
-            k1 = i * (ntheta + 1);     // beginning of current stack
-            k2 = k1 + ntheta + 1;      // beginning of next stack
+            const float* profile = stackProfiles + i * 4;
+            v[0] = profile[0] * ringSin[j];
+            v[1] = profile[1];
+            v[2] = profile[0] * ringCos[j];
 
-            for (int j = 0; j < ntheta; ++j, ++k1, ++k2)
-            {
-                // k1 => k2 => k1+1
-                indices.push_back(k1);
-                indices.push_back(k2);
-                indices.push_back(k1 + 1);
-
-                // k1+1 => k2 => k2+1
-                indices.push_back(k1 + 1);
-                indices.push_back(k2);
-                indices.push_back(k2 + 1);
-            }
+            v[3] = profile[2] * ringSin[j];
+            v[4] = profile[3];
+            v[5] = profile[2] * ringCos[j];
+
+            v[6] = (float)j / ntheta;   // U-coordinate
+            v[7] = (float)i / nt;       // V-coordinate
         }
+    };
 
-        size_t count = coordinates.size();
-        size_t counttex = texCoords.size();
-        for (int i = 0; i < count; i += 3)
-        {
-            vertices.push_back(coordinates[i]);
-            vertices.push_back(coordinates[i + 1]);
-            vertices.push_back(coordinates[i + 2]);
+    // stacks are the rows, ring positions the columns
+    ParametricSurface<SweptVertex> sweptSurface() const
+    {
+        SweptVertex evaluate = { stackProfiles.data(), ringSin.data(), ringCos.data(), nt, ntheta };
+        return ParametricSurface<SweptVertex>(evaluate, nt, ntheta);
+    }
 
-            vertices.push_back(normals[i]);
-            vertices.push_back(normals[i + 1]);
-            vertices.push_back(normals[i + 2]);
+    // orient normals the way the radial ones always pointed: along +r when the
+    // profile is swept downwards (the roof), along -r otherwise
+    static float profileNormalSign(GLfloat ctrlpoints[], int L)
+    {
+        return (ctrlpoints[(L * 3) + 1] - ctrlpoints[1]) < 0.0f ? -1.0f : 1.0f;
+    }
 
-            size_t texIndex = i / 3 * 2;
-            vertices.push_back(texCoords[texIndex]);
-            vertices.push_back(texCoords[texIndex + 1]);
+    GlVertexArray setUpTessellationPatch(GLfloat ctrlpoints[], int L)
+    {
+        normalSign = profileNormalSign(ctrlpoints, L);
+
+        // (radius, height) pairs, the z of the control points is unused like in hollowBezier
+        patchVertices = L + 1;
+        if (patchVertices > maxPatchVertices)
+        {
+            std::cout << "BezierCurve: " << patchVertices << " control points exceed the tessellation limit of " << maxPatchVertices << std::endl;
+            patchVertices = maxPatchVertices;
+        }
+        vector<float> profile;
+        for (int k = 0; k < patchVertices; k++)
+        {
+            profile.push_back(ctrlpoints[k * 3]);
+            profile.push_back(ctrlpoints[(k * 3) + 1]);
         }
 
-        unsigned int bezierVAO;
-        glGenVertexArrays(1, &bezierVAO);
-        glBindVertexArray(bezierVAO);
-
-        // create VBO to copy vertex data to VBO
-        unsigned int bezierVBO;
-        glGenBuffers(1, &bezierVBO);
-        glBindBuffer(GL_ARRAY_BUFFER, bezierVBO);           // for vertex data
-        glBufferData(GL_ARRAY_BUFFER,                   // target
-            (unsigned int)vertices.size() * sizeof(float), // data size, # of bytes
-            vertices.data(),   // ptr to vertex data
-            GL_STATIC_DRAW);                   // usage
-
-        // create EBO to copy index data
-        unsigned int bezierEBO;
-        glGenBuffers(1, &bezierEBO);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, bezierEBO);   // for index data
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER,           // target
-            (unsigned int)indices.size() * sizeof(unsigned int),             // data size, # of bytes
-            indices.data(),               // ptr to index data
-            GL_STATIC_DRAW);                   // usage
-
-        // activate attrib arrays
+        GlVertexArray vao = GlVertexArray::create();
+        glBindVertexArray(vao.get());
+
+        patchVBO = GlBuffer::create();
+        glBindBuffer(GL_ARRAY_BUFFER, patchVBO.get());
+        glBufferData(GL_ARRAY_BUFFER, profile.size() * sizeof(float), profile.data(), GL_STATIC_DRAW);
+        patchVBO.chargeMemory(MemoryCategory::Meshes, profile.size() * sizeof(float));
+
         glEnableVertexAttribArray(0);
-        glEnableVertexAttribArray(1);
-        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        return vao;
+    }
+
+    GlVertexArray hollowBezier(GLfloat ctrlpoints[], int L)
+    {
+        buildSurface(ctrlpoints, L);
+        return uploadSurface();
+    }
+
+    // basis and ring tables plus the profile of every stack: everything an edit needs
+    void buildProfile(GLfloat ctrlpoints[], int L)
+    {
+        buildBernsteinTables(L);
+        buildRingTable();
+
+        normalSign = profileNormalSign(ctrlpoints, L);
+
+        // the profile of each stack is kept so that edits can tell which stacks moved
+        stackProfiles.assign((size_t)(nt + 1) * 4, 0.0f);
+        for (int i = 0; i <= nt; ++i)              //step through y
+            evaluateProfile(i, ctrlpoints, L, &stackProfiles[i * 4]);
+    }
+
+    // CPU part of hollowBezier
+    void buildSurface(GLfloat ctrlpoints[], int L)
+    {
+        buildProfile(ctrlpoints, L);
+
+        ParametricSurface<SweptVertex> surface = sweptSurface();
+        vertices.resize(surface.getVertexCount() * 8);
+        indices.resize(surface.getIndexCount());
+        surface.writeVertices(vertices.data());
+        surface.writeIndices(indices.data());
+    }
+
+    GlVertexArray uploadSurface()
+    {
+        // regroup the triangles into meshlets; the vertex order edits rely on is kept
+        MeshData surface;
+        surface.vertices.swap(vertices);
+        surface.indices.swap(indices);
+        meshlets = buildMeshlets(surface);
+        indexCount = (unsigned int)surface.indices.size();
+
+        GlVertexArray bezierVAO = GlVertexArray::create();
+        glBindVertexArray(bezierVAO.get());
+
+        // edits move the surface, and with it the quantisation bounds, so an editable
+        // roof keeps float positions
+        VertexFormat format = defaultVertexFormat();
+        if (editable && format == VertexFormat::PackedQuantised)
+            format = VertexFormat::Packed;
+
+        // create VBO and EBO and copy vertex and index data
+        layout = uploadVertexData(surface.vertices, surface.indices, bezierVBO, bezierEBO, format,
+            editable ? GL_DYNAMIC_DRAW : GL_STATIC_DRAW);
 
         // set attrib arrays with stride and offset
-        int stride = 32;     // should be 24 bytes
-        glVertexAttribPointer(0, 3, GL_FLOAT, false, stride, (void*)0);
-        glVertexAttribPointer(1, 3, GL_FLOAT, false, stride, (void*)(sizeof(float) * 3));
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * 6));
+        setVertexAttributes(layout, 3);
 
         // unbind VAO, VBO and EBO
         glBindVertexArray(0);
         glBindBuffer(GL_ARRAY_BUFFER, 0);
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 
+        // edits rewrite the vertices in place and rebound meshlets from the indices, so
+        // an editable roof keeps its whole surface whatever the retention policy
+        if (editable)
+        {
+            vertices.swap(surface.vertices);
+            indices.swap(surface.indices);
+        }
+        else
+            retained.retain(std::move(surface), defaultMeshRetention());
+        updateMemoryCharge();
+
         return bezierVAO;
     }
 
+    // meshlets, edit state and the surface an editable roof keeps
+    void updateMemoryCharge()
+    {
+        size_t bytes = meshlets.capacity() * sizeof(Meshlet) + stackProfiles.capacity() * sizeof(float) +
+            vertices.capacity() * sizeof(float) + indices.capacity() * sizeof(unsigned int);
+        memory = MemoryCharge(MemoryCategory::Meshes, bytes, 0);
+    }
+
     // memeber vars
-    unsigned int sphereVAO;
+    GlVertexArray sphereVAO;
+    GlBuffer bezierEBO;
+    VertexLayout layout;
+
+    // editable mode
+    bool editable = false;
+    GlBuffer bezierVBO;
+    vector<float> stackProfiles;        // (r, y, nr, ny) per stack as last uploaded
+    vector<unsigned char> packedSpan;   // scratch for re-uploaded stacks
+    const float positionTolerance = 1e-5f;
+    const float normalTolerance = 1e-4f;
+
+    // meshlet culling
+    vector<Meshlet> meshlets;
+    MeshletDrawList drawList;
+
+    // tessellation path
+    static const int maxPatchVertices = 16;   // MAX_CONTROL_POINTS in the tessellation shaders
+    bool gpuTessellated = false;
+    GlVertexArray patchVAO;
+    GlBuffer patchVBO;
+    int patchVertices = 0;
+    const int patchSectors = 8;
+    const float pixelsPerSegment = 8.0f;
 
     const double pi = 3.14159265389;
-    const int nt = 40;
-    const int ntheta = 20;
-    vector<float> vertices;
-    vector<float> normals;
+    int nt = 40;
+    int ntheta = 20;
+    float normalSign = 1.0f;
+    vector<float> bernstein;            // (nt + 1) x (L + 1) basis table
+    vector<float> bernsteinDeriv;       // (nt + 1) x L derivative basis table
+    vector<float> ringSin;
+    vector<float> ringCos;
+    vector<float> vertices;             // editable surfaces only once uploaded
     vector<unsigned int> indices;
-    vector<float> coordinates;
-    vector<float> texCoords;
-    int verticesStride;                 // # of bytes to hop to the next vertex (should be 24 bytes)
+    unsigned int indexCount = 0;
+    RetainedGeometry retained;
+    MemoryCharge memory;
 
 };
 
@@ -5,18 +5,58 @@
 #include <vector>
 #include <glm/glm.hpp>
 #include "shader.h"
+#include "meshData.h"
+#include "glResource.h"
+#include "textureFeedback.h"
+#include "meshOptimizer.h"
+#include "retainedGeometry.h"
+#include "parametricSurface.h"
 
 class Curtain {
 public:
     Curtain(unsigned int textureID, int waveSegments = 50, float waveAmplitude = 0.2f)
+        : Curtain(buildGeometry(waveSegments, waveAmplitude), textureID, waveSegments, waveAmplitude) {
+    }
+
+    // upload a mesh made by buildGeometry(), which may have run on a worker thread
+    Curtain(MeshData mesh, unsigned int textureID, int waveSegments = 50, float waveAmplitude = 0.2f)
         : textureID(textureID), waveSegments(waveSegments), waveAmplitude(waveAmplitude) {
-        setUpCurtainVertexData();
+        setUpCurtainVertexData(mesh);
+        retained.retain(std::move(mesh), defaultMeshRetention());
+    }
+
+    // CPU half of the constructors: no GL calls, safe on any thread
+    static MeshData buildGeometry(int waveSegments = 50, float waveAmplitude = 0.2f) {
+        float depth = 1.0f;   // Curtain depth (z-axis)
+        float height = 2.0f;  // Curtain height
+        float segmentDepth = depth / waveSegments;
+
+        // the top edge's wave, one sine per column
+        std::vector<float> wave(waveSegments + 1);
+        for (int i = 0; i <= waveSegments; i++)
+            wave[i] = waveAmplitude * sin(i * 2.0f * glm::pi<float>() / waveSegments);
+
+        // row 0 is the straight bottom edge, row 1 the waving top
+        auto curtain = makeParametricSurface([&](int y, int i, float* v) {
+            v[0] = (y == 0) ? 0.0f : wave[i];
+            v[1] = y * height - height / 2.0f;
+            v[2] = -0.5f + i * segmentDepth; // Now varies along z-axis
+            v[3] = static_cast<float>(i) / waveSegments;
+            v[4] = static_cast<float>(y);
+        }, 1, waveSegments, 5);
+
+        MeshData mesh = curtain.build();
+        optimizeMesh(mesh, "curtain");
+        return mesh;
+    }
+
+    // the CPU copy kept under the retention policy, for picking and collision
+    const RetainedGeometry& getRetainedGeometry() const {
+        return retained;
     }
 
-    ~Curtain() {
-        glDeleteVertexArrays(1, &curtainVAO);
-        glDeleteBuffers(1, &curtainVBO);
-        glDeleteBuffers(1, &curtainEBO);
+    void setRetention(MeshRetention retention) {
+        retained.setRetention(retention);
     }
 
     void draw(Shader& shader, glm::mat4 model = glm::mat4(1.0f)) {
@@ -28,59 +68,41 @@ public:
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_2D, textureID);
 
-        glBindVertexArray(curtainVAO);
-        glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(indices.size()), GL_UNSIGNED_INT, 0);
+        glBindVertexArray(curtainVAO.get());
+        glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0);
         glBindVertexArray(0);
+        textureFeedbackLog().record(textureID, curtainVAO.get(), indexCount, GL_UNSIGNED_INT, model, 0, true);
     }
 
 private:
-    unsigned int curtainVAO, curtainVBO, curtainEBO;
+    GlVertexArray curtainVAO;
+    GlBuffer curtainVBO, curtainEBO;
     unsigned int textureID;
     int waveSegments;
     float waveAmplitude;
 
-    std::vector<float> vertices;
-    std::vector<unsigned int> indices;
-
-    void setUpCurtainVertexData() {
-        float depth = 1.0f;   // Curtain depth (z-axis)
-        float height = 2.0f;  // Curtain height
-        float segmentDepth = depth / waveSegments;
+    GLsizei indexCount = 0;
+    RetainedGeometry retained;
 
-        // Generate vertices
-        for (int y = 0; y <= 1; ++y) {  // 0 for bottom, 1 for top
-            for (int i = 0; i <= waveSegments; ++i) {
-                float z = -0.5f + i * segmentDepth; // Now varies along z-axis
-                float x = (y == 0) ? 0.0f : waveAmplitude * sin(i * 2.0f * glm::pi<float>() / waveSegments);
-                float texX = static_cast<float>(i) / waveSegments;
-                float texY = static_cast<float>(y);
-                vertices.insert(vertices.end(), { x, y * height - height / 2.0f, z, texX, texY });
-            }
-        }
-
-        // Generate indices
-        for (int i = 0; i < waveSegments; ++i) {
-            indices.push_back(i);
-            indices.push_back(i + waveSegments + 1);
-            indices.push_back(i + waveSegments + 2);
-
-            indices.push_back(i);
-            indices.push_back(i + waveSegments + 2);
-            indices.push_back(i + 1);
-        }
+    void setUpCurtainVertexData(const MeshData& mesh) {
+        const std::vector<float>& vertices = mesh.vertices;
+        const std::vector<unsigned int>& indices = mesh.indices;
+        indexCount = static_cast<GLsizei>(indices.size());
 
         // VAO, VBO, EBO setup
-        glGenVertexArrays(1, &curtainVAO);
-        glGenBuffers(1, &curtainVBO);
-        glGenBuffers(1, &curtainEBO);
+        curtainVAO = GlVertexArray::create();
+        curtainVBO = GlBuffer::create();
+        curtainEBO = GlBuffer::create();
 
-        glBindVertexArray(curtainVAO);
+        glBindVertexArray(curtainVAO.get());
 
-        glBindBuffer(GL_ARRAY_BUFFER, curtainVBO);
+        glBindBuffer(GL_ARRAY_BUFFER, curtainVBO.get());
         glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+        curtainVBO.chargeMemory(MemoryCategory::Meshes, vertices.size() * sizeof(float));
 
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, curtainEBO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, curtainEBO.get());
         glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+        curtainEBO.chargeMemory(MemoryCategory::Meshes, indices.size() * sizeof(unsigned int));
 
         // Vertex attributes
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
@@ -14,6 +14,10 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include "shader.h"
+#include "glResource.h"
+#include "textureFeedback.h"
+#include "vertexFormat.h"
+#include "primitives.h"
 
 using namespace std;
 
@@ -65,16 +69,6 @@ public:
         setUpCubeVertexDataAndConfigureVertexAttribute();
     }
 
-    // destructor
-    ~Cube()
-    {
-        glDeleteVertexArrays(1, &cubeVAO);
-        glDeleteVertexArrays(1, &lightCubeVAO);
-        glDeleteVertexArrays(1, &lightTexCubeVAO);
-        glDeleteBuffers(1, &cubeVBO);
-        glDeleteBuffers(1, &cubeEBO);
-    }
-
     void drawCubeWithTexture(Shader& lightingShaderWithTexture, glm::mat4 model = glm::mat4(1.0f))
     {
         lightingShaderWithTexture.use();
@@ -91,10 +85,11 @@ public:
         glActiveTexture(GL_TEXTURE1);
         glBindTexture(GL_TEXTURE_2D, this->specularMap);
 
-        lightingShaderWithTexture.setMat4("model", model);
+        lightingShaderWithTexture.setMat4("model", model * layout.dequantize());
 
-        glBindVertexArray(lightTexCubeVAO);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+        glBindVertexArray(lightTexCubeVAO.get());
+        glDrawElements(GL_TRIANGLES, 36, layout.indexType, 0);
+        textureFeedbackLog().record(diffuseMap, lightTexCubeVAO.get(), 36, layout.indexType, model * layout.dequantize());
     }
 
     void drawCubeWithMaterialisticProperty(Shader& lightingShader, glm::mat4 model = glm::mat4(1.0f))
@@ -106,10 +101,10 @@ public:
         lightingShader.setVec3("material.specular", this->specular);
         lightingShader.setFloat("material.shininess", this->shininess);
 
-        lightingShader.setMat4("model", model);
+        lightingShader.setMat4("model", model * layout.dequantize());
 
-        glBindVertexArray(lightCubeVAO);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+        glBindVertexArray(lightCubeVAO.get());
+        glDrawElements(GL_TRIANGLES, 36, layout.indexType, 0);
     }
 
     void drawCube(Shader& shader, glm::mat4 model = glm::mat4(1.0f), float r = 1.0f, float g = 1.0f, float b = 1.0f)
@@ -117,10 +112,10 @@ public:
         shader.use();
 
         shader.setVec3("color", glm::vec3(r, g, b));
-        shader.setMat4("model", model);
+        shader.setMat4("model", model * layout.dequantize());
 
-        glBindVertexArray(cubeVAO);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+        glBindVertexArray(cubeVAO.get());
+        glDrawElements(GL_TRIANGLES, 36, layout.indexType, 0);
     }
 
     void setMaterialisticProperty(glm::vec3 amb, glm::vec3 diff, glm::vec3 spec, float shiny)
@@ -139,124 +134,49 @@ public:
     }
 
 private:
-    unsigned int cubeVAO;
-    unsigned int lightCubeVAO;
-    unsigned int lightTexCubeVAO;
-    unsigned int cubeVBO;
-    unsigned int cubeEBO;
+    // the handles delete the GL objects; a Cube can be moved but not copied
+    GlVertexArray cubeVAO;
+    GlVertexArray lightCubeVAO;
+    GlVertexArray lightTexCubeVAO;
+    GlBuffer cubeVBO;
+    GlBuffer cubeEBO;
+    VertexLayout layout;
 
     void setUpCubeVertexDataAndConfigureVertexAttribute()
     {
         // set up vertex data (and buffer(s)) and configure vertex attributes
         // ------------------------------------------------------------------
 
-        float cube_vertices[] = {
-            // positions          // normals         // texture
-            // back
-            -0.5f, -0.5f, -0.5f,  0.0f, 0.0f, -1.0f,  0.0f, 0.0f,
-             0.5f, -0.5f, -0.5f,  0.0f, 0.0f, -1.0f,  1.0f, 0.0f,
-             0.5f,  0.5f, -0.5f,  0.0f, 0.0f, -1.0f,  1.0f, 1.0f,
-            -0.5f,  0.5f, -0.5f,  0.0f, 0.0f, -1.0f,  0.0f, 1.0f,
-
-            // right
-             0.5f, -0.5f, -0.5f,  1.0f, 0.0f,  0.0f,  0.0f, 0.0f,
-             0.5f,  0.5f, -0.5f,  1.0f, 0.0f,  0.0f,  1.0f, 0.0f,
-             0.5f, -0.5f,  0.5f,  1.0f, 0.0f,  0.0f,  0.0f, 1.0f,
-             0.5f,  0.5f,  0.5f,  1.0f, 0.0f,  0.0f,  1.0f, 1.0f,
-
-             // front
-             -0.5f, -0.5f,  0.5f,  0.0f, 0.0f,  1.0f,  0.0f, 0.0f,
-              0.5f, -0.5f,  0.5f,  0.0f, 0.0f,  1.0f,  1.0f, 0.0f,
-              0.5f,  0.5f,  0.5f,  0.0f, 0.0f,  1.0f,  1.0f, 1.0f,
-             -0.5f,  0.5f,  0.5f,  0.0f, 0.0f,  1.0f,  0.0f, 1.0f,
-
-             // left
-             -0.5f, -0.5f,  0.5f, -1.0f, 0.0f,  0.0f,  0.0f, 0.0f,
-             -0.5f,  0.5f,  0.5f, -1.0f, 0.0f,  0.0f,  1.0f, 0.0f,
-             -0.5f,  0.5f, -0.5f, -1.0f, 0.0f,  0.0f,  1.0f, 1.0f,
-             -0.5f, -0.5f, -0.5f, -1.0f, 0.0f,  0.0f,  0.0f, 1.0f,
-
-             // top
-              0.5f,  0.5f,  0.5f,  0.0f, 1.0f,  0.0f,  0.0f, 0.0f,
-              0.5f,  0.5f, -0.5f,  0.0f, 1.0f,  0.0f,  1.0f, 0.0f,
-             -0.5f,  0.5f, -0.5f,  0.0f, 1.0f,  0.0f,  1.0f, 1.0f,
-             -0.5f,  0.5f,  0.5f,  0.0f, 1.0f,  0.0f,  0.0f, 1.0f,
-
-             // bottom
-             -0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  0.0f, 0.0f,
-              0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  1.0f, 0.0f,
-              0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  1.0f, 1.0f,
-             -0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  0.0f, 1.0f
-        };
-
-
-        unsigned int cube_indices[] = {
-            0, 3, 2,
-            2, 1, 0,
-
-            4, 5, 7,
-            7, 6, 4,
-
-            8, 9, 10,
-            10, 11, 8,
-
-            12, 13, 14,
-            14, 15, 12,
-
-            16, 17, 18,
-            18, 19, 16,
-
-            20, 21, 22,
-            22, 23, 20
-        };
-
-        glGenVertexArrays(1, &cubeVAO);
-        glGenVertexArrays(1, &lightCubeVAO);
-        glGenVertexArrays(1, &lightTexCubeVAO);
-        glGenBuffers(1, &cubeVBO);
-        glGenBuffers(1, &cubeEBO);
-
-
-        glBindVertexArray(lightTexCubeVAO);
-
-        glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(cube_vertices), cube_vertices, GL_STATIC_DRAW);
+        // the unit cube is generated at compile time, see primitives.h
+        const StaticMesh<24, 36>& cube = unitCubeMesh();
 
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cubeEBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(cube_indices), cube_indices, GL_STATIC_DRAW);
+        cubeVAO = GlVertexArray::create();
+        lightCubeVAO = GlVertexArray::create();
+        lightTexCubeVAO = GlVertexArray::create();
 
-        // position attribute
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(0);
 
-        // vertex normal attribute
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)12);
-        glEnableVertexAttribArray(1);
+        glBindVertexArray(lightTexCubeVAO.get());
 
-        // texture coordinate attribute
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)24);
-        glEnableVertexAttribArray(2);
+        layout = uploadVertexData(cube.vertices, cube.vertexCount, cube.indices, cube.indexCount, cubeVBO, cubeEBO);
 
+        // position, vertex normal and texture coordinate attributes
+        setVertexAttributes(layout, 3);
 
-        glBindVertexArray(lightCubeVAO);
 
-        glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cubeEBO);
+        glBindVertexArray(lightCubeVAO.get());
 
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, cubeVBO.get());
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cubeEBO.get());
 
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)12);
-        glEnableVertexAttribArray(1);
+        setVertexAttributes(layout, 2);
 
 
-        glBindVertexArray(cubeVAO);
+        glBindVertexArray(cubeVAO.get());
 
-        glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cubeEBO);
+        glBindBuffer(GL_ARRAY_BUFFER, cubeVBO.get());
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cubeEBO.get());
 
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(0);
+        setVertexAttributes(layout, 1);
     }
 
 };
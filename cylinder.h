@@ -7,6 +7,16 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include "shader.h"
+#include "meshData.h"
+#include "glResource.h"
+#include "textureFeedback.h"
+#include "vertexFormat.h"
+#include "meshOptimizer.h"
+#include "meshSimplifier.h"
+#include "lodSelector.h"
+#include "retainedGeometry.h"
+#include "primitives.h"
+#include "parametricSurface.h"
 #include <cmath>
 
 class Cylinder {
@@ -48,16 +58,124 @@ public:
         setUpCylinderVertexDataAndConfigureVertexAttribute(sectors);
     }
 
-    ~Cylinder()
+    // upload a mesh made by buildGeometry(), which may have run on a worker thread
+    Cylinder(const MeshData& mesh, unsigned int dMap, unsigned int sMap, float shiny, float textureXmin, float textureYmin, float textureXmax, float textureYmax)
     {
-        glDeleteVertexArrays(1, &cylinderVAO);
-        glDeleteVertexArrays(1, &lightCylinderVAO);
-        glDeleteVertexArrays(1, &lightTexCylinderVAO);
-        glDeleteBuffers(1, &cylinderVBO);
-        glDeleteBuffers(1, &cylinderEBO);
+        this->diffuseMap = dMap;
+        this->specularMap = sMap;
+        this->shininess = shiny;
+        this->TXmin = textureXmin;
+        this->TYmin = textureYmin;
+        this->TXmax = textureXmax;
+        this->TYmax = textureYmax;
+        configureVertexAttribute(mesh);
     }
 
-    void drawCylinderWithTexture(Shader& lightingShaderWithTexture, glm::mat4 model = glm::mat4(1.0f))
+    // upload a LOD chain made by buildLodChain(); the draw calls then take a level
+    Cylinder(const LodChain& lods, unsigned int dMap, unsigned int sMap, float shiny, float textureXmin, float textureYmin, float textureXmax, float textureYmax)
+    {
+        this->diffuseMap = dMap;
+        this->specularMap = sMap;
+        this->shininess = shiny;
+        this->TXmin = textureXmin;
+        this->TYmin = textureYmin;
+        this->TXmax = textureXmax;
+        this->TYmax = textureYmax;
+        this->levels = lods.levels;
+        this->boundsCenter = lods.center;
+        this->boundsRadius = lods.radius;
+        configureVertexAttribute(lods.mesh);
+    }
+
+    // same geometry with the tessellation fixed at compile time: the vertices come
+    // from a table the compiler generated, only the optimisation runs here
+    template<int Sectors>
+    static MeshData buildGeometry()
+    {
+        static constexpr auto table = makeCylinder<Sectors>();
+        MeshData mesh = table.toMeshData();
+        optimizeMesh(mesh, "cylinder");
+        return mesh;
+    }
+
+    // CPU half of the constructors: no GL calls, safe on any thread
+    static MeshData buildGeometry(int sectors = 36)
+    {
+        const float radius = 0.5f;
+        const float height = 1.0f;
+
+        std::vector<float> rimX(sectors + 1), rimZ(sectors + 1);
+        for (int j = 0; j <= sectors; j++) {
+            float angle = 2.0f * 3.1416f * float(j) / float(sectors);
+            rimX[j] = radius * cos(angle);
+            rimZ[j] = radius * sin(angle);
+        }
+
+        // each cap is a two-row grid from its centre out to the rim
+        auto cap = [&](float y, float ny, float t) {
+            auto evaluate = [&rimX, &rimZ, sectors, y, ny, t](int i, int j, float* v) {
+                bool rim = i == 1;
+                v[0] = rim ? rimX[j] : 0.0f;
+                v[1] = y;
+                v[2] = rim ? rimZ[j] : 0.0f;
+                v[3] = 0.0f;
+                v[4] = ny;
+                v[5] = 0.0f;
+                v[6] = rim ? float(j) / float(sectors) : 0.5f;
+                v[7] = rim ? t : 0.5f;
+            };
+            auto grid = makeParametricSurface(evaluate, 1, sectors);
+            grid.collapsedFirstRow = true;
+            return grid;
+        };
+        auto topCap = cap(height / 2, 1.0f, 1.0f);
+        auto bottomCap = cap(-height / 2, -1.0f, 0.0f);
+
+        // the side runs from the top rim (row 0) down to the bottom rim
+        auto side = makeParametricSurface([&](int i, int j, float* v) {
+            v[0] = rimX[j];
+            v[1] = i == 0 ? height / 2 : -height / 2;
+            v[2] = rimZ[j];
+            v[3] = rimX[j];
+            v[4] = 0.0f;
+            v[5] = rimZ[j];
+            v[6] = float(j) / float(sectors);
+            v[7] = i == 0 ? 1.0f : 0.0f;
+        }, 1, sectors);
+
+        MeshData mesh;
+        mesh.vertices.reserve((topCap.getVertexCount() + bottomCap.getVertexCount() + side.getVertexCount()) * 8);
+        mesh.indices.reserve(topCap.getIndexCount() + bottomCap.getIndexCount() + side.getIndexCount());
+        topCap.appendTo(mesh);
+        bottomCap.appendTo(mesh);
+        side.appendTo(mesh);
+
+        optimizeMesh(mesh, "cylinder");
+        return mesh;
+    }
+
+    // the CPU copy kept under the retention policy, for picking and collision
+    const RetainedGeometry& getRetainedGeometry() const
+    {
+        return retained;
+    }
+
+    void setRetention(MeshRetention retention)
+    {
+        retained.setRetention(retention);
+    }
+
+    int getLevelCount() const
+    {
+        return (int)levels.size();
+    }
+
+    int selectLevel(const LodSelector& selector, const glm::mat4& model, glm::vec3 cameraPos) const
+    {
+        return selector.select(levels, boundsCenter, boundsRadius, model, cameraPos);
+    }
+
+    void drawCylinderWithTexture(Shader& lightingShaderWithTexture, glm::mat4 model = glm::mat4(1.0f), int level = 0)
     {
         lightingShaderWithTexture.use();
 
@@ -70,13 +188,16 @@ public:
         glActiveTexture(GL_TEXTURE1);
         glBindTexture(GL_TEXTURE_2D, this->specularMap);
 
-        lightingShaderWithTexture.setMat4("model", model);
+        lightingShaderWithTexture.setMat4("model", model * layout.dequantize());
 
-        glBindVertexArray(lightTexCylinderVAO);
-        glDrawElements(GL_TRIANGLES, numIndices, GL_UNSIGNED_INT, 0);
+        glBindVertexArray(lightTexCylinderVAO.get());
+        drawLevel(level);
+        const LodLevel& range = getLevel(level);
+        textureFeedbackLog().record(diffuseMap, lightTexCylinderVAO.get(), range.indexCount, layout.indexType, model * layout.dequantize(),
+            (size_t)range.firstIndex * layout.indexSize());
     }
 
-    void drawCylinderWithMaterialisticProperty(Shader& lightingShader, glm::mat4 model = glm::mat4(1.0f))
+    void drawCylinderWithMaterialisticProperty(Shader& lightingShader, glm::mat4 model = glm::mat4(1.0f), int level = 0)
     {
         lightingShader.use();
 
@@ -85,151 +206,91 @@ public:
         lightingShader.setVec3("material.specular", this->specular);
         lightingShader.setFloat("material.shininess", this->shininess);
 
-        lightingShader.setMat4("model", model);
+        lightingShader.setMat4("model", model * layout.dequantize());
 
-        glBindVertexArray(lightCylinderVAO);
-        glDrawElements(GL_TRIANGLES, numIndices, GL_UNSIGNED_INT, 0);
+        glBindVertexArray(lightCylinderVAO.get());
+        drawLevel(level);
     }
 
-    void drawCylinder(Shader& shader, glm::mat4 model = glm::mat4(1.0f), float r = 1.0f, float g = 1.0f, float b = 1.0f)
+    void drawCylinder(Shader& shader, glm::mat4 model = glm::mat4(1.0f), float r = 1.0f, float g = 1.0f, float b = 1.0f, int level = 0)
     {
         shader.use();
         shader.setVec3("color", glm::vec3(r, g, b));
-        shader.setMat4("model", model);
+        shader.setMat4("model", model * layout.dequantize());
+
+        glBindVertexArray(cylinderVAO.get());
+        drawLevel(level);
+    }
+
+    // bounding sphere of the full detail mesh, in object space
+    glm::vec3 getBoundsCenter() const
+    {
+        return boundsCenter;
+    }
 
-        glBindVertexArray(cylinderVAO);
-        glDrawElements(GL_TRIANGLES, numIndices, GL_UNSIGNED_INT, 0);
+    float getBoundsRadius() const
+    {
+        return boundsRadius;
     }
 
 private:
-    unsigned int cylinderVAO;
-    unsigned int lightCylinderVAO;
-    unsigned int lightTexCylinderVAO;
-    unsigned int cylinderVBO;
-    unsigned int cylinderEBO;
-    int numIndices;
+    GlVertexArray cylinderVAO;
+    GlVertexArray lightCylinderVAO;
+    GlVertexArray lightTexCylinderVAO;
+    GlBuffer cylinderVBO;
+    GlBuffer cylinderEBO;
+    VertexLayout layout;
+
+    // index ranges into the shared EBO, finest first; a plain mesh has one
+    std::vector<LodLevel> levels;
+    glm::vec3 boundsCenter = glm::vec3(0.0f);
+    float boundsRadius = 0.0f;
+    RetainedGeometry retained;
+
+    const LodLevel& getLevel(int level) const
+    {
+        return levels[std::min(std::max(level, 0), (int)levels.size() - 1)];
+    }
+
+    void drawLevel(int level)
+    {
+        const LodLevel& range = getLevel(level);
+        glDrawElements(GL_TRIANGLES, range.indexCount, layout.indexType, (void*)((size_t)range.firstIndex * layout.indexSize()));
+    }
 
     void setUpCylinderVertexDataAndConfigureVertexAttribute(int sectors)
     {
-        std::vector<float> vertices;
-        std::vector<unsigned int> indices;
-        const float radius = 0.5f;
-        const float height = 1.0f;
+        configureVertexAttribute(buildGeometry(sectors));
+    }
 
-        // Top and bottom center vertices
-        vertices.push_back(0.0f); vertices.push_back(height / 2); vertices.push_back(0.0f);  // normal
-        vertices.push_back(0.0f); vertices.push_back(1.0f); vertices.push_back(0.0f);      // texture
-        vertices.push_back(0.5f); vertices.push_back(0.5f);
-
-        vertices.push_back(0.0f); vertices.push_back(-height / 2); vertices.push_back(0.0f); // normal
-        vertices.push_back(0.0f); vertices.push_back(-1.0f); vertices.push_back(0.0f);     // texture
-        vertices.push_back(0.5f); vertices.push_back(0.5f);
-
-        // Add vertices for the sides
-        for (int i = 0; i <= sectors; i++) {
-            float angle = 2.0f * 3.1416f * float(i) / float(sectors);
-            float x = radius * cos(angle);
-            float z = radius * sin(angle);
-            float u = float(i) / float(sectors);
-
-            // Top rim
-            vertices.push_back(x);
-            vertices.push_back(height / 2);
-            vertices.push_back(z);
-            vertices.push_back(0.0f);
-            vertices.push_back(1.0f);
-            vertices.push_back(0.0f);
-            vertices.push_back(u);
-            vertices.push_back(1.0f);
-
-            // Bottom rim
-            vertices.push_back(x);
-            vertices.push_back(-height / 2);
-            vertices.push_back(z);
-            vertices.push_back(0.0f);
-            vertices.push_back(-1.0f);
-            vertices.push_back(0.0f);
-            vertices.push_back(u);
-            vertices.push_back(0.0f);
-
-            // Side
-            vertices.push_back(x);
-            vertices.push_back(height / 2);
-            vertices.push_back(z);
-            vertices.push_back(x);
-            vertices.push_back(0.0f);
-            vertices.push_back(z);
-            vertices.push_back(u);
-            vertices.push_back(1.0f);
-
-            vertices.push_back(x);
-            vertices.push_back(-height / 2);
-            vertices.push_back(z);
-            vertices.push_back(x);
-            vertices.push_back(0.0f);
-            vertices.push_back(z);
-            vertices.push_back(u);
-            vertices.push_back(0.0f);
-        }
+    void configureVertexAttribute(const MeshData& mesh)
+    {
+        const std::vector<float>& vertices = mesh.vertices;
+        const std::vector<unsigned int>& indices = mesh.indices;
 
-        // Generate indices
-        for (int i = 0; i < sectors; i++) {
-            int baseIndex = 2 + (i * 4);
+        if (levels.empty())
+            levels.push_back({ 0, (unsigned int)indices.size(), 0.0f });
 
-            // Top face
-            indices.push_back(0);
-            indices.push_back(baseIndex);
-            indices.push_back(baseIndex + 4);
+        cylinderVAO = GlVertexArray::create();
+        lightCylinderVAO = GlVertexArray::create();
+        lightTexCylinderVAO = GlVertexArray::create();
 
-            // Bottom face
-            indices.push_back(1);
-            indices.push_back(baseIndex + 1);
-            indices.push_back(baseIndex + 5);
+        glBindVertexArray(lightTexCylinderVAO.get());
+        layout = uploadVertexData(vertices, indices, cylinderVBO, cylinderEBO);
+        setVertexAttributes(layout, 3);
 
-            // Side faces
-            indices.push_back(baseIndex + 2);
-            indices.push_back(baseIndex + 3);
-            indices.push_back(baseIndex + 6);
+        glBindVertexArray(lightCylinderVAO.get());
+        glBindBuffer(GL_ARRAY_BUFFER, cylinderVBO.get());
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cylinderEBO.get());
+        setVertexAttributes(layout, 2);
 
-            indices.push_back(baseIndex + 3);
-            indices.push_back(baseIndex + 7);
-            indices.push_back(baseIndex + 6);
-        }
+        glBindVertexArray(cylinderVAO.get());
+        glBindBuffer(GL_ARRAY_BUFFER, cylinderVBO.get());
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cylinderEBO.get());
+        setVertexAttributes(layout, 1);
 
-        numIndices = indices.size();
-
-        glGenVertexArrays(1, &cylinderVAO);
-        glGenVertexArrays(1, &lightCylinderVAO);
-        glGenVertexArrays(1, &lightTexCylinderVAO);
-        glGenBuffers(1, &cylinderVBO);
-        glGenBuffers(1, &cylinderEBO);
-
-        glBindVertexArray(lightTexCylinderVAO);
-        glBindBuffer(GL_ARRAY_BUFFER, cylinderVBO);
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cylinderEBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
-
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-        glEnableVertexAttribArray(2);
-
-        glBindVertexArray(lightCylinderVAO);
-        glBindBuffer(GL_ARRAY_BUFFER, cylinderVBO);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cylinderEBO);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-        glEnableVertexAttribArray(1);
-
-        glBindVertexArray(cylinderVAO);
-        glBindBuffer(GL_ARRAY_BUFFER, cylinderVBO);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cylinderEBO);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(0);
+        // a LOD chain keeps its finest level only
+        retained.retain(mesh, defaultMeshRetention(), levels[0].indexCount);
     }
 };
 
@@ -14,6 +14,12 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include "shader.h"
+#include "meshData.h"
+#include "glResource.h"
+#include "textureFeedback.h"
+#include "meshOptimizer.h"
+#include "retainedGeometry.h"
+#include "parametricSurface.h"
 
 class Flag {
 public:
@@ -50,11 +56,43 @@ public:
         setUpFlagVertexDataAndConfigureVertexAttributes();
     }
 
-    // destructor
-    ~Flag() {
-        glDeleteVertexArrays(1, &flagVAO);
-        glDeleteBuffers(1, &flagVBO);
-        glDeleteBuffers(1, &flagEBO);
+    // upload a mesh made by buildGeometry(), which may have run on a worker thread
+    Flag(const MeshData& mesh, unsigned int dMap, unsigned int sMap, float shiny, float waveAmp, float waveSpd)
+        : diffuseMap(dMap), specularMap(sMap), shininess(shiny),
+        waveAmplitude(waveAmp), waveSpeed(waveSpd) {
+        configureVertexAttributes(mesh);
+    }
+
+    // CPU half of the constructors: no GL calls, safe on any thread
+    static MeshData buildGeometry() {
+        // Example flag vertices and indices for a simple grid
+        const int widthSegments = 20;
+        const int heightSegments = 10;
+        const float width = 1.0f;
+        const float height = 0.5f;
+
+        auto flag = makeParametricSurface([=](int y, int x, float* v) {
+            float u = (float)x / widthSegments;
+            float t = (float)y / heightSegments;
+            v[0] = width * (u - 0.5f);
+            v[1] = height * (t - 0.5f);
+            v[2] = 0.0f;    // z-coordinate
+            v[3] = u;       // texture u
+            v[4] = t;       // texture v
+        }, heightSegments, widthSegments, 5);
+
+        MeshData mesh = flag.build();
+        optimizeMesh(mesh, "flag");
+        return mesh;
+    }
+
+    // the CPU copy kept under the retention policy, for picking and collision
+    const RetainedGeometry& getRetainedGeometry() const {
+        return retained;
+    }
+
+    void setRetention(MeshRetention retention) {
+        retained.setRetention(retention);
     }
 
     // draw function
@@ -81,65 +119,42 @@ public:
         // set transformation
         shader.setMat4("model", model);
 
-        glBindVertexArray(flagVAO);
+        glBindVertexArray(flagVAO.get());
         glDrawElements(GL_TRIANGLES, indicesCount, GL_UNSIGNED_INT, 0);
+        // replayed without the wave, which barely changes how the texture is sampled
+        textureFeedbackLog().record(diffuseMap, flagVAO.get(), indicesCount, GL_UNSIGNED_INT, model, 0, true);
     }
 
 private:
-    unsigned int flagVAO, flagVBO, flagEBO;
+    GlVertexArray flagVAO;
+    GlBuffer flagVBO, flagEBO;
     int indicesCount;
+    RetainedGeometry retained;
 
     void setUpFlagVertexDataAndConfigureVertexAttributes() {
-        // Example flag vertices and indices for a simple grid
-        std::vector<float> vertices;
-        std::vector<unsigned int> indices;
-
-        const int widthSegments = 20;
-        const int heightSegments = 10;
-        const float width = 1.0f;
-        const float height = 0.5f;
+        configureVertexAttributes(buildGeometry());
+    }
 
-        for (int y = 0; y <= heightSegments; ++y) {
-            for (int x = 0; x <= widthSegments; ++x) {
-                float u = (float)x / widthSegments;
-                float v = (float)y / heightSegments;
-                vertices.push_back(width * (u - 0.5f));
-                vertices.push_back(height * (v - 0.5f));
-                vertices.push_back(0.0f); // z-coordinate
-                vertices.push_back(u);    // texture u
-                vertices.push_back(v);    // texture v
-            }
-        }
-
-        for (int y = 0; y < heightSegments; ++y) {
-            for (int x = 0; x < widthSegments; ++x) {
-                int topLeft = y * (widthSegments + 1) + x;
-                int bottomLeft = (y + 1) * (widthSegments + 1) + x;
-
-                indices.push_back(topLeft);
-                indices.push_back(bottomLeft);
-                indices.push_back(topLeft + 1);
-
-                indices.push_back(topLeft + 1);
-                indices.push_back(bottomLeft);
-                indices.push_back(bottomLeft + 1);
-            }
-        }
+    void configureVertexAttributes(const MeshData& mesh) {
+        const std::vector<float>& vertices = mesh.vertices;
+        const std::vector<unsigned int>& indices = mesh.indices;
 
         indicesCount = indices.size();
 
         // OpenGL setup
-        glGenVertexArrays(1, &flagVAO);
-        glGenBuffers(1, &flagVBO);
-        glGenBuffers(1, &flagEBO);
+        flagVAO = GlVertexArray::create();
+        flagVBO = GlBuffer::create();
+        flagEBO = GlBuffer::create();
 
-        glBindVertexArray(flagVAO);
+        glBindVertexArray(flagVAO.get());
 
-        glBindBuffer(GL_ARRAY_BUFFER, flagVBO);
+        glBindBuffer(GL_ARRAY_BUFFER, flagVBO.get());
         glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+        flagVBO.chargeMemory(MemoryCategory::Meshes, vertices.size() * sizeof(float));
 
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, flagEBO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, flagEBO.get());
         glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+        flagEBO.chargeMemory(MemoryCategory::Meshes, indices.size() * sizeof(unsigned int));
 
         // position attribute
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
@@ -148,6 +163,8 @@ private:
         // texture coordinate attribute
         glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
         glEnableVertexAttribArray(1);
+
+        retained.retain(mesh, defaultMeshRetention());
     }
 };
 
@@ -0,0 +1,162 @@
+#ifndef floorDetail_h
+#define floorDetail_h
+
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "textureCache.h"
+#include "textureCompressor.h"
+#include "virtualTextureFile.h"
+
+// the hall floor as one unique texture, the VirtualTextureSource the floor's virtual
+// texture is baked from: the floor boards tiled as the plain floor texture tiles
+// them, with painted aisle markings on top and the boards worn along the aisles.
+// the texture spans the floor's top face once. designers' own bakes can replace
+// this with any other source; its stamp is part of the cache file's key
+class FloorDetailSource
+{
+public:
+    // bump when the markings or the wear change, so the file is baked again
+    static const int version = 1;
+
+    FloorDetailSource(const std::string& tilePath, int tilesPerSide, int virtualSize)
+        : tile(std::make_shared<Tile>()), tilesPerSide(tilesPerSide), virtualSize(virtualSize)
+    {
+        tile->path = tilePath;
+    }
+
+    std::string getStamp() const
+    {
+        return textureSourceStamp(tile->path) + " floor " + std::to_string(version) + " " + std::to_string(tilesPerSide);
+    }
+
+    void operator()(int level, int x, int y, int size, unsigned char* rgba) const
+    {
+        // the board image is only decoded once some page is actually baked
+        std::call_once(tile->decoded, [this] { tile->decode(); });
+
+        int levelSize = std::max(1, virtualSize >> level);
+        float texel = 1.0f / levelSize;
+        for (int row = 0; row < size; row++)
+            for (int column = 0; column < size; column++)
+            {
+                float u = (std::min(std::max(x + column, 0), levelSize - 1) + 0.5f) * texel;
+                float v = (std::min(std::max(y + row, 0), levelSize - 1) + 0.5f) * texel;
+                shade(u, v, texel, rgba + ((size_t)row * size + column) * 4);
+            }
+    }
+
+private:
+    struct Tile
+    {
+        std::string path;
+        std::once_flag decoded;
+        std::vector<RgbaImage> levels;  // mip chain of the board image
+
+        void decode()
+        {
+            RgbaImage image;
+            if (!loadRgbaImage(path, image))
+            {
+                image.width = image.height = 1;
+                image.pixels.assign(4, 128);
+            }
+            levels = buildMipChain(std::move(image));
+        }
+    };
+
+    std::shared_ptr<Tile> tile;
+    int tilesPerSide;
+    int virtualSize;
+
+    // one texel of texel size at (u, v)
+    void shade(float u, float v, float texel, unsigned char* out) const
+    {
+        // aisle centres across u, and the painted edge lines' distance from them and width
+        const float aisles[2] = { 1.0f / 3.0f, 2.0f / 3.0f };
+        const float aisleHalfWidth = 0.025f;
+        const float lineWidth = 0.003f;
+
+        float colour[3];
+        sampleBoards(u, v, texel, colour);
+
+        float wear = 0.0f, paint = 0.0f;
+        for (float aisle : aisles)
+        {
+            float across = (u - aisle) / aisleHalfWidth;
+            wear = std::max(wear, expf(-across * across));
+            paint += coverage(fabsf(u - aisle) - aisleHalfWidth, lineWidth * 0.5f, texel);
+        }
+        // the paint stops short of the floor's front and back edges
+        paint *= coverage(fabsf(v - 0.5f) - 0.225f, 0.225f, texel);
+        wear *= 0.6f + 0.4f * valueNoise(u * 60.0f, v * 60.0f);
+
+        const float lineColour[3] = { 220.0f, 180.0f, 40.0f };
+        for (int c = 0; c < 3; c++)
+        {
+            float worn = colour[c] * (1.0f - 0.3f * wear);
+            float value = worn + (lineColour[c] * (1.0f - 0.4f * wear) - worn) * std::min(paint, 1.0f);
+            out[c] = (unsigned char)std::min(std::max(value + 0.5f, 0.0f), 255.0f);
+        }
+        out[3] = 255;
+    }
+
+    // the share of a texel of size texel, centred distance from a band's centre line,
+    // that falls inside the band of the given half width
+    static float coverage(float distance, float halfWidth, float texel)
+    {
+        float inside = std::min(distance + texel * 0.5f, halfWidth) - std::max(distance - texel * 0.5f, -halfWidth);
+        return std::max(inside, 0.0f) / texel;
+    }
+
+    // bilinear from the board mip level nearest to texel's footprint, wrapping
+    void sampleBoards(float u, float v, float texel, float* colour) const
+    {
+        const std::vector<RgbaImage>& levels = tile->levels;
+        float scale = levels[0].width * tilesPerSide * texel;
+        int level = std::min(std::max((int)floorf(log2f(std::max(scale, 1.0f)) + 0.5f), 0), (int)levels.size() - 1);
+        const RgbaImage& image = levels[level];
+
+        float s = u * tilesPerSide * image.width - 0.5f, t = v * tilesPerSide * image.height - 0.5f;
+        int s0 = (int)floorf(s), t0 = (int)floorf(t);
+        float fs = s - s0, ft = t - t0;
+        auto at = [&](int x, int y, int c) {
+            x = (x % image.width + image.width) % image.width;
+            y = (y % image.height + image.height) % image.height;
+            return (float)image.pixels[((size_t)y * image.width + x) * 4 + c];
+        };
+        for (int c = 0; c < 3; c++)
+        {
+            float bottom = at(s0, t0, c) + (at(s0 + 1, t0, c) - at(s0, t0, c)) * fs;
+            float top = at(s0, t0 + 1, c) + (at(s0 + 1, t0 + 1, c) - at(s0, t0 + 1, c)) * fs;
+            colour[c] = bottom + (top - bottom) * ft;
+        }
+    }
+
+    // smooth noise in [0, 1] on a unit lattice
+    static float valueNoise(float x, float y)
+    {
+        int x0 = (int)floorf(x), y0 = (int)floorf(y);
+        float fx = x - x0, fy = y - y0;
+        fx = fx * fx * (3.0f - 2.0f * fx);
+        fy = fy * fy * (3.0f - 2.0f * fy);
+        float a = latticeValue(x0, y0), b = latticeValue(x0 + 1, y0);
+        float c = latticeValue(x0, y0 + 1), d = latticeValue(x0 + 1, y0 + 1);
+        return (a + (b - a) * fx) + ((c + (d - c) * fx) - (a + (b - a) * fx)) * fy;
+    }
+
+    static float latticeValue(int x, int y)
+    {
+        uint32_t hash = (uint32_t)x * 0x8da6b343u ^ (uint32_t)y * 0xd8163841u;
+        hash ^= hash >> 13;
+        hash *= 0x5bd1e995u;
+        hash ^= hash >> 15;
+        return (hash & 0xffff) / 65535.0f;
+    }
+};
+
+#endif /* floorDetail_h */
@@ -0,0 +1,400 @@
+#ifndef forest_h
+#define forest_h
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <vector>
+#include <algorithm>
+#include "shader.h"
+#include "fractal.h"
+#include "glResource.h"
+
+using namespace std;
+
+// many trees from a few FractalTree archetypes. near trees are drawn as instanced
+// lines and leaf points, far ones as camera-facing cards cut from an impostor atlas
+// that is rendered once. every frame costs at most two draws per archetype plus one
+// for all the cards, however many trees are planted
+class Forest {
+public:
+    static const int maxArchetypes = 4;     // matches the uniform arrays in the impostor shader
+
+    glm::vec3 branchColor;
+    glm::vec3 leafColor;
+    float impostorDistance;     // trees further than this from the camera become cards
+    float swayAmplitude = 0.15f;
+
+    Forest(const std::vector<TreeGeometry>& geometries, glm::vec3 branchColor = glm::vec3(0.35f, 0.22f, 0.1f),
+        glm::vec3 leafColor = glm::vec3(0.0f, 0.6f, 0.1f), float impostorDistance = 25.0f)
+    {
+        this->branchColor = branchColor;
+        this->leafColor = leafColor;
+        this->impostorDistance = impostorDistance;
+        setUpArchetypes(geometries);
+        setUpImpostorCard();
+    }
+
+    // archetype, yaw, size, sway phase and tint all come from the seed, so the same
+    // seed always plants the same tree
+    void plant(glm::vec3 position, unsigned int seed)
+    {
+        if (archetypes.empty())
+            return;
+        unsigned long long bits = FractalTree::counterHash(seed, 0);
+        TreeInstance tree;
+        tree.placement = glm::vec4(position, unitRange(bits) * 2.0f * glm::pi<float>());
+        tree.variation.x = 0.8f + 0.5f * unitRange(bits >> 16);              // scale
+        tree.variation.y = unitRange(bits >> 32) * 2.0f * glm::pi<float>();   // sway phase
+        tree.variation.z = 0.8f + 0.4f * unitRange(bits >> 48);              // tint
+        tree.variation.w = (float)(FractalTree::counterHash(seed, 1) % archetypes.size());
+        trees.push_back(tree);
+    }
+
+    // count trees spread over the rectangle between two corners on the plane y = corner.y
+    void scatter(int count, glm::vec3 minCorner, glm::vec3 maxCorner, unsigned int seed)
+    {
+        trees.reserve(trees.size() + count);
+        for (int i = 0; i < count; i++)
+        {
+            unsigned long long bits = FractalTree::counterHash(seed, 2ull * i);
+            glm::vec3 position(minCorner.x + (maxCorner.x - minCorner.x) * unitRange(bits),
+                minCorner.y,
+                minCorner.z + (maxCorner.z - minCorner.z) * unitRange(bits >> 32));
+            plant(position, (unsigned int)FractalTree::counterHash(seed, 2ull * i + 1));
+        }
+    }
+
+    void draw(Shader& treeShader, Shader& impostorShader, glm::mat4 view, glm::mat4 projection, glm::vec3 cameraPosition, float time)
+    {
+        if (!impostorsCaptured)
+            captureImpostors(treeShader);
+
+        sortInstances(cameraPosition);
+        drawCallCount = 0;
+
+        treeShader.use();
+        treeShader.setMat4("view", view);
+        treeShader.setMat4("projection", projection);
+        treeShader.setFloat("time", time);
+        treeShader.setFloat("swayAmplitude", swayAmplitude);
+        for (size_t a = 0; a < archetypes.size(); a++)
+        {
+            if (nearCounts[a] == 0)
+                continue;
+            treeShader.setFloat("treeHeight", archetypes[a].maxY);
+
+            treeShader.setVec3("color", branchColor);
+            glLineWidth(2.0f);
+            glBindVertexArray(branchVAO.get());
+            pointInstanceAttributes(nearFirsts[a]);
+            glDrawArraysInstanced(GL_LINES, archetypes[a].firstBranchVertex, archetypes[a].branchVertexCount, nearCounts[a]);
+            glLineWidth(1.0f);
+
+            treeShader.setVec3("color", leafColor);
+            glPointSize(3.0f);
+            glBindVertexArray(leafVAO.get());
+            pointInstanceAttributes(nearFirsts[a]);
+            glDrawArraysInstanced(GL_POINTS, archetypes[a].firstLeafVertex, archetypes[a].leafVertexCount, nearCounts[a]);
+            drawCallCount += 2;
+        }
+
+        if (farCount > 0)
+        {
+            impostorShader.use();
+            impostorShader.setMat4("view", view);
+            impostorShader.setMat4("projection", projection);
+            impostorShader.setFloat("time", time);
+            impostorShader.setFloat("swayAmplitude", swayAmplitude);
+            impostorShader.setInt("impostorAtlas", 0);
+            for (size_t a = 0; a < archetypes.size(); a++)
+            {
+                string index = "[" + to_string(a) + "]";
+                impostorShader.setVec4("cardBounds" + index, glm::vec4(archetypes[a].minX, archetypes[a].maxX, archetypes[a].minY, archetypes[a].maxY));
+                impostorShader.setVec4("atlasRects" + index, atlasRect((int)a));
+            }
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, impostorAtlas.get());
+            glBindVertexArray(impostorVAO.get());
+            pointInstanceAttributes(farFirst);
+            glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, farCount);
+            drawCallCount++;
+        }
+        glBindVertexArray(0);
+    }
+
+    int getTreeCount() const
+    {
+        return (int)trees.size();
+    }
+
+    int getLastDrawCallCount() const
+    {
+        return drawCallCount;
+    }
+
+private:
+    struct Archetype {
+        GLint firstBranchVertex, branchVertexCount;
+        GLint firstLeafVertex, leafVertexCount;
+        float minX, maxX, minY, maxY;   // bounds in the tree's plane, used for the card
+    };
+
+    // per-instance attributes, locations 1 and 2 in both forest shaders
+    struct TreeInstance {
+        glm::vec4 placement;    // xyz position, w yaw
+        glm::vec4 variation;    // x scale, y sway phase, z tint, w archetype
+    };
+
+    static const int atlasCellSize = 256;
+
+    std::vector<Archetype> archetypes;
+    std::vector<TreeInstance> trees;
+    std::vector<TreeInstance> frameInstances;   // trees regrouped every frame: near per archetype, then far
+    std::vector<char> farFlags;
+    int nearFirsts[maxArchetypes] = {};
+    int nearCounts[maxArchetypes] = {};
+    int farFirst = 0, farCount = 0;
+    int drawCallCount = 0;
+
+    GlVertexArray branchVAO, leafVAO, impostorVAO;
+    GlBuffer branchVBO, leafVBO, cardVBO, instanceVBO;
+    GlTexture impostorAtlas;
+    MemoryCharge instanceMemory = MemoryCharge(MemoryCategory::Instances, 0, 0);
+    bool impostorsCaptured = false;
+
+    static float unitRange(unsigned long long bits)
+    {
+        return (bits & 0xFFFF) / 65536.0f;
+    }
+
+    // all archetypes share one branch buffer and one leaf buffer
+    void setUpArchetypes(const std::vector<TreeGeometry>& geometries)
+    {
+        std::vector<float> branchVertices, leafVertices;
+        for (size_t i = 0; i < geometries.size() && archetypes.size() < maxArchetypes; i++)
+        {
+            const TreeGeometry& geometry = geometries[i];
+            Archetype archetype;
+            archetype.firstBranchVertex = (GLint)(branchVertices.size() / 3);
+            archetype.branchVertexCount = (GLint)(geometry.branches.vertices.size() / 3);
+            archetype.firstLeafVertex = (GLint)(leafVertices.size() / 3);
+            archetype.leafVertexCount = (GLint)(geometry.leaves.vertices.size() / 3);
+            archetype.minX = archetype.minY = 0.0f;
+            archetype.maxX = archetype.maxY = 0.0f;
+            const std::vector<float>* sets[2] = { &geometry.branches.vertices, &geometry.leaves.vertices };
+            for (const std::vector<float>* set : sets)
+            {
+                for (size_t v = 0; v < set->size(); v += 3)
+                {
+                    archetype.minX = std::min(archetype.minX, (*set)[v]);
+                    archetype.maxX = std::max(archetype.maxX, (*set)[v]);
+                    archetype.minY = std::min(archetype.minY, (*set)[v + 1]);
+                    archetype.maxY = std::max(archetype.maxY, (*set)[v + 1]);
+                }
+            }
+            branchVertices.insert(branchVertices.end(), geometry.branches.vertices.begin(), geometry.branches.vertices.end());
+            leafVertices.insert(leafVertices.end(), geometry.leaves.vertices.begin(), geometry.leaves.vertices.end());
+            archetypes.push_back(archetype);
+        }
+
+        instanceVBO = GlBuffer::create();
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO.get());
+        glBufferData(GL_ARRAY_BUFFER, sizeof(TreeInstance), nullptr, GL_STREAM_DRAW);
+        instanceVBO.chargeMemory(MemoryCategory::Instances, sizeof(TreeInstance));
+
+        branchVBO = setUpTreeVAO(branchVAO, branchVertices);
+        leafVBO = setUpTreeVAO(leafVAO, leafVertices);
+    }
+
+    GlBuffer setUpTreeVAO(GlVertexArray& vao, const std::vector<float>& vertices)
+    {
+        vao = GlVertexArray::create();
+        GlBuffer vbo = GlBuffer::create();
+        glBindVertexArray(vao.get());
+
+        glBindBuffer(GL_ARRAY_BUFFER, vbo.get());
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+        vbo.chargeMemory(MemoryCategory::Trees, vertices.size() * sizeof(float));
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(0);
+
+        enableInstanceAttributes();
+        glBindVertexArray(0);
+        return vbo;
+    }
+
+    void setUpImpostorCard()
+    {
+        // unit card standing on its base: x across, y up
+        float corners[] = {
+            0.0f, 0.0f,
+            1.0f, 0.0f,
+            0.0f, 1.0f,
+            1.0f, 1.0f,
+        };
+        impostorVAO = GlVertexArray::create();
+        cardVBO = GlBuffer::create();
+        glBindVertexArray(impostorVAO.get());
+
+        glBindBuffer(GL_ARRAY_BUFFER, cardVBO.get());
+        glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+        cardVBO.chargeMemory(MemoryCategory::Trees, sizeof(corners));
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(0);
+
+        enableInstanceAttributes();
+        glBindVertexArray(0);
+    }
+
+    void enableInstanceAttributes()
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO.get());
+        glEnableVertexAttribArray(1);
+        glEnableVertexAttribArray(2);
+        glVertexAttribDivisor(1, 1);
+        glVertexAttribDivisor(2, 1);
+        pointInstanceAttributes(0);
+    }
+
+    // GL 3.3 has no base instance, so each draw re-points the instance attributes of
+    // the bound VAO at its own run of frameInstances
+    void pointInstanceAttributes(int firstInstance)
+    {
+        size_t offset = firstInstance * sizeof(TreeInstance);
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO.get());
+        glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(TreeInstance), (void*)offset);
+        glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(TreeInstance), (void*)(offset + sizeof(glm::vec4)));
+    }
+
+    // regroups the trees into contiguous runs, one per near archetype and one for the
+    // cards, and streams them into the instance buffer
+    void sortInstances(glm::vec3 cameraPosition)
+    {
+        int archetypeCount = (int)archetypes.size();
+        std::vector<char>& isFar = farFlags;
+        isFar.resize(trees.size());
+        float farSquared = impostorDistance * impostorDistance;
+        for (int a = 0; a < archetypeCount; a++)
+            nearCounts[a] = 0;
+        farCount = 0;
+
+        for (size_t i = 0; i < trees.size(); i++)
+        {
+            glm::vec3 offset = glm::vec3(trees[i].placement) - cameraPosition;
+            isFar[i] = glm::dot(offset, offset) > farSquared;
+            if (isFar[i])
+                farCount++;
+            else
+                nearCounts[(int)trees[i].variation.w]++;
+        }
+
+        int next[maxArchetypes];
+        int first = 0;
+        for (int a = 0; a < archetypeCount; a++)
+        {
+            nearFirsts[a] = next[a] = first;
+            first += nearCounts[a];
+        }
+        farFirst = first;
+        int nextFar = farFirst;
+
+        frameInstances.resize(trees.size());
+        for (size_t i = 0; i < trees.size(); i++)
+        {
+            int slot = isFar[i] ? nextFar++ : next[(int)trees[i].variation.w]++;
+            frameInstances[slot] = trees[i];
+        }
+
+        // orphan the old storage so the driver does not wait on last frame's draws
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO.get());
+        size_t instanceBytes = std::max<size_t>(frameInstances.size(), 1) * sizeof(TreeInstance);
+        glBufferData(GL_ARRAY_BUFFER, instanceBytes, nullptr, GL_STREAM_DRAW);
+        instanceVBO.chargeMemory(MemoryCategory::Instances, instanceBytes);
+        instanceMemory.set((trees.capacity() + frameInstances.capacity()) * sizeof(TreeInstance) + farFlags.capacity(), 0);
+        if (!frameInstances.empty())
+            glBufferSubData(GL_ARRAY_BUFFER, 0, frameInstances.size() * sizeof(TreeInstance), frameInstances.data());
+    }
+
+    // cell of archetype a in the atlas, as (u0, v0, u1, v1)
+    glm::vec4 atlasRect(int a) const
+    {
+        float cellWidth = 1.0f / archetypes.size();
+        return glm::vec4(a * cellWidth, 0.0f, (a + 1) * cellWidth, 1.0f);
+    }
+
+    // renders every archetype once, side on and without sway, into one row of the atlas
+    void captureImpostors(Shader& treeShader)
+    {
+        impostorsCaptured = true;
+        int archetypeCount = (int)archetypes.size();
+        if (archetypeCount == 0)
+            return;
+
+        GLint previousFramebuffer, previousViewport[4];
+        glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+        glGetIntegerv(GL_VIEWPORT, previousViewport);
+
+        impostorAtlas = GlTexture::create();
+        glBindTexture(GL_TEXTURE_2D, impostorAtlas.get());
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, atlasCellSize * archetypeCount, atlasCellSize, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        // RGBA8 plus a third for the mipmaps
+        impostorAtlas.chargeMemory(MemoryCategory::Textures, (size_t)atlasCellSize * archetypeCount * atlasCellSize * 4 * 4 / 3);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        GlFramebuffer captureFBO = GlFramebuffer::create();
+        glBindFramebuffer(GL_FRAMEBUFFER, captureFBO.get());
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, impostorAtlas.get(), 0);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+
+        // one untinted instance at the origin
+        TreeInstance capture;
+        capture.placement = glm::vec4(0.0f);
+        capture.variation = glm::vec4(1.0f, 0.0f, 1.0f, 0.0f);
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO.get());
+        glBufferData(GL_ARRAY_BUFFER, sizeof(TreeInstance), &capture, GL_STREAM_DRAW);
+        instanceVBO.chargeMemory(MemoryCategory::Instances, sizeof(TreeInstance));
+
+        treeShader.use();
+        treeShader.setMat4("view", glm::mat4(1.0f));
+        treeShader.setFloat("time", 0.0f);
+        treeShader.setFloat("swayAmplitude", 0.0f);
+        for (int a = 0; a < archetypeCount; a++)
+        {
+            const Archetype& archetype = archetypes[a];
+            glViewport(a * atlasCellSize, 0, atlasCellSize, atlasCellSize);
+            treeShader.setMat4("projection", glm::ortho(archetype.minX, archetype.maxX, archetype.minY, archetype.maxY, -1.0f, 1.0f));
+            treeShader.setFloat("treeHeight", archetype.maxY);
+
+            treeShader.setVec3("color", branchColor);
+            glLineWidth(2.0f);
+            glBindVertexArray(branchVAO.get());
+            pointInstanceAttributes(0);
+            glDrawArraysInstanced(GL_LINES, archetype.firstBranchVertex, archetype.branchVertexCount, 1);
+            glLineWidth(1.0f);
+
+            treeShader.setVec3("color", leafColor);
+            glPointSize(3.0f);
+            glBindVertexArray(leafVAO.get());
+            pointInstanceAttributes(0);
+            glDrawArraysInstanced(GL_POINTS, archetype.firstLeafVertex, archetype.leafVertexCount, 1);
+        }
+        glBindVertexArray(0);
+
+        glBindTexture(GL_TEXTURE_2D, impostorAtlas.get());
+        glGenerateMipmap(GL_TEXTURE_2D);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+        captureFBO.reset();
+        glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+    }
+};
+
+#endif /* forest_h */
@@ -6,7 +6,17 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include <vector>
+#include <thread>
+#include <functional>
 #include "Shader.h"
+#include "meshData.h"
+#include "glResource.h"
+
+// branch lines and leaf points, three floats per vertex each
+struct TreeGeometry {
+    MeshData branches;
+    MeshData leaves;
+};
 
 class FractalTree {
 public:
@@ -17,23 +27,36 @@ public:
     FractalTree(float branchLength = 1.0f, float branchAngle = 30.0f, int recursionDepth = 10,
         glm::vec3 branchColor = glm::vec3(0.22f, 1.0f, 0.078f), float branchWidth = 5.0f,
         glm::vec3 leafColor = glm::vec3(0.0f, 1.0f, 0.0f))
+        : FractalTree(buildGeometry(branchLength, branchAngle, recursionDepth), branchColor, branchWidth, leafColor)
     {
         this->branchLength = branchLength;
         this->branchAngle = branchAngle;
         this->recursionDepth = recursionDepth;
+    }
+
+    // upload a tree made by buildGeometry(), which may have run on a worker thread
+    FractalTree(TreeGeometry geometry,
+        glm::vec3 branchColor = glm::vec3(0.22f, 1.0f, 0.078f), float branchWidth = 5.0f,
+        glm::vec3 leafColor = glm::vec3(0.0f, 1.0f, 0.0f))
+    {
         this->branchColor = branchColor;
         this->leafColor = leafColor;
         this->branchWidth = branchWidth;
 
-        buildTree();
+        // lines and points have nothing to pick, so only their counts are kept
+        const std::vector<float>& vertices = geometry.branches.vertices;
+        const std::vector<float>& leafVertices = geometry.leaves.vertices;
+        branchVertexCount = (GLsizei)(vertices.size() / 3);
+        leafVertexCount = (GLsizei)(leafVertices.size() / 3);
 
         // Generate VAO and VBO for rendering
-        glGenVertexArrays(1, &treeVAO);
-        glBindVertexArray(treeVAO);
+        treeVAO = GlVertexArray::create();
+        glBindVertexArray(treeVAO.get());
 
-        glGenBuffers(1, &treeVBO);
-        glBindBuffer(GL_ARRAY_BUFFER, treeVBO);
+        treeVBO = GlBuffer::create();
+        glBindBuffer(GL_ARRAY_BUFFER, treeVBO.get());
         glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+        treeVBO.chargeMemory(MemoryCategory::Trees, vertices.size() * sizeof(float));
 
         // Enable vertex attribute for position
         glEnableVertexAttribArray(0); // Position
@@ -44,12 +67,13 @@ public:
         glBindBuffer(GL_ARRAY_BUFFER, 0);
 
         // Leaves VBO
-        glGenVertexArrays(1, &leafVAO);
-        glBindVertexArray(leafVAO);
+        leafVAO = GlVertexArray::create();
+        glBindVertexArray(leafVAO.get());
 
-        glGenBuffers(1, &leafVBO);
-        glBindBuffer(GL_ARRAY_BUFFER, leafVBO);
+        leafVBO = GlBuffer::create();
+        glBindBuffer(GL_ARRAY_BUFFER, leafVBO.get());
         glBufferData(GL_ARRAY_BUFFER, leafVertices.size() * sizeof(float), leafVertices.data(), GL_STATIC_DRAW);
+        leafVBO.chargeMemory(MemoryCategory::Trees, leafVertices.size() * sizeof(float));
 
         // Enable vertex attribute for position
         glEnableVertexAttribArray(0); // Position
@@ -59,11 +83,70 @@ public:
         glBindBuffer(GL_ARRAY_BUFFER, 0);
     }
 
-    ~FractalTree() {
-        glDeleteVertexArrays(1, &treeVAO);
-        glDeleteBuffers(1, &treeVBO);
-        glDeleteVertexArrays(1, &leafVAO);
-        glDeleteBuffers(1, &leafVBO);
+    // CPU half of the constructors: no GL calls, safe on any thread. the same seed
+    // always gives the same tree, whatever the thread count
+    static TreeGeometry buildGeometry(float branchLength = 1.0f, float branchAngle = 30.0f, int recursionDepth = 10, unsigned int seed = 1) {
+        TreeGeometry geometry;
+        geometry.branches.floatsPerVertex = 3;
+        geometry.leaves.floatsPerVertex = 3;
+
+        // a full binary tree: every node owns a fixed slot, so the buffers are sized once
+        // and subtrees can be written from different threads without locking
+        size_t tipCount = size_t(1) << recursionDepth;
+        geometry.branches.vertices.resize((tipCount - 1) * 6);
+        geometry.leaves.vertices.resize(tipCount * leavesPerTip * 3);
+
+        BranchRule rule;
+        rule.depth = recursionDepth;
+        rule.cosAngle = cos(glm::radians(branchAngle));
+        rule.sinAngle = sin(glm::radians(branchAngle));
+        rule.firstTip = tipCount - 1;
+        rule.seed = seed;
+
+        TreeNode root;
+        root.index = 0;
+        root.level = 0;
+        root.start = glm::vec2(0.0f, 0.0f); // Start at origin
+        root.direction = glm::vec2(0.0f, branchLength); // Initial upward direction
+
+        unsigned int threadCount = std::thread::hardware_concurrency();
+        if (threadCount == 0 || recursionDepth < parallelDepth)
+            threadCount = 1;
+
+        // expand the top levels serially until there are a few subtrees per thread
+        std::vector<TreeNode> subtrees(1, root);
+        while (subtrees.size() < threadCount * 4 && subtrees[0].level < recursionDepth) {
+            std::vector<TreeNode> next;
+            next.reserve(subtrees.size() * 2);
+            for (const TreeNode& node : subtrees) {
+                TreeNode children[2];
+                emitNode(node, rule, geometry, children);
+                next.push_back(children[0]);
+                next.push_back(children[1]);
+            }
+            subtrees.swap(next);
+        }
+
+        // buildGeometry already runs as a pool task at startup, so it starts its own
+        // threads instead of blocking a pool worker on nested tasks
+        std::vector<std::thread> workers;
+        for (unsigned int t = 1; t < threadCount; t++)
+            workers.emplace_back(buildSubtrees, std::cref(subtrees), t, threadCount, std::cref(rule), std::ref(geometry));
+        buildSubtrees(subtrees, 0, threadCount, rule, geometry);
+        for (std::thread& worker : workers)
+            worker.join();
+
+        return geometry;
+    }
+
+    // counter-based random bits: a hash of (seed, counter), so any thread can produce
+    // any value and the result never depends on generation order. splitmix64 finaliser
+    static unsigned long long counterHash(unsigned int seed, unsigned long long counter) {
+        unsigned long long z = ((unsigned long long)seed << 40) ^ counter;
+        z += 0x9E3779B97F4A7C15ull;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
     }
 
     void drawTree(Shader& shader, glm::mat4 model) const {
@@ -73,75 +156,116 @@ public:
         shader.setVec3("color", branchColor);
         shader.setMat4("model", model);
         glLineWidth(branchWidth);
-        glBindVertexArray(treeVAO);
-        glDrawArrays(GL_LINES, 0, vertices.size() / 3);
+        glBindVertexArray(treeVAO.get());
+        glDrawArrays(GL_LINES, 0, branchVertexCount);
         glBindVertexArray(0);
         glLineWidth(1.0f);
 
         // Draw leaves
         shader.setVec3("color", leafColor);
         glPointSize(3.0f); // Set size of leaf points
-        glBindVertexArray(leafVAO);
-        glDrawArrays(GL_POINTS, 0, leafVertices.size() / 3);
+        glBindVertexArray(leafVAO.get());
+        glDrawArrays(GL_POINTS, 0, leafVertexCount);
         glBindVertexArray(0);
     }
 
 private:
-    unsigned int treeVAO, treeVBO, leafVAO, leafVBO;
-    float branchLength;    // Length of the branches
-    float branchAngle;     // Angle between branches
-    int recursionDepth;    // Maximum depth of recursion
-    std::vector<float> vertices;    // Stores the tree's vertices
-    std::vector<float> leafVertices; // Stores the leaf vertices
-
-    void buildTree() {
-        glm::vec3 start(0.0f, 0.0f, 0.0f); // Start at origin
-        glm::vec3 direction(0.0f, branchLength, 0.0f); // Initial upward direction
-        generateBranches(start, direction, recursionDepth);
+    GlVertexArray treeVAO, leafVAO;
+    GlBuffer treeVBO, leafVBO;
+    float branchLength = 1.0f;    // Length of the branches
+    float branchAngle = 30.0f;    // Angle between branches
+    int recursionDepth = 10;      // Maximum depth of recursion
+    GLsizei branchVertexCount = 0;
+    GLsizei leafVertexCount = 0;
+
+    static const int leavesPerTip = 50;    // points per leaf cluster
+    static const int parallelDepth = 12;   // shallower trees are quicker on one thread
+
+    // one node of the tree in heap order: the children of node n are 2n+1 and 2n+2.
+    // the tree is planar, so positions and directions keep z = 0
+    struct TreeNode {
+        size_t index;
+        int level;
+        glm::vec2 start;
+        glm::vec2 direction;
+    };
+
+    struct BranchRule {
+        int depth;
+        float cosAngle, sinAngle;
+        size_t firstTip;       // heap index of the first node at the last level
+        unsigned int seed;
+    };
+
+    // walks the subtrees first, first + stride, ... depth first with an explicit stack
+    static void buildSubtrees(const std::vector<TreeNode>& subtrees, unsigned int first, unsigned int stride, const BranchRule& rule, TreeGeometry& geometry) {
+        std::vector<TreeNode> stack;
+        stack.reserve(rule.depth + 2);
+        for (size_t i = first; i < subtrees.size(); i += stride) {
+            stack.push_back(subtrees[i]);
+            while (!stack.empty()) {
+                TreeNode node = stack.back();
+                stack.pop_back();
+                TreeNode children[2];
+                if (emitNode(node, rule, geometry, children)) {
+                    stack.push_back(children[1]);
+                    stack.push_back(children[0]);
+                }
+            }
+        }
     }
 
-    void generateBranches(const glm::vec3& start, const glm::vec3& direction, int depth) {
-        if (depth == 0) {
-            generateLeaves(start); // Generate leaves at branch tips
-            return;
+    // writes the node's branch, or its leaf cluster at a tip, into the node's own slot.
+    // returns false at a tip, otherwise fills in the two children
+    static bool emitNode(const TreeNode& node, const BranchRule& rule, TreeGeometry& geometry, TreeNode children[2]) {
+        if (node.level == rule.depth) {
+            generateLeaves(node.start, node.index - rule.firstTip, rule.seed, geometry.leaves.vertices); // Generate leaves at branch tips
+            return false;
         }
 
         // Compute the end point of the branch
-        glm::vec3 end = start + direction;
-
-        // Add the branch to the vertices list
-        vertices.push_back(start.x);
-        vertices.push_back(start.y);
-        vertices.push_back(start.z);
-        vertices.push_back(end.x);
-        vertices.push_back(end.y);
-        vertices.push_back(end.z);
-
-        // Compute new branch directions
-        float angleRadians = glm::radians(branchAngle);
-        glm::mat4 rotationLeft = glm::rotate(glm::mat4(1.0f), angleRadians, glm::vec3(0.0f, 0.0f, 1.0f));
-        glm::mat4 rotationRight = glm::rotate(glm::mat4(1.0f), -angleRadians, glm::vec3(0.0f, 0.0f, 1.0f));
-
-        glm::vec3 leftDirection = glm::vec3(rotationLeft * glm::vec4(direction * 0.7f, 0.0f));
-        glm::vec3 rightDirection = glm::vec3(rotationRight * glm::vec4(direction * 0.7f, 0.0f));
-
-        // Recursively generate branches
-        generateBranches(end, leftDirection, depth - 1);
-        generateBranches(end, rightDirection, depth - 1);
+        glm::vec2 end = node.start + node.direction;
+
+        float* branch = &geometry.branches.vertices[node.index * 6];
+        branch[0] = node.start.x;
+        branch[1] = node.start.y;
+        branch[2] = 0.0f;
+        branch[3] = end.x;
+        branch[4] = end.y;
+        branch[5] = 0.0f;
+
+        // new branches are the parent's direction shortened and turned by +-branchAngle about z
+        glm::vec2 d = node.direction * 0.7f;
+        float c = rule.cosAngle;
+        float s = rule.sinAngle;
+        for (int k = 0; k < 2; k++) {
+            children[k].index = 2 * node.index + 1 + k;
+            children[k].level = node.level + 1;
+            children[k].start = end;
+        }
+        children[0].direction = glm::vec2(c * d.x - s * d.y, s * d.x + c * d.y);
+        children[1].direction = glm::vec2(c * d.x + s * d.y, -s * d.x + c * d.y);
+        return true;
     }
 
-    void generateLeaves(const glm::vec3& position) {
+    static void generateLeaves(const glm::vec2& position, size_t tip, unsigned int seed, std::vector<float>& leafVertices) {
         // Add a cluster of points around the given position
-        for (int i = 0; i < 50; ++i) { // Generate 50 points per leaf cluster
-            float offsetX = ((rand() % 100) / 100.0f - 0.5f) * 0.5f;
-            float offsetY = ((rand() % 100) / 100.0f - 0.5f) * 0.5f;
-            float offsetZ = ((rand() % 100) / 100.0f - 0.5f) * 0.5f;
-
-            leafVertices.push_back(position.x + offsetX);
-            leafVertices.push_back(position.y + offsetY);
-            leafVertices.push_back(position.z + offsetZ);
+        float* leaf = &leafVertices[tip * leavesPerTip * 3];
+        unsigned long long counter = (unsigned long long)tip * leavesPerTip;
+        for (int i = 0; i < leavesPerTip; ++i) {
+            // one hash per point, split into three 21-bit fields for x, y and z
+            unsigned long long bits = counterHash(seed, counter++);
+            leaf[0] = position.x + leafOffset(bits);
+            leaf[1] = position.y + leafOffset(bits >> 21);
+            leaf[2] = leafOffset(bits >> 42);
+            leaf += 3;
         }
     }
+
+    // offset in [-0.25, 0.25) in steps of 0.005, as the rand() version had
+    static float leafOffset(unsigned long long bits) {
+        return (((bits & 0x1FFFFF) % 100) / 100.0f - 0.5f) * 0.5f;
+    }
 };
 
 #endif // FRACTAL_TREE_H
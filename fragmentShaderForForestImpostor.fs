@@ -0,0 +1,16 @@
+#version 330 core
+
+in vec2 TexCoords;
+in float vTint;
+
+out vec4 FragColor;
+
+uniform sampler2D impostorAtlas;
+
+void main()
+{
+    vec4 texel = texture(impostorAtlas, TexCoords);
+    if (texel.a < 0.5)
+        discard;
+    FragColor = vec4(texel.rgb * vTint, 1.0f);
+}
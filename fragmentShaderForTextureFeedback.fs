@@ -0,0 +1,35 @@
+#version 330 core
+
+in vec2 TexCoords;
+
+out vec4 FragColor;
+
+// the texture's GL name split into its low and high byte, over 255
+uniform vec2 textureName;
+
+// for a virtual texture its id, which is 0 for an ordinary texture, and its page grid
+uniform float virtualId;
+uniform float pagesPerSide;
+uniform float levelBias;
+uniform float maxLevel;
+
+void main()
+{
+    // log2 of the texture-space footprint of one pixel, in units of the whole
+    // texture, which is what the mip level is before the texture's size is known.
+    // stored in quarter steps with an offset of 32
+    vec2 dx = dFdx(TexCoords);
+    vec2 dy = dFdy(TexCoords);
+    float footprint = 0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1e-20));
+
+    if (virtualId > 0.0)
+    {
+        // the page the main pass samples here, picked the way it picks it
+        float level = clamp(floor(footprint + levelBias + 0.5), 0.0, maxLevel);
+        float pages = pagesPerSide / exp2(level);
+        vec2 page = min(floor(clamp(TexCoords, 0.0, 1.0) * pages), pages - 1.0);
+        FragColor = vec4(page / 255.0, level / 255.0, virtualId / 255.0);
+        return;
+    }
+    FragColor = vec4(textureName, clamp((footprint + 32.0) * 4.0, 0.0, 255.0) / 255.0, 1.0);
+}
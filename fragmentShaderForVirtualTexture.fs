@@ -0,0 +1,90 @@
+#version 330 core
+out vec4 FragColor;
+
+struct Material {
+    sampler2D diffuse;              // the virtual texture's page cache
+    sampler2D specular;
+    float shininess;
+};
+
+struct VirtualTexture {
+    sampler2D pageTable;
+    float pagesPerSide;
+    float pageSize;
+    float border;
+    float maxLevel;
+    float cacheSize;
+};
+
+struct PointLight {
+    vec3 position;
+    
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+#define NR_POINT_LIGHTS 4
+
+in vec3 FragPos;
+in vec3 Normal;
+in vec2 TexCoords;
+
+uniform vec3 viewPos;
+uniform PointLight pointLights[NR_POINT_LIGHTS];
+uniform Material material;
+uniform VirtualTexture virtualTexture;
+
+// function prototypes
+vec3 SampleVirtualTexture(vec2 uv);
+vec3 CalcPointLight(Material material, PointLight light, vec3 N, vec3 fragPos, vec3 V, vec3 colour);
+
+void main()
+{
+    // properties
+    vec3 N = normalize(Normal);
+    vec3 V = normalize(viewPos - FragPos);
+    vec3 colour = SampleVirtualTexture(TexCoords);
+    
+    vec3 result;
+    // point lights
+    for(int i = 0; i < NR_POINT_LIGHTS; i++)
+        result += CalcPointLight(material, pointLights[i], N, FragPos, V, colour);
+      
+    FragColor = vec4(result, 1.0);
+}
+
+// the texel at uv from the finest resident page at or above the level the pixel's
+// footprint asks for, which is the level the feedback pass requests
+vec3 SampleVirtualTexture(vec2 uv)
+{
+    float virtualSize = virtualTexture.pagesPerSide * virtualTexture.pageSize;
+    vec2 dx = dFdx(uv * virtualSize);
+    vec2 dy = dFdy(uv * virtualSize);
+    float footprint = 0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1e-20));
+    float level = clamp(floor(footprint + 0.5), 0.0, virtualTexture.maxLevel);
+
+    uv = clamp(uv, 0.0, 1.0);
+    float pages = virtualTexture.pagesPerSide / exp2(level);
+    vec4 entry = floor(texelFetch(virtualTexture.pageTable, ivec2(min(floor(uv * pages), pages - 1.0)), int(level)) * 255.0 + 0.5);
+
+    // where uv lies in the resident page, inside its border in the cache
+    float residentPages = virtualTexture.pagesPerSide / exp2(entry.b);
+    vec2 inPage = uv * residentPages - min(floor(uv * residentPages), residentPages - 1.0);
+    vec2 texel = entry.rg * (virtualTexture.pageSize + 2.0 * virtualTexture.border) + virtualTexture.border + inPage * virtualTexture.pageSize;
+    return vec3(texture(material.diffuse, texel / virtualTexture.cacheSize));
+}
+
+// calculates the color when using a point light. the floor is its own specular map,
+// as it was with the tiled texture
+vec3 CalcPointLight(Material material, PointLight light, vec3 N, vec3 fragPos, vec3 V, vec3 colour)
+{
+    vec3 L = normalize(light.position - fragPos);
+    vec3 R = reflect(-L, N);
+    
+    vec3 ambient = colour * light.ambient;
+    vec3 diffuse = colour * max(dot(N, L), 0.0) * light.diffuse;
+    vec3 specular = colour * pow(max(dot(V, R), 0.0), material.shininess) * light.specular;
+    
+    return (ambient + diffuse + specular);
+}
@@ -0,0 +1,136 @@
+#ifndef glResource_h
+#define glResource_h
+
+#include <glad/glad.h>
+#include <cstddef>
+#include <utility>
+#include "memoryReport.h"
+
+// move-only owners of GL object names. the object is deleted when its handle goes
+// out of scope or is assigned over, so a mesh or texture can be dropped and rebuilt
+// any number of times without leaking, and copying a class that owns GL objects is
+// a compile error instead of a double delete. get() hands out the name for binding;
+// classes that only use an object someone else owns, like a mesh drawing with a
+// shared texture, keep that plain name.
+//
+// a handle can also carry the GPU bytes its object holds, charged to a category of
+// the memory report until the object is deleted.
+//
+// handles must be destroyed while the context is current, i.e. before glfwTerminate()
+template<class Traits>
+class GlHandle
+{
+public:
+    GlHandle() {}
+
+    // takes ownership of an existing name
+    explicit GlHandle(GLuint id) : id(id)
+    {
+        if (id != 0)
+            liveCount()++;
+    }
+
+    ~GlHandle()
+    {
+        reset();
+    }
+
+    GlHandle(const GlHandle&) = delete;
+    GlHandle& operator=(const GlHandle&) = delete;
+
+    GlHandle(GlHandle&& other) noexcept : id(other.id), memory(std::move(other.memory))
+    {
+        other.id = 0;
+    }
+
+    GlHandle& operator=(GlHandle&& other) noexcept
+    {
+        if (this != &other)
+        {
+            reset();
+            id = other.id;
+            memory = std::move(other.memory);
+            other.id = 0;
+        }
+        return *this;
+    }
+
+    // a new object of this type
+    static GlHandle create()
+    {
+        GLuint id = 0;
+        Traits::generate(id);
+        return GlHandle(id);
+    }
+
+    GLuint get() const
+    {
+        return id;
+    }
+
+    explicit operator bool() const
+    {
+        return id != 0;
+    }
+
+    // deletes the object now; the handle is empty afterwards
+    void reset()
+    {
+        if (id == 0)
+            return;
+        Traits::destroy(id);
+        id = 0;
+        memory = MemoryCharge();
+        liveCount()--;
+    }
+
+    // the object's storage after glBufferData, glTexImage2D and the like; call again
+    // whenever the storage is respecified
+    void chargeMemory(MemoryCategory category, size_t gpuBytes)
+    {
+        memory = MemoryCharge(category, 0, gpuBytes);
+    }
+
+    // objects of this type currently owned by a handle, to check that a reload
+    // returns to the count it started from
+    static size_t& liveCount()
+    {
+        static size_t count = 0;
+        return count;
+    }
+
+private:
+    GLuint id = 0;
+    MemoryCharge memory;
+};
+
+struct GlBufferTraits
+{
+    static void generate(GLuint& id) { glGenBuffers(1, &id); }
+    static void destroy(GLuint id) { glDeleteBuffers(1, &id); }
+};
+
+struct GlVertexArrayTraits
+{
+    static void generate(GLuint& id) { glGenVertexArrays(1, &id); }
+    static void destroy(GLuint id) { glDeleteVertexArrays(1, &id); }
+};
+
+struct GlTextureTraits
+{
+    static void generate(GLuint& id) { glGenTextures(1, &id); }
+    static void destroy(GLuint id) { glDeleteTextures(1, &id); }
+};
+
+struct GlFramebufferTraits
+{
+    static void generate(GLuint& id) { glGenFramebuffers(1, &id); }
+    static void destroy(GLuint id) { glDeleteFramebuffers(1, &id); }
+};
+
+typedef GlHandle<GlBufferTraits> GlBuffer;
+typedef GlHandle<GlVertexArrayTraits> GlVertexArray;
+typedef GlHandle<GlTextureTraits> GlTexture;
+typedef GlHandle<GlFramebufferTraits> GlFramebuffer;
+
+#endif /* glResource_h */
@@ -0,0 +1,109 @@
+// decode time of the in-tree JPEG decoder against stb_image on the given files,
+// or on the hall's own textures when none are given. a command line tool kept
+// out of the Auditorium project; build it optimised next to the sources:
+//
+//   cl /O2 /EHsc /std:c++14 /I C:\openGL\Include jpegBenchmark.cpp stb_image.cpp
+//   g++ -O2 -std=c++14 -pthread jpegBenchmark.cpp stb_image.cpp -o jpegBenchmark
+//
+// each file is decoded to RGBA by both, flipped as the texture loader asks, best
+// of the given number of runs (default 9) on one thread; the decoder's helper
+// threads are timed separately. the two images are compared as well, since a
+// faster decoder that draws something else is no use
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "jpegDecoder.h"
+#include "stb_image.h"
+
+static double now()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static std::vector<unsigned char> readFile(const std::string& path)
+{
+    std::ifstream in(path, std::ios::binary);
+    return std::vector<unsigned char>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+// best of runs calls of decode, in milliseconds
+template<class Decode>
+static double bestOf(int runs, Decode decode)
+{
+    double best = 1e30;
+    for (int run = 0; run < runs; run++)
+    {
+        double start = now();
+        decode();
+        best = std::min(best, now() - start);
+    }
+    return best * 1000.0;
+}
+
+int main(int argc, char** argv)
+{
+    int runs = 9;
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string argument = argv[i];
+        if (argument == "-n" && i + 1 < argc)
+            runs = std::max(1, atoi(argv[++i]));
+        else
+            paths.push_back(argument);
+    }
+    if (paths.empty())
+        // red_curtain.jpg is a WebP under a .jpg name, left to stb_image
+        paths = { "bd_flag_texture.jpg", "curve_texture.jpg", "door_texture.jpg", "fan_texture.jpeg", "floor_texture.jpg",
+            "steel_texture.jpg", "tactile_texture.jpg", "tree_pot_texture.jpg", "wood_texture.jpeg" };
+
+    stbi_set_flip_vertically_on_load(1);
+    printf("%-24s %11s %8s %8s %8s %8s %9s\n", "file", "size", "stb ms", "ours ms", "speedup", "threads", "max diff");
+    double stbTotal = 0.0, oursTotal = 0.0;
+    int failures = 0;
+    for (const std::string& path : paths)
+    {
+        std::vector<unsigned char> data = readFile(path);
+        int width = 0, height = 0, channels = 0;
+        unsigned char* reference = stbi_load_from_memory(data.data(), (int)data.size(), &width, &height, &channels, 4);
+        RgbaImage image;
+        if (!reference || !decodeJpeg(data.data(), data.size(), image, true, false) || image.width != width || image.height != height)
+        {
+            printf("%-24s not decoded by %s\n", path.c_str(), reference ? "ours" : "stb_image");
+            stbi_image_free(reference);
+            failures++;
+            continue;
+        }
+        int maxDifference = 0;
+        for (size_t i = 0; i < image.pixels.size(); i++)
+            maxDifference = std::max(maxDifference, abs((int)image.pixels[i] - (int)reference[i]));
+        stbi_image_free(reference);
+
+        double stb = bestOf(runs, [&] {
+            stbi_image_free(stbi_load_from_memory(data.data(), (int)data.size(), &width, &height, &channels, 4));
+        });
+        double ours = bestOf(runs, [&] {
+            RgbaImage decoded;
+            decodeJpeg(data.data(), data.size(), decoded, true, false);
+        });
+        double threaded = bestOf(runs, [&] {
+            RgbaImage decoded;
+            decodeJpeg(data.data(), data.size(), decoded, true, true);
+        });
+        stbTotal += stb;
+        oursTotal += ours;
+
+        std::string size = std::to_string(width) + "x" + std::to_string(height);
+        printf("%-24s %11s %8.2f %8.2f %7.2fx %8.2f %9d\n", path.c_str(), size.c_str(), stb, ours, stb / ours, threaded, maxDifference);
+    }
+    if (oursTotal > 0.0)
+        printf("%-24s %11s %8.2f %8.2f %7.2fx\n", "total", "", stbTotal, oursTotal, stbTotal / oursTotal);
+    return failures ? 1 : 0;
+}
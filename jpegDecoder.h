@@ -0,0 +1,1293 @@
+#ifndef jpegDecoder_h
+#define jpegDecoder_h
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include "textureCompressor.h"
+
+#if defined(_M_X64) || defined(__x86_64__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define JPEG_SSE2
+#include <emmintrin.h>
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// the AVX2 functions are compiled for AVX2 whatever the rest of the build targets and
+// only called once the CPU has been checked for it
+#if defined(JPEG_SSE2) && (defined(__GNUC__) || defined(__clang__))
+#define JPEG_AVX2_FUNCTION __attribute__((target("avx2")))
+#else
+#define JPEG_AVX2_FUNCTION
+#endif
+
+// decoder for the JPEGs the textures come in: 8-bit baseline and progressive
+// Huffman-coded files with one (grey) or three (YCbCr) components, each sampled at
+// full or half resolution. anything else, like CMYK, arithmetic coding or 4:1:1,
+// is refused, and the caller falls back to stb_image.
+//
+// the entropy-coded data is decoded in parallel between restart markers when the
+// file has them. a sequential file's blocks go through the IDCT as they are decoded,
+// straight into the component's samples; a progressive file's coefficients are kept
+// until the last scan and then IDCT'd in bands of rows on helper threads. chroma
+// upsampling and colour conversion run in bands of rows on helper threads too, with
+// an SSE2 or AVX2 IDCT and colour conversion. the IDCT is the floating-point AAN one, which is
+// also more accurate than stb_image's integer one. upsampling is the same triangle
+// filter stb_image and libjpeg use
+
+// natural order index of each zigzag position, padded for corrupt runs past 63
+const unsigned char jpegNaturalOrder[64 + 16] = {
+    0,  1,  8, 16,  9,  2,  3, 10, 17, 24, 32, 25, 18, 11,  4,  5,
+   12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13,  6,  7, 14, 21, 28,
+   35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+   58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63,
+   63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63
+};
+
+inline bool jpegCpuHasAvx2()
+{
+#if defined(JPEG_SSE2) && defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+    __cpuid(info, 1);
+    if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0 || (_xgetbv(0) & 6) != 6)
+        return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#elif defined(JPEG_SSE2)
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+
+// job(i) for i in [0, count) on up to every core. decodes already run as pool tasks,
+// so helpers are threads of their own rather than nested pool tasks, as in
+// FractalTree::buildGeometry()
+template<class Job>
+inline void jpegParallelFor(int count, bool parallel, const Job& job)
+{
+    unsigned int threadCount = parallel ? std::thread::hardware_concurrency() : 1;
+    threadCount = std::max(1u, std::min(threadCount, (unsigned int)std::max(count, 0)));
+    std::atomic<int> next(0);
+    auto run = [&] {
+        for (int i = next++; i < count; i = next++)
+            job(i);
+    };
+    std::vector<std::thread> helpers;
+    for (unsigned int t = 1; t < threadCount; t++)
+        helpers.emplace_back(run);
+    run();
+    for (std::thread& helper : helpers)
+        helper.join();
+}
+
+struct JpegHuffmanTable
+{
+    static const int fastBits = 10;
+
+    uint16_t fast[1 << fastBits];           // length << 8 | symbol for short codes, 0 if longer
+    int16_t fastAc[1 << fastBits];          // value << 8 | run << 4 | bits, for short AC codes with their value
+    unsigned char values[256];
+    uint32_t maxCode[18];                   // one past the last code of each length, left aligned to 16 bits
+    int delta[17];                          // symbol index minus code, per length
+    bool defined = false;
+
+    // counts of codes per length 1 to 16, then the symbols in code order
+    bool build(const unsigned char* counts, const unsigned char* symbols)
+    {
+        int index = 0;
+        uint32_t code = 0;
+        for (int length = 1; length <= 16; length++)
+        {
+            delta[length] = index - (int)code;
+            for (int i = 0; i < counts[length - 1]; i++)
+            {
+                if (index >= 256)
+                    return false;
+                values[index] = symbols[index];
+                index++;
+                code++;
+            }
+            if (code > (1u << length))
+                return false;
+            maxCode[length] = code << (16 - length);
+            code <<= 1;
+        }
+        maxCode[17] = 0xffffffff;
+
+        memset(fast, 0, sizeof(fast));
+        code = 0;
+        index = 0;
+        for (int length = 1; length <= 16; length++)
+        {
+            for (int i = 0; i < counts[length - 1]; i++, index++, code++)
+                if (length <= fastBits)
+                    std::fill_n(fast + (code << (fastBits - length)), 1 << (fastBits - length), (uint16_t)(length << 8 | values[index]));
+            code <<= 1;
+        }
+
+        for (int bits = 0; bits < (1 << fastBits); bits++)
+        {
+            fastAc[bits] = 0;
+            if (fast[bits] == 0)
+                continue;
+            int length = fast[bits] >> 8;
+            int run = (fast[bits] >> 4) & 15, size = fast[bits] & 15;
+            if (size == 0 || length + size > fastBits)
+                continue;
+            int value = (bits << length & ((1 << fastBits) - 1)) >> (fastBits - size);
+            if (value < 1 << (size - 1))
+                value -= (1 << size) - 1;
+            if (value >= -128 && value <= 127)
+                fastAc[bits] = (int16_t)(value * 256 + run * 16 + length + size);
+        }
+        defined = true;
+        return true;
+    }
+};
+
+// the entropy-coded bytes between two markers, read MSB first with the stuffed
+// zero after each 0xFF removed. past the end it reads zeros
+struct JpegBitReader
+{
+    const unsigned char* position;
+    const unsigned char* end;
+    uint64_t buffer = 0;
+    int count = 0;
+    bool corrupt = false;
+
+    JpegBitReader(const unsigned char* begin, const unsigned char* end) : position(begin), end(end) {}
+
+    void fill()
+    {
+        // most of the time the next eight bytes hold no 0xFF and as many as fit
+        // are taken at once
+        if (end - position >= 8 && count <= 48)
+        {
+            uint64_t word;
+            memcpy(&word, position, 8);
+            uint64_t inverted = ~word;
+            if (((inverted - 0x0101010101010101ull) & ~inverted & 0x8080808080808080ull) == 0)
+            {
+                int bytes = (63 - count) >> 3;
+#ifdef _MSC_VER
+                word = _byteswap_uint64(word);
+#else
+                word = __builtin_bswap64(word);
+#endif
+                buffer |= word >> (64 - bytes * 8) << (64 - count - bytes * 8);
+                position += bytes;
+                count += bytes * 8;
+                return;
+            }
+        }
+        while (count <= 56)
+        {
+            unsigned int byte = 0;
+            if (position < end)
+            {
+                byte = *position++;
+                if (byte == 0xFF)
+                {
+                    if (position < end && *position == 0)
+                        position++;
+                    else
+                    {
+                        // fill bytes before the marker that ends the segment
+                        byte = 0;
+                        position = end;
+                    }
+                }
+            }
+            buffer |= (uint64_t)byte << (56 - count);
+            count += 8;
+        }
+    }
+
+    int getBits(int n)
+    {
+        if (count < n)
+            fill();
+        int value = (int)(buffer >> (64 - n));
+        buffer <<= n;
+        count -= n;
+        return value;
+    }
+
+    int getBit()
+    {
+        return getBits(1);
+    }
+
+    // n bits as a signed value, extended as the coefficient magnitude categories are
+    int receiveExtend(int n)
+    {
+        if (n == 0)
+            return 0;
+        int value = getBits(n);
+        return value < 1 << (n - 1) ? value - (1 << n) + 1 : value;
+    }
+
+    int decode(const JpegHuffmanTable& table)
+    {
+        if (count < 16)
+            fill();
+        int fast = table.fast[buffer >> (64 - JpegHuffmanTable::fastBits)];
+        if (fast)
+        {
+            int length = fast >> 8;
+            buffer <<= length;
+            count -= length;
+            return fast & 255;
+        }
+        uint32_t peek = (uint32_t)(buffer >> 48);
+        int length = JpegHuffmanTable::fastBits + 1;
+        while (peek >= table.maxCode[length])
+            length++;
+        if (length > 16)
+        {
+            corrupt = true;
+            return 0;
+        }
+        int index = (int)(peek >> (16 - length)) + table.delta[length];
+        buffer <<= length;
+        count -= length;
+        return table.values[index & 255];
+    }
+};
+
+class JpegDecoder
+{
+public:
+    // decodes data into image, as RGBA8 with rows from the bottom if flipVertically
+    // as GL stores them; false if the file is not one this decoder handles.
+    // parallel lets a large image use helper threads
+    bool decode(const unsigned char* data, size_t size, RgbaImage& image, bool flipVertically, bool parallel = true)
+    {
+        this->parallel = parallel;
+        if (size < 4 || data[0] != 0xFF || data[1] != 0xD8)
+            return false;
+
+        size_t position = 2;
+        bool ended = false;
+        while (!ended)
+        {
+            // markers may be preceded by any number of fill bytes
+            while (position < size && data[position] == 0xFF && position + 1 < size && data[position + 1] == 0xFF)
+                position++;
+            if (position + 2 > size || data[position] != 0xFF)
+                break;
+            int marker = data[position + 1];
+            position += 2;
+            if (marker == 0xD9)
+            {
+                ended = true;
+                break;
+            }
+            if (marker == 0xD8 || marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7))
+                continue;
+            if (position + 2 > size)
+                return false;
+            size_t length = (size_t)data[position] << 8 | data[position + 1];
+            if (length < 2 || position + length > size)
+                return false;
+            const unsigned char* segment = data + position + 2;
+            size_t segmentSize = length - 2;
+            position += length;
+
+            switch (marker)
+            {
+            case 0xDB:
+                if (!readQuantTables(segment, segmentSize))
+                    return false;
+                break;
+            case 0xC4:
+                if (!readHuffmanTables(segment, segmentSize))
+                    return false;
+                break;
+            case 0xC0:
+            case 0xC1:
+            case 0xC2:
+                if (frameRead || !readFrame(segment, segmentSize, marker == 0xC2))
+                    return false;
+                break;
+            case 0xDD:
+                if (segmentSize < 2)
+                    return false;
+                restartInterval = segment[0] << 8 | segment[1];
+                break;
+            case 0xEE:
+                // an Adobe marker whose colour transform is 0 means the three
+                // components are RGB, not YCbCr
+                if (segmentSize >= 12 && memcmp(segment, "Adobe", 5) == 0 && segment[11] == 0 && components.size() != 1)
+                    return false;
+                break;
+            case 0xDA:
+                if (!frameRead || !readScan(segment, segmentSize))
+                    return false;
+                position = decodeScan(data + position, data + size) - data;
+                if (failed)
+                    return false;
+                break;
+            default:
+                // hierarchical, lossless and arithmetic-coded frames
+                if ((marker >= 0xC3 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC))
+                    return false;
+                break;
+            }
+        }
+        if (!frameRead || scanCount == 0)
+            return false;
+
+        reconstruct(image, flipVertically);
+        return true;
+    }
+
+private:
+    struct Component
+    {
+        int id;
+        int h, v;                           // sampling factors
+        int quant;
+        int dcTable = 0, acTable = 0;
+        int width, height;                  // samples
+        int blocksWide, blocksHigh;         // blocks holding samples, as a single-component scan walks them
+        int blocksPerLine, blocksPerColumn; // blocks in whole MCUs
+        std::vector<int16_t> coefficients;  // 64 per block in natural order, not dequantised; progressive only
+        std::vector<unsigned char> plane;   // blocksPerLine * 8 samples wide
+    };
+
+    struct Scan
+    {
+        int componentCount;
+        int component[4];
+        int start, end;                     // spectral selection
+        int high, low;                      // successive approximation
+    };
+
+    enum class BlockCoding { Baseline, DcFirst, DcRefine, AcFirst, AcRefine };
+
+    bool parallel = true;
+    bool progressive = false;
+    bool frameRead = false;
+    bool failed = false;
+    int scanCount = 0;
+    int width = 0, height = 0;
+    int maxH = 1, maxV = 1;
+    int mcusWide = 0, mcusHigh = 0;
+    int restartInterval = 0;
+    uint16_t quantTables[4][64] = {};
+    float scaledQuantTables[4][64];
+    JpegHuffmanTable dcTables[4], acTables[4];
+    std::vector<Component> components;
+    Scan scan;
+
+    bool readQuantTables(const unsigned char* segment, size_t size)
+    {
+        size_t position = 0;
+        while (position < size)
+        {
+            int precision = segment[position] >> 4, table = segment[position] & 15;
+            position++;
+            if (table > 3 || precision > 1 || position + (precision ? 128 : 64) > size)
+                return false;
+            for (int k = 0; k < 64; k++)
+            {
+                int value = precision ? segment[position + 2 * k] << 8 | segment[position + 2 * k + 1] : segment[position + k];
+                quantTables[table][jpegNaturalOrder[k]] = (uint16_t)value;
+            }
+            position += precision ? 128 : 64;
+        }
+        return true;
+    }
+
+    bool readHuffmanTables(const unsigned char* segment, size_t size)
+    {
+        size_t position = 0;
+        while (position < size)
+        {
+            int type = segment[position] >> 4, table = segment[position] & 15;
+            if (type > 1 || table > 3 || position + 17 > size)
+                return false;
+            const unsigned char* counts = segment + position + 1;
+            int total = 0;
+            for (int i = 0; i < 16; i++)
+                total += counts[i];
+            position += 17;
+            if (total > 256 || position + total > size)
+                return false;
+            if (!(type ? acTables : dcTables)[table].build(counts, segment + position))
+                return false;
+            position += total;
+        }
+        return true;
+    }
+
+    bool readFrame(const unsigned char* segment, size_t size, bool isProgressive)
+    {
+        if (size < 6)
+            return false;
+        progressive = isProgressive;
+        int precision = segment[0];
+        height = segment[1] << 8 | segment[2];
+        width = segment[3] << 8 | segment[4];
+        int count = segment[5];
+        if (precision != 8 || width == 0 || height == 0 || (count != 1 && count != 3) || size < 6 + 3 * (size_t)count)
+            return false;
+        // larger than any texture, and left to stb_image's own limits
+        if ((size_t)width * height > (1u << 28))
+            return false;
+
+        components.resize(count);
+        for (int c = 0; c < count; c++)
+        {
+            Component& component = components[c];
+            component.id = segment[6 + 3 * c];
+            component.h = segment[7 + 3 * c] >> 4;
+            component.v = segment[7 + 3 * c] & 15;
+            component.quant = segment[8 + 3 * c];
+            if (component.h < 1 || component.h > 4 || component.v < 1 || component.v > 4 || component.quant > 3)
+                return false;
+            maxH = std::max(maxH, component.h);
+            maxV = std::max(maxV, component.v);
+        }
+
+        mcusWide = (width + 8 * maxH - 1) / (8 * maxH);
+        mcusHigh = (height + 8 * maxV - 1) / (8 * maxV);
+        for (Component& component : components)
+        {
+            // only full and half resolution are upsampled here
+            if ((maxH != component.h && maxH != 2 * component.h) || (maxV != component.v && maxV != 2 * component.v))
+                return false;
+            component.width = (width * component.h + maxH - 1) / maxH;
+            component.height = (height * component.v + maxV - 1) / maxV;
+            component.blocksWide = (component.width + 7) / 8;
+            component.blocksHigh = (component.height + 7) / 8;
+            component.blocksPerLine = mcusWide * component.h;
+            component.blocksPerColumn = mcusHigh * component.v;
+            size_t blocks = (size_t)component.blocksPerLine * component.blocksPerColumn;
+            if (progressive)
+                component.coefficients.assign(blocks * 64, 0);
+            else
+                component.plane.assign(blocks * 64, 0);
+        }
+        frameRead = true;
+        return true;
+    }
+
+    bool readScan(const unsigned char* segment, size_t size)
+    {
+        if (size < 1)
+            return false;
+        scan.componentCount = segment[0];
+        if (scan.componentCount < 1 || scan.componentCount > (int)components.size() || size < 4 + 2 * (size_t)scan.componentCount)
+            return false;
+        for (int i = 0; i < scan.componentCount; i++)
+        {
+            int id = segment[1 + 2 * i], tables = segment[2 + 2 * i];
+            int found = -1;
+            for (int c = 0; c < (int)components.size(); c++)
+                if (components[c].id == id)
+                    found = c;
+            if (found < 0 || (tables >> 4) > 3 || (tables & 15) > 3)
+                return false;
+            scan.component[i] = found;
+            components[found].dcTable = tables >> 4;
+            components[found].acTable = tables & 15;
+        }
+        const unsigned char* spectral = segment + 1 + 2 * scan.componentCount;
+        scan.start = spectral[0];
+        scan.end = spectral[1];
+        scan.high = spectral[2] >> 4;
+        scan.low = spectral[2] & 15;
+        if (progressive)
+        {
+            if (scan.start > scan.end || scan.end > 63 || scan.low > 13 || (scan.start == 0 && scan.end != 0) ||
+                (scan.start > 0 && scan.componentCount != 1))
+                return false;
+        }
+        else if (scan.start != 0 || scan.end != 63 || scan.high != 0 || scan.low != 0)
+            return false;
+
+        // the tables the scan needs must be there
+        for (int i = 0; i < scan.componentCount; i++)
+        {
+            const Component& component = components[scan.component[i]];
+            bool needsDc = scan.start == 0 && scan.high == 0, needsAc = scan.end > 0;
+            if ((needsDc && !dcTables[component.dcTable].defined) || (needsAc && !acTables[component.acTable].defined))
+                return false;
+        }
+        return true;
+    }
+
+    BlockCoding getBlockCoding() const
+    {
+        if (!progressive)
+            return BlockCoding::Baseline;
+        if (scan.start == 0)
+            return scan.high == 0 ? BlockCoding::DcFirst : BlockCoding::DcRefine;
+        return scan.high == 0 ? BlockCoding::AcFirst : BlockCoding::AcRefine;
+    }
+
+    // decodes the scan's entropy-coded data, which starts at begin, and returns
+    // where the next marker is
+    const unsigned char* decodeScan(const unsigned char* begin, const unsigned char* end)
+    {
+        // split at the restart markers; every stretch between them starts afresh
+        std::vector<const unsigned char*> segmentStarts(1, begin), segmentEnds;
+        const unsigned char* position = begin;
+        for (;;)
+        {
+            position = (const unsigned char*)memchr(position, 0xFF, end - position);
+            if (!position || position + 1 >= end)
+            {
+                position = end;
+                break;
+            }
+            int next = position[1];
+            if (next == 0x00 || next == 0xFF)
+                position += next == 0x00 ? 2 : 1;
+            else if (next >= 0xD0 && next <= 0xD7)
+            {
+                segmentEnds.push_back(position);
+                position += 2;
+                segmentStarts.push_back(position);
+            }
+            else
+                break;
+        }
+        segmentEnds.push_back(position);
+
+        const Component& first = components[scan.component[0]];
+        int units = scan.componentCount == 1 ? first.blocksWide * first.blocksHigh : mcusWide * mcusHigh;
+        int interval = restartInterval > 0 ? restartInterval : units;
+        int segments = std::min((int)segmentStarts.size(), (units + interval - 1) / interval);
+
+        if (!progressive)
+            scaleQuantTables();
+        std::atomic<bool> corrupt(false);
+        jpegParallelFor(segments, parallel && segments > 1, [&](int s) {
+            JpegBitReader bits(segmentStarts[s], segmentEnds[s]);
+            if (!decodeUnits(bits, s * interval, std::min(units, (s + 1) * interval)))
+                corrupt = true;
+        });
+        failed = corrupt;
+        scanCount++;
+        return position;
+    }
+
+    bool decodeUnits(JpegBitReader& bits, int firstUnit, int endUnit)
+    {
+        BlockCoding coding = getBlockCoding();
+        bool useAvx2 = avx2Available();
+        int dcPredictors[4] = {};
+        int endOfBandRun = 0;
+
+        // a sequential block is whole after its one scan, so it is decoded into
+        // scratch and IDCT'd into the plane while it is still in cache
+        int16_t scratch[64] = {};
+        auto block = [&](Component& component, size_t x, size_t y, int& dcPredictor) {
+            if (coding != BlockCoding::Baseline)
+            {
+                decodeBlock(bits, coding, component, &component.coefficients[(y * component.blocksPerLine + x) * 64], dcPredictor, endOfBandRun);
+                return;
+            }
+            decodeBlock(bits, coding, component, scratch, dcPredictor, endOfBandRun);
+            int stride = component.blocksPerLine * 8;
+            idctBlock(scratch, scaledQuantTables[component.quant], &component.plane[y * 8 * stride + x * 8], stride, useAvx2);
+            memset(scratch, 0, sizeof(scratch));
+        };
+
+        for (int unit = firstUnit; unit < endUnit && !bits.corrupt; unit++)
+        {
+            if (scan.componentCount == 1)
+            {
+                // one block per unit, walking only the blocks that hold samples
+                Component& component = components[scan.component[0]];
+                block(component, unit % component.blocksWide, unit / component.blocksWide, dcPredictors[0]);
+                continue;
+            }
+            int mcuX = unit % mcusWide, mcuY = unit / mcusWide;
+            for (int i = 0; i < scan.componentCount; i++)
+            {
+                Component& component = components[scan.component[i]];
+                for (int v = 0; v < component.v; v++)
+                    for (int h = 0; h < component.h; h++)
+                        block(component, (size_t)mcuX * component.h + h, (size_t)mcuY * component.v + v, dcPredictors[i]);
+            }
+        }
+        return !bits.corrupt;
+    }
+
+    // adds the next DC difference to dcPredictor. 8-bit data has DC categories up
+    // to 11 and DC values within 16 bits; anything past either is a corrupt table or
+    // scan, and would shift or overflow an int if decoded
+    static void decodeDc(JpegBitReader& bits, const JpegHuffmanTable& table, int& dcPredictor)
+    {
+        int category = bits.decode(table);
+        if (category > 11)
+        {
+            bits.corrupt = true;
+            return;
+        }
+        dcPredictor += bits.receiveExtend(category);
+        if (dcPredictor < -32768 || dcPredictor > 32767)
+        {
+            bits.corrupt = true;
+            dcPredictor = 0;
+        }
+    }
+
+    void decodeBlock(JpegBitReader& bits, BlockCoding coding, const Component& component, int16_t* block, int& dcPredictor, int& endOfBandRun) const
+    {
+        switch (coding)
+        {
+        case BlockCoding::Baseline:
+        {
+            decodeDc(bits, dcTables[component.dcTable], dcPredictor);
+            block[0] = (int16_t)dcPredictor;
+            const JpegHuffmanTable& table = acTables[component.acTable];
+            for (int k = 1; k < 64;)
+            {
+                if (bits.count < 32)
+                    bits.fill();
+                int fast = table.fastAc[bits.buffer >> (64 - JpegHuffmanTable::fastBits)];
+                if (fast)
+                {
+                    int length = fast & 15;
+                    k += (fast >> 4) & 15;
+                    bits.buffer <<= length;
+                    bits.count -= length;
+                    block[jpegNaturalOrder[k++]] = (int16_t)(fast >> 8);
+                    continue;
+                }
+                int symbol = bits.decode(table);
+                int run = symbol >> 4, size = symbol & 15;
+                if (size == 0)
+                {
+                    if (run != 15)
+                        break;
+                    k += 16;
+                    continue;
+                }
+                k += run;
+                block[jpegNaturalOrder[k++]] = (int16_t)bits.receiveExtend(size);
+            }
+            break;
+        }
+        case BlockCoding::DcFirst:
+            decodeDc(bits, dcTables[component.dcTable], dcPredictor);
+            block[0] = (int16_t)(dcPredictor * (1 << scan.low));
+            break;
+        case BlockCoding::DcRefine:
+            if (bits.getBit())
+                block[0] |= (int16_t)(1 << scan.low);
+            break;
+        case BlockCoding::AcFirst:
+        {
+            if (endOfBandRun > 0)
+            {
+                endOfBandRun--;
+                break;
+            }
+            const JpegHuffmanTable& table = acTables[component.acTable];
+            for (int k = scan.start; k <= scan.end;)
+            {
+                int symbol = bits.decode(table);
+                int run = symbol >> 4, size = symbol & 15;
+                if (size == 0)
+                {
+                    if (run < 15)
+                    {
+                        endOfBandRun = (1 << run) - 1;
+                        if (run)
+                            endOfBandRun += bits.getBits(run);
+                        break;
+                    }
+                    k += 16;
+                    continue;
+                }
+                k += run;
+                block[jpegNaturalOrder[k++]] = (int16_t)(bits.receiveExtend(size) * (1 << scan.low));
+            }
+            break;
+        }
+        case BlockCoding::AcRefine:
+            refineAc(bits, component, block, endOfBandRun);
+            break;
+        }
+    }
+
+    // a successive approximation pass over the band: one more bit for every
+    // coefficient that is already nonzero, and newly nonzero ones of magnitude 1
+    void refineAc(JpegBitReader& bits, const Component& component, int16_t* block, int& endOfBandRun) const
+    {
+        int bit = 1 << scan.low;
+        auto refine = [&](int16_t& coefficient) {
+            if (bits.getBit() && (coefficient & bit) == 0)
+                coefficient = (int16_t)(coefficient > 0 ? coefficient + bit : coefficient - bit);
+        };
+
+        int k = scan.start;
+        if (endOfBandRun == 0)
+        {
+            const JpegHuffmanTable& table = acTables[component.acTable];
+            while (k <= scan.end)
+            {
+                int symbol = bits.decode(table);
+                int run = symbol >> 4, size = symbol & 15;
+                int value = 0;
+                if (size == 0)
+                {
+                    if (run < 15)
+                    {
+                        endOfBandRun = 1 << run;
+                        if (run)
+                            endOfBandRun += bits.getBits(run);
+                        break;
+                    }
+                    // fifteen zeros and a zero: a run of sixteen
+                }
+                else
+                {
+                    if (size != 1)
+                    {
+                        bits.corrupt = true;
+                        return;
+                    }
+                    value = bits.getBit() ? bit : -bit;
+                }
+
+                // past run zero coefficients, refining the nonzero ones on the way
+                while (k <= scan.end)
+                {
+                    int16_t& coefficient = block[jpegNaturalOrder[k++]];
+                    if (coefficient != 0)
+                        refine(coefficient);
+                    else if (run == 0)
+                    {
+                        coefficient = (int16_t)value;
+                        break;
+                    }
+                    else
+                        run--;
+                }
+            }
+        }
+        if (endOfBandRun > 0)
+        {
+            // the rest of the band only refines
+            while (k <= scan.end)
+            {
+                int16_t& coefficient = block[jpegNaturalOrder[k++]];
+                if (coefficient != 0)
+                    refine(coefficient);
+            }
+            endOfBandRun--;
+        }
+    }
+
+    // the AAN IDCT's scale factors, folded into the quantisation tables along with
+    // the final division by 8
+    void scaleQuantTables()
+    {
+        for (int t = 0; t < 4; t++)
+            for (int row = 0; row < 8; row++)
+                for (int column = 0; column < 8; column++)
+                    scaledQuantTables[t][row * 8 + column] = quantTables[t][row * 8 + column] * aanScale(row) * aanScale(column) * 0.125f;
+    }
+
+    // IDCTs a progressive file's blocks, then upsamples and converts to RGBA in
+    // bands of rows
+    void reconstruct(RgbaImage& image, bool flipVertically)
+    {
+        bool useAvx2 = avx2Available();
+        bool large = (size_t)width * height >= 256 * 256;
+        if (progressive)
+        {
+            scaleQuantTables();
+            for (Component& component : components)
+                component.plane.resize((size_t)component.blocksPerLine * 8 * component.blocksPerColumn * 8);
+            jpegParallelFor(mcusHigh, parallel && large, [&](int mcuRow) {
+                for (Component& component : components)
+                {
+                    int stride = component.blocksPerLine * 8;
+                    for (int y = mcuRow * component.v; y < (mcuRow + 1) * component.v; y++)
+                        for (int x = 0; x < component.blocksPerLine; x++)
+                            idctBlock(&component.coefficients[((size_t)y * component.blocksPerLine + x) * 64], scaledQuantTables[component.quant],
+                                &component.plane[(size_t)y * 8 * stride + x * 8], stride, useAvx2);
+                }
+            });
+        }
+
+        image.width = width;
+        image.height = height;
+        image.pixels.resize((size_t)width * height * 4);
+        const int bandRows = 32;
+        jpegParallelFor((height + bandRows - 1) / bandRows, parallel && large, [&](int band) {
+            // each component upsampled to the full width, with room for the odd sample
+            std::vector<unsigned char> rows[3];
+            for (size_t c = 0; c < components.size(); c++)
+                rows[c].resize((size_t)mcusWide * maxH * 8 + 2);
+            const unsigned char* samples[3];
+            for (int y = band * bandRows; y < std::min(height, (band + 1) * bandRows); y++)
+            {
+                for (size_t c = 0; c < components.size(); c++)
+                    samples[c] = upsampleRow(components[c], y, rows[c].data());
+                unsigned char* out = &image.pixels[(size_t)(flipVertically ? height - 1 - y : y) * width * 4];
+                if (components.size() == 1)
+                    for (int x = 0; x < width; x++)
+                    {
+                        out[x * 4] = out[x * 4 + 1] = out[x * 4 + 2] = samples[0][x];
+                        out[x * 4 + 3] = 255;
+                    }
+                else
+                    convertRow(samples[0], samples[1], samples[2], out, width, useAvx2);
+            }
+        });
+    }
+
+    static float aanScale(int k)
+    {
+        return k == 0 ? 1.0f : (float)(cos(k * 3.14159265358979323846 / 16.0) * sqrt(2.0));
+    }
+
+    static bool avx2Available()
+    {
+        static const bool available = jpegCpuHasAvx2();
+        return available;
+    }
+
+    // the samples of component for output row y, at the output's resolution
+    const unsigned char* upsampleRow(const Component& component, int y, unsigned char* out) const
+    {
+        int stride = component.blocksPerLine * 8;
+        int hs = maxH / component.h, vs = maxV / component.v;
+        if (hs == 1 && vs == 1)
+            return &component.plane[(size_t)y * stride];
+
+        // the sample row on the other side of this output row weighs 1/4
+        int sampleRow = y / vs;
+        int farRow = sampleRow;
+        if (vs == 2)
+            farRow = y % 2 ? std::min(sampleRow + 1, component.height - 1) : std::max(sampleRow - 1, 0);
+        const unsigned char* near = &component.plane[(size_t)sampleRow * stride];
+        const unsigned char* far = &component.plane[(size_t)farRow * stride];
+        int w = component.width;
+        int x = 0;
+        if (hs == 1)
+        {
+#ifdef JPEG_SSE2
+            __m128i zero = _mm_setzero_si128(), two = _mm_set1_epi16(2);
+            for (; x + 16 <= w; x += 16)
+            {
+                __m128i nearBytes = _mm_loadu_si128((const __m128i*)(near + x)), farBytes = _mm_loadu_si128((const __m128i*)(far + x));
+                __m128i halves[2];
+                for (int half = 0; half < 2; half++)
+                {
+                    __m128i n = half ? _mm_unpackhi_epi8(nearBytes, zero) : _mm_unpacklo_epi8(nearBytes, zero);
+                    __m128i f = half ? _mm_unpackhi_epi8(farBytes, zero) : _mm_unpacklo_epi8(farBytes, zero);
+                    halves[half] = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(_mm_add_epi16(n, n), _mm_add_epi16(n, f)), two), 2);
+                }
+                _mm_storeu_si128((__m128i*)(out + x), _mm_packus_epi16(halves[0], halves[1]));
+            }
+#endif
+            for (; x < w; x++)
+                out[x] = (unsigned char)((near[x] * 3 + far[x] + 2) >> 2);
+            return out;
+        }
+
+        // horizontally each sample is 3/4 itself and 1/4 its neighbour on that side.
+        // without vertical upsampling far is near, and the sums are four times h2v1's
+        auto column = [&](int i) {
+            i = std::min(std::max(i, 0), w - 1);
+            return near[i] * 3 + far[i];
+        };
+        auto pair = [&](int i) {
+            int centre = column(i) * 3 + 8;
+            out[i * 2] = (unsigned char)((centre + column(i - 1)) >> 4);
+            out[i * 2 + 1] = (unsigned char)((centre + column(i + 1)) >> 4);
+        };
+        pair(x++);
+#ifdef JPEG_SSE2
+        __m128i zero = _mm_setzero_si128(), eight = _mm_set1_epi16(8);
+        auto columns = [&](int i) {
+            __m128i n = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(near + i)), zero);
+            __m128i f = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(far + i)), zero);
+            return _mm_add_epi16(_mm_add_epi16(n, n), _mm_add_epi16(n, f));
+        };
+        for (; x + 9 <= w; x += 8)
+        {
+            __m128i centre = columns(x);
+            centre = _mm_add_epi16(_mm_add_epi16(centre, centre), _mm_add_epi16(centre, eight));
+            __m128i even = _mm_srli_epi16(_mm_add_epi16(centre, columns(x - 1)), 4);
+            __m128i odd = _mm_srli_epi16(_mm_add_epi16(centre, columns(x + 1)), 4);
+            _mm_storeu_si128((__m128i*)(out + x * 2), _mm_unpacklo_epi8(_mm_packus_epi16(even, even), _mm_packus_epi16(odd, odd)));
+        }
+#endif
+        for (; x < w; x++)
+            pair(x);
+        return out;
+    }
+
+    // the AAN IDCT on eight values at a time, each its own row or column
+    template<class V>
+    static void idct1d(V* v)
+    {
+        V tmp10 = v[0] + v[4], tmp11 = v[0] - v[4];
+        V tmp13 = v[2] + v[6], tmp12 = (v[2] - v[6]) * 1.414213562f - tmp13;
+        V tmp0 = tmp10 + tmp13, tmp3 = tmp10 - tmp13;
+        V tmp1 = tmp11 + tmp12, tmp2 = tmp11 - tmp12;
+
+        V z13 = v[5] + v[3], z10 = v[5] - v[3];
+        V z11 = v[1] + v[7], z12 = v[1] - v[7];
+        V tmp7 = z11 + z13;
+        tmp11 = (z11 - z13) * 1.414213562f;
+        V z5 = (z10 + z12) * 1.847759065f;
+        tmp10 = z5 - z12 * 1.082392200f;
+        tmp12 = z5 - z10 * 2.613125930f;
+        V tmp6 = tmp12 - tmp7;
+        V tmp5 = tmp11 - tmp6;
+        V tmp4 = tmp10 - tmp5;
+
+        v[0] = tmp0 + tmp7;
+        v[7] = tmp0 - tmp7;
+        v[1] = tmp1 + tmp6;
+        v[6] = tmp1 - tmp6;
+        v[2] = tmp2 + tmp5;
+        v[5] = tmp2 - tmp5;
+        v[3] = tmp3 + tmp4;
+        v[4] = tmp3 - tmp4;
+    }
+
+    static void idctBlock(const int16_t* block, const float* quant, unsigned char* out, int stride, bool useAvx2)
+    {
+#ifdef JPEG_SSE2
+        if (useAvx2)
+            idctBlockAvx2(block, quant, out, stride);
+        else
+            idctBlockSse2(block, quant, out, stride);
+#else
+        idctBlockScalar(block, quant, out, stride);
+#endif
+    }
+
+    static void idctBlockScalar(const int16_t* block, const float* quant, unsigned char* out, int stride)
+    {
+        float values[64];
+        for (int i = 0; i < 64; i++)
+            values[i] = block[i] * quant[i];
+        float line[8];
+        for (int column = 0; column < 8; column++)
+        {
+            for (int row = 0; row < 8; row++)
+                line[row] = values[row * 8 + column];
+            idct1d(line);
+            for (int row = 0; row < 8; row++)
+                values[row * 8 + column] = line[row];
+        }
+        for (int row = 0; row < 8; row++)
+        {
+            idct1d(values + row * 8);
+            for (int column = 0; column < 8; column++)
+            {
+                int value = (int)lrintf(values[row * 8 + column] + 128.0f);
+                out[row * stride + column] = (unsigned char)std::min(std::max(value, 0), 255);
+            }
+        }
+    }
+
+#ifdef JPEG_SSE2
+    struct Float4
+    {
+        __m128 v;
+        Float4() {}
+        Float4(__m128 v) : v(v) {}
+        Float4 operator+(Float4 o) const { return _mm_add_ps(v, o.v); }
+        Float4 operator-(Float4 o) const { return _mm_sub_ps(v, o.v); }
+        Float4 operator*(float f) const { return _mm_mul_ps(v, _mm_set1_ps(f)); }
+    };
+
+    // an 8x8 block as two columns of four-wide rows, rows[row * 2 + half]
+    static void transpose8x8(Float4* rows)
+    {
+        for (int quarter = 0; quarter < 4; quarter++)
+        {
+            int rowBlock = quarter / 2, columnBlock = quarter % 2;
+            if (columnBlock < rowBlock)
+                continue;
+            __m128 a[4], b[4];
+            for (int i = 0; i < 4; i++)
+            {
+                a[i] = rows[(rowBlock * 4 + i) * 2 + columnBlock].v;
+                b[i] = rows[(columnBlock * 4 + i) * 2 + rowBlock].v;
+            }
+            _MM_TRANSPOSE4_PS(a[0], a[1], a[2], a[3]);
+            _MM_TRANSPOSE4_PS(b[0], b[1], b[2], b[3]);
+            for (int i = 0; i < 4; i++)
+            {
+                rows[(columnBlock * 4 + i) * 2 + rowBlock].v = a[i];
+                rows[(rowBlock * 4 + i) * 2 + columnBlock].v = b[i];
+            }
+        }
+    }
+
+    static void idctBlockSse2(const int16_t* block, const float* quant, unsigned char* out, int stride)
+    {
+        // nothing but DC is common in smooth areas: a flat block
+        __m128i lines[8];
+        for (int row = 0; row < 8; row++)
+            lines[row] = _mm_loadu_si128((const __m128i*)(block + row * 8));
+        __m128i any = _mm_and_si128(lines[0], _mm_setr_epi16(0, -1, -1, -1, -1, -1, -1, -1));
+        for (int row = 1; row < 8; row++)
+            any = _mm_or_si128(any, lines[row]);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(any, _mm_setzero_si128())) == 0xFFFF)
+        {
+            int value = (int)lrintf(block[0] * quant[0] + 128.0f);
+            __m128i flat = _mm_set1_epi8((char)(unsigned char)std::min(std::max(value, 0), 255));
+            for (int row = 0; row < 8; row++)
+                _mm_storel_epi64((__m128i*)(out + row * stride), flat);
+            return;
+        }
+
+        Float4 rows[16];
+        for (int row = 0; row < 8; row++)
+        {
+            __m128i low = _mm_srai_epi32(_mm_unpacklo_epi16(lines[row], lines[row]), 16);
+            __m128i high = _mm_srai_epi32(_mm_unpackhi_epi16(lines[row], lines[row]), 16);
+            rows[row * 2] = _mm_mul_ps(_mm_cvtepi32_ps(low), _mm_loadu_ps(quant + row * 8));
+            rows[row * 2 + 1] = _mm_mul_ps(_mm_cvtepi32_ps(high), _mm_loadu_ps(quant + row * 8 + 4));
+        }
+
+        // columns, with the rows as vectors, then the same again transposed
+        for (int pass = 0; pass < 2; pass++)
+        {
+            for (int half = 0; half < 2; half++)
+            {
+                Float4 v[8];
+                for (int i = 0; i < 8; i++)
+                    v[i] = rows[i * 2 + half];
+                idct1d(v);
+                for (int i = 0; i < 8; i++)
+                    rows[i * 2 + half] = v[i];
+            }
+            transpose8x8(rows);
+        }
+
+        __m128 offset = _mm_set1_ps(128.0f);
+        for (int row = 0; row < 8; row++)
+        {
+            __m128i low = _mm_cvtps_epi32(_mm_add_ps(rows[row * 2].v, offset));
+            __m128i high = _mm_cvtps_epi32(_mm_add_ps(rows[row * 2 + 1].v, offset));
+            __m128i words = _mm_packs_epi32(low, high);
+            _mm_storel_epi64((__m128i*)(out + row * stride), _mm_packus_epi16(words, words));
+        }
+    }
+
+    JPEG_AVX2_FUNCTION static void idct1dAvx2(__m256* v)
+    {
+        __m256 tmp10 = _mm256_add_ps(v[0], v[4]), tmp11 = _mm256_sub_ps(v[0], v[4]);
+        __m256 tmp13 = _mm256_add_ps(v[2], v[6]);
+        __m256 tmp12 = _mm256_sub_ps(_mm256_mul_ps(_mm256_sub_ps(v[2], v[6]), _mm256_set1_ps(1.414213562f)), tmp13);
+        __m256 tmp0 = _mm256_add_ps(tmp10, tmp13), tmp3 = _mm256_sub_ps(tmp10, tmp13);
+        __m256 tmp1 = _mm256_add_ps(tmp11, tmp12), tmp2 = _mm256_sub_ps(tmp11, tmp12);
+
+        __m256 z13 = _mm256_add_ps(v[5], v[3]), z10 = _mm256_sub_ps(v[5], v[3]);
+        __m256 z11 = _mm256_add_ps(v[1], v[7]), z12 = _mm256_sub_ps(v[1], v[7]);
+        __m256 tmp7 = _mm256_add_ps(z11, z13);
+        tmp11 = _mm256_mul_ps(_mm256_sub_ps(z11, z13), _mm256_set1_ps(1.414213562f));
+        __m256 z5 = _mm256_mul_ps(_mm256_add_ps(z10, z12), _mm256_set1_ps(1.847759065f));
+        tmp10 = _mm256_sub_ps(z5, _mm256_mul_ps(z12, _mm256_set1_ps(1.082392200f)));
+        tmp12 = _mm256_sub_ps(z5, _mm256_mul_ps(z10, _mm256_set1_ps(2.613125930f)));
+        __m256 tmp6 = _mm256_sub_ps(tmp12, tmp7);
+        __m256 tmp5 = _mm256_sub_ps(tmp11, tmp6);
+        __m256 tmp4 = _mm256_sub_ps(tmp10, tmp5);
+
+        v[0] = _mm256_add_ps(tmp0, tmp7);
+        v[7] = _mm256_sub_ps(tmp0, tmp7);
+        v[1] = _mm256_add_ps(tmp1, tmp6);
+        v[6] = _mm256_sub_ps(tmp1, tmp6);
+        v[2] = _mm256_add_ps(tmp2, tmp5);
+        v[5] = _mm256_sub_ps(tmp2, tmp5);
+        v[3] = _mm256_add_ps(tmp3, tmp4);
+        v[4] = _mm256_sub_ps(tmp3, tmp4);
+    }
+
+    JPEG_AVX2_FUNCTION static void transpose8x8Avx2(__m256* r)
+    {
+        __m256 t0 = _mm256_unpacklo_ps(r[0], r[1]), t1 = _mm256_unpackhi_ps(r[0], r[1]);
+        __m256 t2 = _mm256_unpacklo_ps(r[2], r[3]), t3 = _mm256_unpackhi_ps(r[2], r[3]);
+        __m256 t4 = _mm256_unpacklo_ps(r[4], r[5]), t5 = _mm256_unpackhi_ps(r[4], r[5]);
+        __m256 t6 = _mm256_unpacklo_ps(r[6], r[7]), t7 = _mm256_unpackhi_ps(r[6], r[7]);
+        __m256 u0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0)), u1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+        __m256 u2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0)), u3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+        __m256 u4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0)), u5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+        __m256 u6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0)), u7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+        r[0] = _mm256_permute2f128_ps(u0, u4, 0x20);
+        r[1] = _mm256_permute2f128_ps(u1, u5, 0x20);
+        r[2] = _mm256_permute2f128_ps(u2, u6, 0x20);
+        r[3] = _mm256_permute2f128_ps(u3, u7, 0x20);
+        r[4] = _mm256_permute2f128_ps(u0, u4, 0x31);
+        r[5] = _mm256_permute2f128_ps(u1, u5, 0x31);
+        r[6] = _mm256_permute2f128_ps(u2, u6, 0x31);
+        r[7] = _mm256_permute2f128_ps(u3, u7, 0x31);
+    }
+
+    // as idctBlockSse2, with a whole row per register
+    JPEG_AVX2_FUNCTION static void idctBlockAvx2(const int16_t* block, const float* quant, unsigned char* out, int stride)
+    {
+        __m256i any = _mm256_and_si256(_mm256_loadu_si256((const __m256i*)block),
+            _mm256_setr_epi16(0, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1));
+        for (int i = 16; i < 64; i += 16)
+            any = _mm256_or_si256(any, _mm256_loadu_si256((const __m256i*)(block + i)));
+        if (_mm256_testz_si256(any, any))
+        {
+            int value = (int)lrintf(block[0] * quant[0] + 128.0f);
+            __m128i fill = _mm_set1_epi8((char)(unsigned char)std::min(std::max(value, 0), 255));
+            for (int row = 0; row < 8; row++)
+                _mm_storel_epi64((__m128i*)(out + row * stride), fill);
+            return;
+        }
+
+        __m256 rows[8];
+        for (int row = 0; row < 8; row++)
+        {
+            __m256i words = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(block + row * 8)));
+            rows[row] = _mm256_mul_ps(_mm256_cvtepi32_ps(words), _mm256_loadu_ps(quant + row * 8));
+        }
+        idct1dAvx2(rows);
+        transpose8x8Avx2(rows);
+        idct1dAvx2(rows);
+        transpose8x8Avx2(rows);
+
+        __m256 offset = _mm256_set1_ps(128.0f);
+        for (int row = 0; row < 8; row++)
+        {
+            __m256i values = _mm256_cvtps_epi32(_mm256_add_ps(rows[row], offset));
+            __m128i words = _mm_packs_epi32(_mm256_castsi256_si128(values), _mm256_extracti128_si256(values, 1));
+            _mm_storel_epi64((__m128i*)(out + row * stride), _mm_packus_epi16(words, words));
+        }
+    }
+#endif
+
+    // JFIF YCbCr to RGBA for one row
+    static void convertRow(const unsigned char* y, const unsigned char* cb, const unsigned char* cr, unsigned char* out, int width, bool useAvx2)
+    {
+        int x = 0;
+#ifdef JPEG_SSE2
+        if (useAvx2)
+            x = convertRowAvx2(y, cb, cr, out, width);
+        else
+            x = convertRowSse2(y, cb, cr, out, width);
+#endif
+        for (; x < width; x++)
+        {
+            float luma = y[x], blue = cb[x] - 128.0f, red = cr[x] - 128.0f;
+            int r = (int)lrintf(luma + 1.402f * red);
+            int g = (int)lrintf(luma - 0.344136f * blue - 0.714136f * red);
+            int b = (int)lrintf(luma + 1.772f * blue);
+            out[x * 4] = (unsigned char)std::min(std::max(r, 0), 255);
+            out[x * 4 + 1] = (unsigned char)std::min(std::max(g, 0), 255);
+            out[x * 4 + 2] = (unsigned char)std::min(std::max(b, 0), 255);
+            out[x * 4 + 3] = 255;
+        }
+    }
+
+#ifdef JPEG_SSE2
+    // four pixels' red, green and blue as 32-bit integers, from bytes as floats
+    static void convertFour(__m128 luma, __m128 blue, __m128 red, __m128i* rgb)
+    {
+        rgb[0] = _mm_cvtps_epi32(_mm_add_ps(luma, _mm_mul_ps(red, _mm_set1_ps(1.402f))));
+        rgb[1] = _mm_cvtps_epi32(_mm_sub_ps(_mm_sub_ps(luma, _mm_mul_ps(blue, _mm_set1_ps(0.344136f))), _mm_mul_ps(red, _mm_set1_ps(0.714136f))));
+        rgb[2] = _mm_cvtps_epi32(_mm_add_ps(luma, _mm_mul_ps(blue, _mm_set1_ps(1.772f))));
+    }
+
+    // sixteen pixels of saturated 16-bit red, green and blue interleaved into RGBA
+    static void storeSixteen(__m128i red[2], __m128i green[2], __m128i blue[2], unsigned char* out)
+    {
+        __m128i r = _mm_packus_epi16(red[0], red[1]), g = _mm_packus_epi16(green[0], green[1]);
+        __m128i b = _mm_packus_epi16(blue[0], blue[1]), a = _mm_set1_epi8((char)0xFF);
+        __m128i rg = _mm_unpacklo_epi8(r, g), ba = _mm_unpacklo_epi8(b, a);
+        _mm_storeu_si128((__m128i*)out, _mm_unpacklo_epi16(rg, ba));
+        _mm_storeu_si128((__m128i*)(out + 16), _mm_unpackhi_epi16(rg, ba));
+        rg = _mm_unpackhi_epi8(r, g);
+        ba = _mm_unpackhi_epi8(b, a);
+        _mm_storeu_si128((__m128i*)(out + 32), _mm_unpacklo_epi16(rg, ba));
+        _mm_storeu_si128((__m128i*)(out + 48), _mm_unpackhi_epi16(rg, ba));
+    }
+
+    // returns how many pixels it converted, a multiple of 16
+    static int convertRowSse2(const unsigned char* y, const unsigned char* cb, const unsigned char* cr, unsigned char* out, int width)
+    {
+        __m128i zero = _mm_setzero_si128();
+        __m128 half = _mm_set1_ps(128.0f);
+        int x = 0;
+        for (; x + 16 <= width; x += 16)
+        {
+            __m128i luma = _mm_loadu_si128((const __m128i*)(y + x));
+            __m128i blue = _mm_loadu_si128((const __m128i*)(cb + x));
+            __m128i red = _mm_loadu_si128((const __m128i*)(cr + x));
+            __m128i channels[3][2];
+            for (int eighth = 0; eighth < 2; eighth++)
+            {
+                __m128i luma16 = eighth ? _mm_unpackhi_epi8(luma, zero) : _mm_unpacklo_epi8(luma, zero);
+                __m128i blue16 = eighth ? _mm_unpackhi_epi8(blue, zero) : _mm_unpacklo_epi8(blue, zero);
+                __m128i red16 = eighth ? _mm_unpackhi_epi8(red, zero) : _mm_unpacklo_epi8(red, zero);
+                __m128i low[3], high[3];
+                convertFour(_mm_cvtepi32_ps(_mm_unpacklo_epi16(luma16, zero)), _mm_sub_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(blue16, zero)), half),
+                    _mm_sub_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(red16, zero)), half), low);
+                convertFour(_mm_cvtepi32_ps(_mm_unpackhi_epi16(luma16, zero)), _mm_sub_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(blue16, zero)), half),
+                    _mm_sub_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(red16, zero)), half), high);
+                for (int c = 0; c < 3; c++)
+                    channels[c][eighth] = _mm_packs_epi32(low[c], high[c]);
+            }
+            storeSixteen(channels[0], channels[1], channels[2], out + x * 4);
+        }
+        return x;
+    }
+
+    JPEG_AVX2_FUNCTION static int convertRowAvx2(const unsigned char* y, const unsigned char* cb, const unsigned char* cr, unsigned char* out, int width)
+    {
+        __m256 half = _mm256_set1_ps(128.0f);
+        int x = 0;
+        for (; x + 16 <= width; x += 16)
+        {
+            __m128i channels[3][2];
+            for (int eighth = 0; eighth < 2; eighth++)
+            {
+                __m256 luma = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(y + x + eighth * 8))));
+                __m256 blue = _mm256_sub_ps(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(cb + x + eighth * 8)))), half);
+                __m256 red = _mm256_sub_ps(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(cr + x + eighth * 8)))), half);
+                __m256i rgb[3];
+                rgb[0] = _mm256_cvtps_epi32(_mm256_add_ps(luma, _mm256_mul_ps(red, _mm256_set1_ps(1.402f))));
+                rgb[1] = _mm256_cvtps_epi32(_mm256_sub_ps(_mm256_sub_ps(luma, _mm256_mul_ps(blue, _mm256_set1_ps(0.344136f))),
+                    _mm256_mul_ps(red, _mm256_set1_ps(0.714136f))));
+                rgb[2] = _mm256_cvtps_epi32(_mm256_add_ps(luma, _mm256_mul_ps(blue, _mm256_set1_ps(1.772f))));
+                for (int c = 0; c < 3; c++)
+                    channels[c][eighth] = _mm_packs_epi32(_mm256_castsi256_si128(rgb[c]), _mm256_extracti128_si256(rgb[c], 1));
+            }
+            storeSixteen(channels[0], channels[1], channels[2], out + x * 4);
+        }
+        return x;
+    }
+#endif
+};
+
+// the JPEG in data as RGBA8, rows from the bottom if flipVertically; false if it
+// is not a JPEG this decoder handles
+inline bool decodeJpeg(const unsigned char* data, size_t size, RgbaImage& image, bool flipVertically, bool parallel = true)
+{
+    JpegDecoder decoder;
+    return decoder.decode(data, size, image, flipVertically, parallel);
+}
+
+#endif /* jpegDecoder_h */
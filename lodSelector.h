@@ -0,0 +1,41 @@
+#ifndef lodSelector_h
+#define lodSelector_h
+
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <glm/glm.hpp>
+#include "meshSimplifier.h"
+
+// picks the coarsest level of a LodChain whose error, projected at the nearest
+// point of the object's bounding sphere, stays within pixelError pixels
+class LodSelector
+{
+public:
+    float pixelError = 1.0f;
+
+    // once per frame with the projection used for drawing and the viewport height
+    void update(const glm::mat4& projection, float viewportHeight)
+    {
+        pixelsPerUnit = 0.5f * viewportHeight * projection[1][1];
+    }
+
+    int select(const std::vector<LodLevel>& levels, glm::vec3 center, float radius, const glm::mat4& model, glm::vec3 cameraPos) const
+    {
+        float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+        glm::vec3 worldCenter = glm::vec3(model * glm::vec4(center, 1.0f));
+        float distance = std::max(glm::length(worldCenter - cameraPos) - radius * scale, nearest);
+
+        for (int level = (int)levels.size() - 1; level > 0; level--)
+            if (levels[level].error * scale * pixelsPerUnit / distance <= pixelError)
+                return level;
+        return 0;
+    }
+
+private:
+    // until update() runs every object gets its full detail
+    float pixelsPerUnit = std::numeric_limits<float>::max();
+    const float nearest = 0.1f;
+};
+
+#endif /* lodSelector_h */
@@ -10,15 +10,32 @@
 #include "basic_camera.h"
 #include "pointLight.h"
 #include "sphere.h"
-#include "stb_image.h"
 #include "cube.h"
 #include "fractal.h"
 #include "railing.h"
 #include "BezierCurve.h"
-#include "CurvyCube.h"
+#include "roundedBox.h"
 #include "Curtain.h"
 #include "cylinder.h"
 #include "flag.h"
+#include "forest.h"
+#include "meshData.h"
+#include "threadPool.h"
+#include "textureLoader.h"
+#include "textureFeedback.h"
+#include "virtualTexture.h"
+#include "floorDetail.h"
+#include "meshOptimizer.h"
+#include "primitives.h"
+#include "meshCache.h"
+#include "meshSimplifier.h"
+#include "lodSelector.h"
+#include "glResource.h"
+#include "retainedGeometry.h"
+#include "memoryReport.h"
+#include "sceneFile.h"
+#include "sceneSystems.h"
+#include "simulation.h"
 
 #include <iostream>
 
@@ -29,18 +46,14 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void processInput(GLFWwindow* window);
-void drawCube(unsigned int& cubeVAO, Shader& lightingShader, glm::mat4 model, float r, float g, float b, float shininess);
-void axis(unsigned int& cubeVAO, Shader& lightingShader);
-void floor(unsigned int& cubeVAO, Shader& lightingShader);
-void chairs(unsigned int& cubeVAO, Shader& lightingShader);
-void frontWall(unsigned int& cubeVAO, Shader& lightingShader);
-void rightWall(unsigned int& cubeVAO, Shader& lightingShader);
+void drawCube(const GlVertexArray& cubeVAO, Shader& lightingShader, glm::mat4 model, float r, float g, float b, float shininess);
+void axis(const GlVertexArray& cubeVAO, Shader& lightingShader);
+void floor(const GlVertexArray& cubeVAO, Shader& lightingShader);
+void rightWall(const GlVertexArray& cubeVAO, Shader& lightingShader);
 void ambienton_off(Shader& lightingShader);
 void diffuse_on_off(Shader& lightingShader);
 void specular_on_off(Shader& lightingShader);
-void walls(unsigned int& cubeVAO, Shader& lightingShader);
-void stairs(unsigned int& cubeVAO, Shader& lightingShader);
-unsigned int loadTexture(char const* path, GLenum textureWrappingModeS, GLenum textureWrappingModeT, GLenum textureFilteringModeMin, GLenum textureFilteringModeMax);
+void editRoofProfile(GLFWwindow* window, BezierCurve& roof);
 
 float left = -5.0f;
 float right = 5.0f;
@@ -49,10 +62,32 @@ float top = 5.0f;
 float near = 0.1f; 
 float far = 100.0f;
 
-float r = 0.0;
-
 bool fanOn = false;
 
+// draw the roof with the GL 4.x tessellation shaders instead of the static CPU mesh
+bool tessellatedRoof = false;
+
+// vertex layout of the static meshes; VertexFormat::Float is the original 32-byte layout
+VertexFormat meshVertexFormat = VertexFormat::PackedQuantised;
+
+// CPU copy the meshes keep once uploaded; nothing in the scene picks or collides yet
+MeshRetention meshRetention = MeshRetention::Discard;
+
+// VRAM the loaded textures may take before finer mip levels are evicted again; the
+// levels of up to 128 texels a side stay resident regardless
+size_t textureBudget = 256 * 1024 * 1024;
+
+// pages of 128 texels per side of the ground floor's unique texture, a power of two
+// up to 256; 32 is about three times the texel density of the tiled floor. only
+// VirtualTexture's page cache is on the GPU, so raising it costs disk and bake time
+int floorDetailPages = 32;
+
+// roof profile editing: , and . pick a control point, arrow keys move it
+int selectedRoofPoint = 0;
+
+// how each of the scene file's mesh names is drawn
+enum class SceneMesh { Unknown, Cube, FloorDetail, Tree, Railing, Roof, Curtain, TreePot };
+
 
 glm::mat4 myProjection(float left, float right, float bottom, float top, float near, float far) {
     glm::mat4 result(0.0f); // Initialize to a zero matrix
@@ -103,69 +138,10 @@ glm::vec3 V = glm::vec3(0.0f, 1.0f, 0.0f);
 BasicCamera basic_camera(eyeX, eyeY, eyeZ, lookAtX, lookAtY, lookAtZ, V);
 
 
-// positions of the point lights
-glm::vec3 pointLightPositions[] = {
-    glm::vec3(4.50f,  2.50f,  1.5f),
-    glm::vec3(4.50f,  2.50f,  -1.5f),
-    glm::vec3(-10.0f, 6.8f, 0.0f),
-    glm::vec3(-10.0f, 6.8f, -1.5f),
-    glm::vec3(-10.0f, 6.8f, 1.5f),
-};
-PointLight pointlight1(
-
-    pointLightPositions[0].x, pointLightPositions[0].y, pointLightPositions[0].z,  // position
-    0.05f, 0.05f, 0.05f,     // ambient
-    0.8f, 0.8f, 0.8f,     // diffuse
-    1.0f, 1.0f, 1.0f,        // specular
-    1.0f,   //k_c
-    0.09f,  //k_l
-    0.032f, //k_q
-    1       // light number
-);
-PointLight pointlight2(
-
-    pointLightPositions[1].x, pointLightPositions[1].y, pointLightPositions[1].z,  // position
-    0.05f, 0.05f, 0.05f,     // ambient
-    0.8f, 0.8f, 0.8f,     // diffuse
-    1.0f, 1.0f, 1.0f,        // specular
-    1.0f,   //k_c
-    0.09f,  //k_l
-    0.032f, //k_q
-    2       // light number
-);
-PointLight pointlight3(
-
-    pointLightPositions[2].x, pointLightPositions[2].y, pointLightPositions[2].z,  // position
-    0.05f, 0.05f, 0.05f,     // ambient
-    0.8f, 0.8f, 0.8f,     // diffuse
-    1.0f, 1.0f, 1.0f,        // specular
-    1.0f,   //k_c
-    0.09f,  //k_l
-    0.032f, //k_q
-    3       // light number
-);
-PointLight pointlight4(
-
-    pointLightPositions[3].x, pointLightPositions[3].y, pointLightPositions[3].z,  // position
-    0.05f, 0.05f, 0.05f,     // ambient
-    0.8f, 0.8f, 0.8f,     // diffuse
-    1.0f, 1.0f, 1.0f,        // specular
-    1.0f,   //k_c
-    0.09f,  //k_l
-    0.032f, //k_q
-    4       // light number
-);
-PointLight pointlight5(
-
-    pointLightPositions[4].x, pointLightPositions[4].y, pointLightPositions[4].z,  // position
-    0.05f, 0.05f, 0.05f,     // ambient
-    0.8f, 0.8f, 0.8f,     // diffuse
-    1.0f, 1.0f, 1.0f,        // specular
-    1.0f,   //k_c
-    0.09f,  //k_l
-    0.032f, //k_q
-    4       // light number
-);
+// the point lights, in the order auditorium.scene lists them; the first
+// stageLightCount are the stage lamps, which the 4, 5 and 6 keys dim
+std::vector<PointLight> pointLights;
+const size_t stageLightCount = 2;
 
 
 // light settings
@@ -204,8 +180,13 @@ int main()
     // glfw: initialize and configure
     // ------------------------------
     glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+
+    // glfw: terminate, clearing all previously allocated GLFW resources, when main
+    // returns. it is declared before any GL object, so it is destroyed after all of
+    // them and they are deleted while the context still exists
+    struct GlfwSession { ~GlfwSession() { glfwTerminate(); } } glfwSession;
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, tessellatedRoof ? 4 : 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, tessellatedRoof ? 1 : 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
 #ifdef __APPLE__
@@ -215,10 +196,18 @@ int main()
     // glfw window creation
     // --------------------
     GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Auditorium", NULL, NULL);
+    if (window == NULL && tessellatedRoof)
+    {
+        // no GL 4.x driver: fall back to the 3.3 context and the CPU roof mesh
+        std::cout << "GL 4.1 context unavailable, roof tessellation disabled" << std::endl;
+        tessellatedRoof = false;
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Auditorium", NULL, NULL);
+    }
     if (window == NULL)
     {
         std::cout << "Failed to create GLFW window" << std::endl;
-        glfwTerminate();
         return -1;
     }
     glfwMakeContextCurrent(window);
@@ -242,14 +231,84 @@ int main()
     // -----------------------------
     glEnable(GL_DEPTH_TEST);
 
-    Torus torus(2.0f, 0.6f, 50, 30); // Torus with radius = 1.0, tube radius = 0.4
+    float curve_points[] = {
+-0.0050, 1.7348, 4.9635,
+-0.2350, 1.7201, 4.9666,
+-0.4850, 1.6467, 4.9821,
+-0.6100, 1.5391, 5.0049,
+-0.7350, 1.3924, 5.0359,
+-0.7400, 1.2945, 5.0566,
+-0.7500, 1.1820, 5.0804,
+-0.7300, 1.0695, 5.1042,
+-0.7600, 1.0059, 5.1177,
+-0.8250, 0.9326, 5.1332,
+-0.9550, 0.9032, 5.1394,
+-1.1000, 0.8787, 5.1446,
+-1.2400, 0.9423, 5.1311,
+-1.3500, 1.0157, 5.1156,
+    };
+
+    // procedural geometry is built and textures are decoded on worker threads while
+    // shaders compile; the GL objects are created from the finished meshes further
+    // down. meshes built on an earlier run come straight out of the cache file instead
+    MeshCache meshCache("mesh_cache.bin");
+    ThreadPool workers;
+    std::future<MeshData> torusMesh = workers.submit([&meshCache] {
+        return meshCache.fetch(MeshCacheKey("torus").add(2.0f).add(0.6f).add(50).add(30),
+            [] { return Torus::buildGeometry(2.0f, 0.6f, 50, 30); });
+    });
+    std::future<MeshData> sphereMesh = workers.submit([&meshCache] {
+        return meshCache.fetch(MeshCacheKey("sphere").add(1.0f).add(36).add(18),
+            [] { return SphereTex::buildGeometry<36, 18>(1.0f); });
+    });
+    std::future<TreeGeometry> treeGeometry = workers.submit([&meshCache] {
+        return meshCache.fetch(MeshCacheKey("fractal tree").add(1.0f).add(30.0f).add(10).add(1),
+            [] { return FractalTree::buildGeometry(); });
+    });
+    std::future<MeshData> roundedBoxMesh = workers.submit([&meshCache] {
+        return meshCache.fetch(MeshCacheKey("rounded box").add(glm::vec3(1.0f)).add(0.1f).add(4),
+            [] { return RoundedBox::buildGeometry(glm::vec3(1.0f), 0.1f, 4); });
+    });
+    std::future<MeshData> curtainMesh = workers.submit([&meshCache] {
+        return meshCache.fetch(MeshCacheKey("curtain").add(50).add(0.2f), [] { return Curtain::buildGeometry(); });
+    });
+    std::future<LodChain> treePotLods = workers.submit([&meshCache] {
+        return meshCache.fetch(MeshCacheKey("tree pot").add(96).add(0.002f).add(0.01f).add(0.03f),
+            [] { return buildLodChain(Cylinder::buildGeometry<96>(), { 0.002f, 0.01f, 0.03f }, "tree pot"); });
+    });
+    std::future<MeshData> flagMesh = workers.submit([&meshCache] {
+        return meshCache.fetch(MeshCacheKey("flag"), [] { return Flag::buildGeometry(); });
+    });
+    // a few tree shapes for the plaza forest; every planted tree is an instance of one
+    struct TreeShape { float branchLength, branchAngle; int recursionDepth; unsigned int seed; };
+    const TreeShape forestShapes[] = { { 1.0f, 25.0f, 9, 11 }, { 1.0f, 32.0f, 9, 23 }, { 0.9f, 40.0f, 8, 37 } };
+    std::vector<std::future<TreeGeometry>> forestArchetypes;
+    for (const TreeShape& shape : forestShapes)
+        forestArchetypes.push_back(workers.submit([&meshCache, shape] {
+            return meshCache.fetch(MeshCacheKey("fractal tree").add(shape.branchLength).add(shape.branchAngle).add(shape.recursionDepth).add((int)shape.seed),
+                [shape] { return FractalTree::buildGeometry(shape.branchLength, shape.branchAngle, shape.recursionDepth, shape.seed); });
+        }));
+    // the tessellated roof is evaluated on the GPU and has no mesh to build
+    std::future<MeshData> roofMesh;
+    if (!tessellatedRoof)
+        roofMesh = workers.submit([&meshCache, &curve_points] {
+            return meshCache.fetch(MeshCacheKey("roof").add(curve_points, 16).add(40).add(20),
+                [&curve_points] { return BezierCurve::buildGeometry(curve_points, 16, 40, 20); });
+        });
+
     /*Shader lightingShader("vertex_shader.glsl", "fragment_shader.glsl");*/
     // build and compile our shader zprogram
     // ------------------------------------
     Shader lightingShader("vertexShaderForPhongShading.vs", "fragmentShaderForPhongShading.fs");
     Shader lightingShaderWithTexture("vertexShaderForPhongShadingWithTexture.vs", "fragmentShaderForPhongShadingWithTexture.fs");
+    Shader virtualTextureShader("vertexShaderForPhongShadingWithTexture.vs", "fragmentShaderForVirtualTexture.fs");
     //Shader lightingShader("vertexShaderForGouraudShading.vs", "fragmentShaderForGouraudShading.fs");
     Shader ourShader("vertexShader.vs", "fragmentShader.fs");
+    Shader forestShader("vertexShaderForForest.vs", "fragmentShaderForForest.fs");
+    Shader forestImpostorShader("vertexShaderForForestImpostor.vs", "fragmentShaderForForestImpostor.fs");
+    Shader roofTessellationShader = tessellatedRoof ?
+        Shader("vertexShaderForBezierTessellation.vs", "fragmentShaderForPhongShadingWithTexture.fs", nullptr, "tessControlShaderForBezier.tcs", "tessEvaluationShaderForBezier.tes") :
+        lightingShaderWithTexture;
 
     string diffuseMapPath = "container2.png";
     string specularMapPath = "container2_specular.png";
@@ -258,180 +317,184 @@ int main()
     string curveTexturePath = "curve_texture.jpg";
     string woodTexturePath = "wood_texture.jpeg";
     string curtainTexturePath = "red_curtain.jpg";
-    string steelTexturePath = "steel_texture.jpg";
-    string doorTexturePath = "door_texture.jpg";
     string treePotTexturePath = "tree_pot_texture.jpg";
     string bdFlagTexturePath = "bd_flag_texture.jpg";
-    string fanTexturePath = "fan_texture.jpeg";
 
-    unsigned int laughEmoji = loadTexture(laughEmoPath.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
-    //unsigned int laughEmojiv2 = loadTexture(laughEmoPath.c_str(), GL_REPEAT, GL_MIRRORED_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+    // where everything in the hall stands, and its lights
+    Scene scene;
+    if (!loadScene("auditorium.scene", scene))
+    {
+        std::cout << "Failed to load auditorium.scene" << std::endl;
+        return -1;
+    }
+    for (size_t i = 0; i < scene.getLightCount(); i++)
+        pointLights.push_back(PointLight(scene.lightPosition[i].x, scene.lightPosition[i].y, scene.lightPosition[i].z,
+            scene.lightAmbient[i].x, scene.lightAmbient[i].y, scene.lightAmbient[i].z,
+            scene.lightDiffuse[i].x, scene.lightDiffuse[i].y, scene.lightDiffuse[i].z,
+            scene.lightSpecular[i].x, scene.lightSpecular[i].y, scene.lightSpecular[i].z,
+            scene.lightAttenuation[i].x, scene.lightAttenuation[i].y, scene.lightAttenuation[i].z, (int)scene.lightSlot[i]));
+
+    // every texture is a grey placeholder until textureLoader.update() in the render
+    // loop has uploaded its image
+    TextureLoader textureLoader(workers, textureBudget);
+    TextureFeedback textureFeedback;
+    std::unordered_map<GLuint, float> textureFootprints;
+    const GlTexture& laughEmoji = textureLoader.load(laughEmoPath, GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+    //const GlTexture& laughEmojiv2 = textureLoader.load(laughEmoPath, GL_REPEAT, GL_MIRRORED_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
     
-    unsigned int floor_texture = loadTexture(floorTexturePath.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
-
-    unsigned int curveTexture = loadTexture(curveTexturePath.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+    const GlTexture& curveTexture = textureLoader.load(curveTexturePath, GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
     
-    unsigned int woodTexture = loadTexture(woodTexturePath.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+    const GlTexture& woodTexture = textureLoader.load(woodTexturePath, GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
     
-    unsigned int curtainTexture = loadTexture(curtainTexturePath.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+    const GlTexture& curtainTexture = textureLoader.load(curtainTexturePath, GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
     
-    unsigned int steelTexture = loadTexture(steelTexturePath.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
-
-    unsigned int doorTexture = loadTexture(doorTexturePath.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+    const GlTexture& treePotTexture = textureLoader.load(treePotTexturePath, GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
 
-    unsigned int treePotTexture = loadTexture(treePotTexturePath.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+    const GlTexture& bdFlagTexture = textureLoader.load(bdFlagTexturePath, GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
 
-    unsigned int bdFlagTexture = loadTexture(bdFlagTexturePath.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
 
-    unsigned int fanTexture = loadTexture(fanTexturePath.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+    // the ground floor's boards, markings and wear, baked into floor_texture.jpg.vtex
+    // on the workers the first time
+    FloorDetailSource floorDetailSource(floorTexturePath, 2, 128 * floorDetailPages);
+    VirtualTexture floorDetail(workers, floorTexturePath + ".vtex", 128, floorDetailPages, floorDetailSource.getStamp(), floorDetailSource);
     
-    Cube floorCube = Cube(floor_texture, floor_texture, 32.0f, 0.0f, 0.0f, 2.0f, 2.0f);
+    defaultVertexFormat() = meshVertexFormat;
+    defaultMeshRetention() = meshRetention;
+
+    Torus torus(torusMesh.get()); // Torus with radius = 1.0, tube radius = 0.4
+
+    Cube floorDetailCube = Cube(floorDetail.getCacheTexture().get(), floorDetail.getCacheTexture().get(), 32.0f, 0.0f, 0.0f, 1.0f, 1.0f);
 
-    //Cube CurtainHolderCube = Cube(woodTexture, woodTexture, )
+    //Cube CurtainHolderCube = Cube(woodTexture.get(), woodTexture.get(), )
 
 
 
-    Cube cube = Cube(laughEmoji, laughEmoji, 32.0f, 0.0f, 0.0f, 2.0f, 2.0f);
-    SphereTex spheretex = SphereTex();
+    Cube cube = Cube(laughEmoji.get(), laughEmoji.get(), 32.0f, 0.0f, 0.0f, 2.0f, 2.0f);
+    SphereTex spheretex = SphereTex(sphereMesh.get());
 
     //fractal for tree
-    FractalTree tree = FractalTree();
+    FractalTree tree = FractalTree(treeGeometry.get());
+
+    //forest on the plaza outside the hall
+    std::vector<TreeGeometry> forestGeometries;
+    for (std::future<TreeGeometry>& archetype : forestArchetypes)
+        forestGeometries.push_back(archetype.get());
+    Forest forest(forestGeometries);
+    forestGeometries.clear();
+    forest.scatter(300, glm::vec3(-70.0f, -0.9f, -30.0f), glm::vec3(-30.0f, -0.9f, 40.0f), 7);
 
     //Railing on the second floor
     Railing railing = Railing();
 
-    //Curvy Cube
-    CurvyCube curvyCube = CurvyCube(woodTexture, woodTexture,32.0f,0.0f,0.0f,2.0f,2.0f );
-
-    //Curtain Holder
-    Cube curtainHolderCube = Cube(woodTexture, woodTexture, 32.0f, 0.0f, 0.0f, 2.0f, 2.0f);
+    //Rounded Box
+    RoundedBox roundedBox = RoundedBox(roundedBoxMesh.get(), woodTexture.get(), woodTexture.get(), 32.0f, 0.0f, 0.0f, 2.0f, 2.0f);
 
     //Curtain
-    Curtain curtain = Curtain(curtainTexture);
-
-    //steel
-    Cube steel = Cube(steelTexture, steelTexture, 32.0f, 0.0f, 0.0f, 2.0f, 2.0f);
-
-    //door
-    Cube door = Cube(doorTexture, doorTexture, 32.0f, 0.0f, 0.0f, 2.0f, 2.0f);
+    Curtain curtain = Curtain(curtainMesh.get(), curtainTexture.get());
 
     //Tree Pot texture cylinder
-    Cylinder treePot = Cylinder(treePotTexture, treePotTexture, 32.0f, 0.0f, 0.0f, 2.0f, 2.0f);
+    Cylinder treePot = Cylinder(treePotLods.get(), treePotTexture.get(), treePotTexture.get(), 32.0f, 0.0f, 0.0f, 2.0f, 2.0f);
+    LodSelector lodSelector;
 
     //wavin flag
-    Flag bdFlag = Flag(bdFlagTexture,bdFlagTexture, 32.0f,2.0f,1.0f);
+    Flag bdFlag = Flag(flagMesh.get(), bdFlagTexture.get(),bdFlagTexture.get(), 32.0f,2.0f,1.0f);
 
-    //fan
-    Cube fan = Cube(fanTexture, fanTexture, 32.0f, 0.0f, 0.0f, 2.0f, 2.0f);
-    
+    //the scene's cubes: one textured cube per textured material, each texture loaded once
+    std::vector<std::unique_ptr<Cube>> materialCubes(scene.materials.size());
+    std::unordered_map<std::string, const GlTexture*> sceneTextures = { { woodTexturePath, &woodTexture } };
+    for (size_t m = 0; m < scene.materials.size(); m++)
+    {
+        const SceneMaterial& material = scene.materials[m];
+        if (material.texture.empty())
+            continue;
+        const GlTexture*& texture = sceneTextures[material.texture];
+        if (!texture)
+            texture = &textureLoader.load(material.texture, GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+        materialCubes[m].reset(new Cube(texture->get(), texture->get(), material.shininess, 0.0f, 0.0f, 1.0f, 1.0f));
+    }
 
-    // set up vertex data (and buffer(s)) and configure vertex attributes
-    // ------------------------------------------------------------------
+    //what each of the scene's meshes is
+    const std::pair<const char*, SceneMesh> sceneMeshNames[] = {
+        { "cube", SceneMesh::Cube }, { "floorDetail", SceneMesh::FloorDetail }, { "tree", SceneMesh::Tree }, { "railing", SceneMesh::Railing },
+        { "roof", SceneMesh::Roof }, { "curtain", SceneMesh::Curtain }, { "treePot", SceneMesh::TreePot } };
+    std::vector<SceneMesh> sceneMeshes(scene.meshes.size(), SceneMesh::Unknown);
+    for (size_t i = 0; i < scene.meshes.size(); i++)
+    {
+        for (const auto& name : sceneMeshNames)
+            if (scene.meshes[i] == name.first)
+                sceneMeshes[i] = name.second;
+        if (sceneMeshes[i] == SceneMesh::Unknown)
+            std::cout << "auditorium.scene: no mesh named " << scene.meshes[i] << ", its objects are not drawn" << std::endl;
+    }
 
-    float curve_points[] = {
--0.0050, 1.7348, 4.9635,
--0.2350, 1.7201, 4.9666,
--0.4850, 1.6467, 4.9821,
--0.6100, 1.5391, 5.0049,
--0.7350, 1.3924, 5.0359,
--0.7400, 1.2945, 5.0566,
--0.7500, 1.1820, 5.0804,
--0.7300, 1.0695, 5.1042,
--0.7600, 1.0059, 5.1177,
--0.8250, 0.9326, 5.1332,
--0.9550, 0.9032, 5.1394,
--1.1000, 0.8787, 5.1446,
--1.2400, 0.9423, 5.1311,
--1.3500, 1.0157, 5.1156,
-    };
+    //object space boxes to cull against: the plain cubes span 0 to 1 and the textured
+    //ones are centred on the origin. the other meshes are always drawn
+    for (uint32_t i = 0; i < scene.getObjectCount(); i++)
+    {
+        SceneMesh mesh = sceneMeshes[scene.objectMesh[i]];
+        uint32_t material = scene.objectMaterial[i];
+        if (mesh == SceneMesh::Cube && (material == sceneNoMaterial || !materialCubes[material]))
+            scene.setObjectBounds(i, glm::vec3(0.5f), glm::vec3(0.5f));
+        else if (mesh == SceneMesh::Cube || mesh == SceneMesh::FloorDetail)
+            scene.setObjectBounds(i, glm::vec3(0.0f), glm::vec3(0.5f));
+        else if (mesh == SceneMesh::TreePot)
+            scene.setObjectBounds(i, treePot.getBoundsCenter(), glm::vec3(treePot.getBoundsRadius()));
+    }
+    SceneDrawList sceneDrawList;
 
-    //Bezier Curve
-    BezierCurve bezierCurve = BezierCurve(curve_points,16,curveTexture);
-
-    float cube_vertices[] = {
-        // positions      // normals
-        0.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f,
-        1.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f,
-        1.0f, 1.0f, 0.0f, 0.0f, 0.0f, -1.0f,
-        0.0f, 1.0f, 0.0f, 0.0f, 0.0f, -1.0f,
-
-        1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f,
-        1.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f,
-        1.0f, 0.0f, 1.0f, 1.0f, 0.0f, 0.0f,
-        1.0f, 1.0f, 1.0f, 1.0f, 0.0f, 0.0f,
-
-        0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f,
-        1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f,
-        1.0f, 1.0f, 1.0f, 0.0f, 0.0f, 1.0f,
-        0.0f, 1.0f, 1.0f, 0.0f, 0.0f, 1.0f,
-
-        0.0f, 0.0f, 1.0f, -1.0f, 0.0f, 0.0f,
-        0.0f, 1.0f, 1.0f, -1.0f, 0.0f, 0.0f,
-        0.0f, 1.0f, 0.0f, -1.0f, 0.0f, 0.0f,
-        0.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f,
-
-        1.0f, 1.0f, 1.0f, 0.0f, 1.0f, 0.0f,
-        1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f,
-        0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f,
-        0.0f, 1.0f, 1.0f, 0.0f, 1.0f, 0.0f,
-
-        0.0f, 0.0f, 0.0f, 0.0f, -1.0f, 0.0f,
-        1.0f, 0.0f, 0.0f, 0.0f, -1.0f, 0.0f,
-        1.0f, 0.0f, 1.0f, 0.0f, -1.0f, 0.0f,
-        0.0f, 0.0f, 1.0f, 0.0f, -1.0f, 0.0f
-    };
-    unsigned int cube_indices[] = {
-        0, 3, 2,
-        2, 1, 0,
+    // the fan, the door and the wave clock, stepped at a fixed rate apart from frames
+    Simulation simulation;
 
-        4, 5, 7,
-        7, 6, 4,
+    // set up vertex data (and buffer(s)) and configure vertex attributes
+    // ------------------------------------------------------------------
 
-        8, 9, 10,
-        10, 11, 8,
 
-        12, 13, 14,
-        14, 15, 12,
+    //Bezier Curve
+    BezierCurve bezierCurve = tessellatedRoof ?
+        BezierCurve(curve_points, 16, curveTexture.get(), glm::vec4(1.0, 0.0, 0.0, 1.0f), glm::vec4(1.0, 0.0, 0.0, 1.0f), glm::vec4(0.1f, 0.1f, 0.1f, 0.5f), 32.0f, 40, 20, true, true) :
+        BezierCurve(roofMesh.get(), curve_points, 16, curveTexture.get(), glm::vec4(1.0, 0.0, 0.0, 1.0f), glm::vec4(1.0, 0.0, 0.0, 1.0f), glm::vec4(0.1f, 0.1f, 0.1f, 0.5f), 32.0f, 40, 20, true);
 
-        16, 17, 18,
-        18, 19, 16,
+    // every mesh future has been collected by now
+    meshCache.save();
+    meshCache.printReport();
+    printMeshOptimizationReport();
+    printMemoryReport();
 
-        20, 21, 22,
-        22, 23, 20
-    };
+    // unit cube with a corner at the origin, generated at compile time
+    static constexpr StaticMesh<24, 36> cornerCube = makeCube(0.0, 1.0);
 
 
-    unsigned int cubeVAO, cubeVBO, cubeEBO;
-    glGenVertexArrays(1, &cubeVAO);
-    glGenBuffers(1, &cubeVBO);
-    glGenBuffers(1, &cubeEBO);
+    GlVertexArray cubeVAO = GlVertexArray::create();
+    GlBuffer cubeVBO = GlBuffer::create();
+    GlBuffer cubeEBO = GlBuffer::create();
 
-    glBindVertexArray(cubeVAO);
+    glBindVertexArray(cubeVAO.get());
 
-    glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(cube_vertices), cube_vertices, GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, cubeVBO.get());
+    glBufferData(GL_ARRAY_BUFFER, sizeof(cornerCube.vertices), cornerCube.vertices, GL_STATIC_DRAW);
+    cubeVBO.chargeMemory(MemoryCategory::Meshes, sizeof(cornerCube.vertices));
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cubeEBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(cube_indices), cube_indices, GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cubeEBO.get());
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(cornerCube.indices), cornerCube.indices, GL_STATIC_DRAW);
+    cubeEBO.chargeMemory(MemoryCategory::Meshes, sizeof(cornerCube.indices));
 
 
     // position attribute
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(0);
 
     // vertex normal attribute
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)12);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)12);
     glEnableVertexAttribArray(1);
 
     // second, configure the light's VAO (VBO stays the same; the vertices are the same for the light object which is also a 3D cube)
-    unsigned int lightCubeVAO;
-    glGenVertexArrays(1, &lightCubeVAO);
-    glBindVertexArray(lightCubeVAO);
+    GlVertexArray lightCubeVAO = GlVertexArray::create();
+    glBindVertexArray(lightCubeVAO.get());
 
-    glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cubeEBO);
+    glBindBuffer(GL_ARRAY_BUFFER, cubeVBO.get());
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cubeEBO.get());
     // note that we update the lamp's position attribute's stride to reflect the updated buffer data
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(0);
 
     /*Cone cone = Cone();*/
@@ -453,9 +516,33 @@ int main()
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
 
+        // textures whose images finished decoding since the last frame, and mip
+        // levels the last feedback pass found missing
+        if (textureFeedback.collect(textureFootprints))
+        {
+            textureLoader.applyFeedback(textureFootprints);
+            floorDetail.applyFeedback(textureFeedback.getPageRequests());
+        }
+        floorDetail.update();
+        if (textureLoader.update() > 0 && textureLoader.idle())
+        {
+            textureLoader.printReport();
+            floorDetail.printReport();
+            printMemoryReport();
+        }
+
         // input
         // -----
         processInput(window);
+        editRoofProfile(window, bezierCurve);
+
+        // simulation
+        // ----------
+        SimulationInput simulationInput;
+        simulationInput.fanOn = fanOn;
+        simulationInput.doorOpen = doorOpen;
+        simulation.advance(deltaTime, simulationInput);
+        SimulationState animated = simulation.getRenderState();
 
         // render
         // ------
@@ -479,18 +566,15 @@ int main()
         //glm::mat4 view = basic_camera.createViewMatrix();
         lightingShaderWithTexture.setMat4("view", view);
 
+        virtualTextureShader.use();
+        virtualTextureShader.setVec3("viewPos", camera.Position);
+        virtualTextureShader.setMat4("projection", projection_texture);
+        virtualTextureShader.setMat4("view", view);
 
 
-        // point light 1
-        pointlight1.setUpPointLight(lightingShader);
-        // point light 2
-        pointlight2.setUpPointLight(lightingShader);
-        // point light 3
-        pointlight3.setUpPointLight(lightingShader);
-        // point light 4
-        pointlight4.setUpPointLight(lightingShader);
 
-        pointlight5.setUpPointLight(lightingShader);
+        for (PointLight& pointLight : pointLights)
+            pointLight.setUpPointLight(lightingShader);
 
         // activate shader
         lightingShader.use();
@@ -538,6 +622,11 @@ int main()
 
         glm::mat4 projection = myProjection(left, right, bottom, top, near, far);
 
+        int viewportWidth, viewportHeight;
+        glfwGetFramebufferSize(window, &viewportWidth, &viewportHeight);
+        lodSelector.update(projection, (float)viewportHeight);
+        textureFeedback.beginFrame(viewportWidth, viewportHeight);
+
         lightingShader.setMat4("projection", projection);
 
         // camera/view transformation
@@ -556,219 +645,87 @@ int main()
         lightingShader.setMat4("model", model);
 
         lightingShaderWithTexture.use();
-        pointlight1.setUpPointLight(lightingShaderWithTexture);
-        pointlight2.setUpPointLight(lightingShaderWithTexture);
-        pointlight3.setUpPointLight(lightingShaderWithTexture);
-        pointlight4.setUpPointLight(lightingShaderWithTexture);
-        pointlight5.setUpPointLight(lightingShaderWithTexture);
+        for (PointLight& pointLight : pointLights)
+        {
+            pointLight.setUpPointLight(lightingShaderWithTexture);
+            pointLight.setUpPointLight(virtualTextureShader);
+        }
 
         glm::mat4 modelMatrixForContainer = glm::mat4(1.0f);
         //modelMatrixForContainer = glm::translate(modelMatrixForContainer, glm::vec3(4.87f, 2.5f, 0.1f)) * glm::scale(identityMatrix, glm::vec3(0.0f,1.0f,1.5f));
         /*modelMatrixForContainer = glm::translate(modelMatrixForContainer, glm::vec3(2.0f, 2.5f, 0.1f));
         cube.drawCubeWithTexture(lightingShaderWithTexture, modelMatrixForContainer);*/
 
-        
-        //1st floor
-        glm::mat4 modelMatrixForFloorContainer = glm::mat4(1.0f);
-        modelMatrixForFloorContainer = ((glm::scale(identityMatrix, glm::vec3(30.0f, 0.2f, 30.0f))) *
-            (glm::translate(identityMatrix, glm::vec3(-0.23f, -4.5f, 0.0f))));
-        floorCube.drawCubeWithTexture(lightingShaderWithTexture, modelMatrixForFloorContainer);
-
-        //2nd floor
-        glm::mat4 translate2ndfloor = glm::mat4(1.0f);
-        //glm::mat4 translate2 = glm::mat4(1.0f);
-        glm::mat4 scale2ndfloor = glm::mat4(1.0f);
-
-        glm::mat4 modelMatrixFor2ndFloorContainer = glm::mat4(1.0f);
-
-        translate2ndfloor = glm::scale(identityMatrix, glm::vec3(-8.7f, 0.2f, 25.0f));
-        scale2ndfloor = glm::translate(identityMatrix, glm::vec3(2.0f, 15.0f, -0.1f)) ;
-
-        modelMatrixFor2ndFloorContainer = translate2ndfloor * scale2ndfloor;
-        floorCube.drawCubeWithTexture(lightingShaderWithTexture, modelMatrixFor2ndFloorContainer);
-
-        //draw Tree using fractal
-        translateMatrix = glm::translate(identityMatrix, glm::vec3(-23.0f,0.0f,4.0f));
-        scaleMatrix = glm::scale(identityMatrix, glm::vec3(2.0f, 2.0f, 2.0f));
-        glm::mat4 rotateTree = glm::rotate(identityMatrix, glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        glm::mat4 modelMatrixForTree = translateMatrix * scaleMatrix * rotateTree;
-        tree.drawTree(lightingShader, modelMatrixForTree);
-
-        //drawing railing on the second floor
-        translateMatrix = glm::translate(identityMatrix, glm::vec3(-13.5f, 3.0f, -14.9f));
-        scaleMatrix = glm::scale(identityMatrix, glm::vec3(2.0f, 2.0f, 2.0f));
-        //rotateMatrix = glm::rotate()
-        glm::mat4 modelMatrixForRailing = translateMatrix * scaleMatrix;
-        railing.drawRailing(lightingShader, modelMatrixForRailing);
-
-
-        //roof
-        translateMatrix = glm::translate(identityMatrix, glm::vec3(-7.0f, 2.1f, 0.0f));
-        scaleMatrix = glm::scale(identityMatrix, glm::vec3(30.0f, 5.0f, 30.0f));
-        glm::mat4 modelMatrixForRoof = translateMatrix * scaleMatrix;
-        bezierCurve.drawBezierCurve(lightingShaderWithTexture, modelMatrixForRoof);
-
-        
-
-        //curvyObject
-        /*translateMatrix = glm::translate(identityMatrix, glm::vec3(1.0f, 2.0f, 0.0f));
-        scaleMatrix = glm::scale(identityMatrix, glm::vec3(10.0f, 2.0f, 4.0f));
-        glm::mat4 modelMatrixForCurvyObj = translateMatrix * scaleMatrix;
-        curvyCube.draw(lightingShaderWithTexture, modelMatrixForCurvyObj);*/
-
-        //CurtainHolder left
-        translateMatrix = glm::translate(identityMatrix, glm::vec3(4.5f, 1.4f, -3.7f));
-        scaleMatrix = glm::scale(identityMatrix, glm::vec3(1.0f, 7.0f, 0.5f));
-        glm::mat4 modelMatrixForCurtainHolder = translateMatrix * scaleMatrix;
-        curtainHolderCube.drawCubeWithTexture(lightingShaderWithTexture, modelMatrixForCurtainHolder);
-
-        //CurtainHolder up
-        translateMatrix = glm::translate(identityMatrix, glm::vec3(2.8f, 5.0f,0.0f));
-        scaleMatrix = glm::scale(identityMatrix, glm::vec3(4.0f, 0.5f, 8.0f));
-        modelMatrixForCurtainHolder = translateMatrix * scaleMatrix;
-        curtainHolderCube.drawCubeWithTexture(lightingShaderWithTexture, modelMatrixForCurtainHolder);
-
-        //CurtainHolder Right
-        translateMatrix = glm::translate(identityMatrix, glm::vec3(4.5f, 1.4f, 3.7f));
-        scaleMatrix = glm::scale(identityMatrix, glm::vec3(1.0f, 7.0f, 0.5f));
-        modelMatrixForCurtainHolder = translateMatrix * scaleMatrix;
-        curtainHolderCube.drawCubeWithTexture(lightingShaderWithTexture, modelMatrixForCurtainHolder);
-
-
-        //Curtain
-        translateMatrix = glm::translate(identityMatrix, glm::vec3(4.5f, 2.4f, -3.0f));
-        scaleMatrix = glm::scale(identityMatrix, glm::vec3(1.0f, 2.5f, 1.0f));
-        glm::mat4 modelMatrixForCurtain = translateMatrix * scaleMatrix;
-        curtain.draw(lightingShaderWithTexture, modelMatrixForCurtain);
 
-        //curtain right
+        //plaza forest
+        forest.draw(forestShader, forestImpostorShader, view, projection, camera.Position, (float)animated.time);
 
-        //steel bar for light
-        translateMatrix = glm::translate(identityMatrix, glm::vec3(-10.0f, 7.0f, 0.0f));
-        scaleMatrix = glm::scale(identityMatrix, glm::vec3(1.0f, 0.2f, 4.0f));
-        glm::mat4 modelMatrixForSteel = translateMatrix * scaleMatrix;
-        steel.drawCubeWithTexture(lightingShaderWithTexture, modelMatrixForSteel);
-
-
-        //power cable for steel 1
-        glm::mat4 scale = glm::scale(identityMatrix, glm::vec3(0.1, 3.5, 0.1));
-        glm::mat4 translate = glm::translate(identityMatrix, glm::vec3(-10.0f, 7.0f, 0.0f));
-        glm::mat4 modelForCable = translate * scale;
-        drawCube(cubeVAO, lightingShader, modelForCable, 0.0f, 0.0f, 0.0f, 32.0f);
-
-        
-        
-        //door
-        glm::mat4 modelForDoor = glm::mat4(1.0f);
-        if (!doorOpen) {
-            scale = glm::scale(identityMatrix, glm::vec3(0.2, 4.0, 3.0));
-            translate = glm::translate(identityMatrix, glm::vec3(-21.8f, 1.0f, 0.0f));
-            modelForDoor = translate * scale;
-        }
-        else {
-            scale = glm::scale(identityMatrix, glm::vec3(0.2, 4.0, 3.0));
-            glm::mat4 translate = glm::translate(identityMatrix, glm::vec3(-20.4f, 1.0f, -1.5f));  // Move to hinge point
-            glm::mat4 rotation = glm::rotate(identityMatrix, glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-            modelForDoor = translate * rotation * scale;
+        //the hall, as auditorium.scene places it; only what the door and the fan carry is moved again
+        scene.setChannel("door", animated.doorAngle);
+        scene.setChannel("fan", animated.fanAngle);
+        scene.animate();
+        updateSceneBounds(scene);
+        submitScene(scene, projection * view, sceneDrawList);
+        for (uint32_t i : sceneDrawList.objects)
+        {
+            const glm::mat4& world = scene.getObjectWorld(i);
+            uint32_t material = scene.objectMaterial[i];
+            switch (sceneMeshes[scene.objectMesh[i]])
+            {
+            case SceneMesh::Cube:
+                if (material == sceneNoMaterial)
+                    drawCube(cubeVAO, lightingShader, world, 1.0f, 1.0f, 1.0f, 32.0f);
+                else if (materialCubes[material])
+                    materialCubes[material]->drawCubeWithTexture(lightingShaderWithTexture, world);
+                else
+                {
+                    const glm::vec3& colour = scene.materials[material].colour;
+                    drawCube(cubeVAO, lightingShader, world, colour.x, colour.y, colour.z, scene.materials[material].shininess);
+                }
+                break;
+            case SceneMesh::FloorDetail:
+                floorDetail.bind(virtualTextureShader);
+                floorDetailCube.drawCubeWithTexture(virtualTextureShader, world);
+                break;
+            case SceneMesh::Tree:
+                tree.drawTree(lightingShader, world);
+                break;
+            case SceneMesh::Railing:
+                railing.drawRailing(lightingShader, world);
+                break;
+            case SceneMesh::Roof:
+                if (bezierCurve.isGpuTessellated())
+                {
+                    roofTessellationShader.use();
+                    roofTessellationShader.setVec3("viewPos", camera.Position);
+                    roofTessellationShader.setMat4("projection", projection_texture);
+                    roofTessellationShader.setMat4("view", view);
+                    for (PointLight& pointLight : pointLights)
+                        pointLight.setUpPointLight(roofTessellationShader);
+                    bezierCurve.drawBezierCurveTessellated(roofTessellationShader, world, (float)viewportWidth, (float)viewportHeight);
+                }
+                else
+                    bezierCurve.drawBezierCurve(lightingShaderWithTexture, world, view, projection_texture, camera.Position);
+                break;
+            case SceneMesh::Curtain:
+                curtain.draw(lightingShaderWithTexture, world);
+                break;
+            case SceneMesh::TreePot:
+                treePot.drawCylinderWithTexture(lightingShaderWithTexture, world, treePot.selectLevel(lodSelector, world, camera.Position));
+                break;
+            default:
+                break;
+            }
         }
-        door.drawCubeWithTexture(lightingShaderWithTexture, modelForDoor);
-
-
-        //floor extended ahead of the door
-
-        scale = glm::scale(identityMatrix, glm::vec3(-5.0, 0.2, 10.0));
-        translate = glm::translate(identityMatrix, glm::vec3(-22.0,-1.0, -5.0));
-        model = translate * scale;
-        drawCube(cubeVAO, lightingShader, model, 1.0, 1.0, 1.0, 32.0);
-
-        //TreePot
-        translateMatrix = glm::translate(identityMatrix, glm::vec3(-23.0f, 0.0f, 4.0f));
-        scaleMatrix = glm::scale(identityMatrix, glm::vec3(1.0f, 1.5f, 2.0f));
-        glm::mat4 modelMatrixForTeaPot = translateMatrix * scaleMatrix;
-        treePot.drawCylinderWithTexture(lightingShaderWithTexture, modelMatrixForTeaPot);
 
         //BdFlag
         /*translateMatrix = glm::translate(identityMatrix, glm::vec3(0.0f, 2.0f, 0.0f));
         scaleMatrix = glm::scale(identityMatrix, glm::vec3(1.0f, 1.0f, 1.0f));
         glm::mat4 modelMatrixForFlag = translateMatrix * scaleMatrix;
-        bdFlag.drawFlag(lightingShaderWithTexture, modelMatrixForFlag,currentFrame);*/
-
-
-        //FAN
-        if (fanOn)
-        {
-
-            translateMatrix = glm::translate(identityMatrix, glm::vec3(0.5f, 1.5f, 0.125f));
-            glm::mat4 translateMatrix2 = glm::translate(identityMatrix, glm::vec3(-0.2f, 0.5f, -0.125f));
-
-            // Move fan to the world center (0, 0, 0)
-            glm::mat4 translateMatrix3 = glm::translate(identityMatrix, glm::vec3(-6.0f, 4.0f, 0.0f));
-
-            // Scale matrix for the fan blades
-            glm::mat4 scaleMatrix = glm::scale(identityMatrix, glm::vec3(3.0f, 0.1f, 0.5f));
-
-            // First blade transformation
-            glm::mat4 model = translateMatrix3 * translateMatrix * glm::rotate(identityMatrix, glm::radians(r), glm::vec3(0.0f, 1.0f, 0.0f)) * translateMatrix2 * scaleMatrix;
+        bdFlag.drawFlag(lightingShaderWithTexture, modelMatrixForFlag, (float)animated.time);*/
 
-            fan.drawCubeWithTexture(lightingShaderWithTexture, model);
-            //drawCube(cubeVAO, lightingShader, model, 0.0196, 0.0157f, 0.4f, 32.0f);
 
-            // Second blade transformation (90 degrees offset)
-            model = translateMatrix3 * translateMatrix * glm::rotate(identityMatrix, glm::radians(r + 90.0f), glm::vec3(0.0f, 1.0f, 0.0f)) * translateMatrix2 * scaleMatrix;
-
-            fan.drawCubeWithTexture(lightingShaderWithTexture, model);
-            //drawCube(cubeVAO, lightingShader, model, 0.0196, 0.0157f, 0.4f, 32.0f);
-
-            // Fan stand (centered)
-            scaleMatrix = glm::scale(identityMatrix, glm::vec3(0.1f, 4.8f, 0.1f));
-            translateMatrix3 = glm::translate(identityMatrix, glm::vec3(-5.7f, 6.0f, 0.0f));
-
-            model = translateMatrix3 * scaleMatrix;
-            
-
-            drawCube(cubeVAO, lightingShader, model, 0.0f, 0.0f, 0.0f, 32.0f);
-
-            // Update rotation angle
-            r = (r + 5.0f);
-
-
-        }
-        else
-        {
-            glm::mat4 translateMatrix = glm::translate(identityMatrix, glm::vec3(0.5f, 1.5f, 0.125f));
-            glm::mat4 translateMatrix2 = glm::translate(identityMatrix, glm::vec3(-0.2f, 0.5f, -0.125f));
-
-            // Move fan to the world center (0, 0, 0)
-            glm::mat4 translateMatrix3 = glm::translate(identityMatrix, glm::vec3(-6.0f, 4.0f, 0.0f));
-
-            // Scale matrix for the fan blades
-            glm::mat4 scaleMatrix = glm::scale(identityMatrix, glm::vec3(3.0f, 0.1f, 0.5f));
-
-            // First blade transformation
-            glm::mat4 model = translateMatrix3 * translateMatrix * glm::rotate(identityMatrix, glm::radians(r), glm::vec3(0.0f, 1.0f, 0.0f)) * translateMatrix2 * scaleMatrix;
-
-            fan.drawCubeWithTexture(lightingShaderWithTexture, model);
-            //drawCube(cubeVAO, lightingShader, model, 0.0196, 0.0157f, 0.4f, 32.0f);
-
-            // Second blade transformation (90 degrees offset)
-            model = translateMatrix3 * translateMatrix * glm::rotate(identityMatrix, glm::radians(r + 90.0f), glm::vec3(0.0f, 1.0f, 0.0f)) * translateMatrix2 * scaleMatrix;
-
-            //drawCube(cubeVAO, lightingShader, model, 0.0196, 0.0157f, 0.4f, 32.0f);
-            fan.drawCubeWithTexture(lightingShaderWithTexture, model);
-
-            // Fan stand (centered)
-            scaleMatrix = glm::scale(identityMatrix, glm::vec3(0.1f, 4.8f, 0.1f));
-            translateMatrix3 = glm::translate(identityMatrix, glm::vec3(-5.7f, 6.0f, 0.0f));
-
-            model = translateMatrix3 * scaleMatrix;
- 
-
-            drawCube(cubeVAO, lightingShader, model, 0.0f, 0.0f, 0.0f, 32.0f);
-        }
-
-
-
-        //spheretex.drawSphere(lightingShaderWithTexture, laughEmoji, modelMatrixForContainer);
+        //spheretex.drawSphere(lightingShaderWithTexture, laughEmoji.get(), modelMatrixForContainer);
 
         //glBindVertexArray(cubeVAO);
         //glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
@@ -778,10 +735,6 @@ int main()
         //draw floor
         //floor(cubeVAO, lightingShader);
         //axis(cubeVAO, lightingShader);
-        frontWall(cubeVAO, lightingShader);
-        chairs(cubeVAO, lightingShader);
-        walls(cubeVAO, lightingShader);
-        stairs(cubeVAO, lightingShader);
 
 
         //second floor
@@ -796,11 +749,11 @@ int main()
         ourShader.setMat4("view", view);
 
         // we now draw as many light bulbs as we have point lights.
-        glBindVertexArray(lightCubeVAO);
-        for (unsigned int i = 0; i < 5; i++)
+        glBindVertexArray(lightCubeVAO.get());
+        for (const PointLight& pointLight : pointLights)
         {
             model = glm::mat4(1.0f);
-            model = glm::translate(model, pointLightPositions[i]);
+            model = glm::translate(model, pointLight.position);
             model = glm::scale(model, glm::vec3(0.2f)); // Make it a smaller cube
             ourShader.setMat4("model", model);
             ourShader.setVec3("color", glm::vec3(0.8f, 0.8f, 0.8f));
@@ -833,26 +786,21 @@ int main()
         //torus.drawTorus(lightingShader, model);
 
 
+        // replays this frame's textured draws for the streaming, every few frames
+        textureFeedback.render(view, projection_texture);
+
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
         // -------------------------------------------------------------------------------
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
 
-    // optional: de-allocate all resources once they've outlived their purpose:
-    // ------------------------------------------------------------------------
-    glDeleteVertexArrays(1, &cubeVAO);
-    glDeleteVertexArrays(1, &lightCubeVAO);
-    glDeleteBuffers(1, &cubeVBO);
-    glDeleteBuffers(1, &cubeEBO);
-
-    // glfw: terminate, clearing all previously allocated GLFW resources.
-    // ------------------------------------------------------------------
-    glfwTerminate();
+    // every mesh, texture and buffer is released by its handle on the way out of
+    // main, and glfwSession then terminates GLFW
     return 0;
 }
 
-void drawCube(unsigned int& cubeVAO, Shader& lightingShader, glm::mat4 model = glm::mat4(1.0f), float r = 1.0f, float g = 1.0f, float b = 1.0f, float shininess = 32.0f)
+void drawCube(const GlVertexArray& cubeVAO, Shader& lightingShader, glm::mat4 model = glm::mat4(1.0f), float r = 1.0f, float g = 1.0f, float b = 1.0f, float shininess = 32.0f)
 {
     lightingShader.use();
 
@@ -863,11 +811,11 @@ void drawCube(unsigned int& cubeVAO, Shader& lightingShader, glm::mat4 model = g
 
     lightingShader.setMat4("model", model);
 
-    glBindVertexArray(cubeVAO);
+    glBindVertexArray(cubeVAO.get());
     glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
 }
 
-void floor(unsigned int& cubeVAO, Shader& lightingShader)
+void floor(const GlVertexArray& cubeVAO, Shader& lightingShader)
 {
     //second floor
     lightingShader.use();
@@ -896,217 +844,10 @@ void floor(unsigned int& cubeVAO, Shader& lightingShader)
 
 
 }
-void chairs(unsigned int& cubeVAO, Shader& lightingShader) {
-    lightingShader.use();
-    //base
-    glm::mat4 identityMatrix = glm::mat4(1.0f);
-    glm::mat4 translate = glm::mat4(1.0f);
-    glm::mat4 scale = glm::mat4(1.0f);
-    glm::mat4 rotation = glm::mat4(1.0f);
-    glm::mat4 model = translate * scale;
-
-    float chairdistanceX = 1.5f;
-    float chairdistanceY = 2.5f;
-
-    //left columns
-    for (int i = 0; i < 5; i++) {
-        for (int j = 0; j < 5; j++) {
-            scale = glm::scale(identityMatrix, glm::vec3(0.8, 0.5, 1.0));
-            translate = glm::translate(identityMatrix, glm::vec3(-2.5 - (chairdistanceY * i), -0.8, -14.0 + (chairdistanceX * j)));
-            model = translate * scale;
-            drawCube(cubeVAO, lightingShader, model, 0.0f, 0.0f, 1.0f, 32.0f); // Blue seat
-
-            //Back Rest
-            scale = glm::scale(identityMatrix, glm::vec3(0.3, 1.0, 1.0));
-            translate = glm::translate(identityMatrix, glm::vec3(-2.5 - (chairdistanceY * i), -0.8, -14.0 + (chairdistanceX * j)));
-            model = translate * scale;
-            drawCube(cubeVAO, lightingShader, model, 0.0f, 0.0f, 1.0f, 32.0f);
-        }
-
-    }
-
-
-    //mid columns
-    for (int i = 0; i < 5; i++) {
-        for (int j = 0; j < 5; j++) {
-            scale = glm::scale(identityMatrix, glm::vec3(0.8, 0.5, 1.0));
-            translate = glm::translate(identityMatrix, glm::vec3(-2.5 - (chairdistanceY * i), -0.8, -4.0 + (chairdistanceX * j)));
-            model = translate * scale;
-            drawCube(cubeVAO, lightingShader, model, 0.0f, 0.0f, 1.0f, 32.0f); // Blue seat
-
-            //Back Rest
-            scale = glm::scale(identityMatrix, glm::vec3(0.3, 1.0, 1.0));
-            translate = glm::translate(identityMatrix, glm::vec3(-2.5 - (chairdistanceY * i), -0.8, -4.0 + (chairdistanceX * j)));
-            model = translate * scale;
-            drawCube(cubeVAO, lightingShader, model, 0.0f, 0.0f, 1.0f, 32.0f);
-        }
-        
-    }
-
-    //right columns
-    for (int i = 0; i < 5; i++) {
-        for (int j = 0; j < 5; j++) {
-            scale = glm::scale(identityMatrix, glm::vec3(0.8, 0.5, 1.0));
-            translate = glm::translate(identityMatrix, glm::vec3(-2.5 - (chairdistanceY * i), -0.8, 6.0 + (chairdistanceX * j)));
-            model = translate * scale;
-            drawCube(cubeVAO, lightingShader, model, 0.0f, 0.0f, 1.0f, 32.0f); // Blue seat
-
-            //Back Rest
-            scale = glm::scale(identityMatrix, glm::vec3(0.3, 1.0, 1.0));
-            translate = glm::translate(identityMatrix, glm::vec3(-2.5 - (chairdistanceY * i), -0.8, 6.0 + (chairdistanceX * j)));
-            model = translate * scale;
-            drawCube(cubeVAO, lightingShader, model, 0.0f, 0.0f, 1.0f, 32.0f);
-        }
-
-    }
-
-    //chairs at the second floor
-    //left column
-    for (int i = 0; i < 3; i++) {
-        for (int j = 0; j < 3; j++) {
-            scale = glm::scale(identityMatrix, glm::vec3(0.8, 0.5, 1.0));
-            translate = glm::translate(identityMatrix, glm::vec3(-15 - (chairdistanceY * i), 3.0, -14.0 + (chairdistanceX * j)));
-            model = translate * scale;
-            drawCube(cubeVAO, lightingShader, model, 0.0f, 0.0f, 1.0f, 32.0f); // Blue seat
-
-            //Back Rest
-            scale = glm::scale(identityMatrix, glm::vec3(0.3, 1.0, 1.0));
-            translate = glm::translate(identityMatrix, glm::vec3(-15 - (chairdistanceY * i), 3.0, -14.0 + (chairdistanceX * j)));
-            model = translate * scale;
-            drawCube(cubeVAO, lightingShader, model, 0.0f, 0.0f, 1.0f, 32.0f);
-        }
-
-    }
-
-    //mid column
-    for (int i = 0; i < 3; i++) {
-        for (int j = 0; j < 6; j++) {
-            scale = glm::scale(identityMatrix, glm::vec3(0.8, 0.5, 1.0));
-            translate = glm::translate(identityMatrix, glm::vec3(-15 - (chairdistanceY * i), 3.0, -7.0 + (chairdistanceX * j)));
-            model = translate * scale;
-            drawCube(cubeVAO, lightingShader, model, 0.0f, 0.0f, 1.0f, 32.0f); // Blue seat
-
-            //Back Rest
-            scale = glm::scale(identityMatrix, glm::vec3(0.3, 1.0, 1.0));
-            translate = glm::translate(identityMatrix, glm::vec3(-15 - (chairdistanceY * i), 3.0, -7.0 + (chairdistanceX * j)));
-            model = translate * scale;
-            drawCube(cubeVAO, lightingShader, model, 0.0f, 0.0f, 1.0f, 32.0f);
-        }
-
-    }
-
-    //right column
-    for (int i = 0; i < 3; i++) {
-        for (int j = 0; j < 3; j++) {
-            scale = glm::scale(identityMatrix, glm::vec3(0.8, 0.5, 1.0));
-            translate = glm::translate(identityMatrix, glm::vec3(-15 - (chairdistanceY * i), 3.0, 4.0 + (chairdistanceX * j)));
-            model = translate * scale;
-            drawCube(cubeVAO, lightingShader, model, 0.0f, 0.0f, 1.0f, 32.0f); // Blue seat
-
-            //Back Rest
-            scale = glm::scale(identityMatrix, glm::vec3(0.3, 1.0, 1.0));
-            translate = glm::translate(identityMatrix, glm::vec3(-15 - (chairdistanceY * i), 3.0, 4.0 + (chairdistanceX * j)));
-            model = translate * scale;
-            drawCube(cubeVAO, lightingShader, model, 0.0f, 0.0f, 1.0f, 32.0f);
-        }
-
-    }
-     
-    
-    //scale = glm::scale(identityMatrix, glm::vec3( 0.8, 0.5, 1.0));
-    //translate = glm::translate(identityMatrix, glm::vec3(-2.5, -0.8, -4.5));
-    //model = translate * scale;
-    //drawCube(cubeVAO, lightingShader, model, 0.0f, 0.0f, 1.0f, 32.0f); // Blue seat
-    //
-    ////Back Rest
-    //scale = glm::scale(identityMatrix, glm::vec3(0.3, 1.0, 1.0));
-    //translate = glm::translate(identityMatrix, glm::vec3(-2.5, -0.8, -4.5));
-    //model = translate * scale;
-    //drawCube(cubeVAO, lightingShader, model, 0.0f, 0.0f, 1.0f, 32.0f);
-
-
-
-
-
-
-
-
-
-}
-
-
-void frontWall(unsigned int& cubeVAO, Shader& lightingShader)
-{
-    lightingShader.use();
-    //base
-    glm::mat4 identityMatrix = glm::mat4(1.0f);
-    glm::mat4 translate = glm::mat4(1.0f);
-    glm::mat4 scale = glm::mat4(1.0f);
-    glm::mat4 rotation = glm::mat4(1.0f);
-    glm::mat4 model = translate * scale;
 
-    //wall
-    scale = glm::scale(identityMatrix, glm::vec3(0.1, 10.0, 30.0));
-    translate = glm::translate(identityMatrix, glm::vec3(4.9, -0.8, -15.0));
-    model = translate * scale;
-    drawCube(cubeVAO, lightingShader, model, 0.5, 0.5, 0.5, 32.0);
 
-    //podium
-    scale = glm::scale(identityMatrix, glm::vec3(-1.0, 1.8, 1.0));
-    translate = glm::translate(identityMatrix, glm::vec3(3.0, 0.0, -3.0));
-    model = translate * scale;
-    drawCube(cubeVAO, lightingShader, model, 0.431, 0.149, 0.055, 1.0);
-
-    //stage code upper
-
-    scale = glm::scale(identityMatrix, glm::vec3(-4.0, 0.1, 8.0));
-    translate = glm::translate(identityMatrix, glm::vec3(5.0, -0.1, -4.0));
-    model = translate * scale;
-    drawCube(cubeVAO, lightingShader, model, 0.624, 0.396, 0.188, 1.0);
 
-    //stage code lower
-    scale = glm::scale(identityMatrix, glm::vec3(-4.0, 0.7, 8.0));
-    translate = glm::translate(identityMatrix, glm::vec3(5.0, -0.8, -4.0));
-    model = translate * scale;
-    drawCube(cubeVAO, lightingShader, model, 0.431, 0.149, 0.055, 1.0);
-
-
-    //stage stairs
-    scale = glm::scale(identityMatrix, glm::vec3(-0.6, 0.6, 0.5));
-    translate = glm::translate(identityMatrix, glm::vec3(1.7, -0.8, -4.5));
-    model = translate * scale;
-    drawCube(cubeVAO, lightingShader, model, 0.431, 0.149, 0.055, 32.0);
-
-    //stage stairs
-    scale = glm::scale(identityMatrix, glm::vec3(-0.6, 0.3, 0.5));
-    translate = glm::translate(identityMatrix, glm::vec3(1.7, -0.8, -4.9));
-    model = translate * scale;
-    drawCube(cubeVAO, lightingShader, model, 0.431, 0.149, 0.055, 32.0);
-
-
-    /*scale = glm::scale(identityMatrix, glm::vec3(-1.0, 0.8, 10.0));
-    translate = glm::translate(identityMatrix, glm::vec3(1.0, -0.8, -5.0));
-    model = translate * scale;
-    drawCube(cubeVAO, lightingShader, model, 0.112, 0.167, 0.231, 32.0);*/
-
-    /*scale = glm::scale(identityMatrix, glm::vec3(-1.0, 0.4, 10.0));
-    translate = glm::translate(identityMatrix, glm::vec3(0.0, -0.8, -5.0));
-    model = translate * scale;
-    drawCube(cubeVAO, lightingShader, model, 0.112, 0.167, 0.231, 32.0);*/
-
-    ////lamp holder
-    //scale = glm::scale(identityMatrix, glm::vec3(0.6, 0.05, 0.05));
-    //translate = glm::translate(identityMatrix, glm::vec3(4.4f, 2.9f, 1.475f));
-    //model = translate * scale;
-    //drawCube(cubeVAO, lightingShader, model, 0.0, 0.0, 0.0, 32.0);
-
-    //translate = glm::translate(identityMatrix, glm::vec3(4.4f, 2.9f, -1.525f));
-    //model = translate * scale;
-    //drawCube(cubeVAO, lightingShader, model, 0.0, 0.0, 0.0, 32.0);
-
-}
-
-void rightWall(unsigned int& cubeVAO, Shader& lightingShader)
+void rightWall(const GlVertexArray& cubeVAO, Shader& lightingShader)
 {
     lightingShader.use();
     //base
@@ -1128,108 +869,8 @@ void rightWall(unsigned int& cubeVAO, Shader& lightingShader)
 
 
 }
-void walls(unsigned int& cubeVAO, Shader& lightingShader) {
-    lightingShader.use();
-    //base
-    glm::mat4 identityMatrix = glm::mat4(1.0f);
-    glm::mat4 translate = glm::mat4(1.0f);
-    glm::mat4 scale = glm::mat4(1.0f);
-    glm::mat4 rotation = glm::mat4(1.0f);
-    glm::mat4 model = translate * scale;
-
-    //left wall
-    scale = glm::scale(identityMatrix, glm::vec3(-26.8, 10.0, 0.1));
-    translate = glm::translate(identityMatrix, glm::vec3(4.9, -0.8, -15.0));
-    model = translate * scale;
-    drawCube(cubeVAO, lightingShader, model, 0.5, 0.5, 0.5, 32.0);
-
-    //right wall
-    scale = glm::scale(identityMatrix, glm::vec3(-26.8, 10.0, 0.1));
-    translate = glm::translate(identityMatrix, glm::vec3(4.9, -0.8, 15.0));
-    model = translate * scale;
-    drawCube(cubeVAO, lightingShader, model, 0.5, 0.5, 0.5, 32.0);
-
-    //back wall left
-    scale = glm::scale(identityMatrix, glm::vec3(0.1, 10.0, 10.0));
-    translate = glm::translate(identityMatrix, glm::vec3(-22, -0.8, -15.0));
-    model = translate * scale ;
-    drawCube(cubeVAO, lightingShader, model, 1.0, 1.0, 1.0, 32.0);
-
-    //back wall right
-    scale = glm::scale(identityMatrix, glm::vec3(0.1, 10.0, -10.0));
-    translate = glm::translate(identityMatrix, glm::vec3(-22, -0.8, 15.0));
-    model = translate * scale;
-    drawCube(cubeVAO, lightingShader, model, 1.0, 1.0, 1.0, 32.0);
-
-    //back wall up
-    scale = glm::scale(identityMatrix, glm::vec3(0.1, -6.3, -10.0));
-    translate = glm::translate(identityMatrix, glm::vec3(-22.0, 9.2, 5.0));
-    model = translate * scale;
-    drawCube(cubeVAO, lightingShader, model, 0.5, 0.5, 0.5, 32.0);
-
-    //left down
-    scale = glm::scale(identityMatrix, glm::vec3(0.1, 5.0, -3.5));
-    translate = glm::translate(identityMatrix, glm::vec3(-22.0,-0.8, -1.5));
-    model = translate * scale;
-    drawCube(cubeVAO, lightingShader, model, 0.5, 0.5, 0.5, 32.0);
-
-    //right down
-    scale = glm::scale(identityMatrix, glm::vec3(0.1, 5.0, 3.5));
-    translate = glm::translate(identityMatrix, glm::vec3(-22.0, -0.8, 1.5));
-    model = translate * scale;
-    drawCube(cubeVAO, lightingShader, model, 0.5, 0.5, 0.5, 32.0);
-
-
-
-}
-void stairs(unsigned int& cubeVAO, Shader& lightingShader) {
-    lightingShader.use();
-
-    float stepWidth = 1.0f;
-    float stepHeight = 0.5f;
-    float stepDepth = 1.0f;
-    int numSteps = 4;
 
-    glm::mat4 identityMatrix = glm::mat4(1.0f);
-    glm::mat4 translate = glm::mat4(1.0f);
-    glm::mat4 scale = glm::mat4(1.0f);
-    glm::mat4 rotation = glm::mat4(1.0f);
-    glm::mat4 model = translate * scale;
-
-    for (int i = 0; i < numSteps; i++) {
-
-        scale = glm::scale(identityMatrix, glm::vec3(-2.0, 0.5 + (stepHeight * i), -1.0));
-        translate = glm::translate(identityMatrix, glm::vec3(-18.0 , -0.9, 12.0 +(stepWidth * i)));
-        model = translate * scale;
-        drawCube(cubeVAO, lightingShader, model, 0.5, 0.5, 0.5, 32.0);
-    }
-
-    for (int i = 0; i < numSteps+1; i++) {
-
-        scale = glm::scale(identityMatrix, glm::vec3(-2.0, 0.5 , -1.0));
-        translate = glm::translate(identityMatrix, glm::vec3(-16.0, 0.6 + (stepHeight * i), 15.0 - (stepWidth * i)));
-        model = translate * scale;
-        drawCube(cubeVAO, lightingShader, model, 0.5, 0.5, 0.5, 32.0);
-    }
-    
-
-    //for (int i = 0; i < numSteps; i++) {
-    //    // Calculate position of the step
-    //    float x = 0.0f;
-    //    float y = i * stepHeight;
-    //    float z = -i * stepDepth;
-
-    //    // Transformation matrix for the step
-    //    glm::mat4 step = glm::mat4(1.0f);
-    //    step = glm::translate(step, glm::vec3(x, y, z));
-    //    step = glm::scale(step, glm::vec3(stepWidth, stepHeight, stepDepth));
-
-    //    // Draw the step
-    //    drawCube(cubeVAO, lightingShader, step, 0.7f, 0.5f, 0.3f); // Brownish color
-    //}
-}
-
-void axis(unsigned int& cubeVAO, Shader& lightingShader)
+void axis(const GlVertexArray& cubeVAO, Shader& lightingShader)
 {
     lightingShader.use();
     //base
@@ -1384,6 +1025,42 @@ void processInput(GLFWwindow* window)
     //}
 
 }
+void editRoofProfile(GLFWwindow* window, BezierCurve& roof)
+{
+    double currentTime = glfwGetTime();
+    if (currentTime - lastKeyPressTime >= keyPressDelay)
+    {
+        int count = roof.getControlPointCount();
+        if (glfwGetKey(window, GLFW_KEY_PERIOD) == GLFW_PRESS)
+        {
+            selectedRoofPoint = (selectedRoofPoint + 1) % count;
+            lastKeyPressTime = currentTime;
+        }
+        if (glfwGetKey(window, GLFW_KEY_COMMA) == GLFW_PRESS)
+        {
+            selectedRoofPoint = (selectedRoofPoint + count - 1) % count;
+            lastKeyPressTime = currentTime;
+        }
+    }
+
+    // radius on left/right, height on up/down, in profile units per second
+    float step = 0.2f * deltaTime;
+    glm::vec2 delta = glm::vec2(0.0f, 0.0f);
+    if (glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS)
+        delta.x -= step;
+    if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS)
+        delta.x += step;
+    if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS)
+        delta.y += step;
+    if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS)
+        delta.y -= step;
+
+    if (delta.x != 0.0f || delta.y != 0.0f)
+    {
+        glm::vec2 point = roof.getControlPoint(selectedRoofPoint);
+        roof.setControlPoint(selectedRoofPoint, point.x + delta.x, point.y + delta.y);
+    }
+}
 void ambienton_off(Shader& lightingShader)
 {
     double currentTime = glfwGetTime();
@@ -1391,8 +1068,8 @@ void ambienton_off(Shader& lightingShader)
     lightingShader.use();
     if (AmbientON)
     {
-        pointlight1.turnAmbientOff();
-        pointlight2.turnAmbientOff();
+        for (size_t i = 0; i < std::min(stageLightCount, pointLights.size()); i++)
+            pointLights[i].turnAmbientOff();
         lightingShader.setVec3("directionalLight.ambient", 0.0f, 0.0f, 0.0f);
         lightingShader.setVec3("spotLight.ambient", 0.0f, 0.0f, 0.0f);
         AmbientON = !AmbientON;
@@ -1400,8 +1077,8 @@ void ambienton_off(Shader& lightingShader)
     }
     else
     {
-        pointlight1.turnAmbientOn();
-        pointlight2.turnAmbientOn();
+        for (size_t i = 0; i < std::min(stageLightCount, pointLights.size()); i++)
+            pointLights[i].turnAmbientOn();
         lightingShader.setVec3("directionalLight.ambient", 0.2f, 0.2f, 0.2f);
         lightingShader.setVec3("spotLight.ambient", 0.2f, 0.2f, 0.2f);
         AmbientON = !AmbientON;
@@ -1415,8 +1092,8 @@ void diffuse_on_off(Shader& lightingShader)
     lightingShader.use();
     if (DiffusionON)
     {
-        pointlight1.turnDiffuseOff();
-        pointlight2.turnDiffuseOff();
+        for (size_t i = 0; i < std::min(stageLightCount, pointLights.size()); i++)
+            pointLights[i].turnDiffuseOff();
         lightingShader.setVec3("directionalLight.diffuse", 0.0f, 0.0f, 0.0f);
         lightingShader.setVec3("spotLight.diffuse", 0.0f, 0.0f, 0.0f);
         DiffusionON = !DiffusionON;
@@ -1424,8 +1101,8 @@ void diffuse_on_off(Shader& lightingShader)
     }
     else
     {
-        pointlight1.turnDiffuseOn();
-        pointlight2.turnDiffuseOn();
+        for (size_t i = 0; i < std::min(stageLightCount, pointLights.size()); i++)
+            pointLights[i].turnDiffuseOn();
         lightingShader.setVec3("directionalLight.diffuse", 0.8f, 0.8f, 0.8f);
         lightingShader.setVec3("spotLight.diffuse", 0.8f, 0.8f, 0.8f);
         DiffusionON = !DiffusionON;
@@ -1439,8 +1116,8 @@ void specular_on_off(Shader& lightingShader)
     lightingShader.use();
     if (SpecularON)
     {
-        pointlight1.turnSpecularOff();
-        pointlight2.turnSpecularOff();
+        for (size_t i = 0; i < std::min(stageLightCount, pointLights.size()); i++)
+            pointLights[i].turnSpecularOff();
         lightingShader.setVec3("directionalLight.specular", 0.0f, 0.0f, 0.0f);
         lightingShader.setVec3("spotLight.specular", 0.0f, 0.0f, 0.0f);
         SpecularON = !SpecularON;
@@ -1448,8 +1125,8 @@ void specular_on_off(Shader& lightingShader)
     }
     else
     {
-        pointlight1.turnSpecularOn();
-        pointlight2.turnSpecularOn();
+        for (size_t i = 0; i < std::min(stageLightCount, pointLights.size()); i++)
+            pointLights[i].turnSpecularOn();
         lightingShader.setVec3("directionalLight.specular", 1.0f, 1.0f, 1.0f);
         lightingShader.setVec3("spotLight.specular", 1.0f, 1.0f, 1.0f);
         SpecularON = !SpecularON;
@@ -1482,20 +1159,14 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
     {
         if (pointLightOn)
         {
-            pointlight1.turnOff();
-            pointlight2.turnOff();
-            pointlight3.turnOff();
-            pointlight4.turnOff();
-            pointlight5.turnOff();
+            for (PointLight& pointLight : pointLights)
+                pointLight.turnOff();
             pointLightOn = !pointLightOn;
         }
         else
         {
-            pointlight1.turnOn();
-            pointlight2.turnOn();
-            pointlight3.turnOn();
-            pointlight4.turnOn();
-            pointlight5.turnOn();
+            for (PointLight& pointLight : pointLights)
+                pointLight.turnOn();
             pointLightOn = !pointLightOn;
         }
     }
@@ -1561,41 +1232,4 @@ void mouse_callback(GLFWwindow* window, double xposIn, double yposIn)
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 {
     camera.ProcessMouseScroll(static_cast<float>(yoffset));
-}
-unsigned int loadTexture(char const* path, GLenum textureWrappingModeS, GLenum textureWrappingModeT, GLenum textureFilteringModeMin, GLenum textureFilteringModeMax)
-{
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    stbi_set_flip_vertically_on_load(true);
-    unsigned char* data = stbi_load(path, &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, textureWrappingModeS);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, textureWrappingModeT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, textureFilteringModeMin);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, textureFilteringModeMax);
-
-        stbi_image_free(data);
-    }
-    else
-    {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
-
-    return textureID;
 }
\ No newline at end of file
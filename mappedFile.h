@@ -0,0 +1,35 @@
+#ifndef mappedFile_h
+#define mappedFile_h
+
+#include <cstddef>
+#include <string>
+
+// read-only memory mapping of a whole file. the platform calls live in
+// mappedFile.cpp so that <windows.h> stays out of the headers
+class MappedFile
+{
+public:
+    MappedFile() {}
+    ~MappedFile() { close(); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // false if the file is missing, empty or cannot be mapped
+    bool open(const std::string& path);
+    void close();
+
+    const unsigned char* data() const { return bytes; }
+    size_t size() const { return length; }
+    bool isOpen() const { return bytes != nullptr; }
+
+private:
+    const unsigned char* bytes = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#endif
+};
+
+#endif /* mappedFile_h */
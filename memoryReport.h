@@ -0,0 +1,110 @@
+#ifndef memoryReport_h
+#define memoryReport_h
+
+#include <cstddef>
+#include <cstdio>
+
+// CPU and GPU bytes held by the scene, per kind of resource. every allocation that
+// outlives loading is charged to one category through a MemoryCharge owned next to
+// it, so the totals follow the resources as they are created, resized and released
+enum class MemoryCategory { Meshes, Trees, Textures, Instances, Count };
+
+inline const char* memoryCategoryName(MemoryCategory category)
+{
+    static const char* names[] = { "meshes", "trees", "textures", "instances" };
+    return names[(int)category];
+}
+
+struct MemoryUsage
+{
+    size_t cpuBytes = 0;
+    size_t gpuBytes = 0;
+};
+
+// current usage of every category; only touched from the GL thread
+inline MemoryUsage* memoryUsage()
+{
+    static MemoryUsage usage[(int)MemoryCategory::Count];
+    return usage;
+}
+
+// bytes charged to a category for as long as the charge lives. move-only, like the
+// GL handles it usually sits beside
+class MemoryCharge
+{
+public:
+    MemoryCharge() {}
+
+    MemoryCharge(MemoryCategory category, size_t cpuBytes, size_t gpuBytes) : category(category)
+    {
+        set(cpuBytes, gpuBytes);
+    }
+
+    ~MemoryCharge()
+    {
+        set(0, 0);
+    }
+
+    MemoryCharge(const MemoryCharge&) = delete;
+    MemoryCharge& operator=(const MemoryCharge&) = delete;
+
+    MemoryCharge(MemoryCharge&& other) noexcept
+        : category(other.category), cpuBytes(other.cpuBytes), gpuBytes(other.gpuBytes)
+    {
+        other.cpuBytes = other.gpuBytes = 0;
+    }
+
+    MemoryCharge& operator=(MemoryCharge&& other) noexcept
+    {
+        if (this != &other)
+        {
+            set(0, 0);
+            category = other.category;
+            cpuBytes = other.cpuBytes;
+            gpuBytes = other.gpuBytes;
+            other.cpuBytes = other.gpuBytes = 0;
+        }
+        return *this;
+    }
+
+    // replaces what this charge accounts for
+    void set(size_t cpu, size_t gpu)
+    {
+        MemoryUsage& usage = memoryUsage()[(int)category];
+        usage.cpuBytes += cpu - cpuBytes;
+        usage.gpuBytes += gpu - gpuBytes;
+        cpuBytes = cpu;
+        gpuBytes = gpu;
+    }
+
+    size_t getCpuBytes() const
+    {
+        return cpuBytes;
+    }
+
+    size_t getGpuBytes() const
+    {
+        return gpuBytes;
+    }
+
+private:
+    MemoryCategory category = MemoryCategory::Meshes;
+    size_t cpuBytes = 0;
+    size_t gpuBytes = 0;
+};
+
+inline void printMemoryReport()
+{
+    size_t cpuTotal = 0, gpuTotal = 0;
+    printf("%-10s %10s %10s\n", "memory", "CPU KB", "GPU KB");
+    for (int c = 0; c < (int)MemoryCategory::Count; c++)
+    {
+        const MemoryUsage& usage = memoryUsage()[c];
+        printf("%-10s %10zu %10zu\n", memoryCategoryName((MemoryCategory)c), usage.cpuBytes / 1024, usage.gpuBytes / 1024);
+        cpuTotal += usage.cpuBytes;
+        gpuTotal += usage.gpuBytes;
+    }
+    printf("%-10s %10zu %10zu\n", "total", cpuTotal / 1024, gpuTotal / 1024);
+}
+
+#endif /* memoryReport_h */
@@ -0,0 +1,411 @@
+#ifndef meshCache_h
+#define meshCache_h
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include "meshData.h"
+#include "meshSimplifier.h"
+#include "fractal.h"
+#include "mappedFile.h"
+
+// binary cache of generated meshes, so that a warm start skips generation,
+// optimisation and simplification altogether. the file is memory-mapped at startup;
+// entries are found by a hash of the generator's name, its parameters and the
+// generator code's version, and copied out of the mapping with one memcpy per array.
+//
+// layout, all little-endian and every array 16-byte aligned:
+//   MeshCacheHeader
+//   MeshCacheEntry[entryCount]              key, offset and size of each value
+//   values: uint32 meshCount, then per mesh
+//     MeshCacheRecord                       counts, AABB, bounding sphere
+//     float vertices[vertexCount * floatsPerVertex]
+//     uint32 indices[indexCount]
+//     LodLevel levels[levelCount]
+
+// the generator code's version: the project hashes the headers that generate,
+// optimise and simplify meshes into MESH_GENERATOR_HASH at build time, so editing
+// them rebuilds the cache. builds that do not define it fall back to
+// meshGeneratorVersion alone, which then has to be bumped by hand whenever a
+// generator, optimizeMesh() or buildLodChain() changes its output. a file written
+// for another version is ignored and rebuilt
+#ifndef MESH_GENERATOR_HASH
+#define MESH_GENERATOR_HASH 0u
+#endif
+const uint32_t meshGeneratorVersion = 1;
+const uint32_t meshGeneratorHash = MESH_GENERATOR_HASH;
+
+struct MeshCacheHeader
+{
+    char magic[8];
+    uint32_t formatVersion;
+    uint32_t generatorVersion;
+    uint32_t entryCount;
+    uint32_t generatorHash;
+};
+
+struct MeshCacheEntry
+{
+    uint64_t key;
+    uint64_t offset;
+    uint64_t size;
+};
+
+struct MeshCacheRecord
+{
+    uint32_t floatsPerVertex;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t levelCount;
+    float boundsLow[3];
+    float boundsHigh[3];
+    float center[3];
+    float radius;
+    uint32_t reserved[2];
+};
+
+// FNV-1a over everything that determines a mesh
+class MeshCacheKey
+{
+public:
+    explicit MeshCacheKey(const char* generator)
+    {
+        add(generator);
+        add((int)meshGeneratorVersion);
+        add((int)meshGeneratorHash);
+    }
+
+    MeshCacheKey& add(const char* text)
+    {
+        return addBytes(text, strlen(text) + 1);
+    }
+
+    MeshCacheKey& add(int value)
+    {
+        return addBytes(&value, sizeof(value));
+    }
+
+    MeshCacheKey& add(float value)
+    {
+        return addBytes(&value, sizeof(value));
+    }
+
+    MeshCacheKey& add(const float* values, size_t count)
+    {
+        return addBytes(values, count * sizeof(float));
+    }
+
+    MeshCacheKey& add(glm::vec3 value)
+    {
+        return add(&value[0], 3);
+    }
+
+    uint64_t value() const
+    {
+        return hash;
+    }
+
+private:
+    uint64_t hash = 14695981039346656037ull;
+
+    MeshCacheKey& addBytes(const void* data, size_t size)
+    {
+        const unsigned char* bytes = (const unsigned char*)data;
+        for (size_t i = 0; i < size; i++)
+        {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+        return *this;
+    }
+};
+
+inline size_t alignMeshCacheOffset(size_t offset)
+{
+    return (offset + 15) & ~(size_t)15;
+}
+
+// serialised form of one mesh of a cached value
+inline void appendMeshCacheRecord(std::vector<unsigned char>& blob, const MeshData& mesh,
+    const std::vector<LodLevel>* levels = nullptr, glm::vec3 center = glm::vec3(0.0f), float radius = 0.0f)
+{
+    MeshCacheRecord record = {};
+    record.floatsPerVertex = (uint32_t)mesh.floatsPerVertex;
+    record.vertexCount = mesh.getVertexCount();
+    record.indexCount = (uint32_t)mesh.indices.size();
+    record.levelCount = levels ? (uint32_t)levels->size() : 0;
+    for (uint32_t v = 0; v < record.vertexCount; v++)
+    {
+        const float* p = &mesh.vertices[(size_t)v * mesh.floatsPerVertex];
+        for (int i = 0; i < 3; i++)
+        {
+            record.boundsLow[i] = v == 0 ? p[i] : std::min(record.boundsLow[i], p[i]);
+            record.boundsHigh[i] = v == 0 ? p[i] : std::max(record.boundsHigh[i], p[i]);
+        }
+    }
+    for (int i = 0; i < 3; i++)
+        record.center[i] = center[i];
+    record.radius = radius;
+
+    auto append = [&](const void* data, size_t size) {
+        size_t offset = alignMeshCacheOffset(blob.size());
+        blob.resize(offset + size);
+        if (size > 0)
+            memcpy(&blob[offset], data, size);
+    };
+    append(&record, sizeof(record));
+    append(mesh.vertices.data(), mesh.vertices.size() * sizeof(float));
+    append(mesh.indices.data(), mesh.indices.size() * sizeof(unsigned int));
+    if (levels)
+        append(levels->data(), levels->size() * sizeof(LodLevel));
+}
+
+// reads one mesh back; false if the value is cut short
+inline bool readMeshCacheRecord(const unsigned char* base, size_t size, size_t& offset, MeshData& mesh,
+    std::vector<LodLevel>* levels = nullptr, glm::vec3* center = nullptr, float* radius = nullptr)
+{
+    auto take = [&](size_t bytes) -> const unsigned char* {
+        offset = alignMeshCacheOffset(offset);
+        if (offset + bytes > size)
+            return nullptr;
+        const unsigned char* data = base + offset;
+        offset += bytes;
+        return data;
+    };
+
+    const unsigned char* header = take(sizeof(MeshCacheRecord));
+    if (!header)
+        return false;
+    MeshCacheRecord record;
+    memcpy(&record, header, sizeof(record));
+
+    size_t floatCount = (size_t)record.vertexCount * record.floatsPerVertex;
+    const unsigned char* vertices = take(floatCount * sizeof(float));
+    const unsigned char* indices = vertices ? take((size_t)record.indexCount * sizeof(unsigned int)) : nullptr;
+    const unsigned char* lodLevels = indices ? take((size_t)record.levelCount * sizeof(LodLevel)) : nullptr;
+    if (!lodLevels)
+        return false;
+
+    mesh.floatsPerVertex = (int)record.floatsPerVertex;
+    mesh.vertices.resize(floatCount);
+    mesh.indices.resize(record.indexCount);
+    if (floatCount > 0)
+        memcpy(mesh.vertices.data(), vertices, floatCount * sizeof(float));
+    if (record.indexCount > 0)
+        memcpy(mesh.indices.data(), indices, (size_t)record.indexCount * sizeof(unsigned int));
+    if (levels)
+    {
+        levels->resize(record.levelCount);
+        if (record.levelCount > 0)
+            memcpy(levels->data(), lodLevels, (size_t)record.levelCount * sizeof(LodLevel));
+    }
+    if (center)
+        *center = glm::vec3(record.center[0], record.center[1], record.center[2]);
+    if (radius)
+        *radius = record.radius;
+    return true;
+}
+
+inline uint32_t meshCacheMeshCount(const unsigned char* base, size_t size)
+{
+    uint32_t meshCount = 0;
+    if (size >= sizeof(meshCount))
+        memcpy(&meshCount, base, sizeof(meshCount));
+    return meshCount;
+}
+
+// one writer and reader per value type that a generator returns
+inline void writeMeshCacheValue(std::vector<unsigned char>& blob, const MeshData& mesh)
+{
+    uint32_t meshCount = 1;
+    blob.insert(blob.end(), (const unsigned char*)&meshCount, (const unsigned char*)(&meshCount + 1));
+    appendMeshCacheRecord(blob, mesh);
+}
+
+inline bool readMeshCacheValue(const unsigned char* base, size_t size, MeshData& mesh)
+{
+    size_t offset = sizeof(uint32_t);
+    return meshCacheMeshCount(base, size) == 1 && readMeshCacheRecord(base, size, offset, mesh);
+}
+
+inline void writeMeshCacheValue(std::vector<unsigned char>& blob, const LodChain& chain)
+{
+    uint32_t meshCount = 1;
+    blob.insert(blob.end(), (const unsigned char*)&meshCount, (const unsigned char*)(&meshCount + 1));
+    appendMeshCacheRecord(blob, chain.mesh, &chain.levels, chain.center, chain.radius);
+}
+
+inline bool readMeshCacheValue(const unsigned char* base, size_t size, LodChain& chain)
+{
+    size_t offset = sizeof(uint32_t);
+    return meshCacheMeshCount(base, size) == 1 && readMeshCacheRecord(base, size, offset, chain.mesh, &chain.levels, &chain.center, &chain.radius);
+}
+
+inline void writeMeshCacheValue(std::vector<unsigned char>& blob, const TreeGeometry& tree)
+{
+    uint32_t meshCount = 2;
+    blob.insert(blob.end(), (const unsigned char*)&meshCount, (const unsigned char*)(&meshCount + 1));
+    appendMeshCacheRecord(blob, tree.branches);
+    appendMeshCacheRecord(blob, tree.leaves);
+}
+
+inline bool readMeshCacheValue(const unsigned char* base, size_t size, TreeGeometry& tree)
+{
+    size_t offset = sizeof(uint32_t);
+    return meshCacheMeshCount(base, size) == 2 && readMeshCacheRecord(base, size, offset, tree.branches) &&
+        readMeshCacheRecord(base, size, offset, tree.leaves);
+}
+
+// fetch() is safe to call from the mesh builder threads. save() rewrites the file
+// once every fetch has returned; it closes the mapping, so later fetches rebuild
+class MeshCache
+{
+public:
+    static const uint32_t formatVersion = 1;
+
+    explicit MeshCache(const std::string& path) : path(path)
+    {
+        if (!file.open(path))
+            return;
+
+        MeshCacheHeader header;
+        if (file.size() < sizeof(header))
+        {
+            file.close();
+            return;
+        }
+        memcpy(&header, file.data(), sizeof(header));
+        size_t tableEnd = sizeof(header) + (size_t)header.entryCount * sizeof(MeshCacheEntry);
+        if (memcmp(header.magic, "AUDMESH", 8) != 0 || header.formatVersion != formatVersion ||
+            header.generatorVersion != meshGeneratorVersion || header.generatorHash != meshGeneratorHash || tableEnd > file.size())
+        {
+            std::cout << "mesh cache: " << path << " is out of date and will be rebuilt" << std::endl;
+            file.close();
+            return;
+        }
+
+        for (uint32_t i = 0; i < header.entryCount; i++)
+        {
+            MeshCacheEntry entry;
+            memcpy(&entry, file.data() + sizeof(header) + i * sizeof(MeshCacheEntry), sizeof(entry));
+            if (entry.offset + entry.size <= file.size())
+                entries[entry.key] = entry;
+        }
+    }
+
+    // the cached value for key, or build() run and remembered for save()
+    template<class Build>
+    auto fetch(const MeshCacheKey& key, Build build) -> decltype(build())
+    {
+        decltype(build()) value;
+        auto found = entries.find(key.value());
+        if (found != entries.end() && file.isOpen() &&
+            readMeshCacheValue(file.data() + found->second.offset, (size_t)found->second.size, value))
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            hits++;
+            return value;
+        }
+
+        value = build();
+        std::vector<unsigned char> blob;
+        writeMeshCacheValue(blob, value);
+        std::lock_guard<std::mutex> lock(mutex);
+        pending[key.value()] = std::move(blob);
+        misses++;
+        return value;
+    }
+
+    // writes the mapped entries plus everything built this run, if anything was
+    void save()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (pending.empty())
+            return;
+
+        std::vector<uint64_t> keys;
+        for (const auto& entry : entries)
+            if (!pending.count(entry.first))
+                keys.push_back(entry.first);
+        for (const auto& value : pending)
+            keys.push_back(value.first);
+        std::sort(keys.begin(), keys.end());
+
+        MeshCacheHeader header = {};
+        memcpy(header.magic, "AUDMESH", 8);
+        header.formatVersion = formatVersion;
+        header.generatorVersion = meshGeneratorVersion;
+        header.generatorHash = meshGeneratorHash;
+        header.entryCount = (uint32_t)keys.size();
+
+        std::vector<MeshCacheEntry> table(keys.size());
+        size_t offset = sizeof(header) + table.size() * sizeof(MeshCacheEntry);
+        for (size_t i = 0; i < keys.size(); i++)
+        {
+            offset = alignMeshCacheOffset(offset);
+            auto built = pending.find(keys[i]);
+            table[i].key = keys[i];
+            table[i].offset = offset;
+            table[i].size = built != pending.end() ? built->second.size() : entries[keys[i]].size;
+            offset += (size_t)table[i].size;
+        }
+
+        // written next to the old file, which is still mapped, then swapped in
+        std::string temporary = path + ".tmp";
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        if (!out)
+            return;
+        out.write((const char*)&header, sizeof(header));
+        out.write((const char*)table.data(), table.size() * sizeof(MeshCacheEntry));
+        size_t written = sizeof(header) + table.size() * sizeof(MeshCacheEntry);
+        const char padding[16] = {};
+        for (size_t i = 0; i < keys.size(); i++)
+        {
+            out.write(padding, table[i].offset - written);
+            auto built = pending.find(keys[i]);
+            if (built != pending.end())
+                out.write((const char*)built->second.data(), built->second.size());
+            else
+                out.write((const char*)file.data() + entries[keys[i]].offset, (std::streamsize)table[i].size);
+            written = (size_t)(table[i].offset + table[i].size);
+        }
+        out.close();
+        if (!out)
+        {
+            std::remove(temporary.c_str());
+            return;
+        }
+
+        file.close();
+        entries.clear();
+        std::remove(path.c_str());
+        std::rename(temporary.c_str(), path.c_str());
+        pending.clear();
+    }
+
+    void printReport() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::cout << "mesh cache: " << hits << " of " << hits + misses << " meshes loaded from " << path << std::endl;
+    }
+
+private:
+    std::string path;
+    MappedFile file;
+    std::unordered_map<uint64_t, MeshCacheEntry> entries;
+    std::unordered_map<uint64_t, std::vector<unsigned char>> pending;
+    mutable std::mutex mutex;
+    int hits = 0;
+    int misses = 0;
+};
+
+#endif /* meshCache_h */
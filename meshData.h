@@ -0,0 +1,22 @@
+#ifndef meshData_h
+#define meshData_h
+
+#include <vector>
+
+// CPU side of a generated mesh: interleaved vertex floats and triangle indices.
+// Every procedural shape fills one in a static buildGeometry() that touches no GL
+// state, so it can run on a worker thread; the shape's MeshData constructor then
+// only uploads it on the GL thread.
+struct MeshData
+{
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices;
+    int floatsPerVertex = 8;            // 3 position + 3 normal + 2 texture by default
+
+    unsigned int getVertexCount() const
+    {
+        return (unsigned int)(vertices.size() / floatsPerVertex);
+    }
+};
+
+#endif /* meshData_h */
@@ -0,0 +1,349 @@
+#ifndef meshOptimizer_h
+#define meshOptimizer_h
+
+#include <vector>
+#include <string>
+#include <mutex>
+#include <cmath>
+#include <algorithm>
+#include <numeric>
+#include <iostream>
+#include <cstdio>
+#include <glm/glm.hpp>
+#include "meshData.h"
+
+// pre-upload pass for indexed triangle meshes: weld duplicate vertices, reorder
+// triangles for the post-transform vertex cache (Forsyth), reorder cache-friendly
+// clusters to cut overdraw, then renumber vertices in first-use order for fetch
+// locality. everything works on MeshData and touches no GL state, so it runs inside
+// the buildGeometry() tasks on the worker threads
+
+struct MeshOptimizeOptions
+{
+    bool weld = true;                   // merge bitwise-equal vertices
+    bool reorderVertices = true;        // off for meshes whose vertex order is relied on
+    float overdrawThreshold = 1.05f;    // allowed ACMR loss for the overdraw ordering
+};
+
+struct VertexCacheStatistics
+{
+    float acmr = 0.0f;      // transformed vertices per triangle: 0.5 is ideal, 3 is worst
+    float atvr = 0.0f;      // transformed vertices per referenced vertex: 1 is ideal
+};
+
+// FIFO cache of cacheSize entries, roughly what current GPUs behave like
+inline VertexCacheStatistics analyzeVertexCache(const std::vector<unsigned int>& indices, size_t vertexCount, int cacheSize = 16)
+{
+    VertexCacheStatistics statistics;
+    if (indices.empty())
+        return statistics;
+
+    std::vector<unsigned int> cache(cacheSize, ~0u);
+    std::vector<char> referenced(vertexCount, 0);
+    size_t head = 0, misses = 0, unique = 0;
+    for (unsigned int index : indices)
+    {
+        if (!referenced[index])
+        {
+            referenced[index] = 1;
+            unique++;
+        }
+        if (std::find(cache.begin(), cache.end(), index) != cache.end())
+            continue;
+        cache[head] = index;
+        head = (head + 1) % cacheSize;
+        misses++;
+    }
+    statistics.acmr = (float)misses / (indices.size() / 3);
+    statistics.atvr = (float)misses / unique;
+    return statistics;
+}
+
+// merges vertices whose floats are all equal, keeping the first of each group
+inline void weldVertices(MeshData& mesh)
+{
+    int stride = mesh.floatsPerVertex;
+    size_t vertexCount = mesh.getVertexCount();
+    const float* data = mesh.vertices.data();
+
+    std::vector<unsigned int> order(vertexCount);
+    std::iota(order.begin(), order.end(), 0u);
+    std::sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) {
+        const float* va = data + (size_t)a * stride;
+        const float* vb = data + (size_t)b * stride;
+        for (int i = 0; i < stride; i++)
+            if (va[i] != vb[i])
+                return va[i] < vb[i];
+        return a < b;
+    });
+
+    // every run of equal vertices maps to its lowest index, which sorted first
+    std::vector<unsigned int> remap(vertexCount);
+    for (size_t i = 0; i < vertexCount; )
+    {
+        size_t j = i + 1;
+        while (j < vertexCount && std::equal(data + (size_t)order[i] * stride, data + (size_t)order[i] * stride + stride, data + (size_t)order[j] * stride))
+            j++;
+        for (size_t k = i; k < j; k++)
+            remap[order[k]] = order[i];
+        i = j;
+    }
+    for (unsigned int& index : mesh.indices)
+        index = remap[index];
+    // the unreferenced duplicates are dropped by the vertex fetch reorder
+}
+
+// Tom Forsyth, "Linear-Speed Vertex Cache Optimisation": greedily emits the triangle
+// whose vertices score best, favouring vertices recently used and with few triangles
+// left, so fans and strips are finished before the cache forgets them
+inline void optimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount)
+{
+    const int cacheSize = 32;
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+        return;
+
+    auto vertexScore = [](int cachePosition, int remaining) {
+        if (remaining == 0)
+            return -1.0f;
+        float score = 0.0f;
+        if (cachePosition >= 0)
+            score = cachePosition < 3 ? 0.75f : powf(1.0f - (cachePosition - 3) / float(cacheSize - 3), 1.5f);
+        return score + 2.0f / sqrtf((float)remaining);
+    };
+
+    // triangles around every vertex, compressed
+    std::vector<unsigned int> remaining(vertexCount, 0);
+    for (unsigned int index : indices)
+        remaining[index]++;
+    std::vector<unsigned int> firstTriangle(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++)
+        firstTriangle[v + 1] = firstTriangle[v] + remaining[v];
+    std::vector<unsigned int> adjacency(indices.size());
+    std::vector<unsigned int> filled(firstTriangle.begin(), firstTriangle.end() - 1);
+    for (size_t t = 0; t < triangleCount; t++)
+        for (int k = 0; k < 3; k++)
+            adjacency[filled[indices[t * 3 + k]]++] = (unsigned int)t;
+
+    std::vector<float> score(vertexCount);
+    std::vector<int> cachePosition(vertexCount, -1);
+    for (size_t v = 0; v < vertexCount; v++)
+        score[v] = vertexScore(-1, remaining[v]);
+
+    std::vector<char> emitted(triangleCount, 0);
+    std::vector<unsigned int> result;
+    result.reserve(indices.size());
+    std::vector<unsigned int> cache, nextCache;
+    size_t scan = 0;
+    long long best = -1;
+
+    for (size_t count = 0; count < triangleCount; count++)
+    {
+        if (best < 0)
+        {
+            // nothing useful in the cache: continue with the next unemitted triangle
+            while (emitted[scan])
+                scan++;
+            best = (long long)scan;
+        }
+        emitted[best] = 1;
+
+        // emitted vertices move to the front of the cache
+        nextCache.clear();
+        for (int k = 0; k < 3; k++)
+        {
+            unsigned int v = indices[best * 3 + k];
+            result.push_back(v);
+            nextCache.push_back(v);
+            remaining[v]--;
+            // retire the triangle from the vertex's adjacency list
+            unsigned int* begin = &adjacency[firstTriangle[v]];
+            unsigned int* end = begin + remaining[v] + 1;
+            *std::find(begin, end, (unsigned int)best) = end[-1];
+        }
+        for (unsigned int v : cache)
+            if (std::find(nextCache.begin(), nextCache.begin() + 3, v) == nextCache.begin() + 3)
+                nextCache.push_back(v);
+
+        // rescore everything that was or is in the cache, then the triangles around it
+        for (size_t i = 0; i < nextCache.size(); i++)
+        {
+            unsigned int v = nextCache[i];
+            cachePosition[v] = i < (size_t)cacheSize ? (int)i : -1;
+            score[v] = vertexScore(cachePosition[v], remaining[v]);
+        }
+        best = -1;
+        float bestScore = 0.0f;
+        for (unsigned int v : nextCache)
+        {
+            for (unsigned int a = firstTriangle[v]; a < firstTriangle[v] + remaining[v]; a++)
+            {
+                unsigned int t = adjacency[a];
+                float s = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+                if (s > bestScore)
+                {
+                    bestScore = s;
+                    best = t;
+                }
+            }
+        }
+        if (nextCache.size() > (size_t)cacheSize)
+            nextCache.resize(cacheSize);
+        cache.swap(nextCache);
+    }
+    indices.swap(result);
+}
+
+// splits the cache-ordered triangles into clusters where the cache order restarts,
+// then draws outward-facing clusters far from the centre first so they hide what is
+// behind them. view independent, after Sander et al. the new order is kept only if
+// its ACMR stays within threshold of the cache-only order
+inline void optimizeOverdraw(std::vector<unsigned int>& indices, const MeshData& mesh, float threshold)
+{
+    size_t triangleCount = indices.size() / 3;
+    size_t vertexCount = mesh.getVertexCount();
+    if (triangleCount < 2)
+        return;
+
+    auto position = [&](unsigned int v) {
+        const float* p = &mesh.vertices[(size_t)v * mesh.floatsPerVertex];
+        return glm::vec3(p[0], p[1], p[2]);
+    };
+
+    // a triangle that misses on all three vertices starts a new cluster
+    const int cacheSize = 16;
+    std::vector<unsigned int> cache(cacheSize, ~0u);
+    size_t head = 0;
+    std::vector<size_t> clusterStarts;
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        int misses = 0;
+        for (int k = 0; k < 3; k++)
+        {
+            unsigned int v = indices[t * 3 + k];
+            if (std::find(cache.begin(), cache.end(), v) != cache.end())
+                continue;
+            cache[head] = v;
+            head = (head + 1) % cacheSize;
+            misses++;
+        }
+        if (misses == 3 || t == 0)
+            clusterStarts.push_back(t);
+    }
+    clusterStarts.push_back(triangleCount);
+    size_t clusterCount = clusterStarts.size() - 1;
+    if (clusterCount < 2)
+        return;
+
+    glm::vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+    std::vector<float> sortKey(clusterCount);
+    std::vector<glm::vec3> clusterCentroid(clusterCount, glm::vec3(0.0f));
+    std::vector<glm::vec3> clusterNormal(clusterCount, glm::vec3(0.0f));
+    std::vector<float> clusterArea(clusterCount, 0.0f);
+    for (size_t c = 0; c < clusterCount; c++)
+    {
+        for (size_t t = clusterStarts[c]; t < clusterStarts[c + 1]; t++)
+        {
+            glm::vec3 a = position(indices[t * 3]), b = position(indices[t * 3 + 1]), d = position(indices[t * 3 + 2]);
+            glm::vec3 normal = glm::cross(b - a, d - a);       // length is twice the area
+            float area = glm::length(normal) * 0.5f;
+            glm::vec3 centre = (a + b + d) * (1.0f / 3.0f);
+            clusterCentroid[c] += centre * area;
+            clusterNormal[c] += normal;
+            clusterArea[c] += area;
+        }
+        meshCentroid += clusterCentroid[c];
+        meshArea += clusterArea[c];
+    }
+    if (meshArea <= 0.0f)
+        return;
+    meshCentroid = meshCentroid * (1.0f / meshArea);
+
+    for (size_t c = 0; c < clusterCount; c++)
+    {
+        glm::vec3 centroid = clusterArea[c] > 0.0f ? clusterCentroid[c] * (1.0f / clusterArea[c]) : meshCentroid;
+        float normalLength = glm::length(clusterNormal[c]);
+        glm::vec3 normal = normalLength > 0.0f ? clusterNormal[c] * (1.0f / normalLength) : glm::vec3(0.0f);
+        sortKey[c] = glm::dot(centroid - meshCentroid, normal);
+    }
+
+    std::vector<size_t> clusterOrder(clusterCount);
+    std::iota(clusterOrder.begin(), clusterOrder.end(), (size_t)0);
+    std::stable_sort(clusterOrder.begin(), clusterOrder.end(), [&](size_t a, size_t b) { return sortKey[a] > sortKey[b]; });
+
+    std::vector<unsigned int> sorted;
+    sorted.reserve(indices.size());
+    for (size_t c : clusterOrder)
+        sorted.insert(sorted.end(), indices.begin() + clusterStarts[c] * 3, indices.begin() + clusterStarts[c + 1] * 3);
+
+    if (analyzeVertexCache(sorted, vertexCount).acmr <= analyzeVertexCache(indices, vertexCount).acmr * threshold)
+        indices.swap(sorted);
+}
+
+// renumbers vertices in the order the index buffer first uses them, dropping the
+// ones no triangle references
+inline void optimizeVertexFetch(MeshData& mesh)
+{
+    int stride = mesh.floatsPerVertex;
+    std::vector<unsigned int> remap(mesh.getVertexCount(), ~0u);
+    std::vector<float> vertices;
+    vertices.reserve(mesh.vertices.size());
+    unsigned int next = 0;
+    for (unsigned int& index : mesh.indices)
+    {
+        if (remap[index] == ~0u)
+        {
+            remap[index] = next++;
+            vertices.insert(vertices.end(), mesh.vertices.begin() + (size_t)index * stride, mesh.vertices.begin() + (size_t)(index + 1) * stride);
+        }
+        index = remap[index];
+    }
+    mesh.vertices.swap(vertices);
+}
+
+// before/after figures of every optimised mesh, printed once the scene is built
+struct MeshOptimizationLog
+{
+    std::mutex mutex;
+    std::vector<std::string> lines;
+};
+
+inline MeshOptimizationLog& meshOptimizationLog()
+{
+    static MeshOptimizationLog log;
+    return log;
+}
+
+inline void printMeshOptimizationReport()
+{
+    MeshOptimizationLog& log = meshOptimizationLog();
+    std::lock_guard<std::mutex> guard(log.mutex);
+    for (const std::string& line : log.lines)
+        std::cout << line << std::endl;
+    log.lines.clear();
+}
+
+inline void optimizeMesh(MeshData& mesh, const char* name, MeshOptimizeOptions options = MeshOptimizeOptions())
+{
+    size_t vertexCount = mesh.getVertexCount();
+    VertexCacheStatistics before = analyzeVertexCache(mesh.indices, vertexCount);
+
+    if (options.weld)
+        weldVertices(mesh);
+    optimizeVertexCache(mesh.indices, vertexCount);
+    optimizeOverdraw(mesh.indices, mesh, options.overdrawThreshold);
+    if (options.reorderVertices)
+        optimizeVertexFetch(mesh);
+
+    VertexCacheStatistics after = analyzeVertexCache(mesh.indices, mesh.getVertexCount());
+
+    char line[160];
+    snprintf(line, sizeof(line), "%-10s %6u vertices  ACMR %.3f -> %.3f  ATVR %.3f -> %.3f",
+        name, mesh.getVertexCount(), before.acmr, after.acmr, before.atvr, after.atvr);
+    MeshOptimizationLog& log = meshOptimizationLog();
+    std::lock_guard<std::mutex> guard(log.mutex);
+    log.lines.push_back(line);
+}
+
+#endif /* meshOptimizer_h */
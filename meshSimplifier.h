@@ -0,0 +1,450 @@
+#ifndef meshSimplifier_h
+#define meshSimplifier_h
+
+#include <vector>
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+#include <cstdio>
+#include <mutex>
+#include <glm/glm.hpp>
+#include "meshData.h"
+#include "meshOptimizer.h"
+
+// quadric error metric simplification (Garland and Heckbert) for indexed MeshData.
+// a collapse moves a vertex onto one of its neighbours, so every level keeps using
+// the original vertex buffer and only the index buffer shrinks. vertices sharing a
+// position with a differently attributed copy (uv seams, hard edges) only collapse
+// along that seam, together with their copy, and open boundaries only collapse
+// along themselves, so neither opens cracks nor drags texture coordinates across
+
+struct LodLevel
+{
+    unsigned int firstIndex = 0;
+    unsigned int indexCount = 0;
+    float error = 0.0f;             // bound on the object space distance from the full mesh
+};
+
+struct LodChain
+{
+    MeshData mesh;                  // the vertices, then every level's indices back to back
+    std::vector<LodLevel> levels;   // finest first
+    glm::vec3 center = glm::vec3(0.0f);
+    float radius = 0.0f;
+};
+
+// sum of squared distances to weighted planes, as the symmetric A, b, c of p'Ap + 2b'p + c
+struct Quadric
+{
+    double a00 = 0.0, a01 = 0.0, a02 = 0.0, a11 = 0.0, a12 = 0.0, a22 = 0.0;
+    double b0 = 0.0, b1 = 0.0, b2 = 0.0, c = 0.0;
+    double weight = 0.0;
+
+    // plane dot(n, p) + d = 0 with unit n
+    void addPlane(glm::dvec3 n, double d, double w)
+    {
+        a00 += w * n.x * n.x; a01 += w * n.x * n.y; a02 += w * n.x * n.z;
+        a11 += w * n.y * n.y; a12 += w * n.y * n.z; a22 += w * n.z * n.z;
+        b0 += w * n.x * d; b1 += w * n.y * d; b2 += w * n.z * d;
+        c += w * d * d;
+        weight += w;
+    }
+
+    void add(const Quadric& q)
+    {
+        a00 += q.a00; a01 += q.a01; a02 += q.a02; a11 += q.a11; a12 += q.a12; a22 += q.a22;
+        b0 += q.b0; b1 += q.b1; b2 += q.b2; c += q.c;
+        weight += q.weight;
+    }
+
+    // weighted mean squared distance from p to the planes
+    double error(glm::dvec3 p) const
+    {
+        double e = p.x * (a00 * p.x + a01 * p.y + a02 * p.z)
+            + p.y * (a01 * p.x + a11 * p.y + a12 * p.z)
+            + p.z * (a02 * p.x + a12 * p.y + a22 * p.z)
+            + 2.0 * (b0 * p.x + b1 * p.y + b2 * p.z) + c;
+        return weight > 0.0 ? std::max(e, 0.0) / weight : 0.0;
+    }
+};
+
+// what a vertex may collapse along
+enum class VertexKind { Manifold, Border, Seam, Locked };
+
+// removes triangles from indices until at most targetIndexCount remain or every
+// further collapse would move the surface by more than targetError. the indices
+// returned refer to the same vertices; resultError receives the largest error used
+inline std::vector<unsigned int> simplifyMesh(const MeshData& mesh, const std::vector<unsigned int>& indices,
+    size_t targetIndexCount, float targetError, float* resultError = nullptr)
+{
+    const double borderWeight = 10.0;
+    size_t vertexCount = mesh.getVertexCount();
+    int stride = mesh.floatsPerVertex;
+    auto position = [&](unsigned int v) {
+        const float* p = &mesh.vertices[(size_t)v * stride];
+        return glm::dvec3(p[0], p[1], p[2]);
+    };
+    auto edgeKey = [](unsigned int a, unsigned int b) {
+        return ((unsigned long long)a << 32) | b;
+    };
+
+    // vertices at the same position form a group named after its lowest vertex;
+    // wedge links every vertex of a group in a cycle. positions closer than a
+    // ten-thousandth of the mesh size count as the same, so seams that sin and cos
+    // generate at 0 and 2 pi still meet
+    glm::dvec3 low = vertexCount > 0 ? position(0) : glm::dvec3(0.0, 0.0, 0.0), high = low;
+    for (size_t v = 0; v < vertexCount; v++)
+        for (int i = 0; i < 3; i++)
+        {
+            low[i] = std::min(low[i], position((unsigned int)v)[i]);
+            high[i] = std::max(high[i], position((unsigned int)v)[i]);
+        }
+    double tolerance = std::max(high.x - low.x, std::max(high.y - low.y, high.z - low.z)) * 1e-4;
+
+    std::vector<unsigned int> order(vertexCount), group(vertexCount), wedge(vertexCount), groupSize(vertexCount, 0);
+    std::iota(order.begin(), order.end(), 0u);
+    std::iota(group.begin(), group.end(), 0u);
+    auto root = [&](unsigned int v) {
+        while (group[v] != v)
+            v = group[v] = group[group[v]];
+        return v;
+    };
+    // sweep along x, joining everything within the tolerance box
+    std::sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) { return position(a).x < position(b).x; });
+    for (size_t i = 0; i < vertexCount; i++)
+    {
+        glm::dvec3 p = position(order[i]);
+        for (size_t j = i + 1; j < vertexCount && position(order[j]).x - p.x <= tolerance; j++)
+        {
+            glm::dvec3 q = position(order[j]);
+            if (fabs(q.y - p.y) > tolerance || fabs(q.z - p.z) > tolerance)
+                continue;
+            unsigned int a = root(order[i]), b = root(order[j]);
+            group[std::max(a, b)] = std::min(a, b);
+        }
+    }
+    for (size_t v = 0; v < vertexCount; v++)
+        group[v] = root((unsigned int)v);
+    std::sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) {
+        return group[a] != group[b] ? group[a] < group[b] : a < b;
+    });
+    for (size_t i = 0; i < vertexCount; )
+    {
+        size_t j = i + 1;
+        while (j < vertexCount && group[order[j]] == group[order[i]])
+            j++;
+        for (size_t k = i; k < j; k++)
+            wedge[order[k]] = order[k + 1 < j ? k + 1 : i];
+        groupSize[order[i]] = (unsigned int)(j - i);
+        i = j;
+    }
+
+    std::vector<unsigned int> result(indices);
+    std::vector<unsigned long long> vertexEdges, positionEdges;
+
+    // directed edges between vertices, and undirected edges between groups
+    auto collectEdges = [&]() {
+        vertexEdges.clear();
+        positionEdges.clear();
+        for (size_t t = 0; t < result.size(); t += 3)
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned int a = result[t + k], b = result[t + (k + 1) % 3];
+                vertexEdges.push_back(edgeKey(a, b));
+                positionEdges.push_back(edgeKey(std::min(group[a], group[b]), std::max(group[a], group[b])));
+            }
+        std::sort(vertexEdges.begin(), vertexEdges.end());
+        std::sort(positionEdges.begin(), positionEdges.end());
+    };
+    auto hasVertexEdge = [&](unsigned int a, unsigned int b) {
+        return std::binary_search(vertexEdges.begin(), vertexEdges.end(), edgeKey(a, b));
+    };
+    auto positionEdgeCount = [&](unsigned int a, unsigned int b) {
+        unsigned long long key = edgeKey(std::min(group[a], group[b]), std::max(group[a], group[b]));
+        auto range = std::equal_range(positionEdges.begin(), positionEdges.end(), key);
+        return (size_t)(range.second - range.first);
+    };
+
+    // classify once: a border edge has one triangle, a seam edge is open between
+    // vertices but closed between positions
+    collectEdges();
+    std::vector<unsigned int> borderEdges(vertexCount, 0), seamEdges(vertexCount, 0);
+    std::vector<char> nonManifold(vertexCount, 0);
+    std::vector<Quadric> quadrics(vertexCount);
+    for (size_t t = 0; t < result.size(); t += 3)
+    {
+        unsigned int v[3] = { result[t], result[t + 1], result[t + 2] };
+        glm::dvec3 p[3] = { position(v[0]), position(v[1]), position(v[2]) };
+        glm::dvec3 normal = glm::cross(p[1] - p[0], p[2] - p[0]);
+        double length = glm::length(normal);
+        if (length > 0.0)
+        {
+            normal /= length;
+            for (int k = 0; k < 3; k++)
+                quadrics[group[v[k]]].addPlane(normal, -glm::dot(normal, p[0]), length * 0.5);
+        }
+
+        for (int k = 0; k < 3; k++)
+        {
+            unsigned int a = v[k], b = v[(k + 1) % 3];
+            size_t count = positionEdgeCount(a, b);
+            if (count == 1)
+            {
+                borderEdges[group[a]]++;
+                borderEdges[group[b]]++;
+                // keep the boundary in place with a plane through it, across the face
+                glm::dvec3 edge = p[(k + 1) % 3] - p[k];
+                glm::dvec3 across = glm::cross(edge, normal);
+                double acrossLength = glm::length(across);
+                if (length > 0.0 && acrossLength > 0.0)
+                {
+                    across /= acrossLength;
+                    double d = -glm::dot(across, p[k]);
+                    double w = glm::dot(edge, edge) * borderWeight;
+                    quadrics[group[a]].addPlane(across, d, w);
+                    quadrics[group[b]].addPlane(across, d, w);
+                }
+            }
+            else if (count > 2)
+                nonManifold[group[a]] = nonManifold[group[b]] = 1;
+            else if (!hasVertexEdge(b, a))
+            {
+                seamEdges[a]++;
+                seamEdges[b]++;
+            }
+        }
+    }
+
+    std::vector<VertexKind> kind(vertexCount, VertexKind::Locked);
+    for (size_t v = 0; v < vertexCount; v++)
+    {
+        unsigned int g = group[v];
+        if (nonManifold[g])
+            continue;
+        if (groupSize[g] == 1 && borderEdges[g] == 0)
+            kind[v] = VertexKind::Manifold;
+        else if (groupSize[g] == 1 && borderEdges[g] == 2)
+            kind[v] = VertexKind::Border;
+        else if (groupSize[g] == 2 && borderEdges[g] == 0 && seamEdges[v] == 2)
+            kind[v] = VertexKind::Seam;
+    }
+
+    struct Collapse
+    {
+        unsigned int from, to;
+        double cost;
+    };
+    std::vector<Collapse> collapses;
+    std::vector<unsigned int> firstTriangle, adjacency, remap(vertexCount);
+    std::vector<char> touched(vertexCount);
+    double errorLimit = (double)targetError * targetError;
+    double largestError = 0.0;
+
+    // moving from onto to must not turn any surviving triangle around from over
+    auto keepsOrientation = [&](unsigned int from, unsigned int to) {
+        glm::dvec3 target = position(to);
+        for (unsigned int a = firstTriangle[from]; a < firstTriangle[from + 1]; a++)
+        {
+            const unsigned int* tri = &result[(size_t)adjacency[a] * 3];
+            if (tri[0] == to || tri[1] == to || tri[2] == to)
+                continue;
+            glm::dvec3 p[3], q[3];
+            for (int k = 0; k < 3; k++)
+            {
+                p[k] = position(tri[k]);
+                q[k] = tri[k] == from ? target : p[k];
+            }
+            glm::dvec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+            glm::dvec3 after = glm::cross(q[1] - q[0], q[2] - q[0]);
+            if (glm::dot(before, after) <= 0.0)
+                return false;
+        }
+        return true;
+    };
+    // the copy of to's position that shares an edge with from
+    auto matchingWedge = [&](unsigned int from, unsigned int to) {
+        for (unsigned int w = wedge[to]; w != to; w = wedge[w])
+            if (hasVertexEdge(from, w) || hasVertexEdge(w, from))
+                return w;
+        return ~0u;
+    };
+
+    while (result.size() > targetIndexCount)
+    {
+        size_t triangleCount = result.size() / 3;
+        collectEdges();
+
+        firstTriangle.assign(vertexCount + 1, 0);
+        for (unsigned int index : result)
+            firstTriangle[index + 1]++;
+        for (size_t v = 0; v < vertexCount; v++)
+            firstTriangle[v + 1] += firstTriangle[v];
+        adjacency.resize(result.size());
+        std::vector<unsigned int> filled(firstTriangle.begin(), firstTriangle.end() - 1);
+        for (size_t t = 0; t < triangleCount; t++)
+            for (int k = 0; k < 3; k++)
+                adjacency[filled[result[t * 3 + k]]++] = (unsigned int)t;
+
+        collapses.clear();
+        auto consider = [&](unsigned int from, unsigned int to) {
+            switch (kind[from])
+            {
+            case VertexKind::Locked:
+                return;
+            case VertexKind::Border:
+                if (positionEdgeCount(from, to) != 1 || kind[to] == VertexKind::Manifold)
+                    return;
+                break;
+            case VertexKind::Seam:
+                if (positionEdgeCount(from, to) != 2 || hasVertexEdge(from, to) == hasVertexEdge(to, from) ||
+                    kind[to] == VertexKind::Manifold || kind[to] == VertexKind::Border)
+                    return;
+                break;
+            default:
+                break;
+            }
+            Quadric q = quadrics[group[from]];
+            q.add(quadrics[group[to]]);
+            double cost = q.error(position(to));
+            if (cost <= errorLimit)
+                collapses.push_back({ from, to, cost });
+        };
+        for (size_t t = 0; t < triangleCount; t++)
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned int a = result[t * 3 + k], b = result[t * 3 + (k + 1) % 3];
+                consider(a, b);
+                consider(b, a);
+            }
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) {
+            if (a.cost != b.cost)
+                return a.cost < b.cost;
+            return a.from != b.from ? a.from < b.from : a.to < b.to;
+        });
+
+        // cheapest first; a collapse freezes every vertex around it until the next
+        // pass so the adjacency above stays exact
+        std::iota(remap.begin(), remap.end(), 0u);
+        std::fill(touched.begin(), touched.end(), 0);
+        size_t remaining = triangleCount, performed = 0;
+        for (const Collapse& collapse : collapses)
+        {
+            unsigned int from = collapse.from, to = collapse.to;
+            if (touched[from] || touched[to])
+                continue;
+            unsigned int fromCopy = ~0u, toCopy = ~0u;
+            if (kind[from] == VertexKind::Seam)
+            {
+                fromCopy = wedge[from];
+                toCopy = matchingWedge(fromCopy, to);
+                if (toCopy == ~0u || touched[fromCopy] || touched[toCopy])
+                    continue;
+            }
+            if (!keepsOrientation(from, to) || (fromCopy != ~0u && !keepsOrientation(fromCopy, toCopy)))
+                continue;
+
+            unsigned int pairs[2][2] = { { from, to }, { fromCopy, toCopy } };
+            for (auto& pair : pairs)
+            {
+                if (pair[0] == ~0u)
+                    continue;
+                remap[pair[0]] = pair[1];
+                for (unsigned int a = firstTriangle[pair[0]]; a < firstTriangle[pair[0] + 1]; a++)
+                {
+                    const unsigned int* tri = &result[(size_t)adjacency[a] * 3];
+                    if (tri[0] == pair[1] || tri[1] == pair[1] || tri[2] == pair[1])
+                        remaining--;
+                    touched[tri[0]] = touched[tri[1]] = touched[tri[2]] = 1;
+                }
+            }
+            quadrics[group[to]].add(quadrics[group[from]]);
+            largestError = std::max(largestError, collapse.cost);
+            performed++;
+            if (remaining * 3 <= targetIndexCount)
+                break;
+        }
+        if (performed == 0)
+            break;
+
+        // drop the triangles that collapsed onto an edge
+        size_t kept = 0;
+        for (size_t t = 0; t < triangleCount; t++)
+        {
+            unsigned int a = remap[result[t * 3]], b = remap[result[t * 3 + 1]], c = remap[result[t * 3 + 2]];
+            if (group[a] == group[b] || group[b] == group[c] || group[c] == group[a])
+                continue;
+            result[kept++] = a;
+            result[kept++] = b;
+            result[kept++] = c;
+        }
+        result.resize(kept);
+    }
+
+    if (resultError)
+        *resultError = (float)sqrt(largestError);
+    return result;
+}
+
+// LOD chain for the asset-build step: levelErrors are the allowed deviations as
+// fractions of the bounding radius, finest first. each level simplifies the one
+// before it; levels that would save less than a tenth of the triangles are skipped
+inline LodChain buildLodChain(MeshData mesh, const std::vector<float>& levelErrors, const char* name)
+{
+    LodChain chain;
+    size_t vertexCount = mesh.getVertexCount();
+    if (vertexCount > 0)
+    {
+        glm::vec3 low(mesh.vertices[0], mesh.vertices[1], mesh.vertices[2]), high = low;
+        for (size_t v = 0; v < vertexCount; v++)
+        {
+            glm::vec3 p(mesh.vertices[v * mesh.floatsPerVertex], mesh.vertices[v * mesh.floatsPerVertex + 1], mesh.vertices[v * mesh.floatsPerVertex + 2]);
+            low = glm::min(low, p);
+            high = glm::max(high, p);
+        }
+        chain.center = (low + high) * 0.5f;
+        chain.radius = glm::length(high - low) * 0.5f;
+    }
+
+    std::vector<unsigned int> current = mesh.indices;
+    std::vector<unsigned int> allIndices = current;
+    chain.levels.push_back({ 0, (unsigned int)current.size(), 0.0f });
+    float accumulated = 0.0f;
+    for (float relativeError : levelErrors)
+    {
+        float target = relativeError * chain.radius;
+        if (target <= accumulated)
+            continue;
+        float error = 0.0f;
+        std::vector<unsigned int> simplified = simplifyMesh(mesh, current, 0, target - accumulated, &error);
+        if (simplified.empty() || simplified.size() * 10 > current.size() * 9)
+            continue;
+        optimizeVertexCache(simplified, vertexCount);
+
+        // errors of successive levels add up at worst
+        accumulated += error;
+        chain.levels.push_back({ (unsigned int)allIndices.size(), (unsigned int)simplified.size(), accumulated });
+        allIndices.insert(allIndices.end(), simplified.begin(), simplified.end());
+        current.swap(simplified);
+    }
+
+    std::string line = name;
+    line.resize(std::max(line.size(), (size_t)10), ' ');
+    line += " LOD triangles";
+    for (size_t level = 0; level < chain.levels.size(); level++)
+    {
+        char entry[48];
+        snprintf(entry, sizeof(entry), "%s %u (%.4f)", level ? " /" : "", chain.levels[level].indexCount / 3, chain.levels[level].error);
+        line += entry;
+    }
+    {
+        MeshOptimizationLog& log = meshOptimizationLog();
+        std::lock_guard<std::mutex> guard(log.mutex);
+        log.lines.push_back(line);
+    }
+
+    mesh.indices.swap(allIndices);
+    chain.mesh = std::move(mesh);
+    return chain;
+}
+
+#endif /* meshSimplifier_h */
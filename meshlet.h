@@ -0,0 +1,277 @@
+#ifndef meshlet_h
+#define meshlet_h
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include "meshData.h"
+
+// meshlets: small clusters of triangles, at most 64 vertices and 124 triangles,
+// stored as contiguous ranges of the index buffer. each carries a bounding sphere
+// and a cone around its triangle normals, so whole clusters that are outside the
+// frustum or face away from the camera can be skipped on the CPU before the
+// surviving ranges go to the GPU in one glMultiDrawElements call
+struct Meshlet
+{
+    unsigned int firstIndex = 0;
+    unsigned int indexCount = 0;
+    glm::vec3 center = glm::vec3(0.0f);
+    float radius = 0.0f;
+    glm::vec3 coneAxis = glm::vec3(0.0f);
+    float coneCutoff = 1.0f;            // 1 never culls
+};
+
+// sphere around the bounding box centre and the normal cone of one meshlet,
+// from the CPU copy of the vertices in object space
+inline void computeMeshletBounds(const float* vertices, int floatsPerVertex, const unsigned int* indices, Meshlet& meshlet)
+{
+    auto position = [&](unsigned int v) {
+        const float* p = vertices + (size_t)v * floatsPerVertex;
+        return glm::vec3(p[0], p[1], p[2]);
+    };
+    const unsigned int* first = indices + meshlet.firstIndex;
+    const unsigned int* last = first + meshlet.indexCount;
+    if (first == last)
+        return;
+
+    glm::vec3 low = position(*first), high = low;
+    for (const unsigned int* index = first; index != last; index++)
+    {
+        low = glm::min(low, position(*index));
+        high = glm::max(high, position(*index));
+    }
+    meshlet.center = (low + high) * 0.5f;
+    meshlet.radius = 0.0f;
+    for (const unsigned int* index = first; index != last; index++)
+        meshlet.radius = std::max(meshlet.radius, glm::length(position(*index) - meshlet.center));
+
+    // the cone axis is the mean winding normal, opened wide enough for every triangle
+    std::vector<glm::vec3> normals;
+    glm::vec3 axis(0.0f);
+    for (const unsigned int* tri = first; tri != last; tri += 3)
+    {
+        glm::vec3 a = position(tri[0]);
+        glm::vec3 normal = glm::cross(position(tri[1]) - a, position(tri[2]) - a);
+        float length = glm::length(normal);
+        if (length <= 0.0f)
+            continue;
+        normals.push_back(normal / length);
+        axis += normals.back();
+    }
+    float axisLength = glm::length(axis);
+    meshlet.coneAxis = axisLength > 0.0f ? axis / axisLength : glm::vec3(0.0f);
+    float minDot = axisLength > 0.0f ? 1.0f : -1.0f;
+    for (const glm::vec3& normal : normals)
+        minDot = std::min(minDot, glm::dot(normal, meshlet.coneAxis));
+    // past roughly 84 degrees the cone can no longer be back-facing as a whole
+    meshlet.coneCutoff = minDot <= 0.1f ? 1.0f : sqrtf(1.0f - minDot * minDot);
+}
+
+// reorders mesh.indices into meshlets and returns them. a meshlet grows from the
+// first unassigned triangle by the neighbour that adds the fewest new vertices,
+// preferring normals close to the meshlet's, so clusters stay compact and flat
+inline std::vector<Meshlet> buildMeshlets(MeshData& mesh, size_t maxVertices = 64, size_t maxTriangles = 124)
+{
+    std::vector<Meshlet> meshlets;
+    const std::vector<unsigned int>& indices = mesh.indices;
+    size_t vertexCount = mesh.getVertexCount();
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+        return meshlets;
+
+    auto position = [&](unsigned int v) {
+        const float* p = &mesh.vertices[(size_t)v * mesh.floatsPerVertex];
+        return glm::vec3(p[0], p[1], p[2]);
+    };
+    std::vector<glm::vec3> faceNormals(triangleCount);
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        glm::vec3 a = position(indices[t * 3]);
+        glm::vec3 normal = glm::cross(position(indices[t * 3 + 1]) - a, position(indices[t * 3 + 2]) - a);
+        float length = glm::length(normal);
+        faceNormals[t] = length > 0.0f ? normal / length : glm::vec3(0.0f);
+    }
+
+    // triangles around every vertex, compressed
+    std::vector<unsigned int> firstTriangle(vertexCount + 1, 0);
+    for (unsigned int index : indices)
+        firstTriangle[index + 1]++;
+    for (size_t v = 0; v < vertexCount; v++)
+        firstTriangle[v + 1] += firstTriangle[v];
+    std::vector<unsigned int> adjacency(indices.size());
+    std::vector<unsigned int> filled(firstTriangle.begin(), firstTriangle.end() - 1);
+    for (size_t t = 0; t < triangleCount; t++)
+        for (int k = 0; k < 3; k++)
+            adjacency[filled[indices[t * 3 + k]]++] = (unsigned int)t;
+
+    std::vector<char> assigned(triangleCount, 0);
+    std::vector<unsigned int> owner(vertexCount, ~0u);     // meshlet a vertex was last added to
+    std::vector<unsigned int> meshletVertices;
+    std::vector<unsigned int> result;
+    result.reserve(indices.size());
+    const size_t none = ~(size_t)0;
+    size_t scan = 0;
+
+    while (true)
+    {
+        while (scan < triangleCount && assigned[scan])
+            scan++;
+        if (scan == triangleCount)
+            break;
+
+        unsigned int id = (unsigned int)meshlets.size();
+        Meshlet meshlet;
+        meshlet.firstIndex = (unsigned int)result.size();
+        meshletVertices.clear();
+        glm::vec3 normalSum(0.0f);
+        size_t triangles = 0;
+
+        for (size_t tri = scan; tri != none; )
+        {
+            assigned[tri] = 1;
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned int v = indices[tri * 3 + k];
+                if (owner[v] != id)
+                {
+                    owner[v] = id;
+                    meshletVertices.push_back(v);
+                }
+                result.push_back(v);
+            }
+            normalSum += faceNormals[tri];
+            if (++triangles == maxTriangles)
+                break;
+
+            size_t best = none;
+            int bestNew = 4;
+            float bestDot = -2.0f;
+            float sumLength = glm::length(normalSum);
+            glm::vec3 meanNormal = sumLength > 0.0f ? normalSum / sumLength : glm::vec3(0.0f);
+            for (unsigned int v : meshletVertices)
+            {
+                for (unsigned int a = firstTriangle[v]; a < firstTriangle[v + 1]; a++)
+                {
+                    unsigned int t = adjacency[a];
+                    if (assigned[t])
+                        continue;
+                    int added = 0;
+                    for (int k = 0; k < 3; k++)
+                        added += owner[indices[t * 3 + k]] != id;
+                    if (meshletVertices.size() + added > maxVertices)
+                        continue;
+                    float agreement = glm::dot(faceNormals[t], meanNormal);
+                    if (added < bestNew || (added == bestNew && agreement > bestDot))
+                    {
+                        best = t;
+                        bestNew = added;
+                        bestDot = agreement;
+                    }
+                }
+            }
+            tri = best;
+        }
+
+        meshlet.indexCount = (unsigned int)(result.size() - meshlet.firstIndex);
+        meshlets.push_back(meshlet);
+    }
+
+    mesh.indices.swap(result);
+    for (Meshlet& meshlet : meshlets)
+        computeMeshletBounds(mesh.vertices.data(), mesh.floatsPerVertex, mesh.indices.data(), meshlet);
+    return meshlets;
+}
+
+// index ranges that survived culling, ready for glMultiDrawElements
+struct MeshletDrawList
+{
+    std::vector<GLsizei> counts;
+    std::vector<const void*> offsets;
+    size_t frustumCulled = 0;
+    size_t backfaceCulled = 0;
+};
+
+// the six frustum planes of clipFrom, straight from the matrix rows (Gribb and
+// Hartmann), normalised so that dot(plane.xyz, p) + plane.w is a distance; a point
+// is inside where all six are positive
+inline void frustumPlanes(const glm::mat4& clipFrom, glm::vec4 planes[6])
+{
+    for (int i = 0; i < 3; i++)
+    {
+        glm::vec4 row(clipFrom[0][i], clipFrom[1][i], clipFrom[2][i], clipFrom[3][i]);
+        glm::vec4 w(clipFrom[0][3], clipFrom[1][3], clipFrom[2][3], clipFrom[3][3]);
+        planes[i * 2] = w + row;
+        planes[i * 2 + 1] = w + row * -1.0f;
+    }
+    for (int i = 0; i < 6; i++)
+    {
+        float length = glm::length(glm::vec3(planes[i]));
+        if (length > 0.0f)
+            planes[i] = planes[i] * (1.0f / length);
+    }
+}
+
+// clipFromObject is projection * view * model and cameraInObject the camera position
+// in the mesh's own space; both tests run there, where scaling cannot distort them.
+// coneCulling is only valid for meshes whose back faces can never be seen, i.e.
+// closed ones. adjacent surviving meshlets merge into one range
+inline void cullMeshlets(const std::vector<Meshlet>& meshlets, const glm::mat4& clipFromObject, glm::vec3 cameraInObject,
+    bool coneCulling, int indexSize, MeshletDrawList& drawList)
+{
+    drawList.counts.clear();
+    drawList.offsets.clear();
+    drawList.frustumCulled = 0;
+    drawList.backfaceCulled = 0;
+
+    glm::vec4 planes[6];
+    frustumPlanes(clipFromObject, planes);
+
+    unsigned int rangeEnd = ~0u;
+    for (const Meshlet& meshlet : meshlets)
+    {
+        bool outside = false;
+        for (const glm::vec4& plane : planes)
+            if (glm::dot(glm::vec3(plane), meshlet.center) + plane.w < -meshlet.radius)
+            {
+                outside = true;
+                break;
+            }
+        if (outside)
+        {
+            drawList.frustumCulled++;
+            continue;
+        }
+
+        if (coneCulling)
+        {
+            glm::vec3 toMeshlet = meshlet.center - cameraInObject;
+            if (glm::dot(toMeshlet, meshlet.coneAxis) >= meshlet.coneCutoff * glm::length(toMeshlet) + meshlet.radius)
+            {
+                drawList.backfaceCulled++;
+                continue;
+            }
+        }
+
+        if (meshlet.firstIndex == rangeEnd)
+            drawList.counts.back() += meshlet.indexCount;
+        else
+        {
+            drawList.counts.push_back(meshlet.indexCount);
+            drawList.offsets.push_back((const void*)((size_t)meshlet.firstIndex * indexSize));
+        }
+        rangeEnd = meshlet.firstIndex + meshlet.indexCount;
+    }
+}
+
+// the caller's VAO must be bound
+inline void drawMeshlets(const MeshletDrawList& drawList, GLenum indexType)
+{
+    if (drawList.counts.empty())
+        return;
+    glMultiDrawElements(GL_TRIANGLES, drawList.counts.data(), indexType, drawList.offsets.data(), (GLsizei)drawList.counts.size());
+}
+
+#endif /* meshlet_h */
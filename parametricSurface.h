@@ -0,0 +1,126 @@
+#ifndef parametricSurface_h
+#define parametricSurface_h
+
+#include <vector>
+#include "meshData.h"
+
+// one grid engine for every shape made of (u, v) samples: the sphere's stacks and
+// sectors, the torus' rings, the roof's swept profile, the cylinder's side and caps,
+// the flag and the curtain.
+//
+// F is called as evaluate(row, column, vertex) and writes the floatsPerVertex floats
+// of one vertex. rows run along v and columns along u, both including the closing
+// seam, so rows x columns quads have (rows + 1) x (columns + 1) vertices. vertices
+// are written row by row straight into the caller's memory (a MeshData sized once,
+// or a mapped buffer), with no per-attribute staging vectors. shapes with
+// trigonometry keep it in tables the functor reads, so the inner loop is a few
+// multiplies per vertex that the compiler can inline and unroll
+template<class F>
+class ParametricSurface
+{
+public:
+    // a first or last row that collapses to a point, like a sphere's poles or the
+    // centre of a cap, gets one triangle per quad instead of two
+    bool collapsedFirstRow = false;
+    bool collapsedLastRow = false;
+
+    ParametricSurface(F evaluate, int rows, int columns, int floatsPerVertex = 8)
+        : evaluate(evaluate), rows(rows), columns(columns), floatsPerVertex(floatsPerVertex)
+    {
+    }
+
+    size_t getVertexCount() const
+    {
+        return (size_t)(rows + 1) * (columns + 1);
+    }
+
+    size_t getIndexCount() const
+    {
+        size_t triangles = (size_t)rows * columns * 2;
+        if (collapsedFirstRow)
+            triangles -= columns;
+        if (collapsedLastRow)
+            triangles -= columns;
+        return triangles * 3;
+    }
+
+    int getFloatsPerVertex() const
+    {
+        return floatsPerVertex;
+    }
+
+    // rows firstRow to lastRow (inclusive, -1 for the last one) into out, which
+    // receives only the vertices of those rows
+    void writeVertices(float* out, int firstRow = 0, int lastRow = -1) const
+    {
+        if (lastRow < 0)
+            lastRow = rows;
+        for (int i = firstRow; i <= lastRow; ++i)
+            for (int j = 0; j <= columns; ++j, out += floatsPerVertex)
+                evaluate(i, j, out);
+    }
+
+    // k1--k1+1
+    // |  / |
+    // | /  |
+    // k2--k2+1
+    void writeIndices(unsigned int* out, unsigned int baseVertex = 0) const
+    {
+        for (int i = 0; i < rows; ++i)
+        {
+            unsigned int k1 = baseVertex + (unsigned int)(i * (columns + 1));   // beginning of current row
+            unsigned int k2 = k1 + columns + 1;                                 // beginning of next row
+            bool upper = !(i == 0 && collapsedFirstRow);
+            bool lower = !(i == rows - 1 && collapsedLastRow);
+            for (int j = 0; j < columns; ++j, ++k1, ++k2)
+            {
+                if (upper)
+                {
+                    *out++ = k1;
+                    *out++ = k2;
+                    *out++ = k1 + 1;
+                }
+                if (lower)
+                {
+                    *out++ = k1 + 1;
+                    *out++ = k2;
+                    *out++ = k2 + 1;
+                }
+            }
+        }
+    }
+
+    // adds the grid to mesh, which must use the same vertex size; reserve the total
+    // up front when appending several grids
+    void appendTo(MeshData& mesh) const
+    {
+        size_t firstVertex = mesh.vertices.size() / floatsPerVertex;
+        size_t firstIndex = mesh.indices.size();
+        mesh.vertices.resize((firstVertex + getVertexCount()) * floatsPerVertex);
+        mesh.indices.resize(firstIndex + getIndexCount());
+        writeVertices(&mesh.vertices[firstVertex * floatsPerVertex]);
+        writeIndices(&mesh.indices[firstIndex], (unsigned int)firstVertex);
+    }
+
+    MeshData build() const
+    {
+        MeshData mesh;
+        mesh.floatsPerVertex = floatsPerVertex;
+        appendTo(mesh);
+        return mesh;
+    }
+
+private:
+    F evaluate;
+    int rows;
+    int columns;
+    int floatsPerVertex;
+};
+
+template<class F>
+ParametricSurface<F> makeParametricSurface(F evaluate, int rows, int columns, int floatsPerVertex = 8)
+{
+    return ParametricSurface<F>(evaluate, rows, columns, floatsPerVertex);
+}
+
+#endif /* parametricSurface_h */
@@ -0,0 +1,221 @@
+#ifndef primitives_h
+#define primitives_h
+
+#include <cstddef>
+#include "meshData.h"
+
+// primitive meshes generated at compile time. the generators below are constexpr,
+// so a mesh bound to a static constexpr variable is computed by the compiler and
+// sits in read-only data: startup only uploads it, with no trig and no copies.
+// the layout is the interleaved 8-float vertex (position, normal, uv) used by
+// MeshData and uploadVertexData()
+
+// <cmath> is not constexpr, so sine and cosine are a range reduction followed by a
+// Taylor series in double, accurate far beyond float precision
+constexpr double constexprPi = 3.14159265358979323846;
+
+constexpr double constexprSin(double x)
+{
+    while (x > constexprPi)
+        x -= 2.0 * constexprPi;
+    while (x < -constexprPi)
+        x += 2.0 * constexprPi;
+    double term = x;
+    double sum = x;
+    for (int n = 1; n < 12; n++)
+    {
+        term *= -x * x / ((2.0 * n) * (2.0 * n + 1.0));
+        sum += term;
+    }
+    return sum;
+}
+
+constexpr double constexprCos(double x)
+{
+    return constexprSin(x + constexprPi / 2.0);
+}
+
+template<size_t VertexCount, size_t IndexCount>
+struct StaticMesh
+{
+    static constexpr size_t vertexCount = VertexCount;
+    static constexpr size_t indexCount = IndexCount;
+
+    float vertices[VertexCount * 8];
+    unsigned int indices[IndexCount];
+
+    constexpr void setVertex(size_t v, double x, double y, double z, double nx, double ny, double nz, double s, double t)
+    {
+        float* p = vertices + v * 8;
+        p[0] = (float)x; p[1] = (float)y; p[2] = (float)z;
+        p[3] = (float)nx; p[4] = (float)ny; p[5] = (float)nz;
+        p[6] = (float)s; p[7] = (float)t;
+    }
+
+    // copy for the CPU passes (optimizeMesh, buildLodChain) that need to own the data
+    MeshData toMeshData() const
+    {
+        MeshData mesh;
+        mesh.vertices.assign(vertices, vertices + VertexCount * 8);
+        mesh.indices.assign(indices, indices + IndexCount);
+        return mesh;
+    }
+};
+
+template<size_t VertexCount, size_t IndexCount>
+constexpr size_t StaticMesh<VertexCount, IndexCount>::vertexCount;
+template<size_t VertexCount, size_t IndexCount>
+constexpr size_t StaticMesh<VertexCount, IndexCount>::indexCount;
+
+// axis-aligned cube from (low, low, low) to (high, high, high) with one quad per
+// face, outward normals and the full texture on every face
+constexpr StaticMesh<24, 36> makeCube(double low = -0.5, double high = 0.5)
+{
+    // per face: normal, then the directions in which u and v grow
+    const int faces[6][9] = {
+        {  0,  0, -1,    1, 0,  0,    0, 1,  0 },   // back
+        {  1,  0,  0,    0, 1,  0,    0, 0,  1 },   // right
+        {  0,  0,  1,    1, 0,  0,    0, 1,  0 },   // front
+        { -1,  0,  0,    0, 1,  0,    0, 0, -1 },   // left
+        {  0,  1,  0,    0, 0, -1,   -1, 0,  0 },   // top
+        {  0, -1,  0,    1, 0,  0,    0, 0,  1 }    // bottom
+    };
+    const int corners[4][2] = { { 0, 0 }, { 1, 0 }, { 1, 1 }, { 0, 1 } };
+
+    StaticMesh<24, 36> mesh{};
+    double center = (low + high) * 0.5;
+    double size = high - low;
+    for (int f = 0; f < 6; f++)
+    {
+        const int* n = faces[f];
+        const int* u = faces[f] + 3;
+        const int* v = faces[f] + 6;
+        for (int c = 0; c < 4; c++)
+        {
+            double s = corners[c][0];
+            double t = corners[c][1];
+            double p[3] = {};
+            for (int i = 0; i < 3; i++)
+                p[i] = center + size * (n[i] * 0.5 + (s - 0.5) * u[i] + (t - 0.5) * v[i]);
+            mesh.setVertex(f * 4 + c, p[0], p[1], p[2], n[0], n[1], n[2], s, t);
+        }
+
+        // wind counter-clockwise seen from outside
+        int facing = (u[1] * v[2] - u[2] * v[1]) * n[0] + (u[2] * v[0] - u[0] * v[2]) * n[1] + (u[0] * v[1] - u[1] * v[0]) * n[2];
+        const int forward[6] = { 0, 1, 2, 2, 3, 0 };
+        const int backward[6] = { 0, 3, 2, 2, 1, 0 };
+        for (int k = 0; k < 6; k++)
+            mesh.indices[f * 6 + k] = (unsigned int)(f * 4 + (facing > 0 ? forward[k] : backward[k]));
+    }
+    return mesh;
+}
+
+// unit-height cylinder of radius 0.5 around the y axis, the surface of
+// Cylinder::buildGeometry(): the two cap centres, then per rim position the top and
+// bottom cap vertices followed by the top and bottom side vertices
+template<int Sectors>
+constexpr StaticMesh<2 + 4 * (Sectors + 1), 12 * Sectors> makeCylinder()
+{
+    static_assert(Sectors >= 3, "a cylinder needs at least 3 sectors");
+    static_assert(2 + 4 * (Sectors + 1) <= 65536, "cylinder vertices must fit 16-bit indices");
+
+    StaticMesh<2 + 4 * (Sectors + 1), 12 * Sectors> mesh{};
+    const double radius = 0.5;
+    const double half = 0.5;
+    mesh.setVertex(0, 0.0, half, 0.0, 0.0, 1.0, 0.0, 0.5, 0.5);
+    mesh.setVertex(1, 0.0, -half, 0.0, 0.0, -1.0, 0.0, 0.5, 0.5);
+
+    for (int i = 0; i <= Sectors; i++)
+    {
+        double angle = 2.0 * constexprPi * i / Sectors;
+        double x = radius * constexprCos(angle);
+        double z = radius * constexprSin(angle);
+        double u = (double)i / Sectors;
+        size_t base = 2 + 4 * (size_t)i;
+        mesh.setVertex(base, x, half, z, 0.0, 1.0, 0.0, u, 1.0);
+        mesh.setVertex(base + 1, x, -half, z, 0.0, -1.0, 0.0, u, 0.0);
+        mesh.setVertex(base + 2, x, half, z, x, 0.0, z, u, 1.0);
+        mesh.setVertex(base + 3, x, -half, z, x, 0.0, z, u, 0.0);
+    }
+
+    const unsigned int pattern[12] = { 0, 0, 4, 1, 1, 5, 2, 3, 6, 3, 7, 6 };
+    for (int i = 0; i < Sectors; i++)
+    {
+        unsigned int base = 2 + 4 * (unsigned int)i;
+        for (int k = 0; k < 12; k++)
+        {
+            // the cap triangles start at their centre vertex
+            bool capCenter = k == 0 || k == 3;
+            mesh.indices[i * 12 + k] = capCenter ? pattern[k] : base + pattern[k];
+        }
+    }
+    return mesh;
+}
+
+// unit uv sphere with Stacks rings from the north pole down and Sectors + 1 vertices
+// per ring, the first and last of which share a position along the texture seam.
+// the pole rows contribute one triangle per sector, every other row two
+template<int Sectors, int Stacks>
+constexpr StaticMesh<(Sectors + 1) * (Stacks + 1), 6 * Sectors * (Stacks - 1)> makeUvSphere()
+{
+    static_assert(Sectors >= 3, "a sphere needs at least 3 sectors");
+    static_assert(Stacks >= 2, "a sphere needs at least 2 stacks");
+    static_assert((Sectors + 1) * (Stacks + 1) <= 65536, "sphere vertices must fit 16-bit indices");
+
+    StaticMesh<(Sectors + 1) * (Stacks + 1), 6 * Sectors * (Stacks - 1)> mesh{};
+
+    // one sine and cosine per sector and per stack rather than per vertex
+    double sectorSin[Sectors + 1] = {};
+    double sectorCos[Sectors + 1] = {};
+    for (int j = 0; j <= Sectors; j++)
+    {
+        double angle = 2.0 * constexprPi * j / Sectors;
+        sectorSin[j] = constexprSin(angle);
+        sectorCos[j] = constexprCos(angle);
+    }
+
+    for (int i = 0; i <= Stacks; i++)
+    {
+        double stackAngle = constexprPi / 2.0 - constexprPi * i / Stacks;
+        double xz = constexprCos(stackAngle);
+        double y = constexprSin(stackAngle);
+        for (int j = 0; j <= Sectors; j++)
+        {
+            double x = xz * sectorSin[j];
+            double z = xz * sectorCos[j];
+            mesh.setVertex((size_t)i * (Sectors + 1) + j, x, y, z, x, y, z, (double)j / Sectors, (double)i / Stacks);
+        }
+    }
+
+    size_t k = 0;
+    for (int i = 0; i < Stacks; i++)
+    {
+        unsigned int k1 = (unsigned int)(i * (Sectors + 1));
+        unsigned int k2 = k1 + Sectors + 1;
+        for (int j = 0; j < Sectors; j++, k1++, k2++)
+        {
+            if (i != 0)
+            {
+                mesh.indices[k++] = k1;
+                mesh.indices[k++] = k2;
+                mesh.indices[k++] = k1 + 1;
+            }
+            if (i != Stacks - 1)
+            {
+                mesh.indices[k++] = k1 + 1;
+                mesh.indices[k++] = k2;
+                mesh.indices[k++] = k2 + 1;
+            }
+        }
+    }
+    return mesh;
+}
+
+// the shared unit cube, centred on the origin; one copy in read-only data
+inline const StaticMesh<24, 36>& unitCubeMesh()
+{
+    static constexpr StaticMesh<24, 36> mesh = makeCube();
+    return mesh;
+}
+
+#endif /* primitives_h */
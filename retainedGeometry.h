@@ -0,0 +1,203 @@
+#ifndef retainedGeometry_h
+#define retainedGeometry_h
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <utility>
+#include "meshData.h"
+#include "memoryReport.h"
+
+// what a mesh keeps on the CPU once its buffers are uploaded. drawing needs only the
+// counts, so by default nothing is kept
+enum class MeshRetention {
+    Discard,    // nothing: the GPU copy is the only one
+    Compact,    // positions and indices, 16-bit where they fit, enough for picking and collision
+    Keep        // the vertices and indices exactly as built
+};
+
+// retention for meshes that do not ask for one; set it before building the scene
+inline MeshRetention& defaultMeshRetention()
+{
+    static MeshRetention retention = MeshRetention::Discard;
+    return retention;
+}
+
+// the CPU copy of one uploaded mesh under a retention policy, with the queries the
+// kept data is for. positions are in the mesh's own space, before any quantisation
+class RetainedGeometry
+{
+public:
+    // keeps what retention asks for of mesh, taking its storage. a LOD chain passes
+    // the index count of its finest level, as the coarser ones are of no use for picking
+    void retain(MeshData&& mesh, MeshRetention retention, size_t indexCount = ~(size_t)0)
+    {
+        clear();
+        this->retention = retention;
+        indexCount = std::min(indexCount, mesh.indices.size());
+        if (retention == MeshRetention::Keep)
+        {
+            if (indexCount < mesh.indices.size())
+            {
+                mesh.indices.resize(indexCount);
+                mesh.indices.shrink_to_fit();
+            }
+            full = std::move(mesh);
+        }
+        else if (retention == MeshRetention::Compact)
+            compact(mesh, indexCount);
+        updateCharge();
+    }
+
+    // same for a mesh the caller still owns; nothing is copied when nothing is kept
+    void retain(const MeshData& mesh, MeshRetention retention, size_t indexCount = ~(size_t)0)
+    {
+        clear();
+        this->retention = retention;
+        indexCount = std::min(indexCount, mesh.indices.size());
+        if (retention == MeshRetention::Keep)
+        {
+            full.floatsPerVertex = mesh.floatsPerVertex;
+            full.vertices = mesh.vertices;
+            full.indices.assign(mesh.indices.begin(), mesh.indices.begin() + indexCount);
+        }
+        else if (retention == MeshRetention::Compact)
+            compact(mesh, indexCount);
+        updateCharge();
+    }
+
+    // lowers the policy after the fact, e.g. once a mesh is known never to be picked.
+    // a copy that was discarded cannot be brought back, so raising it does nothing
+    void setRetention(MeshRetention retention)
+    {
+        if (retention >= this->retention)
+            return;
+        MeshData mesh;
+        std::swap(mesh, full);
+        clear();
+        if (retention == MeshRetention::Compact)
+            compact(mesh, mesh.indices.size());
+        this->retention = retention;
+        updateCharge();
+    }
+
+    MeshRetention getRetention() const
+    {
+        return retention;
+    }
+
+    // the mesh as built, only with MeshRetention::Keep
+    const MeshData* getMesh() const
+    {
+        return retention == MeshRetention::Keep ? &full : nullptr;
+    }
+
+    size_t getVertexCount() const
+    {
+        return retention == MeshRetention::Keep ? full.getVertexCount() : positions.size() / 3;
+    }
+
+    size_t getTriangleCount() const
+    {
+        if (retention == MeshRetention::Keep)
+            return full.indices.size() / 3;
+        return (shortIndices.size() + longIndices.size()) / 3;
+    }
+
+    glm::vec3 getPosition(size_t vertex) const
+    {
+        const float* p = retention == MeshRetention::Keep ? &full.vertices[vertex * full.floatsPerVertex] : &positions[vertex * 3];
+        return glm::vec3(p[0], p[1], p[2]);
+    }
+
+    unsigned int getIndex(size_t i) const
+    {
+        if (retention == MeshRetention::Keep)
+            return full.indices[i];
+        return shortIndices.empty() ? longIndices[i] : shortIndices[i];
+    }
+
+    // nearest hit of the ray origin + t * direction with either side of a triangle,
+    // t > 0 in units of direction. false when nothing is hit or nothing was kept
+    bool intersectRay(glm::vec3 origin, glm::vec3 direction, float& distance) const
+    {
+        bool hit = false;
+        size_t triangles = getTriangleCount();
+        for (size_t t = 0; t < triangles; t++)
+        {
+            // Moller-Trumbore
+            glm::vec3 a = getPosition(getIndex(t * 3));
+            glm::vec3 edge1 = getPosition(getIndex(t * 3 + 1)) - a;
+            glm::vec3 edge2 = getPosition(getIndex(t * 3 + 2)) - a;
+            glm::vec3 p = glm::cross(direction, edge2);
+            float determinant = glm::dot(edge1, p);
+            if (fabs(determinant) < 1e-12f)
+                continue;
+            float inverse = 1.0f / determinant;
+            glm::vec3 s = origin - a;
+            float u = glm::dot(s, p) * inverse;
+            if (u < 0.0f || u > 1.0f)
+                continue;
+            glm::vec3 q = glm::cross(s, edge1);
+            float v = glm::dot(direction, q) * inverse;
+            if (v < 0.0f || u + v > 1.0f)
+                continue;
+            float distanceHere = glm::dot(edge2, q) * inverse;
+            if (distanceHere > 0.0f && (!hit || distanceHere < distance))
+            {
+                distance = distanceHere;
+                hit = true;
+            }
+        }
+        return hit;
+    }
+
+    size_t getByteCount() const
+    {
+        return full.vertices.capacity() * sizeof(float) + full.indices.capacity() * sizeof(unsigned int) +
+            positions.capacity() * sizeof(float) + shortIndices.capacity() * sizeof(unsigned short) +
+            longIndices.capacity() * sizeof(unsigned int);
+    }
+
+private:
+    MeshRetention retention = MeshRetention::Discard;
+    MeshData full;                              // Keep
+    std::vector<float> positions;               // Compact: xyz per vertex
+    std::vector<unsigned short> shortIndices;   // Compact, up to 65536 vertices
+    std::vector<unsigned int> longIndices;      // Compact, beyond that
+    MemoryCharge charge;
+
+    void clear()
+    {
+        full = MeshData();
+        positions = std::vector<float>();
+        shortIndices = std::vector<unsigned short>();
+        longIndices = std::vector<unsigned int>();
+    }
+
+    void compact(const MeshData& mesh, size_t indexCount)
+    {
+        size_t vertexCount = mesh.getVertexCount();
+        positions.resize(vertexCount * 3);
+        for (size_t v = 0; v < vertexCount; v++)
+            for (int i = 0; i < 3; i++)
+                positions[v * 3 + i] = mesh.vertices[v * mesh.floatsPerVertex + i];
+        if (vertexCount <= 65536)
+        {
+            shortIndices.resize(indexCount);
+            for (size_t i = 0; i < indexCount; i++)
+                shortIndices[i] = (unsigned short)mesh.indices[i];
+        }
+        else
+            longIndices.assign(mesh.indices.begin(), mesh.indices.begin() + indexCount);
+    }
+
+    void updateCharge()
+    {
+        charge = MemoryCharge(MemoryCategory::Meshes, getByteCount(), 0);
+    }
+};
+
+#endif /* retainedGeometry_h */
@@ -0,0 +1,229 @@
+#ifndef roundedBox_h
+#define roundedBox_h
+
+#include <glad/glad.h>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include "shader.h"
+#include "meshData.h"
+#include "glResource.h"
+#include "textureFeedback.h"
+#include "vertexFormat.h"
+#include "meshOptimizer.h"
+#include "retainedGeometry.h"
+#include "parametricSurface.h"
+
+using namespace std;
+
+// box of the given size centred on the origin whose edges and corners are rounded
+// with radius bevelRadius. only the surface is generated: six face grids, each a flat
+// middle plus its half of the four rounded edges around it. every rounded edge is
+// split at 45 degrees between the two faces that meet there, and a corner is the
+// matching cube-sphere patch, so neighbouring faces share their border positions and
+// normals exactly. uvs run over each face including its bevels
+class RoundedBox {
+public:
+
+    // materialistic property
+    glm::vec3 ambient;
+    glm::vec3 diffuse;
+    glm::vec3 specular;
+
+    // texture property
+    float TXmin = 0.0f;
+    float TXmax = 1.0f;
+    float TYmin = 0.0f;
+    float TYmax = 1.0f;
+    unsigned int diffuseMap;
+    unsigned int specularMap;
+
+    // common property
+    float shininess;
+
+    // constructors
+    RoundedBox(glm::vec3 size = glm::vec3(1.0f), float bevelRadius = 0.1f, int segments = 4)
+    {
+        uploadRoundedBoxVertexData(buildGeometry(size, bevelRadius, segments));
+    }
+
+    RoundedBox(glm::vec3 amb, glm::vec3 diff, glm::vec3 spec, float shiny,
+        glm::vec3 size = glm::vec3(1.0f), float bevelRadius = 0.1f, int segments = 4)
+        : ambient(amb), diffuse(diff), specular(spec), shininess(shiny)
+    {
+        uploadRoundedBoxVertexData(buildGeometry(size, bevelRadius, segments));
+    }
+
+    // upload a mesh made by buildGeometry(), which may have run on a worker thread
+    RoundedBox(const MeshData& mesh, unsigned int dMap, unsigned int sMap, float shiny, float textureXmin, float textureYmin, float textureXmax, float textureYmax)
+    {
+        this->diffuseMap = dMap;
+        this->specularMap = sMap;
+        this->shininess = shiny;
+        this->TXmin = textureXmin;
+        this->TYmin = textureYmin;
+        this->TXmax = textureXmax;
+        this->TYmax = textureYmax;
+
+        uploadRoundedBoxVertexData(mesh);
+    }
+
+    // segments is the subdivision of each rounded edge's quarter circle; it is split
+    // between two faces, so odd counts are rounded up. without a bevel every face is
+    // one quad
+    static unsigned int getIndexCount(float bevelRadius, int segments)
+    {
+        unsigned int quads = 2 * bevelSteps(bevelRadius, segments) + 1;
+        return 6 * quads * quads * 6;
+    }
+
+    // CPU half of the constructors: no GL calls, safe on any thread
+    static MeshData buildGeometry(glm::vec3 size = glm::vec3(1.0f), float bevelRadius = 0.1f, int segments = 4)
+    {
+        glm::vec3 half = size * 0.5f;
+        float radius = std::max(0.0f, std::min(bevelRadius, std::min(half.x, std::min(half.y, half.z))));
+        int steps = bevelSteps(radius, segments);
+
+        // samples along one face axis, from the low border to the high one: the low
+        // bevel from 45 degrees in to flat, then the high bevel from flat out to 45
+        // degrees. each is the inner box offset and the tangent of the bevel angle
+        struct Sample { float offset, slope; };
+        auto axisSamples = [&](float innerHalf) {
+            std::vector<Sample> samples;
+            for (int k = 0; k <= steps; k++)
+                samples.push_back({ -innerHalf, steps > 0 ? -tanf(glm::pi<float>() * 0.25f * (steps - k) / steps) : 0.0f });
+            for (int k = 0; k <= steps; k++)
+                samples.push_back({ innerHalf, steps > 0 ? tanf(glm::pi<float>() * 0.25f * k / steps) : 0.0f });
+            return samples;
+        };
+
+        // per face the outward normal and the right and up directions it is viewed
+        // with; rows run down the face and columns to the right, which winds it
+        // counter-clockwise seen from outside
+        const glm::vec3 faces[6][3] = {
+            { glm::vec3( 1, 0, 0), glm::vec3( 0, 0, -1), glm::vec3(0, 1,  0) },
+            { glm::vec3(-1, 0, 0), glm::vec3( 0, 0,  1), glm::vec3(0, 1,  0) },
+            { glm::vec3( 0, 0, 1), glm::vec3( 1, 0,  0), glm::vec3(0, 1,  0) },
+            { glm::vec3( 0, 0,-1), glm::vec3(-1, 0,  0), glm::vec3(0, 1,  0) },
+            { glm::vec3( 0, 1, 0), glm::vec3( 1, 0,  0), glm::vec3(0, 0, -1) },
+            { glm::vec3( 0,-1, 0), glm::vec3( 1, 0,  0), glm::vec3(0, 0,  1) }
+        };
+
+        MeshData mesh;
+        int columns = 2 * steps + 1;
+        size_t faceVertices = (size_t)(columns + 1) * (columns + 1);
+        mesh.vertices.reserve(6 * faceVertices * 8);
+        mesh.indices.reserve(getIndexCount(radius, segments));
+
+        glm::vec3 inner = half - glm::vec3(radius);
+        for (const glm::vec3* face : faces)
+        {
+            glm::vec3 normal = face[0], right = face[1], up = face[2];
+            float normalHalf = fabs(glm::dot(inner, normal));
+            float rightHalf = fabs(glm::dot(half, right)), upHalf = fabs(glm::dot(half, up));
+            std::vector<Sample> across = axisSamples(fabs(glm::dot(inner, right)));
+            std::vector<Sample> down = axisSamples(fabs(glm::dot(inner, up)));
+            std::reverse(down.begin(), down.end());
+
+            auto grid = makeParametricSurface([&](int i, int j, float* v) {
+                glm::vec3 direction = glm::normalize(normal + right * across[j].slope + up * down[i].slope);
+                glm::vec3 position = normal * normalHalf + right * across[j].offset + up * down[i].offset + direction * radius;
+                v[0] = position.x;
+                v[1] = position.y;
+                v[2] = position.z;
+                v[3] = direction.x;
+                v[4] = direction.y;
+                v[5] = direction.z;
+                v[6] = (glm::dot(position, right) + rightHalf) / (2.0f * rightHalf);
+                v[7] = (glm::dot(position, up) + upHalf) / (2.0f * upHalf);
+            }, columns, columns);
+            grid.appendTo(mesh);
+        }
+
+        optimizeMesh(mesh, "rounded box");
+        return mesh;
+    }
+
+    // the CPU copy kept under the retention policy, for picking and collision
+    const RetainedGeometry& getRetainedGeometry() const
+    {
+        return retained;
+    }
+
+    void setRetention(MeshRetention retention)
+    {
+        retained.setRetention(retention);
+    }
+
+    void drawRoundedBoxWithTexture(Shader& lightingShaderWithTexture, glm::mat4 model = glm::mat4(1.0f))
+    {
+        lightingShaderWithTexture.use();
+
+        lightingShaderWithTexture.setInt("material.diffuse", 0);
+        lightingShaderWithTexture.setInt("material.specular", 1);
+        lightingShaderWithTexture.setFloat("material.shininess", this->shininess);
+
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, this->diffuseMap);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, this->specularMap);
+
+        lightingShaderWithTexture.setMat4("model", model * layout.dequantize());
+
+        glBindVertexArray(roundedBoxVAO.get());
+        glDrawElements(GL_TRIANGLES, indexCount, layout.indexType, 0);
+        glBindVertexArray(0);
+        textureFeedbackLog().record(diffuseMap, roundedBoxVAO.get(), indexCount, layout.indexType, model * layout.dequantize());
+    }
+
+    void drawRoundedBoxWithMaterialisticProperty(Shader& lightingShader, glm::mat4 model = glm::mat4(1.0f))
+    {
+        lightingShader.use();
+
+        lightingShader.setVec3("material.ambient", this->ambient);
+        lightingShader.setVec3("material.diffuse", this->diffuse);
+        lightingShader.setVec3("material.specular", this->specular);
+        lightingShader.setFloat("material.shininess", this->shininess);
+
+        lightingShader.setMat4("model", model * layout.dequantize());
+
+        glBindVertexArray(roundedBoxVAO.get());
+        glDrawElements(GL_TRIANGLES, indexCount, layout.indexType, 0);
+        glBindVertexArray(0);
+    }
+
+private:
+    GlVertexArray roundedBoxVAO;
+    GlBuffer roundedBoxVBO, roundedBoxEBO;
+    GLsizei indexCount = 0;
+    VertexLayout layout;
+    RetainedGeometry retained;
+
+    // grid steps each face gives to one rounded edge
+    static int bevelSteps(float bevelRadius, int segments)
+    {
+        return bevelRadius > 0.0f ? (std::max(segments, 1) + 1) / 2 : 0;
+    }
+
+    void uploadRoundedBoxVertexData(const MeshData& mesh)
+    {
+        indexCount = (GLsizei)mesh.indices.size();
+
+        roundedBoxVAO = GlVertexArray::create();
+        glBindVertexArray(roundedBoxVAO.get());
+
+        layout = uploadVertexData(mesh.vertices, mesh.indices, roundedBoxVBO, roundedBoxEBO);
+
+        // position, vertex normal and texture coordinate attributes
+        setVertexAttributes(layout, 3);
+
+        glBindVertexArray(0);
+
+        retained.retain(mesh, defaultMeshRetention());
+    }
+};
+
+#endif /* roundedBox_h */
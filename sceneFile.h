@@ -0,0 +1,732 @@
+#ifndef sceneFile_h
+#define sceneFile_h
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <utility>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <type_traits>
+#include "mappedFile.h"
+#include "textureCache.h"
+
+// the venue's layout as data: which meshes stand where, in which material, the point
+// lights, and the objects that move. it is written as text (auditorium.scene) and
+// compiled into a binary file next to it (auditorium.scene.bin) the first time it is
+// loaded, stamped with the text's size and modification time as the texture caches
+// are; a binary whose text is gone is used as it is, so a venue can ship as either.
+//
+// the text is one statement per line, # starts a comment:
+//   material <name> colour <r g b> shininess <s>
+//   material <name> texture <path> shininess <s>
+//   group <name> [in <group>] <transform>
+//   object <mesh> <material or -> [in <group>] <transform>
+//   light <slot> position <x y z> ambient <r g b> diffuse <r g b> specular <r g b> attenuation <c l q>
+//
+// meshes are named by the program, which decides how each is drawn; an object of a
+// mesh that draws in its own material takes - instead of one. the transform is a
+// list of translate <x y z>, scale <x y z> and rotate <degrees> <axis x y z>,
+// multiplied in the order written as the code would (translate ... scale). a group
+// places everything in it: their transforms are relative to it, and it may itself
+// be in a group declared before it. one rotate of a group or object may give a
+// channel instead of an angle, @name or @name+degrees; it then turns with the
+// channel's value, set by the program every frame, and carries what is in it along.
+// light slots are the shaders' pointLights[] entries counted from 1.
+//
+// groups and objects are both nodes of one hierarchy, kept as flat arrays per
+// property in depth-first order, so each node's descendants are the nodes right
+// after it. a node whose transform changes is marked dirty, and update() recomputes
+// the world matrices of the dirty nodes' ranges only, parents before children, in
+// one pass along the arrays; a turning fan recomputes its blades and none of the
+// seats. the binary holds the arrays as they are, world matrices included, so a
+// current one is loaded with a single mapping and one memcpy per array
+
+const uint32_t sceneFormatVersion = 3;
+const char sceneFileIdentifier[8] = { 'A', 'U', 'D', 'S', 'C', 'E', 'N', 'E' };
+
+// objectMaterial of an object drawn in its mesh's own material
+const uint32_t sceneNoMaterial = 0xffffffff;
+
+// nodeParent of a node that is in no group
+const uint32_t sceneNoParent = 0xffffffff;
+
+// nodeObject of a group
+const uint32_t sceneNoObject = 0xffffffff;
+
+// objectBoundsExtent of an object the program gives no bounds, which is never culled
+const float sceneUnbounded = 1e30f;
+
+struct SceneMaterial
+{
+    std::string name;
+    std::string texture;                // empty for a plain colour
+    glm::vec3 colour = glm::vec3(1.0f);
+    float shininess = 32.0f;
+};
+
+// a node that turns about axis by its channel's value plus phase, in degrees
+struct SceneAnimation
+{
+    uint32_t node;
+    uint32_t channel;
+    float phase;
+    glm::vec3 axis;
+    glm::mat4 pre;                      // local = pre * rotation * post
+    glm::mat4 post;
+};
+
+struct Scene
+{
+    std::vector<std::string> meshes;
+    std::vector<SceneMaterial> materials;
+    std::vector<std::string> channels;
+    std::vector<float> channelValues;
+
+    // nodes, the same index into each, every parent before its children
+    std::vector<uint32_t> nodeParent;
+    std::vector<uint32_t> nodeSubtreeEnd;       // one past the node's last descendant
+    std::vector<uint32_t> nodeObject;
+    std::vector<glm::mat4> nodeLocal;           // relative to the parent
+    std::vector<glm::mat4> nodeWorld;
+
+    // node ranges whose world matrices changed since the systems that follow them
+    // (see sceneSystems.h) last ran; everything, after loading
+    std::vector<std::pair<uint32_t, uint32_t>> movedNodes;
+
+    // objects, the same index into each, in the order they were written
+    std::vector<uint32_t> objectMesh;
+    std::vector<uint32_t> objectMaterial;
+    std::vector<uint32_t> objectNode;
+
+    // object space box of each object, centre and half size, set by the program that
+    // knows the meshes; not part of the files
+    std::vector<glm::vec3> objectBoundsCenter;
+    std::vector<glm::vec3> objectBoundsExtent;
+
+    // world space boxes around the objects' boxes, one array per coordinate so that
+    // culling runs down them in vector registers
+    std::vector<float> worldBoundsCenter[3];
+    std::vector<float> worldBoundsExtent[3];
+
+    std::vector<SceneAnimation> animations;
+
+    // point lights, the same index into each
+    std::vector<uint32_t> lightSlot;
+    std::vector<glm::vec3> lightPosition;
+    std::vector<glm::vec3> lightAmbient;
+    std::vector<glm::vec3> lightDiffuse;
+    std::vector<glm::vec3> lightSpecular;
+    std::vector<glm::vec3> lightAttenuation;    // constant, linear, quadratic
+
+    size_t getNodeCount() const
+    {
+        return nodeParent.size();
+    }
+
+    size_t getObjectCount() const
+    {
+        return objectMesh.size();
+    }
+
+    size_t getLightCount() const
+    {
+        return lightSlot.size();
+    }
+
+    const glm::mat4& getObjectWorld(size_t object) const
+    {
+        return nodeWorld[objectNode[object]];
+    }
+
+    // 0xffffffff if the scene has no mesh or channel of that name
+    uint32_t findMesh(const std::string& name) const
+    {
+        return find(meshes, name);
+    }
+
+    uint32_t findChannel(const std::string& name) const
+    {
+        return find(channels, name);
+    }
+
+    // a channel the scene does not use is ignored
+    void setChannel(const std::string& name, float value)
+    {
+        uint32_t channel = findChannel(name);
+        if (channel < channelValues.size() && channelValues[channel] != value)
+        {
+            channelValues[channel] = value;
+            channelChanged[channel] = true;
+        }
+    }
+
+    // object space box of object, centre and half size
+    void setObjectBounds(uint32_t object, const glm::vec3& center, const glm::vec3& extent)
+    {
+        objectBoundsCenter[object] = center;
+        objectBoundsExtent[object] = extent;
+        movedNodes.push_back(std::make_pair(objectNode[object], objectNode[object] + 1));
+    }
+
+    // moves node and everything in it at the next update()
+    void setLocal(uint32_t node, const glm::mat4& local)
+    {
+        nodeLocal[node] = local;
+        if (!nodeDirty[node])
+        {
+            nodeDirty[node] = true;
+            dirtyNodes.push_back(node);
+        }
+    }
+
+    // the animated nodes whose channels changed since the last call, then update()
+    size_t animate()
+    {
+        for (const SceneAnimation& animation : animations)
+        {
+            if (!channelChanged[animation.channel])
+                continue;
+            float angle = channelValues[animation.channel] + animation.phase;
+            setLocal(animation.node, animation.pre * glm::rotate(glm::mat4(1.0f), glm::radians(angle), animation.axis) * animation.post);
+        }
+        std::fill(channelChanged.begin(), channelChanged.end(), false);
+        return update();
+    }
+
+    // the world matrices of the dirty nodes and their descendants; returns how many
+    // were recomputed
+    size_t update()
+    {
+        if (dirtyNodes.empty())
+            return 0;
+        std::sort(dirtyNodes.begin(), dirtyNodes.end());
+        size_t updated = 0;
+        uint32_t done = 0;      // end of the last range recomputed
+        for (uint32_t node : dirtyNodes)
+        {
+            nodeDirty[node] = false;
+            if (node < done)
+                continue;       // in a dirty ancestor's range
+            done = nodeSubtreeEnd[node];
+            for (uint32_t i = node; i < done; i++)
+                nodeWorld[i] = nodeParent[i] == sceneNoParent ? nodeLocal[i] : nodeWorld[nodeParent[i]] * nodeLocal[i];
+            updated += done - node;
+            movedNodes.push_back(std::make_pair(node, done));
+        }
+        dirtyNodes.clear();
+        return updated;
+    }
+
+    // nodeSubtreeEnd and nodeObject from nodeParent and objectNode, the flags update()
+    // keeps and unbounded objects, with every world matrix computed if computeWorld. false unless every node's parent comes before
+    // it with only the parent's other descendants in between
+    bool link(bool computeWorld)
+    {
+        size_t count = getNodeCount();
+        nodeSubtreeEnd.assign(count, 0);
+        std::vector<uint32_t> ancestors;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            while (!ancestors.empty() && ancestors.back() != nodeParent[i])
+            {
+                nodeSubtreeEnd[ancestors.back()] = i;
+                ancestors.pop_back();
+            }
+            if (ancestors.empty() && nodeParent[i] != sceneNoParent)
+                return false;
+            ancestors.push_back(i);
+        }
+        for (uint32_t node : ancestors)
+            nodeSubtreeEnd[node] = (uint32_t)count;
+
+        nodeObject.assign(count, sceneNoObject);
+        for (size_t i = 0; i < objectNode.size(); i++)
+            if (objectNode[i] < count)
+                nodeObject[objectNode[i]] = (uint32_t)i;
+        objectBoundsCenter.assign(getObjectCount(), glm::vec3(0.0f));
+        objectBoundsExtent.assign(getObjectCount(), glm::vec3(sceneUnbounded));
+        for (int axis = 0; axis < 3; axis++)
+        {
+            worldBoundsCenter[axis].assign(getObjectCount(), 0.0f);
+            worldBoundsExtent[axis].assign(getObjectCount(), sceneUnbounded);
+        }
+        movedNodes.assign(1, std::make_pair(0u, (uint32_t)count));
+
+        nodeWorld.resize(count);
+        nodeDirty.assign(count, false);
+        dirtyNodes.clear();
+        channelValues.assign(channels.size(), 0.0f);
+        channelChanged.assign(channels.size(), false);
+        if (computeWorld)
+            for (uint32_t i = 0; i < count; i++)
+                nodeWorld[i] = nodeParent[i] == sceneNoParent ? nodeLocal[i] : nodeWorld[nodeParent[i]] * nodeLocal[i];
+        return true;
+    }
+
+private:
+    std::vector<bool> nodeDirty;
+    std::vector<uint32_t> dirtyNodes;
+    std::vector<bool> channelChanged;
+
+    static uint32_t find(const std::vector<std::string>& names, const std::string& name)
+    {
+        auto found = std::find(names.begin(), names.end(), name);
+        return found == names.end() ? 0xffffffff : (uint32_t)(found - names.begin());
+    }
+};
+
+// parses the text form; a statement it cannot read is reported with its line and
+// skipped. false if the file cannot be opened
+inline bool parseSceneText(const std::string& path, Scene& scene)
+{
+    std::ifstream in(path);
+    if (!in)
+        return false;
+    scene = Scene();
+
+    // nodes are collected in the order written, and put in depth-first order after
+    std::vector<std::string> groups;
+    std::vector<uint32_t> groupNode;
+
+    std::string line;
+    for (int lineNumber = 1; std::getline(in, line); lineNumber++)
+    {
+        line = line.substr(0, line.find('#'));
+        std::istringstream tokens(line);
+        std::string statement;
+        if (!(tokens >> statement))
+            continue;
+
+        std::string error;
+        auto number = [&tokens, &error](float& value) {
+            std::string token;
+            char* end = nullptr;
+            if (tokens >> token)
+                value = strtof(token.c_str(), &end);
+            if (!end || *end != '\0')
+                error = "expected a number";
+            return error.empty();
+        };
+        auto vector = [&number](glm::vec3& value) {
+            return number(value.x) && number(value.y) && number(value.z);
+        };
+        // the keyword, then the vector that follows it
+        auto field = [&tokens, &vector, &error](const char* keyword, glm::vec3& value) {
+            std::string token;
+            if (!(tokens >> token) || token != keyword)
+                error = std::string("expected ") + keyword;
+            return error.empty() && vector(value);
+        };
+        // the rest of a group or object statement, added as a node; sceneNoParent on errors
+        auto node = [&]() {
+            uint32_t parent = sceneNoParent;
+            glm::mat4 transform(1.0f);
+            SceneAnimation animation = {};
+            bool animated = false;
+            std::string operation;
+            for (bool first = true; error.empty() && tokens >> operation; first = false)
+            {
+                glm::vec3 value;
+                if (operation == "in" && first)
+                {
+                    std::string group;
+                    tokens >> group;
+                    auto found = std::find(groups.begin(), groups.end(), group);
+                    if (found == groups.end())
+                        error = "unknown group " + group;
+                    else
+                        parent = groupNode[found - groups.begin()];
+                }
+                else if (operation == "translate" && vector(value))
+                    transform = transform * glm::translate(glm::mat4(1.0f), value);
+                else if (operation == "scale" && vector(value))
+                    transform = transform * glm::scale(glm::mat4(1.0f), value);
+                else if (operation == "rotate")
+                {
+                    std::string angle;
+                    tokens >> angle;
+                    if (angle.size() > 1 && angle[0] == '@' && !animated)
+                    {
+                        // the rotation splits the transform into the parts either side of it
+                        size_t sign = angle.find_first_of("+-", 1);
+                        std::string channel = angle.substr(1, sign == std::string::npos ? std::string::npos : sign - 1);
+                        char* end = nullptr;
+                        animation.phase = sign == std::string::npos ? 0.0f : strtof(angle.c_str() + sign, &end);
+                        if (channel.empty() || (end && *end != '\0'))
+                            error = "bad channel " + angle;
+                        else if (vector(animation.axis))
+                        {
+                            animation.channel = scene.findChannel(channel);
+                            if (animation.channel >= scene.channels.size())
+                            {
+                                animation.channel = (uint32_t)scene.channels.size();
+                                scene.channels.push_back(channel);
+                            }
+                            animation.pre = transform;
+                            transform = glm::mat4(1.0f);
+                            animated = true;
+                        }
+                    }
+                    else
+                    {
+                        char* end = nullptr;
+                        float degrees = strtof(angle.c_str(), &end);
+                        if (angle.empty() || *end != '\0')
+                            error = "expected an angle or one channel";
+                        else if (vector(value))
+                            transform = transform * glm::rotate(glm::mat4(1.0f), glm::radians(degrees), value);
+                    }
+                }
+                else if (error.empty())
+                    error = "unknown transform " + operation;
+            }
+            if (!error.empty())
+                return sceneNoParent;
+
+            uint32_t index = (uint32_t)scene.getNodeCount();
+            if (animated)
+            {
+                animation.node = index;
+                animation.post = transform;
+                transform = animation.pre * glm::rotate(glm::mat4(1.0f), glm::radians(animation.phase), animation.axis) * animation.post;
+                scene.animations.push_back(animation);
+            }
+            scene.nodeParent.push_back(parent);
+            scene.nodeLocal.push_back(transform);
+            return index;
+        };
+
+        if (statement == "material")
+        {
+            SceneMaterial material;
+            std::string kind, keyword;
+            tokens >> material.name >> kind;
+            if (kind == "colour")
+                vector(material.colour);
+            else if (kind == "texture")
+            {
+                if (!(tokens >> material.texture))
+                    error = "expected a texture path";
+            }
+            else
+                error = "expected colour or texture";
+            if (error.empty() && (!(tokens >> keyword) || keyword != "shininess"))
+                error = "expected shininess";
+            if (error.empty() && number(material.shininess))
+                scene.materials.push_back(material);
+        }
+        else if (statement == "group")
+        {
+            std::string name;
+            tokens >> name;
+            if (name.empty() || std::find(groups.begin(), groups.end(), name) != groups.end())
+                error = name.empty() ? "expected a name" : "group " + name + " declared twice";
+            uint32_t index = error.empty() ? node() : sceneNoParent;
+            if (index != sceneNoParent)
+            {
+                groups.push_back(name);
+                groupNode.push_back(index);
+            }
+        }
+        else if (statement == "object")
+        {
+            std::string mesh, material;
+            tokens >> mesh >> material;
+            uint32_t materialIndex = sceneNoMaterial;
+            if (mesh.empty())
+                error = "expected a mesh";
+            else if (material != "-")
+            {
+                materialIndex = (uint32_t)scene.materials.size();
+                for (size_t m = 0; m < scene.materials.size(); m++)
+                    if (scene.materials[m].name == material)
+                        materialIndex = (uint32_t)m;
+                if (materialIndex == scene.materials.size())
+                    error = "unknown material " + material;
+            }
+            uint32_t index = error.empty() ? node() : sceneNoParent;
+            if (index != sceneNoParent)
+            {
+                uint32_t meshIndex = scene.findMesh(mesh);
+                if (meshIndex >= scene.meshes.size())
+                {
+                    meshIndex = (uint32_t)scene.meshes.size();
+                    scene.meshes.push_back(mesh);
+                }
+                scene.objectMesh.push_back(meshIndex);
+                scene.objectMaterial.push_back(materialIndex);
+                scene.objectNode.push_back(index);
+            }
+        }
+        else if (statement == "light")
+        {
+            float slot = 0.0f;
+            glm::vec3 position, ambient, diffuse, specular, attenuation;
+            if (number(slot) && field("position", position) && field("ambient", ambient) && field("diffuse", diffuse) &&
+                field("specular", specular) && field("attenuation", attenuation))
+            {
+                scene.lightSlot.push_back((uint32_t)std::max(slot, 1.0f));
+                scene.lightPosition.push_back(position);
+                scene.lightAmbient.push_back(ambient);
+                scene.lightDiffuse.push_back(diffuse);
+                scene.lightSpecular.push_back(specular);
+                scene.lightAttenuation.push_back(attenuation);
+            }
+        }
+        else
+            error = "unknown statement " + statement;
+
+        if (!error.empty())
+            std::cout << path << ":" << lineNumber << ": " << error << ", line skipped" << std::endl;
+    }
+
+    // depth-first order, children in the order written. parents are always written
+    // before their children, so walking the nodes backwards and pushing each onto its
+    // parent's list leaves every list reversed, ready to pop from the back
+    size_t count = scene.getNodeCount();
+    std::vector<std::vector<uint32_t>> children(count);
+    std::vector<uint32_t> pending;
+    for (size_t i = count; i-- > 0;)
+        (scene.nodeParent[i] == sceneNoParent ? pending : children[scene.nodeParent[i]]).push_back((uint32_t)i);
+    std::vector<uint32_t> order, position(count);
+    while (!pending.empty())
+    {
+        uint32_t next = pending.back();
+        pending.pop_back();
+        position[next] = (uint32_t)order.size();
+        order.push_back(next);
+        pending.insert(pending.end(), children[next].begin(), children[next].end());
+    }
+    std::vector<uint32_t> parents(count);
+    std::vector<glm::mat4> locals(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        uint32_t parent = scene.nodeParent[order[i]];
+        parents[i] = parent == sceneNoParent ? sceneNoParent : position[parent];
+        locals[i] = scene.nodeLocal[order[i]];
+    }
+    scene.nodeParent.swap(parents);
+    scene.nodeLocal.swap(locals);
+    for (uint32_t& node : scene.objectNode)
+        node = position[node];
+    for (SceneAnimation& animation : scene.animations)
+        animation.node = position[animation.node];
+    scene.link(true);
+    return true;
+}
+
+struct SceneFileHeader
+{
+    char identifier[8];
+    uint32_t version;                   // sceneFormatVersion
+    uint32_t meshCount;
+    uint32_t materialCount;
+    uint32_t channelCount;
+    uint32_t nodeCount;
+    uint32_t objectCount;
+    uint32_t animationCount;
+    uint32_t lightCount;
+    uint32_t stringBytes;
+    char source[64];                    // stamp of the text it was compiled from
+};
+
+struct SceneMaterialRecord
+{
+    float colour[3];
+    float shininess;
+    uint32_t name;                      // offsets into the strings
+    uint32_t texture;
+};
+
+// layout of the binary, every array 16-byte aligned:
+//   SceneFileHeader
+//   uint32 meshNames[meshCount], channelNames[channelCount]
+//   SceneMaterialRecord materials[materialCount]
+//   uint32 nodeParent[nodeCount], mat4 nodeLocal[nodeCount], nodeWorld[nodeCount]
+//   uint32 objectMesh[objectCount], objectMaterial[objectCount], objectNode[objectCount]
+//   SceneAnimation animations[animationCount]
+//   uint32 lightSlot[lightCount], vec3 lightPosition[lightCount] and the other light arrays
+//   char strings[stringBytes], each name NUL-terminated
+inline std::vector<unsigned char> writeSceneBinary(const Scene& scene, const std::string& stamp)
+{
+    std::string strings;
+    auto addString = [&strings](const std::string& text) {
+        uint32_t offset = (uint32_t)strings.size();
+        strings.append(text.c_str(), text.size() + 1);
+        return offset;
+    };
+    std::vector<uint32_t> meshNames, channelNames;
+    for (const std::string& mesh : scene.meshes)
+        meshNames.push_back(addString(mesh));
+    for (const std::string& channel : scene.channels)
+        channelNames.push_back(addString(channel));
+    std::vector<SceneMaterialRecord> materials;
+    for (const SceneMaterial& material : scene.materials)
+        materials.push_back({ { material.colour.x, material.colour.y, material.colour.z }, material.shininess,
+            addString(material.name), addString(material.texture) });
+
+    SceneFileHeader header = {};
+    memcpy(header.identifier, sceneFileIdentifier, sizeof(header.identifier));
+    header.version = sceneFormatVersion;
+    header.meshCount = (uint32_t)scene.meshes.size();
+    header.materialCount = (uint32_t)scene.materials.size();
+    header.channelCount = (uint32_t)scene.channels.size();
+    header.nodeCount = (uint32_t)scene.getNodeCount();
+    header.objectCount = (uint32_t)scene.getObjectCount();
+    header.animationCount = (uint32_t)scene.animations.size();
+    header.lightCount = (uint32_t)scene.getLightCount();
+    header.stringBytes = (uint32_t)strings.size();
+    strncpy(header.source, stamp.c_str(), sizeof(header.source) - 1);
+
+    std::vector<unsigned char> out;
+    auto append = [&out](const void* data, size_t bytes) {
+        out.insert(out.end(), (const unsigned char*)data, (const unsigned char*)data + bytes);
+        out.resize((out.size() + 15) & ~(size_t)15);
+    };
+    append(&header, sizeof(header));
+    append(meshNames.data(), meshNames.size() * sizeof(uint32_t));
+    append(channelNames.data(), channelNames.size() * sizeof(uint32_t));
+    append(materials.data(), materials.size() * sizeof(SceneMaterialRecord));
+    append(scene.nodeParent.data(), scene.nodeParent.size() * sizeof(uint32_t));
+    append(scene.nodeLocal.data(), scene.nodeLocal.size() * sizeof(glm::mat4));
+    append(scene.nodeWorld.data(), scene.nodeWorld.size() * sizeof(glm::mat4));
+    append(scene.objectMesh.data(), scene.objectMesh.size() * sizeof(uint32_t));
+    append(scene.objectMaterial.data(), scene.objectMaterial.size() * sizeof(uint32_t));
+    append(scene.objectNode.data(), scene.objectNode.size() * sizeof(uint32_t));
+    append(scene.animations.data(), scene.animations.size() * sizeof(SceneAnimation));
+    append(scene.lightSlot.data(), scene.lightSlot.size() * sizeof(uint32_t));
+    for (const std::vector<glm::vec3>* lights : { &scene.lightPosition, &scene.lightAmbient, &scene.lightDiffuse, &scene.lightSpecular, &scene.lightAttenuation })
+        append(lights->data(), lights->size() * sizeof(glm::vec3));
+    append(strings.data(), strings.size());
+    return out;
+}
+
+// reads a binary written for stamp, or for any stamp if it is empty. false if the
+// data is not a whole, consistent scene of this version
+inline bool readSceneBinary(const unsigned char* data, size_t size, const std::string& stamp, Scene& scene)
+{
+    SceneFileHeader header;
+    if (size < sizeof(header))
+        return false;
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.identifier, sceneFileIdentifier, sizeof(header.identifier)) != 0 || header.version != sceneFormatVersion)
+        return false;
+    if (!stamp.empty() && strncmp(header.source, stamp.c_str(), sizeof(header.source)) != 0)
+        return false;
+
+    scene = Scene();
+    size_t offset = (sizeof(header) + 15) & ~(size_t)15;
+    bool complete = true;
+    auto read = [&](auto& array, size_t count) {
+        typedef typename std::remove_reference<decltype(array)>::type::value_type Value;
+        if (!complete || count > (size - std::min(offset, size)) / sizeof(Value))
+        {
+            complete = false;
+            return;
+        }
+        array.resize(count);
+        if (count > 0)
+            memcpy(array.data(), data + offset, count * sizeof(Value));
+        offset = (offset + count * sizeof(Value) + 15) & ~(size_t)15;
+    };
+    std::vector<uint32_t> meshNames, channelNames;
+    std::vector<SceneMaterialRecord> materials;
+    std::vector<char> strings;
+    read(meshNames, header.meshCount);
+    read(channelNames, header.channelCount);
+    read(materials, header.materialCount);
+    read(scene.nodeParent, header.nodeCount);
+    read(scene.nodeLocal, header.nodeCount);
+    read(scene.nodeWorld, header.nodeCount);
+    read(scene.objectMesh, header.objectCount);
+    read(scene.objectMaterial, header.objectCount);
+    read(scene.objectNode, header.objectCount);
+    read(scene.animations, header.animationCount);
+    read(scene.lightSlot, header.lightCount);
+    for (std::vector<glm::vec3>* lights : { &scene.lightPosition, &scene.lightAmbient, &scene.lightDiffuse, &scene.lightSpecular, &scene.lightAttenuation })
+        read(*lights, header.lightCount);
+    read(strings, header.stringBytes);
+    if (!complete || (!strings.empty() && strings.back() != '\0'))
+        return false;
+
+    auto text = [&strings, &complete](uint32_t offset) {
+        if (offset >= strings.size())
+        {
+            complete = false;
+            return std::string();
+        }
+        return std::string(strings.data() + offset);
+    };
+    for (uint32_t name : meshNames)
+        scene.meshes.push_back(text(name));
+    for (uint32_t name : channelNames)
+        scene.channels.push_back(text(name));
+    for (const SceneMaterialRecord& record : materials)
+    {
+        SceneMaterial material;
+        material.name = text(record.name);
+        material.texture = text(record.texture);
+        material.colour = glm::vec3(record.colour[0], record.colour[1], record.colour[2]);
+        material.shininess = record.shininess;
+        scene.materials.push_back(material);
+    }
+
+    // every index has to point inside its array, and the nodes be in depth-first order
+    for (size_t i = 0; i < scene.getObjectCount(); i++)
+        if (scene.objectMesh[i] >= header.meshCount || scene.objectNode[i] >= header.nodeCount ||
+            (scene.objectMaterial[i] >= header.materialCount && scene.objectMaterial[i] != sceneNoMaterial))
+            complete = false;
+    for (const SceneAnimation& animation : scene.animations)
+        if (animation.node >= header.nodeCount || animation.channel >= header.channelCount)
+            complete = false;
+    return scene.link(false) && complete;
+}
+
+// the scene at path, from its binary when that is current and otherwise parsed from
+// the text and compiled again. false if neither can be read
+inline bool loadScene(const std::string& path, Scene& scene)
+{
+    std::string binaryPath = path + ".bin";
+    std::string stamp = textureSourceStamp(path);
+    auto report = [&scene](const std::string& from) {
+        std::cout << "scene: " << scene.getObjectCount() << " objects in " << scene.getNodeCount() << " nodes ("
+            << scene.animations.size() << " animated), " << scene.getLightCount() << " lights " << from << std::endl;
+    };
+
+    MappedFile file;
+    if (file.open(binaryPath) && readSceneBinary(file.data(), file.size(), stamp, scene))
+    {
+        report("loaded from " + binaryPath);
+        return true;
+    }
+    file.close();
+    if (!parseSceneText(path, scene))
+        return false;
+    report("compiled from " + path);
+
+    // written next to the old file and swapped in, as the texture cache does
+    std::vector<unsigned char> binary = writeSceneBinary(scene, stamp);
+    std::string temporary = binaryPath + ".tmp";
+    std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+    out.write((const char*)binary.data(), binary.size());
+    out.close();
+    if (!out)
+    {
+        std::remove(temporary.c_str());
+        return true;
+    }
+    std::remove(binaryPath.c_str());
+    std::rename(temporary.c_str(), binaryPath.c_str());
+    return true;
+}
+
+#endif /* sceneFile_h */
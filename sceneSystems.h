@@ -0,0 +1,108 @@
+#ifndef sceneSystems_h
+#define sceneSystems_h
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include "sceneFile.h"
+#include "meshlet.h"
+
+// the passes over a Scene's component arrays that run every frame, after animate()
+// has brought the world matrices up to date: the world boxes of the objects that
+// moved, then culling and the list of what is drawn. each walks its arrays from
+// front to back and keeps no state of its own, so a range of objects can be given
+// to any thread
+
+// visible objects of one frame, in the order they are to be drawn
+struct SceneDrawList
+{
+    std::vector<uint32_t> objects;
+    std::vector<uint32_t> order;        // every object, in drawing order
+    std::vector<uint8_t> visible;       // per object, as culling left it
+    size_t culled = 0;
+};
+
+// world boxes of the objects at the nodes in movedNodes, which it then clears
+inline void updateSceneBounds(Scene& scene)
+{
+    for (const std::pair<uint32_t, uint32_t>& range : scene.movedNodes)
+        for (uint32_t node = range.first; node < range.second; node++)
+        {
+            uint32_t object = scene.nodeObject[node];
+            if (object == sceneNoObject)
+                continue;
+
+            // the box around the transformed box: each world axis spans the object
+            // axes' extents projected onto it
+            const glm::mat4& world = scene.nodeWorld[node];
+            glm::vec3 center = glm::vec3(world * glm::vec4(scene.objectBoundsCenter[object], 1.0f));
+            glm::vec3 extent = scene.objectBoundsExtent[object];
+            for (int axis = 0; axis < 3; axis++)
+            {
+                scene.worldBoundsCenter[axis][object] = center[axis];
+                scene.worldBoundsExtent[axis][object] = fabsf(world[0][axis]) * extent.x + fabsf(world[1][axis]) * extent.y + fabsf(world[2][axis]) * extent.z;
+            }
+        }
+    scene.movedNodes.clear();
+}
+
+// visible[object] for the objects in [begin, end): 0 where the world box is wholly
+// outside one of the planes, 1 otherwise. one plane at a time down the arrays
+// without a branch, which compilers turn into vector code
+inline void cullSceneObjects(const Scene& scene, const glm::vec4 planes[6], size_t begin, size_t end, uint8_t* visible)
+{
+    const float* centerX = scene.worldBoundsCenter[0].data();
+    const float* centerY = scene.worldBoundsCenter[1].data();
+    const float* centerZ = scene.worldBoundsCenter[2].data();
+    const float* extentX = scene.worldBoundsExtent[0].data();
+    const float* extentY = scene.worldBoundsExtent[1].data();
+    const float* extentZ = scene.worldBoundsExtent[2].data();
+
+    std::fill(visible + begin, visible + end, (uint8_t)1);
+    for (int p = 0; p < 6; p++)
+    {
+        float nx = planes[p].x, ny = planes[p].y, nz = planes[p].z, d = planes[p].w;
+        float ax = fabsf(nx), ay = fabsf(ny), az = fabsf(nz);
+        for (size_t i = begin; i < end; i++)
+        {
+            float distance = nx * centerX[i] + ny * centerY[i] + nz * centerZ[i] + d;
+            float radius = ax * extentX[i] + ay * extentY[i] + az * extentZ[i];
+            visible[i] &= (uint8_t)(distance + radius >= 0.0f);
+        }
+    }
+}
+
+// the objects inside clipFromWorld's frustum, by mesh and then material so that
+// draws sharing them follow each other. the order is worked out on the first call
+// and only filtered after that
+inline void submitScene(const Scene& scene, const glm::mat4& clipFromWorld, SceneDrawList& drawList)
+{
+    size_t count = scene.getObjectCount();
+    if (drawList.order.size() != count)
+    {
+        drawList.order.resize(count);
+        for (uint32_t i = 0; i < count; i++)
+            drawList.order[i] = i;
+        std::stable_sort(drawList.order.begin(), drawList.order.end(), [&scene](uint32_t a, uint32_t b) {
+            if (scene.objectMesh[a] != scene.objectMesh[b])
+                return scene.objectMesh[a] < scene.objectMesh[b];
+            return scene.objectMaterial[a] < scene.objectMaterial[b];
+        });
+    }
+
+    glm::vec4 planes[6];
+    frustumPlanes(clipFromWorld, planes);
+    drawList.visible.resize(count);
+    cullSceneObjects(scene, planes, 0, count, drawList.visible.data());
+
+    drawList.objects.clear();
+    for (uint32_t object : drawList.order)
+        if (drawList.visible[object])
+            drawList.objects.push_back(object);
+    drawList.culled = count - drawList.objects.size();
+}
+
+#endif /* sceneSystems_h */
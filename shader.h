@@ -16,19 +16,26 @@ public:
     unsigned int ID;
     // constructor generates the shader on the fly
     // ------------------------------------------------------------------------
-    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
+    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr,
+        const char* tessControlPath = nullptr, const char* tessEvaluationPath = nullptr)
     {
         // 1. retrieve the vertex/fragment source code from filePath
         std::string vertexCode;
         std::string fragmentCode;
         std::string geometryCode;
+        std::string tessControlCode;
+        std::string tessEvaluationCode;
         std::ifstream vShaderFile;
         std::ifstream fShaderFile;
         std::ifstream gShaderFile;
+        std::ifstream tcShaderFile;
+        std::ifstream teShaderFile;
         // ensure ifstream objects can throw exceptions:
         vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
         fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
         gShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+        tcShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+        teShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
         try
         {
             // open files
@@ -53,6 +60,19 @@ public:
                 gShaderFile.close();
                 geometryCode = gShaderStream.str();
             }
+            // tessellation stages come as a pair (GL 4.0+)
+            if (tessControlPath != nullptr && tessEvaluationPath != nullptr)
+            {
+                tcShaderFile.open(tessControlPath);
+                teShaderFile.open(tessEvaluationPath);
+                std::stringstream tcShaderStream, teShaderStream;
+                tcShaderStream << tcShaderFile.rdbuf();
+                teShaderStream << teShaderFile.rdbuf();
+                tcShaderFile.close();
+                teShaderFile.close();
+                tessControlCode = tcShaderStream.str();
+                tessEvaluationCode = teShaderStream.str();
+            }
         }
         catch (std::ifstream::failure& e)
         {
@@ -82,12 +102,33 @@ public:
             glCompileShader(geometry);
             checkCompileErrors(geometry, "GEOMETRY");
         }
+        // if tessellation shaders are given, compile both stages
+        bool tessellation = tessControlPath != nullptr && tessEvaluationPath != nullptr;
+        unsigned int tessControl, tessEvaluation;
+        if (tessellation)
+        {
+            const char* tcShaderCode = tessControlCode.c_str();
+            const char* teShaderCode = tessEvaluationCode.c_str();
+            tessControl = glCreateShader(GL_TESS_CONTROL_SHADER);
+            glShaderSource(tessControl, 1, &tcShaderCode, NULL);
+            glCompileShader(tessControl);
+            checkCompileErrors(tessControl, "TESS_CONTROL");
+            tessEvaluation = glCreateShader(GL_TESS_EVALUATION_SHADER);
+            glShaderSource(tessEvaluation, 1, &teShaderCode, NULL);
+            glCompileShader(tessEvaluation);
+            checkCompileErrors(tessEvaluation, "TESS_EVALUATION");
+        }
         // shader Program
         ID = glCreateProgram();
         glAttachShader(ID, vertex);
         glAttachShader(ID, fragment);
         if (geometryPath != nullptr)
             glAttachShader(ID, geometry);
+        if (tessellation)
+        {
+            glAttachShader(ID, tessControl);
+            glAttachShader(ID, tessEvaluation);
+        }
         glLinkProgram(ID);
         checkCompileErrors(ID, "PROGRAM");
         // delete the shaders as they're linked into our program now and no longer necessary
@@ -95,6 +136,11 @@ public:
         glDeleteShader(fragment);
         if (geometryPath != nullptr)
             glDeleteShader(geometry);
+        if (tessellation)
+        {
+            glDeleteShader(tessControl);
+            glDeleteShader(tessEvaluation);
+        }
 
     }
     // activate the shader
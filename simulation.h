@@ -0,0 +1,95 @@
+#ifndef simulation_h
+#define simulation_h
+
+#include <algorithm>
+
+// everything in the hall that moves by itself, as of one simulation step
+struct SimulationState
+{
+    double time = 0.0;          // seconds simulated, the clock the flag and the trees wave by
+    float fanAngle = 0.0f;      // degrees, kept in [0, 360)
+    float doorAngle = 0.0f;     // degrees open
+};
+
+// what the keys asked for during a frame
+struct SimulationInput
+{
+    bool fanOn = false;
+    bool doorOpen = false;
+};
+
+// steps the hall's animation at a fixed rate however fast frames come. each frame's
+// time is added to an accumulator and whole steps are taken out of it; what is left
+// over places the frame between the last two steps, and the state drawn is blended
+// from them by that much. the same key presses at the same times then move things
+// the same way at 30 or 240 frames a second
+class Simulation
+{
+public:
+    // degrees a second; the fan used to turn 5 degrees a frame at 60 frames a second
+    static constexpr float fanSpeed = 300.0f;
+    static constexpr float doorSpeed = 180.0f;
+    static constexpr float doorOpenAngle = 90.0f;
+
+    explicit Simulation(double step = 1.0 / 60.0, double maxFrameTime = 0.25)
+        : step(step), maxFrameTime(maxFrameTime)
+    {
+    }
+
+    // takes frameTime seconds worth of steps with input held throughout; returns how
+    // many. a long stall, like a window drag, only catches up maxFrameTime of it
+    int advance(double frameTime, const SimulationInput& input)
+    {
+        accumulator += std::min(std::max(frameTime, 0.0), maxFrameTime);
+        int steps = 0;
+        while (accumulator >= step)
+        {
+            previous = current;
+            integrate(input);
+            accumulator -= step;
+            steps++;
+        }
+        return steps;
+    }
+
+    // the state at the frame's time, between the last two steps
+    SimulationState getRenderState() const
+    {
+        float alpha = (float)(accumulator / step);
+        SimulationState state;
+        state.time = previous.time + (current.time - previous.time) * alpha;
+        state.fanAngle = previous.fanAngle + (current.fanAngle - previous.fanAngle) * alpha;
+        state.doorAngle = previous.doorAngle + (current.doorAngle - previous.doorAngle) * alpha;
+        return state;
+    }
+
+    const SimulationState& getState() const { return current; }
+    double getStep() const { return step; }
+
+private:
+    double step;
+    double maxFrameTime;
+    double accumulator = 0.0;
+    SimulationState previous, current;
+
+    void integrate(const SimulationInput& input)
+    {
+        float seconds = (float)step;
+        current.time += step;
+
+        if (input.fanOn)
+            current.fanAngle += fanSpeed * seconds;
+        // wrapping both ends keeps the blend between them from sweeping back round
+        if (current.fanAngle >= 360.0f)
+        {
+            current.fanAngle -= 360.0f;
+            previous.fanAngle -= 360.0f;
+        }
+
+        float target = input.doorOpen ? doorOpenAngle : 0.0f;
+        float swing = doorSpeed * seconds;
+        current.doorAngle = std::min(std::max(target, current.doorAngle - swing), current.doorAngle + swing);
+    }
+};
+
+#endif /* simulation_h */
@@ -7,6 +7,15 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include "shader.h"
+#include "meshData.h"
+#include "glResource.h"
+#include "textureFeedback.h"
+#include "vertexFormat.h"
+#include "meshOptimizer.h"
+#include "meshlet.h"
+#include "retainedGeometry.h"
+#include "primitives.h"
+#include "parametricSurface.h"
 
 # define PI 3.1416
 
@@ -28,24 +37,37 @@ public:
     // Constructor
     Torus(float majorRadius = 1.0f, float minorRadius = 0.3f, int majorSegments = 36, int minorSegments = 18,
         glm::vec3 amb = glm::vec3(1.0, 0.0, 0.0), glm::vec3 diff = glm::vec3(1.0, 0.0, 0.0),
-        glm::vec3 spec = glm::vec3(1.0f, 0.0f, 0.0f), float shiny = 32.0f) : verticesStride(24) {
+        glm::vec3 spec = glm::vec3(1.0f, 0.0f, 0.0f), float shiny = 32.0f)
+        : Torus(buildGeometry(majorRadius, minorRadius, majorSegments, minorSegments), amb, diff, spec, shiny) {
         set(majorRadius, minorRadius, majorSegments, minorSegments, amb, diff, spec, shiny);
-        buildCoordinatesAndIndices();
-        buildVertices();
+    }
 
-        // Generate VAO, VBO, EBO
-        glGenVertexArrays(1, &torusVAO);
-        glBindVertexArray(torusVAO);
+    // upload a mesh made by buildGeometry(), which may have run on a worker thread
+    Torus(MeshData mesh,
+        glm::vec3 amb = glm::vec3(1.0, 0.0, 0.0), glm::vec3 diff = glm::vec3(1.0, 0.0, 0.0),
+        glm::vec3 spec = glm::vec3(1.0f, 0.0f, 0.0f), float shiny = 32.0f) : verticesStride(24) {
+        this->ambient = amb;
+        this->diffuse = diff;
+        this->specular = spec;
+        this->shininess = shiny;
+        meshlets = buildMeshlets(mesh);
+        meshletMemory = MemoryCharge(MemoryCategory::Meshes, meshlets.capacity() * sizeof(Meshlet), 0);
+        vertexCount = mesh.getVertexCount();
+        indexCount = (unsigned int)mesh.indices.size();
 
-        unsigned int torusVBO, torusEBO;
+        // Generate VAO, VBO, EBO
+        torusVAO = GlVertexArray::create();
+        glBindVertexArray(torusVAO.get());
 
-        glGenBuffers(1, &torusVBO);
-        glBindBuffer(GL_ARRAY_BUFFER, torusVBO);
-        glBufferData(GL_ARRAY_BUFFER, this->getVertexSize(), this->getVertices(), GL_STATIC_DRAW);
+        torusVBO = GlBuffer::create();
+        glBindBuffer(GL_ARRAY_BUFFER, torusVBO.get());
+        glBufferData(GL_ARRAY_BUFFER, this->getVertexSize(), mesh.vertices.data(), GL_STATIC_DRAW);
+        torusVBO.chargeMemory(MemoryCategory::Meshes, this->getVertexSize());
 
-        glGenBuffers(1, &torusEBO);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, torusEBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, this->getIndexSize(), this->getIndices(), GL_STATIC_DRAW);
+        torusEBO = GlBuffer::create();
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, torusEBO.get());
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, this->getIndexSize(), mesh.indices.data(), GL_STATIC_DRAW);
+        torusEBO.chargeMemory(MemoryCategory::Meshes, this->getIndexSize());
 
         // Enable attribute arrays
         glEnableVertexAttribArray(0); // Position
@@ -57,9 +79,45 @@ public:
         glBindVertexArray(0);
         glBindBuffer(GL_ARRAY_BUFFER, 0);
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+        retained.retain(std::move(mesh), defaultMeshRetention());
     }
 
-    ~Torus() {}
+    // CPU half of the constructor: no GL calls, safe on any thread
+    static MeshData buildGeometry(float majorRadius, float minorRadius, int majorSegments, int minorSegments) {
+        if (majorRadius <= 0) majorRadius = 1.0f;
+        if (minorRadius <= 0) minorRadius = 0.3f;
+        majorSegments = max(majorSegments, MIN_MAJOR_SEGMENTS);
+        minorSegments = max(minorSegments, MIN_MINOR_SEGMENTS);
+
+        // rows go around the major circle, columns around the tube
+        vector<float> ringCos(majorSegments + 1), ringSin(majorSegments + 1);
+        for (int i = 0; i <= majorSegments; ++i) {
+            float majorAngle = i * 2.0f * PI / majorSegments;
+            ringCos[i] = cos(majorAngle);
+            ringSin[i] = sin(majorAngle);
+        }
+        vector<float> tubeCos(minorSegments + 1), tubeSin(minorSegments + 1);
+        for (int j = 0; j <= minorSegments; ++j) {
+            float minorAngle = j * 2.0f * PI / minorSegments;
+            tubeCos[j] = cos(minorAngle);
+            tubeSin[j] = sin(minorAngle);
+        }
+        auto torus = makeParametricSurface([&](int i, int j, float* v) {
+            float cx = ringCos[i], cz = ringSin[i];
+            float ring = majorRadius + minorRadius * tubeCos[j];
+            v[0] = ring * cx;
+            v[1] = minorRadius * tubeSin[j];
+            v[2] = ring * cz;
+            v[3] = tubeCos[j] * cx;
+            v[4] = tubeSin[j];
+            v[5] = tubeCos[j] * cz;
+        }, majorSegments, minorSegments, 6);
+
+        MeshData mesh = torus.build();
+        optimizeMesh(mesh, "torus");
+        return mesh;
+    }
 
     // Set parameters
     void set(float majorRadius, float minorRadius, int majorSegments, int minorSegments, glm::vec3 amb, glm::vec3 diff, glm::vec3 spec, float shiny) {
@@ -76,14 +134,16 @@ public:
     }
 
     // Accessors
-    unsigned int getVertexCount() const { return (unsigned int)coordinates.size() / 3; }
-    unsigned int getVertexSize() const { return (unsigned int)vertices.size() * sizeof(float); }
+    unsigned int getVertexCount() const { return vertexCount; }
+    unsigned int getVertexSize() const { return vertexCount * verticesStride; }
     int getVerticesStride() const { return verticesStride; }
-    const float* getVertices() const { return vertices.data(); }
 
-    unsigned int getIndexCount() const { return (unsigned int)indices.size(); }
-    unsigned int getIndexSize() const { return (unsigned int)indices.size() * sizeof(unsigned int); }
-    const unsigned int* getIndices() const { return indices.data(); }
+    unsigned int getIndexCount() const { return indexCount; }
+    unsigned int getIndexSize() const { return indexCount * sizeof(unsigned int); }
+
+    // the CPU copy kept under the retention policy, for picking and collision
+    const RetainedGeometry& getRetainedGeometry() const { return retained; }
+    void setRetention(MeshRetention retention) { retained.setRetention(retention); }
 
     // Draw torus
     void drawTorus(Shader& shader, glm::mat4 model) const {
@@ -94,77 +154,40 @@ public:
         shader.setFloat("material.shininess", this->shininess);
         shader.setMat4("model", model);
 
-        glBindVertexArray(torusVAO);
+        glBindVertexArray(torusVAO.get());
         glDrawElements(GL_TRIANGLES, this->getIndexCount(), GL_UNSIGNED_INT, (void*)0);
         glBindVertexArray(0);
     }
 
-private:
-    unsigned int torusVAO;
-    float majorRadius, minorRadius;
-    int majorSegments, minorSegments;
-    vector<float> vertices;
-    vector<float> normals;
-    vector<unsigned int> indices;
-    vector<float> coordinates;
-    int verticesStride;
-
-    // Generate torus coordinates and indices
-    void buildCoordinatesAndIndices() {
-        float majorStep = 2.0f * PI / majorSegments;
-        float minorStep = 2.0f * PI / minorSegments;
-
-        // Generate vertices
-        for (int i = 0; i <= majorSegments; ++i) {
-            float majorAngle = i * majorStep;
-            glm::vec3 majorCircle(cos(majorAngle), 0.0f, sin(majorAngle));
-
-            for (int j = 0; j <= minorSegments; ++j) {
-                float minorAngle = j * minorStep;
-                float x = (majorRadius + minorRadius * cos(minorAngle)) * majorCircle.x;
-                float y = minorRadius * sin(minorAngle);
-                float z = (majorRadius + minorRadius * cos(minorAngle)) * majorCircle.z;
-
-                coordinates.push_back(x);
-                coordinates.push_back(y);
-                coordinates.push_back(z);
-
-                glm::vec3 normal = glm::normalize(glm::vec3(cos(minorAngle) * majorCircle.x, sin(minorAngle), cos(minorAngle) * majorCircle.z));
-                normals.push_back(normal.x);
-                normals.push_back(normal.y);
-                normals.push_back(normal.z);
-            }
-        }
-
-        // Generate indices
-        for (int i = 0; i < majorSegments; ++i) {
-            for (int j = 0; j < minorSegments; ++j) {
-                int current = i * (minorSegments + 1) + j;
-                int next = (i + 1) * (minorSegments + 1) + j;
+    // the torus is closed, so besides the frustum test meshlets facing away are skipped
+    void drawTorus(Shader& shader, glm::mat4 model, const glm::mat4& view, const glm::mat4& projection, glm::vec3 cameraPos) {
+        shader.use();
+        shader.setVec3("material.ambient", this->ambient);
+        shader.setVec3("material.diffuse", this->diffuse);
+        shader.setVec3("material.specular", this->specular);
+        shader.setFloat("material.shininess", this->shininess);
+        shader.setMat4("model", model);
 
-                indices.push_back(current);
-                indices.push_back(next);
-                indices.push_back(current + 1);
+        glm::vec3 cameraInObject = glm::vec3(glm::inverse(model) * glm::vec4(cameraPos, 1.0f));
+        cullMeshlets(meshlets, projection * view * model, cameraInObject, true, sizeof(unsigned int), drawList);
 
-                indices.push_back(current + 1);
-                indices.push_back(next);
-                indices.push_back(next + 1);
-            }
-        }
+        glBindVertexArray(torusVAO.get());
+        drawMeshlets(drawList, GL_UNSIGNED_INT);
+        glBindVertexArray(0);
     }
 
-    // Interleave vertices and normals
-    void buildVertices() {
-        for (size_t i = 0; i < coordinates.size(); i += 3) {
-            vertices.push_back(coordinates[i]);
-            vertices.push_back(coordinates[i + 1]);
-            vertices.push_back(coordinates[i + 2]);
-
-            vertices.push_back(normals[i]);
-            vertices.push_back(normals[i + 1]);
-            vertices.push_back(normals[i + 2]);
-        }
-    }
+private:
+    GlVertexArray torusVAO;
+    GlBuffer torusVBO, torusEBO;
+    vector<Meshlet> meshlets;
+    MemoryCharge meshletMemory;
+    MeshletDrawList drawList;
+    float majorRadius, minorRadius;
+    int majorSegments, minorSegments;
+    unsigned int vertexCount = 0;
+    unsigned int indexCount = 0;
+    RetainedGeometry retained;
+    int verticesStride;
 };
 class SphereTex
 {
@@ -178,45 +201,105 @@ public:
         glm::vec3 amb = glm::vec3(1.0f, 0.0f, 0.0f),
         glm::vec3 diff = glm::vec3(1.0f, 0.0f, 0.0f),
         glm::vec3 spec = glm::vec3(0.5f, 0.5f, 0.5f),
-        float shiny = 32.0f) : verticesStride(32)
+        float shiny = 32.0f) : SphereTex(buildGeometry(radius, sectorCount, stackCount), amb, diff, spec, shiny)
     {
         set(radius, sectorCount, stackCount, amb, diff, spec, shiny);
-        buildCoordinatesAndIndices();
-        buildVertices();
-
-        glGenVertexArrays(1, &sphereVAO);
-        glBindVertexArray(sphereVAO);
+    }
 
-        // Create VBO for vertex data
-        unsigned int sphereVBO;
-        glGenBuffers(1, &sphereVBO);
-        glBindBuffer(GL_ARRAY_BUFFER, sphereVBO);
-        glBufferData(GL_ARRAY_BUFFER, this->getVertexSize(), this->getVertices(), GL_STATIC_DRAW);
+    // upload a mesh made by buildGeometry(), which may have run on a worker thread
+    SphereTex(MeshData mesh,
+        glm::vec3 amb = glm::vec3(1.0f, 0.0f, 0.0f),
+        glm::vec3 diff = glm::vec3(1.0f, 0.0f, 0.0f),
+        glm::vec3 spec = glm::vec3(0.5f, 0.5f, 0.5f),
+        float shiny = 32.0f) : verticesStride(32)
+    {
+        this->ambient = amb;
+        this->diffuse = diff;
+        this->specular = spec;
+        this->shininess = shiny;
+        vertexCount = mesh.getVertexCount();
+        indexCount = (unsigned int)mesh.indices.size();
 
-        // Create EBO for index data
-        unsigned int sphereEBO;
-        glGenBuffers(1, &sphereEBO);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sphereEBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, this->getIndexSize(), this->getIndices(), GL_STATIC_DRAW);
+        sphereVAO = GlVertexArray::create();
+        glBindVertexArray(sphereVAO.get());
 
-        // Enable vertex attributes
-        glEnableVertexAttribArray(0); // Position
-        glEnableVertexAttribArray(1); // Normal
-        glEnableVertexAttribArray(2); // Texture Coordinates
+        // Create VBO and EBO, in the default vertex format
+        layout = uploadVertexData(mesh.vertices, mesh.indices, sphereVBO, sphereEBO);
+        verticesStride = layout.stride;
 
-        // Set attribute pointers
-        int stride = this->getVerticesStride();
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);                        // Position
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * 3));      // Normal
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * 6));      // Texture Coordinates
+        // Position, Normal, Texture Coordinates
+        setVertexAttributes(layout, 3);
 
         // Unbind VAO and buffers
         glBindVertexArray(0);
         glBindBuffer(GL_ARRAY_BUFFER, 0);
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+        retained.retain(std::move(mesh), defaultMeshRetention());
     }
 
-    ~SphereTex() {}
+    // same sphere with the tessellation fixed at compile time; the unit sphere comes
+    // from a generated table and only the scaling and optimisation run here
+    template<int Sectors, int Stacks>
+    static MeshData buildGeometry(float radius)
+    {
+        static constexpr auto table = makeUvSphere<Sectors, Stacks>();
+        if (radius <= 0)
+            radius = 1.0f;
+        MeshData mesh = table.toMeshData();
+        for (size_t v = 0; v < mesh.vertices.size(); v += 8)
+            for (int i = 0; i < 3; i++)
+                mesh.vertices[v + i] *= radius;
+        optimizeMesh(mesh, "sphere");
+        return mesh;
+    }
+
+    // CPU half of the constructor: no GL calls, safe on any thread
+    static MeshData buildGeometry(float radius, int sectorCount, int stackCount)
+    {
+        if (radius <= 0)
+            radius = 1.0f;
+        if (sectorCount < MIN_SECTOR_COUNT)
+            sectorCount = MIN_SECTOR_COUNT;
+        if (stackCount < MIN_STACK_COUNT)
+            stackCount = MIN_STACK_COUNT;
+
+        // rows are stacks from the north pole down, columns sectors around y
+        std::vector<float> sectorSin(sectorCount + 1), sectorCos(sectorCount + 1);
+        for (int j = 0; j <= sectorCount; ++j)
+        {
+            float sectorAngle = j * 2 * PI / sectorCount;
+            sectorSin[j] = sinf(sectorAngle);
+            sectorCos[j] = cosf(sectorAngle);
+        }
+        std::vector<float> stackCos(stackCount + 1), stackSin(stackCount + 1);
+        for (int i = 0; i <= stackCount; ++i)
+        {
+            float stackAngle = PI / 2 - i * PI / stackCount;
+            stackCos[i] = cosf(stackAngle);
+            stackSin[i] = sinf(stackAngle);
+        }
+        auto sphere = makeParametricSurface([&](int i, int j, float* v)
+        {
+            float xz = stackCos[i];
+            float y = stackSin[i];
+
+            v[3] = xz * sectorSin[j];
+            v[4] = y;
+            v[5] = xz * sectorCos[j];
+            v[0] = radius * v[3];
+            v[1] = radius * v[4];
+            v[2] = radius * v[5];
+            v[6] = (float)j / sectorCount;  // U-coordinate
+            v[7] = (float)i / stackCount;   // V-coordinate
+        }, stackCount, sectorCount);
+        sphere.collapsedFirstRow = true;
+        sphere.collapsedLastRow = true;
+
+        MeshData mesh = sphere.build();
+        optimizeMesh(mesh, "sphere");
+        return mesh;
+    }
 
     void set(float radius, int sectors, int stacks, glm::vec3 amb, glm::vec3 diff, glm::vec3 spec, float shiny)
     {
@@ -236,37 +319,38 @@ public:
 
     unsigned int getVertexCount() const
     {
-        return (unsigned int)coordinates.size() / 3;
+        return vertexCount;
     }
 
     unsigned int getVertexSize() const
     {
-        return (unsigned int)vertices.size() * sizeof(float);
+        return vertexCount * verticesStride;
     }
 
     int getVerticesStride() const
     {
-        return verticesStride; // 32 bytes: 3 (position) + 3 (normal) + 2 (texture coordinates)
+        return verticesStride; // bytes per vertex as uploaded, see VertexLayout
     }
 
-    const float* getVertices() const
+    unsigned int getIndexSize() const
     {
-        return vertices.data();
+        return indexCount * layout.indexSize();
     }
 
-    unsigned int getIndexSize() const
+    unsigned int getIndexCount() const
     {
-        return (unsigned int)indices.size() * sizeof(unsigned int);
+        return indexCount;
     }
 
-    const unsigned int* getIndices() const
+    // the CPU copy kept under the retention policy, for picking and collision
+    const RetainedGeometry& getRetainedGeometry() const
     {
-        return indices.data();
+        return retained;
     }
 
-    unsigned int getIndexCount() const
+    void setRetention(MeshRetention retention)
     {
-        return (unsigned int)indices.size();
+        retained.setRetention(retention);
     }
 
     void drawSphere(Shader& lightingShader, unsigned int texture, glm::mat4 model) const
@@ -277,111 +361,28 @@ public:
         lightingShader.setVec3("material.diffuse", this->diffuse);
         lightingShader.setVec3("material.specular", this->specular);
         lightingShader.setFloat("material.shininess", this->shininess);
-        lightingShader.setMat4("model", model);
+        lightingShader.setMat4("model", model * layout.dequantize());
 
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_2D, texture);
 
-        glBindVertexArray(sphereVAO);
-        glDrawElements(GL_TRIANGLES, this->getIndexCount(), GL_UNSIGNED_INT, (void*)0);
+        glBindVertexArray(sphereVAO.get());
+        glDrawElements(GL_TRIANGLES, this->getIndexCount(), layout.indexType, (void*)0);
         glBindVertexArray(0);
+        textureFeedbackLog().record(texture, sphereVAO.get(), this->getIndexCount(), layout.indexType, model * layout.dequantize());
     }
 
 private:
-    void buildCoordinatesAndIndices()
-    {
-        float x, y, z, xz;
-        float nx, ny, nz, lengthInv = 1.0f / radius;
-        float s, t;
-
-        float sectorStep = 2 * PI / sectorCount;
-        float stackStep = PI / stackCount;
-        float sectorAngle = -sectorStep;
-        float stackAngle = PI / 2 + stackStep;
-
-        for (int i = 0; i <= stackCount; ++i)
-        {
-            stackAngle -= stackStep;
-            xz = radius * cosf(stackAngle);
-            y = radius * sinf(stackAngle);
-
-            for (int j = 0; j <= sectorCount; ++j)
-            {
-                sectorAngle += sectorStep;
-
-                z = xz * cosf(sectorAngle);
-                x = xz * sinf(sectorAngle);
-                coordinates.push_back(x);
-                coordinates.push_back(y);
-                coordinates.push_back(z);
-
-                nx = x * lengthInv;
-                ny = y * lengthInv;
-                nz = z * lengthInv;
-                normals.push_back(nx);
-                normals.push_back(ny);
-                normals.push_back(nz);
-
-                s = (float)j / sectorCount; // U-coordinate
-                t = (float)i / stackCount; // V-coordinate
-                texCoords.push_back(s);
-                texCoords.push_back(t);
-            }
-        }
-
-        int k1, k2;
-        for (int i = 0; i < stackCount; ++i)
-        {
-            k1 = i * (sectorCount + 1);
-            k2 = k1 + sectorCount + 1;
-
-            for (int j = 0; j < sectorCount; ++j, ++k1, ++k2)
-            {
-                if (i != 0)
-                {
-                    indices.push_back(k1);
-                    indices.push_back(k2);
-                    indices.push_back(k1 + 1);
-                }
-
-                if (i != (stackCount - 1))
-                {
-                    indices.push_back(k1 + 1);
-                    indices.push_back(k2);
-                    indices.push_back(k2 + 1);
-                }
-            }
-        }
-    }
-
-    void buildVertices()
-    {
-        for (size_t i = 0; i < coordinates.size(); i += 3)
-        {
-            vertices.push_back(coordinates[i]);
-            vertices.push_back(coordinates[i + 1]);
-            vertices.push_back(coordinates[i + 2]);
-
-            vertices.push_back(normals[i]);
-            vertices.push_back(normals[i + 1]);
-            vertices.push_back(normals[i + 2]);
-
-            size_t texIndex = i / 3 * 2;
-            vertices.push_back(texCoords[texIndex]);
-            vertices.push_back(texCoords[texIndex + 1]);
-        }
-    }
-
-    unsigned int sphereVAO;
+    GlVertexArray sphereVAO;
+    GlBuffer sphereVBO, sphereEBO;
     float radius;
     int sectorCount;
     int stackCount;
-    std::vector<float> vertices;
-    std::vector<float> normals;
-    std::vector<float> texCoords;
-    std::vector<unsigned int> indices;
-    std::vector<float> coordinates;
+    unsigned int vertexCount = 0;
+    unsigned int indexCount = 0;
+    RetainedGeometry retained;
     int verticesStride;
+    VertexLayout layout;
 };
 
 #endif // TORUS_H
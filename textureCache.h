@@ -0,0 +1,305 @@
+#ifndef textureCache_h
+#define textureCache_h
+
+#include <glad/glad.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <memory>
+#include <fstream>
+#include <algorithm>
+#include "stb_image.h"
+#include "mappedFile.h"
+#include "jpegDecoder.h"
+#include "textureCompressor.h"
+
+// block-compressed copies of the image files, so that startup uploads finished mip
+// chains instead of decoding JPEGs and generating mipmaps. each image gets a KTX 1.1
+// file next to it (floor_texture.jpg.ktx), written the first time the image is
+// loaded and memory-mapped from then on. the file's key/value data records the
+// source's size and modification time and textureCompressorVersion; a file that
+// does not match is converted again. a file whose source is gone is used as it is.
+//
+// levels are BC1, or BC3 for images with any transparency. without the S3TC
+// extension they are stored as plain RGBA8 instead, still with prebuilt mipmaps
+
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+struct KtxHeader
+{
+    unsigned char identifier[12];
+    uint32_t endianness;
+    uint32_t glType;
+    uint32_t glTypeSize;
+    uint32_t glFormat;
+    uint32_t glInternalFormat;
+    uint32_t glBaseInternalFormat;
+    uint32_t pixelWidth;
+    uint32_t pixelHeight;
+    uint32_t pixelDepth;
+    uint32_t numberOfArrayElements;
+    uint32_t numberOfFaces;
+    uint32_t numberOfMipmapLevels;
+    uint32_t bytesOfKeyValueData;
+};
+
+const unsigned char ktxIdentifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+const char ktxSourceKey[] = "AUDsource";
+
+struct TextureLevel
+{
+    int width, height;
+    size_t offset;                  // from the start of the file
+    size_t size;
+};
+
+// one texture's mip chain as it is uploaded, either mapped from its cache file or
+// just converted and still in memory
+struct TextureData
+{
+    GLenum internalFormat = 0;      // a compressed format or GL_RGBA8
+    std::vector<TextureLevel> levels;
+    bool fromCache = false;
+
+    bool isCompressed() const
+    {
+        return internalFormat != GL_RGBA8;
+    }
+
+    const unsigned char* bytes() const
+    {
+        return file ? file->data() : storage.data();
+    }
+
+    size_t getByteCount() const
+    {
+        size_t bytes = 0;
+        for (const TextureLevel& level : levels)
+            bytes += level.size;
+        return bytes;
+    }
+
+    std::unique_ptr<MappedFile> file;
+    std::vector<unsigned char> storage;
+};
+
+// whether the context can sample BC1/BC3, and so whether cache files may hold them.
+// needs the GL context, unlike the rest of this file
+inline bool textureCompressionSupported()
+{
+    GLint extensionCount = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+    for (GLint i = 0; i < extensionCount; i++)
+    {
+        const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+        if (extension && strcmp(extension, "GL_EXT_texture_compression_s3tc") == 0)
+            return true;
+    }
+    return false;
+}
+
+// what a cache file must record to stand for the image at path; empty if there is
+// no image there
+inline std::string textureSourceStamp(const std::string& path)
+{
+    struct stat status;
+    if (stat(path.c_str(), &status) != 0)
+        return std::string();
+    char stamp[64];
+    snprintf(stamp, sizeof(stamp), "%llu %llu %u", (unsigned long long)status.st_size,
+        (unsigned long long)status.st_mtime, textureCompressorVersion);
+    return stamp;
+}
+
+inline size_t textureLevelSize(GLenum internalFormat, int width, int height)
+{
+    if (internalFormat == GL_RGBA8)
+        return (size_t)width * height * 4;
+    return compressedLevelSize(width, height, internalFormat == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT);
+}
+
+// a KTX file of the whole mip chain
+inline std::vector<unsigned char> writeKtx(const std::vector<RgbaImage>& levels, GLenum internalFormat, const std::string& stamp)
+{
+    KtxHeader header = {};
+    memcpy(header.identifier, ktxIdentifier, sizeof(ktxIdentifier));
+    header.endianness = 0x04030201;
+    bool compressed = internalFormat != GL_RGBA8;
+    header.glType = compressed ? 0 : GL_UNSIGNED_BYTE;
+    header.glTypeSize = 1;
+    header.glFormat = compressed ? 0 : GL_RGBA;
+    header.glInternalFormat = internalFormat;
+    header.glBaseInternalFormat = internalFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT ? GL_RGB : GL_RGBA;
+    header.pixelWidth = (uint32_t)levels[0].width;
+    header.pixelHeight = (uint32_t)levels[0].height;
+    header.numberOfFaces = 1;
+    header.numberOfMipmapLevels = (uint32_t)levels.size();
+
+    // one key/value pair, padded to 4 bytes like everything else in the file
+    uint32_t pairSize = (uint32_t)(sizeof(ktxSourceKey) + stamp.size() + 1);
+    header.bytesOfKeyValueData = 4 + ((pairSize + 3) & ~3u);
+
+    std::vector<unsigned char> blob(sizeof(header) + header.bytesOfKeyValueData);
+    memcpy(&blob[0], &header, sizeof(header));
+    memcpy(&blob[sizeof(header)], &pairSize, 4);
+    memcpy(&blob[sizeof(header) + 4], ktxSourceKey, sizeof(ktxSourceKey));
+    memcpy(&blob[sizeof(header) + 4 + sizeof(ktxSourceKey)], stamp.c_str(), stamp.size() + 1);
+
+    for (const RgbaImage& level : levels)
+    {
+        size_t sizeOffset = blob.size();
+        blob.resize(sizeOffset + 4);
+        if (compressed)
+            compressLevel(level, internalFormat == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, blob);
+        else
+            blob.insert(blob.end(), level.pixels.begin(), level.pixels.end());
+        uint32_t imageSize = (uint32_t)(blob.size() - sizeOffset - 4);
+        memcpy(&blob[sizeOffset], &imageSize, 4);
+        blob.resize((blob.size() + 3) & ~(size_t)3);
+    }
+    return blob;
+}
+
+// the levels of a KTX file written by writeKtx(); false if it is malformed, in a
+// format that cannot be used, or made from another version of its source. an
+// empty stamp accepts any source
+inline bool parseKtx(const unsigned char* data, size_t size, const std::string& stamp, bool allowCompressed, TextureData& texture)
+{
+    KtxHeader header;
+    if (size < sizeof(header))
+        return false;
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.identifier, ktxIdentifier, sizeof(ktxIdentifier)) != 0 || header.endianness != 0x04030201 ||
+        header.pixelWidth == 0 || header.pixelDepth != 0 ||
+        header.numberOfArrayElements != 0 || header.numberOfFaces != 1 || header.numberOfMipmapLevels == 0 ||
+        sizeof(header) + (size_t)header.bytesOfKeyValueData > size)
+        return false;
+
+    GLenum format = header.glInternalFormat;
+    bool compressed = format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT || format == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    if (compressed ? !allowCompressed : (format != GL_RGBA8 || header.glFormat != GL_RGBA || header.glType != GL_UNSIGNED_BYTE))
+        return false;
+
+    std::string recorded;
+    size_t offset = sizeof(header);
+    size_t keyValueEnd = offset + header.bytesOfKeyValueData;
+    while (offset + 4 <= keyValueEnd)
+    {
+        uint32_t pairSize;
+        memcpy(&pairSize, data + offset, 4);
+        if (offset + 4 + pairSize > keyValueEnd)
+            return false;
+        const char* pair = (const char*)data + offset + 4;
+        if (pairSize > sizeof(ktxSourceKey) && memcmp(pair, ktxSourceKey, sizeof(ktxSourceKey)) == 0)
+            recorded.assign(pair + sizeof(ktxSourceKey), strnlen(pair + sizeof(ktxSourceKey), pairSize - sizeof(ktxSourceKey)));
+        offset += 4 + ((pairSize + 3) & ~(size_t)3);
+    }
+    if (!stamp.empty() && recorded != stamp)
+        return false;
+
+    texture.internalFormat = format;
+    texture.levels.clear();
+    offset = keyValueEnd;
+    int width = (int)header.pixelWidth, height = (int)std::max(header.pixelHeight, 1u);
+    for (uint32_t l = 0; l < header.numberOfMipmapLevels; l++)
+    {
+        uint32_t imageSize;
+        if (offset + 4 > size)
+            return false;
+        memcpy(&imageSize, data + offset, 4);
+        offset += 4;
+        if (imageSize != textureLevelSize(format, width, height) || offset + imageSize > size)
+            return false;
+        texture.levels.push_back({ width, height, offset, imageSize });
+        offset += (imageSize + 3) & ~(size_t)3;
+        width = std::max(1, width / 2);
+        height = std::max(1, height / 2);
+    }
+    return true;
+}
+
+// the image at path as RGBA8, rows running upwards as TextureLoader has stb_image
+// load them. JPEGs go through decodeJpeg(), anything else and the JPEGs it refuses
+// through stb_image. false if the image cannot be read
+inline bool loadRgbaImage(const std::string& path, RgbaImage& image)
+{
+    MappedFile file;
+    if (!file.open(path))
+        return false;
+    if (decodeJpeg(file.data(), file.size(), image, true))
+        return true;
+
+    // four channels whatever the file has, as the block encoder works on RGBA
+    int components;
+    unsigned char* pixels = stbi_load_from_memory(file.data(), (int)file.size(), &image.width, &image.height, &components, 4);
+    if (!pixels)
+        return false;
+    image.pixels.assign(pixels, pixels + (size_t)image.width * image.height * 4);
+    stbi_image_free(pixels);
+    return true;
+}
+
+// the mip chain for the image at path, from its cache file when that is current and
+// otherwise decoded, filtered, compressed and written back. no GL calls, so it runs
+// on a worker; allowCompressed is whether the context has S3TC. levels is empty if
+// the image cannot be read
+inline TextureData loadTextureData(const std::string& path, bool allowCompressed)
+{
+    std::string cachePath = path + ".ktx";
+    std::string stamp = textureSourceStamp(path);
+
+    TextureData texture;
+    texture.file.reset(new MappedFile());
+    if (texture.file->open(cachePath) && parseKtx(texture.file->data(), texture.file->size(), stamp, allowCompressed, texture))
+    {
+        texture.fromCache = true;
+        return texture;
+    }
+    texture.file.reset();
+
+    RgbaImage image;
+    if (!loadRgbaImage(path, image))
+        return texture;
+
+    GLenum format = GL_RGBA8;
+    if (allowCompressed)
+        format = image.hasAlpha() ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    texture.storage = writeKtx(buildMipChain(std::move(image)), format, stamp);
+    parseKtx(texture.storage.data(), texture.storage.size(), stamp, allowCompressed, texture);
+
+    // written next to the old file and swapped in, as the mesh cache does
+    std::string temporary = cachePath + ".tmp";
+    std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+    out.write((const char*)texture.storage.data(), texture.storage.size());
+    out.close();
+    if (!out)
+    {
+        std::remove(temporary.c_str());
+        return texture;
+    }
+    std::remove(cachePath.c_str());
+    std::rename(temporary.c_str(), cachePath.c_str());
+
+    // the levels are kept for streaming, so they are read from the new file's
+    // mapping from here on rather than held in memory
+    std::unique_ptr<MappedFile> file(new MappedFile());
+    TextureData mapped;
+    if (file->open(cachePath) && parseKtx(file->data(), file->size(), stamp, allowCompressed, mapped))
+    {
+        texture.storage = std::vector<unsigned char>();
+        texture.file = std::move(file);
+    }
+    return texture;
+}
+
+#endif /* textureCache_h */
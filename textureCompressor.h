@@ -0,0 +1,247 @@
+#ifndef textureCompressor_h
+#define textureCompressor_h
+
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+// CPU side of the compressed texture cache: box-filtered mip chains and BC1/BC3
+// (DXT1/DXT5) block encoding of RGBA8 images. no GL calls, safe on any thread.
+//
+// the encoder fits each 4x4 block's colours to the principal axis of their spread,
+// which is quick and close enough for the hall's photographic textures; BC7 would
+// look better but needs a far more involved mode search
+
+// bump whenever mip filtering or block encoding changes its output; cached files
+// written by another version are converted again
+const uint32_t textureCompressorVersion = 1;
+
+struct RgbaImage
+{
+    int width = 0, height = 0;
+    std::vector<unsigned char> pixels;      // width * height * 4
+
+    bool hasAlpha() const
+    {
+        for (size_t i = 3; i < pixels.size(); i += 4)
+            if (pixels[i] != 255)
+                return true;
+        return false;
+    }
+};
+
+// the next smaller mip level, halving each side down to 1; odd sides drop their
+// last row or column, as glGenerateMipmap's box filter does
+inline RgbaImage downsampleImage(const RgbaImage& image)
+{
+    RgbaImage half;
+    half.width = std::max(1, image.width / 2);
+    half.height = std::max(1, image.height / 2);
+    half.pixels.resize((size_t)half.width * half.height * 4);
+    for (int y = 0; y < half.height; y++)
+        for (int x = 0; x < half.width; x++)
+        {
+            int x0 = std::min(x * 2, image.width - 1), x1 = std::min(x * 2 + 1, image.width - 1);
+            int y0 = std::min(y * 2, image.height - 1), y1 = std::min(y * 2 + 1, image.height - 1);
+            for (int c = 0; c < 4; c++)
+            {
+                int sum = image.pixels[((size_t)y0 * image.width + x0) * 4 + c] + image.pixels[((size_t)y0 * image.width + x1) * 4 + c] +
+                    image.pixels[((size_t)y1 * image.width + x0) * 4 + c] + image.pixels[((size_t)y1 * image.width + x1) * 4 + c];
+                half.pixels[((size_t)y * half.width + x) * 4 + c] = (unsigned char)((sum + 2) / 4);
+            }
+        }
+    return half;
+}
+
+// image followed by every smaller level down to 1x1
+inline std::vector<RgbaImage> buildMipChain(RgbaImage image)
+{
+    std::vector<RgbaImage> levels;
+    levels.push_back(std::move(image));
+    while (levels.back().width > 1 || levels.back().height > 1)
+        levels.push_back(downsampleImage(levels.back()));
+    return levels;
+}
+
+inline uint16_t packRgb565(const float* colour)
+{
+    int r = (int)(std::min(std::max(colour[0], 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+    int g = (int)(std::min(std::max(colour[1], 0.0f), 255.0f) * 63.0f / 255.0f + 0.5f);
+    int b = (int)(std::min(std::max(colour[2], 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+    return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+inline void unpackRgb565(uint16_t packed, int* colour)
+{
+    int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+    colour[0] = (r << 3) | (r >> 2);
+    colour[1] = (g << 2) | (g >> 4);
+    colour[2] = (b << 3) | (b >> 2);
+}
+
+// the 8-byte colour half of a block in four-colour mode. block is 16 RGBA pixels
+inline void encodeColourBlock(const unsigned char* block, unsigned char* out)
+{
+    float mean[3] = {};
+    for (int p = 0; p < 16; p++)
+        for (int c = 0; c < 3; c++)
+            mean[c] += block[p * 4 + c] / 16.0f;
+
+    float covariance[6] = {};
+    for (int p = 0; p < 16; p++)
+    {
+        float d[3] = { block[p * 4] - mean[0], block[p * 4 + 1] - mean[1], block[p * 4 + 2] - mean[2] };
+        covariance[0] += d[0] * d[0]; covariance[1] += d[0] * d[1]; covariance[2] += d[0] * d[2];
+        covariance[3] += d[1] * d[1]; covariance[4] += d[1] * d[2]; covariance[5] += d[2] * d[2];
+    }
+
+    // principal axis by power iteration
+    float axis[3] = { 0.577f, 0.577f, 0.577f };
+    for (int i = 0; i < 8; i++)
+    {
+        float next[3] = {
+            covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2],
+            covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2],
+            covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2] };
+        float length = sqrtf(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+        if (length < 1e-6f)
+            break;
+        for (int c = 0; c < 3; c++)
+            axis[c] = next[c] / length;
+    }
+
+    float low = 0.0f, high = 0.0f;
+    for (int p = 0; p < 16; p++)
+    {
+        float t = 0.0f;
+        for (int c = 0; c < 3; c++)
+            t += (block[p * 4 + c] - mean[c]) * axis[c];
+        low = std::min(low, t);
+        high = std::max(high, t);
+    }
+    float lowColour[3], highColour[3];
+    for (int c = 0; c < 3; c++)
+    {
+        lowColour[c] = mean[c] + axis[c] * low;
+        highColour[c] = mean[c] + axis[c] * high;
+    }
+
+    uint16_t colour0 = packRgb565(highColour), colour1 = packRgb565(lowColour);
+    if (colour0 < colour1)
+        std::swap(colour0, colour1);
+
+    uint32_t indices = 0;
+    if (colour0 != colour1)
+    {
+        int palette[4][3];
+        unpackRgb565(colour0, palette[0]);
+        unpackRgb565(colour1, palette[1]);
+        for (int c = 0; c < 3; c++)
+        {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+        for (int p = 0; p < 16; p++)
+        {
+            int best = 0, bestError = 1 << 30;
+            for (int i = 0; i < 4; i++)
+            {
+                int error = 0;
+                for (int c = 0; c < 3; c++)
+                {
+                    int d = block[p * 4 + c] - palette[i][c];
+                    error += d * d;
+                }
+                if (error < bestError)
+                {
+                    bestError = error;
+                    best = i;
+                }
+            }
+            indices |= (uint32_t)best << (p * 2);
+        }
+    }
+
+    out[0] = (unsigned char)(colour0 & 0xff);
+    out[1] = (unsigned char)(colour0 >> 8);
+    out[2] = (unsigned char)(colour1 & 0xff);
+    out[3] = (unsigned char)(colour1 >> 8);
+    for (int i = 0; i < 4; i++)
+        out[4 + i] = (unsigned char)(indices >> (i * 8));
+}
+
+// the 8-byte alpha half of a BC3 block, interpolating eight values between the
+// block's lowest and highest alpha
+inline void encodeAlphaBlock(const unsigned char* block, unsigned char* out)
+{
+    int alpha0 = 0, alpha1 = 255;
+    for (int p = 0; p < 16; p++)
+    {
+        alpha0 = std::max(alpha0, (int)block[p * 4 + 3]);
+        alpha1 = std::min(alpha1, (int)block[p * 4 + 3]);
+    }
+
+    uint64_t indices = 0;
+    if (alpha0 != alpha1)
+    {
+        int palette[8] = { alpha0, alpha1 };
+        for (int i = 1; i < 7; i++)
+            palette[i + 1] = ((7 - i) * alpha0 + i * alpha1) / 7;
+        for (int p = 0; p < 16; p++)
+        {
+            int best = 0, bestError = 256;
+            for (int i = 0; i < 8; i++)
+            {
+                int error = abs(block[p * 4 + 3] - palette[i]);
+                if (error < bestError)
+                {
+                    bestError = error;
+                    best = i;
+                }
+            }
+            indices |= (uint64_t)best << (p * 3);
+        }
+    }
+
+    out[0] = (unsigned char)alpha0;
+    out[1] = (unsigned char)alpha1;
+    for (int i = 0; i < 6; i++)
+        out[2 + i] = (unsigned char)(indices >> (i * 8));
+}
+
+inline size_t compressedLevelSize(int width, int height, bool withAlpha)
+{
+    return (size_t)((width + 3) / 4) * ((height + 3) / 4) * (withAlpha ? 16 : 8);
+}
+
+// one level in BC1, or BC3 with withAlpha, appended to out. blocks overhanging the
+// image repeat its last row and column
+inline void compressLevel(const RgbaImage& image, bool withAlpha, std::vector<unsigned char>& out)
+{
+    size_t offset = out.size();
+    out.resize(offset + compressedLevelSize(image.width, image.height, withAlpha));
+    unsigned char* written = &out[offset];
+    unsigned char block[16 * 4];
+    for (int by = 0; by < image.height; by += 4)
+        for (int bx = 0; bx < image.width; bx += 4)
+        {
+            for (int y = 0; y < 4; y++)
+                for (int x = 0; x < 4; x++)
+                {
+                    int sx = std::min(bx + x, image.width - 1), sy = std::min(by + y, image.height - 1);
+                    memcpy(&block[(y * 4 + x) * 4], &image.pixels[((size_t)sy * image.width + sx) * 4], 4);
+                }
+            if (withAlpha)
+            {
+                encodeAlphaBlock(block, written);
+                written += 8;
+            }
+            encodeColourBlock(block, written);
+            written += 8;
+        }
+}
+
+#endif /* textureCompressor_h */
@@ -0,0 +1,298 @@
+#ifndef textureFeedback_h
+#define textureFeedback_h
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include "shader.h"
+#include "glResource.h"
+
+// which part of each texture's mip chain the last frames actually sampled, for
+// TextureLoader's streaming. every few frames the textured draws of a frame are
+// logged as they are made and replayed afterwards into a small offscreen target, at
+// 1/downscale of the window, with a shader that writes each pixel's texture and how
+// much of that texture the pixel covers. the target is read back through a pixel
+// buffer and only looked at once its fence has passed, so the frame never waits.
+//
+// draws that cannot be replayed, like the GPU-tessellated roof, ask for full detail
+// instead.
+//
+// draws with a virtual texture (see virtualTexture.h) write which of its pages the
+// pixel needs instead: page x and y, mip level and the virtual texture's id
+
+// one logged draw: an indexed triangle list with the texture it samples
+struct FeedbackDraw
+{
+    GLuint texture;
+    GLuint vertexArray;
+    GLsizei indexCount;
+    GLenum indexType;
+    size_t indexOffset;         // in bytes
+    glm::mat4 model;            // including the mesh's dequantisation
+    bool texCoordsAtOne;        // texture coordinates at attribute 1 instead of 2
+};
+
+// the shape of a virtual texture's page grid, for the feedback shader
+struct FeedbackVirtualTexture
+{
+    int id;                     // 1 to 254, written to alpha
+    int pagesPerSide;           // at level 0, at most 256
+    int virtualSize;            // texels per side at level 0
+    int levelCount;
+};
+
+// a page some pixel of the last pass needed
+struct FeedbackPage
+{
+    GLuint texture;             // the virtual texture's physical cache
+    int level, x, y;
+};
+
+// the textured draws of the current frame, filled in by the draw methods of the
+// meshes while a feedback frame is being drawn
+class FeedbackLog
+{
+public:
+    bool isRecording() const
+    {
+        return recording;
+    }
+
+    void record(GLuint texture, GLuint vertexArray, GLsizei indexCount, GLenum indexType, const glm::mat4& model,
+        size_t indexOffset = 0, bool texCoordsAtOne = false)
+    {
+        if (recording && texture != 0)
+            draws.push_back({ texture, vertexArray, indexCount, indexType, indexOffset, model, texCoordsAtOne });
+    }
+
+    void requestFullDetail(GLuint texture)
+    {
+        if (recording && texture != 0)
+            fullDetail.push_back(texture);
+    }
+
+    // draws recorded with texture are replayed as draws of a virtual texture with
+    // the given page grid from now on
+    void addVirtualTexture(GLuint texture, int pagesPerSide, int virtualSize, int levelCount)
+    {
+        int id = 1;
+        for (const auto& known : virtualTextures)
+            id = std::max(id, known.second.id + 1);
+        virtualTextures[texture] = { id, pagesPerSide, virtualSize, levelCount };
+    }
+
+    void removeVirtualTexture(GLuint texture)
+    {
+        virtualTextures.erase(texture);
+    }
+
+private:
+    friend class TextureFeedback;
+    bool recording = false;
+    std::vector<FeedbackDraw> draws;
+    std::vector<GLuint> fullDetail;
+    std::unordered_map<GLuint, FeedbackVirtualTexture> virtualTextures;
+};
+
+inline FeedbackLog& textureFeedbackLog()
+{
+    static FeedbackLog log;
+    return log;
+}
+
+class TextureFeedback
+{
+public:
+    static const int downscale = 8;     // of the window, per side
+    int interval = 4;                   // frames between feedback passes
+
+    TextureFeedback() : shader("vertexShaderForTextureFeedback.vs", "fragmentShaderForTextureFeedback.fs")
+    {
+        target = GlFramebuffer::create();
+        colour = GlTexture::create();
+        depth = GlTexture::create();
+        readback = GlBuffer::create();
+    }
+
+    ~TextureFeedback()
+    {
+        if (fence)
+            glDeleteSync(fence);
+    }
+
+    TextureFeedback(const TextureFeedback&) = delete;
+    TextureFeedback& operator=(const TextureFeedback&) = delete;
+
+    // once a frame before anything is drawn; starts logging the frame's textured
+    // draws when a pass is due and the previous one has been read back
+    void beginFrame(int viewportWidth, int viewportHeight)
+    {
+        FeedbackLog& log = textureFeedbackLog();
+        log.draws.clear();
+        log.fullDetail.clear();
+        log.recording = frame++ % interval == 0 && !fence;
+        if (log.recording)
+            resize(std::max(1, viewportWidth / downscale), std::max(1, viewportHeight / downscale));
+    }
+
+    // after the frame's draws, with the view and projection they were made with
+    void render(const glm::mat4& view, const glm::mat4& projection)
+    {
+        FeedbackLog& log = textureFeedbackLog();
+        if (!log.recording)
+            return;
+        log.recording = false;
+
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        glBindFramebuffer(GL_FRAMEBUFFER, target.get());
+        glViewport(0, 0, width, height);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        shader.use();
+        shader.setMat4("view", view);
+        shader.setMat4("projection", projection);
+        for (const FeedbackDraw& draw : log.draws)
+        {
+            shader.setMat4("model", draw.model);
+            shader.setBool("texCoordsAtOne", draw.texCoordsAtOne);
+            shader.setVec2("textureName", (draw.texture & 255) / 255.0f, ((draw.texture >> 8) & 255) / 255.0f);
+            auto virtualTexture = log.virtualTextures.find(draw.texture);
+            if (virtualTexture != log.virtualTextures.end())
+            {
+                // the level a window pixel samples, from the footprint of a feedback pixel
+                const FeedbackVirtualTexture& grid = virtualTexture->second;
+                shader.setFloat("virtualId", (float)grid.id);
+                shader.setFloat("pagesPerSide", (float)grid.pagesPerSide);
+                shader.setFloat("levelBias", log2f((float)grid.virtualSize) - log2f((float)downscale));
+                shader.setFloat("maxLevel", (float)(grid.levelCount - 1));
+            }
+            else
+                shader.setFloat("virtualId", 0.0f);
+            glBindVertexArray(draw.vertexArray);
+            glDrawElements(GL_TRIANGLES, draw.indexCount, draw.indexType, (void*)draw.indexOffset);
+        }
+        glBindVertexArray(0);
+        fullDetail = log.fullDetail;
+        virtualTextures.clear();
+        for (const auto& known : log.virtualTextures)
+            virtualTextures[known.second.id] = known.first;
+
+        // into the pixel buffer; read on a later frame
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.get());
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    }
+
+    // once the last pass has been read back, the smallest log2 footprint of one
+    // window pixel in each texture it saw, in units of the whole texture; adding
+    // log2 of the texture's size gives the mip level it was sampled at. the pages
+    // of virtual textures the pass saw are in getPageRequests() afterwards. false
+    // while the pass is still in flight
+    bool collect(std::unordered_map<GLuint, float>& footprints)
+    {
+        if (!fence || glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+            return false;
+        glDeleteSync(fence);
+        fence = 0;
+
+        footprints.clear();
+        pageRequests.clear();
+        std::unordered_set<uint32_t> pagesSeen;
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.get());
+        const unsigned char* pixels = (const unsigned char*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (size_t)width * height * 4, GL_MAP_READ_BIT);
+        if (pixels)
+        {
+            // a feedback pixel spans downscale window pixels
+            float offset = -32.0f - log2f((float)downscale);
+            for (size_t p = 0; p < (size_t)width * height; p++)
+            {
+                const unsigned char* pixel = pixels + p * 4;
+                if (pixel[3] != 255)
+                {
+                    // a virtual texture's page, or nothing drawn at all
+                    auto virtualTexture = virtualTextures.find(pixel[3]);
+                    if (virtualTexture != virtualTextures.end() &&
+                        pagesSeen.insert(pixel[3] << 24 | pixel[2] << 16 | pixel[1] << 8 | pixel[0]).second)
+                        pageRequests.push_back({ virtualTexture->second, pixel[2], pixel[0], pixel[1] });
+                    continue;
+                }
+                GLuint texture = pixels[p * 4] | (pixels[p * 4 + 1] << 8);
+                if (texture == 0)
+                    continue;
+                float footprint = pixels[p * 4 + 2] / 4.0f + offset;
+                auto found = footprints.find(texture);
+                if (found == footprints.end())
+                    footprints[texture] = footprint;
+                else
+                    found->second = std::min(found->second, footprint);
+            }
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        for (GLuint texture : fullDetail)
+            footprints[texture] = -INFINITY;
+        return true;
+    }
+
+    // the distinct virtual texture pages the last collected pass saw
+    const std::vector<FeedbackPage>& getPageRequests() const
+    {
+        return pageRequests;
+    }
+
+private:
+    Shader shader;
+    GlFramebuffer target;
+    GlTexture colour, depth;
+    GlBuffer readback;
+    GLsync fence = 0;                   // set while a pass is being read back
+    std::vector<GLuint> fullDetail;
+    std::unordered_map<int, GLuint> virtualTextures;    // by id, as of the pass in flight
+    std::vector<FeedbackPage> pageRequests;
+    int width = 0, height = 0;
+    unsigned int frame = 0;
+
+    void resize(int newWidth, int newHeight)
+    {
+        if (newWidth == width && newHeight == height)
+            return;
+        width = newWidth;
+        height = newHeight;
+
+        glBindTexture(GL_TEXTURE_2D, colour.get());
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        colour.chargeMemory(MemoryCategory::Textures, (size_t)width * height * 4);
+        glBindTexture(GL_TEXTURE_2D, depth.get());
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, width, height, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        depth.chargeMemory(MemoryCategory::Textures, (size_t)width * height * 4);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, target.get());
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colour.get(), 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth.get(), 0);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.get());
+        glBufferData(GL_PIXEL_PACK_BUFFER, (size_t)width * height * 4, nullptr, GL_STREAM_READ);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        readback.chargeMemory(MemoryCategory::Textures, (size_t)width * height * 4);
+    }
+};
+
+#endif /* textureFeedback_h */
@@ -0,0 +1,344 @@
+#ifndef textureLoader_h
+#define textureLoader_h
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <chrono>
+#include <deque>
+#include <future>
+#include <iostream>
+#include <string>
+#include <cstring>
+#include <cmath>
+#include <unordered_map>
+#include "stb_image.h"
+#include "textureCache.h"
+#include "glResource.h"
+#include "memoryReport.h"
+#include "threadPool.h"
+
+// loads image files into textures without stalling the GL thread. load() hands back
+// a texture at once with a 1x1 placeholder in it and queues the work on a worker,
+// which maps the image's compressed cache file or converts the image into one (see
+// textureCache.h). update(), called once a frame, copies mip levels through a small
+// ring of pixel buffers and respecifies the texture from there, so the driver can
+// do the transfer asynchronously. a fence per buffer keeps a buffer from being
+// rewritten while the GPU may still be reading it.
+//
+// levels are streamed: at first a texture only gets the levels of at most
+// residentSize texels a side. applyFeedback() tells the loader which level each
+// texture was last sampled at (see textureFeedback.h), and update() streams finer
+// levels in, one at a time, while everything resident fits in the budget. when it
+// does not, levels are dropped again from the textures seen longest ago, starting
+// with levels no texture currently needs. the GL names never change; only the
+// texture's base level moves.
+//
+// the loader owns its textures; it has to outlive everything that draws with them
+class TextureLoader
+{
+public:
+    static const int ringSize = 3;
+    static const int residentSize = 128;
+
+    TextureLoader(ThreadPool& workers, size_t budgetBytes) : workers(workers), budget(budgetBytes)
+    {
+        // stb_image keeps this flag globally, so it is set once here rather than
+        // per image on the workers
+        stbi_set_flip_vertically_on_load(true);
+        for (Slot& slot : ring)
+            slot.buffer = GlBuffer::create();
+        compressionSupported = textureCompressionSupported();
+    }
+
+    ~TextureLoader()
+    {
+        for (Slot& slot : ring)
+            if (slot.fence)
+                glDeleteSync(slot.fence);
+    }
+
+    TextureLoader(const TextureLoader&) = delete;
+    TextureLoader& operator=(const TextureLoader&) = delete;
+
+    // the texture for path, a placeholder of the given colour until its image has
+    // been decoded and uploaded. the reference stays valid for the loader's lifetime
+    const GlTexture& load(const std::string& path, GLenum wrapS, GLenum wrapT, GLenum minFilter, GLenum magFilter,
+        glm::vec4 placeholder = glm::vec4(0.5f, 0.5f, 0.5f, 1.0f))
+    {
+        textures.emplace_back();
+        Entry& entry = textures.back();
+        entry.path = path;
+        entry.texture = GlTexture::create();
+
+        glBindTexture(GL_TEXTURE_2D, entry.texture.get());
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_FLOAT, &placeholder[0]);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrapS);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrapT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, minFilter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, magFilter);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        entry.texture.chargeMemory(MemoryCategory::Textures, 4);
+
+        bool allowCompressed = compressionSupported;
+        entry.image = workers.submit([path, allowCompressed] {
+            return loadTextureData(path, allowCompressed);
+        });
+        pending++;
+        return entry.texture;
+    }
+
+    // sets the level each texture should have resident from the footprints of the
+    // last feedback pass; textures it did not see only need their low levels
+    void applyFeedback(const std::unordered_map<GLuint, float>& footprints)
+    {
+        feedbackPass++;
+        for (Entry& entry : textures)
+        {
+            if (entry.data.levels.empty())
+                continue;
+            entry.wantedLevel = entry.floorLevel;
+            auto found = footprints.find(entry.texture.get());
+            if (found == footprints.end())
+                continue;
+            const TextureLevel& top = entry.data.levels[0];
+            float level = found->second + log2f((float)std::max(top.width, top.height));
+            entry.wantedLevel = std::min(level <= 0.0f ? 0 : (int)level, entry.floorLevel);
+            entry.lastSeen = feedbackPass;
+        }
+    }
+
+    // uploads the low levels of finished textures, then streams finer levels in, as
+    // far as there are free pixel buffers; returns how many textures got their real
+    // image in this call
+    int update()
+    {
+        for (Slot& slot : ring)
+            if (slot.fence && glClientWaitSync(slot.fence, 0, 0) != GL_TIMEOUT_EXPIRED)
+            {
+                glDeleteSync(slot.fence);
+                slot.fence = 0;
+            }
+
+        int uploaded = 0;
+        for (Entry& entry : textures)
+        {
+            if (!entry.image.valid() || entry.image.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+                continue;
+            Slot* slot = freeSlot();
+            if (!slot)
+                break;
+
+            entry.data = entry.image.get();
+            pending--;
+            if (entry.data.levels.empty())
+            {
+                std::cout << "Texture failed to load at path: " << entry.path << std::endl;
+                continue;
+            }
+            if (entry.data.fromCache)
+                cacheHits++;
+
+            int levelCount = (int)entry.data.levels.size();
+            entry.floorLevel = 0;
+            while (entry.floorLevel < levelCount - 1 &&
+                std::max(entry.data.levels[entry.floorLevel].width, entry.data.levels[entry.floorLevel].height) > residentSize)
+                entry.floorLevel++;
+            entry.wantedLevel = entry.floorLevel;
+            uploadLevels(entry, entry.floorLevel, levelCount, *slot);
+            uploaded++;
+        }
+
+        while (Slot* slot = freeSlot())
+            if (!streamIn(*slot))
+                break;
+        return uploaded;
+    }
+
+    // true once every texture asked for has its image or has failed to load
+    bool idle() const
+    {
+        return pending == 0;
+    }
+
+    // textures whose images are still being decoded or waiting for a pixel buffer
+    int getPendingCount() const
+    {
+        return pending;
+    }
+
+    size_t getResidentBytes() const
+    {
+        return residentBytes;
+    }
+
+    void printReport() const
+    {
+        std::cout << "texture cache: " << cacheHits << " of " << textures.size() - pending <<
+            " textures loaded from " << (compressionSupported ? "compressed" : "uncompressed") << " cache files" << std::endl;
+        std::cout << "texture streaming: " << residentBytes / 1024 << " of " << budget / 1024 << " KB resident, " <<
+            streamedLevels << " levels streamed in, " << evictedLevels << " evicted" << std::endl;
+    }
+
+private:
+    struct Entry
+    {
+        std::string path;
+        GlTexture texture;
+        std::future<TextureData> image;     // invalid once taken
+        TextureData data;                   // the whole mip chain, kept for streaming
+        int residentLevel = 0;              // finest level on the GPU
+        int floorLevel = 0;                 // this and coarser levels are always resident
+        int wantedLevel = 0;                // finest level the last feedback asked for
+        unsigned int lastSeen = 0;          // feedback pass that last saw the texture
+        size_t residentBytes = 0;
+    };
+
+    struct Slot
+    {
+        GlBuffer buffer;
+        GLsync fence = 0;                   // set while the GPU may be reading buffer
+    };
+
+    ThreadPool& workers;
+    std::deque<Entry> textures;             // a deque, so load() references stay put
+    Slot ring[ringSize];
+    bool compressionSupported = false;
+    int pending = 0;
+    int cacheHits = 0;
+
+    size_t budget;
+    size_t residentBytes = 0;
+    unsigned int feedbackPass = 0;
+    int streamedLevels = 0;
+    int evictedLevels = 0;
+
+    Slot* freeSlot()
+    {
+        for (Slot& slot : ring)
+            if (!slot.fence)
+                return &slot;
+        return nullptr;
+    }
+
+    // the next finer level of the most recently seen texture that wants one, after
+    // making room for it; false if nothing wants a level or there is no room
+    bool streamIn(Slot& slot)
+    {
+        Entry* wanting = nullptr;
+        for (Entry& entry : textures)
+        {
+            if (entry.data.levels.empty() || entry.residentLevel <= entry.wantedLevel)
+                continue;
+            if (!wanting || entry.lastSeen > wanting->lastSeen || (entry.lastSeen == wanting->lastSeen &&
+                entry.residentLevel - entry.wantedLevel > wanting->residentLevel - wanting->wantedLevel))
+                wanting = &entry;
+        }
+        if (!wanting)
+            return false;
+
+        int level = wanting->residentLevel - 1;
+        size_t bytes = wanting->data.levels[level].size;
+        while (residentBytes + bytes > budget)
+        {
+            // levels nobody needs go first, then needed ones of textures seen longer
+            // ago than this one, least recently seen first in both cases
+            Entry* victim = nullptr;
+            bool victimNeeded = false;
+            for (Entry& entry : textures)
+            {
+                if (&entry == wanting || entry.data.levels.empty() || entry.residentLevel >= entry.floorLevel)
+                    continue;
+                bool needed = entry.residentLevel >= entry.wantedLevel;
+                if (needed && entry.lastSeen >= wanting->lastSeen)
+                    continue;
+                if (!victim || (victimNeeded && !needed) || (victimNeeded == needed && entry.lastSeen < victim->lastSeen))
+                {
+                    victim = &entry;
+                    victimNeeded = needed;
+                }
+            }
+            if (!victim)
+                return false;
+            evict(*victim);
+        }
+
+        uploadLevels(*wanting, level, wanting->residentLevel, slot);
+        streamedLevels++;
+        return true;
+    }
+
+    // drops the finest resident level of entry
+    void evict(Entry& entry)
+    {
+        int level = entry.residentLevel;
+        glBindTexture(GL_TEXTURE_2D, entry.texture.get());
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level + 1);
+        // respecified as empty, so the driver can release its storage
+        if (entry.data.isCompressed())
+            glCompressedTexImage2D(GL_TEXTURE_2D, level, entry.data.internalFormat, 0, 0, 0, 0, nullptr);
+        else
+            glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        entry.residentLevel++;
+        evictedLevels++;
+        updateCharge(entry);
+    }
+
+    // levels [first, end) of entry; end is the first level already resident, or the
+    // level count on the first upload
+    void uploadLevels(Entry& entry, int first, int end, Slot& slot)
+    {
+        const TextureData& data = entry.data;
+
+        // the levels lie back to back in the file, each after its 4-byte size
+        size_t begin = data.levels[first].offset;
+        size_t bytes = data.levels[end - 1].offset + data.levels[end - 1].size - begin;
+
+        // orphan the buffer's old storage, then fill the new one
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer.get());
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+        void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        if (mapped)
+        {
+            memcpy(mapped, data.bytes() + begin, bytes);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        }
+        else
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        slot.buffer.chargeMemory(MemoryCategory::Textures, bytes);
+
+        glBindTexture(GL_TEXTURE_2D, entry.texture.get());
+        for (int l = first; l < end; l++)
+        {
+            // an offset into the pixel buffer, or a client pointer if it could not be mapped
+            const TextureLevel& level = data.levels[l];
+            const void* pixels = mapped ? (const void*)(level.offset - begin) : data.bytes() + level.offset;
+            if (data.isCompressed())
+                glCompressedTexImage2D(GL_TEXTURE_2D, l, data.internalFormat, level.width, level.height, 0, (GLsizei)level.size, pixels);
+            else
+                glTexImage2D(GL_TEXTURE_2D, l, GL_RGBA8, level.width, level.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, first);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)data.levels.size() - 1);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+        entry.residentLevel = first;
+        updateCharge(entry);
+    }
+
+    void updateCharge(Entry& entry)
+    {
+        size_t bytes = 0;
+        for (size_t l = entry.residentLevel; l < entry.data.levels.size(); l++)
+            bytes += entry.data.levels[l].size;
+        residentBytes = residentBytes - entry.residentBytes + bytes;
+        entry.residentBytes = bytes;
+        entry.texture.chargeMemory(MemoryCategory::Textures, bytes);
+    }
+};
+
+#endif /* textureLoader_h */
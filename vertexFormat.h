@@ -0,0 +1,256 @@
+#ifndef vertexFormat_h
+#define vertexFormat_h
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <vector>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include "glResource.h"
+
+// GPU layouts for the interleaved 8-float vertex (position, normal, uv) the mesh
+// classes build on the CPU:
+//   Float            float3 position, float3 normal, float2 uv        32 bytes
+//   Packed           float3 position, 2_10_10_10 normal, half2 uv     20 bytes
+//   PackedQuantised  short3 position, 2_10_10_10 normal, half2 uv     16 bytes
+// the packed layouts also switch to 16-bit indices when the vertex count allows
+enum class VertexFormat { Float, Packed, PackedQuantised };
+
+// format for meshes that do not ask for one; set it before building the scene
+inline VertexFormat& defaultVertexFormat()
+{
+    static VertexFormat format = VertexFormat::PackedQuantised;
+    return format;
+}
+
+struct VertexLayout
+{
+    VertexFormat format = VertexFormat::Float;
+    int stride = 32;
+    int normalOffset = 12;
+    int texCoordOffset = 24;
+    GLenum indexType = GL_UNSIGNED_INT;
+
+    // quantised positions decode as dequantOffset + dequantScale * q with q in [-1, 1].
+    // the scale is the same on every axis so normals are unaffected, and the decode
+    // folds into the model matrix instead of the shaders
+    glm::vec3 dequantOffset = glm::vec3(0.0f);
+    float dequantScale = 1.0f;
+
+    glm::mat4 dequantize() const
+    {
+        if (format != VertexFormat::PackedQuantised)
+            return glm::mat4(1.0f);
+        return glm::scale(glm::translate(glm::mat4(1.0f), dequantOffset), glm::vec3(dequantScale));
+    }
+
+    int indexSize() const
+    {
+        return indexType == GL_UNSIGNED_SHORT ? 2 : 4;
+    }
+};
+
+inline unsigned short floatToHalf(float value)
+{
+    unsigned int bits;
+    memcpy(&bits, &value, sizeof(bits));
+    unsigned int sign = (bits >> 16) & 0x8000;
+    int exponent = (int)((bits >> 23) & 0xFF) - 127 + 15;
+    unsigned int mantissa = bits & 0x7FFFFF;
+
+    if (exponent >= 31)
+        return (unsigned short)(sign | 0x7C00);         // too large: infinity
+    if (exponent <= 0)
+    {
+        // subnormal half, or zero
+        if (exponent < -10)
+            return (unsigned short)sign;
+        mantissa |= 0x800000;
+        int shift = 14 - exponent;
+        unsigned int half = mantissa >> shift;
+        unsigned int rest = mantissa & ((1u << shift) - 1);
+        unsigned int halfway = 1u << (shift - 1);
+        if (rest > halfway || (rest == halfway && (half & 1)))
+            half++;
+        return (unsigned short)(sign | half);
+    }
+    // round to nearest even; a carry into the exponent is still correct
+    unsigned int half = sign | (exponent << 10) | (mantissa >> 13);
+    if ((mantissa & 0x1000) && (mantissa & 0x2FFF))
+        half++;
+    return (unsigned short)half;
+}
+
+// signed normalised 10-bit x, y, z with w = 0, for GL_INT_2_10_10_10_REV
+inline unsigned int packNormal(float x, float y, float z)
+{
+    float length = sqrt(x * x + y * y + z * z);
+    float inverse = length > 0.0f ? 1.0f / length : 0.0f;
+    float n[3] = { x * inverse, y * inverse, z * inverse };
+    unsigned int packed = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        int q = (int)lround(std::max(-1.0f, std::min(1.0f, n[i])) * 511.0f);
+        packed |= ((unsigned int)q & 0x3FF) << (10 * i);
+    }
+    return packed;
+}
+
+// layout for vertexCount vertices of 8 floats in the given format, including the
+// quantisation bounds when positions are quantised
+inline VertexLayout chooseVertexLayout(const float* vertices, size_t vertexCount, VertexFormat format)
+{
+    VertexLayout layout;
+    layout.format = format;
+    if (format == VertexFormat::Float)
+        return layout;
+
+    if (vertexCount <= 65536)
+        layout.indexType = GL_UNSIGNED_SHORT;
+
+    if (format == VertexFormat::Packed)
+    {
+        layout.stride = 20;
+        layout.normalOffset = 12;
+        layout.texCoordOffset = 16;
+        return layout;
+    }
+
+    layout.stride = 16;
+    layout.normalOffset = 8;
+    layout.texCoordOffset = 12;
+    if (vertexCount == 0)
+        return layout;
+
+    glm::vec3 low(vertices[0], vertices[1], vertices[2]);
+    glm::vec3 high = low;
+    for (size_t v = 0; v < vertexCount; v++)
+    {
+        const float* p = vertices + v * 8;
+        for (int i = 0; i < 3; i++)
+        {
+            low[i] = std::min(low[i], p[i]);
+            high[i] = std::max(high[i], p[i]);
+        }
+    }
+    layout.dequantOffset = (low + high) * 0.5f;
+    float extent = std::max(high.x - low.x, std::max(high.y - low.y, high.z - low.z)) * 0.5f;
+    layout.dequantScale = extent > 0.0f ? extent : 1.0f;
+    return layout;
+}
+
+// converts count 8-float vertices into layout.stride bytes each at out
+inline void packVertices(const VertexLayout& layout, const float* vertices, size_t count, unsigned char* out)
+{
+    if (layout.format == VertexFormat::Float)
+    {
+        memcpy(out, vertices, count * 8 * sizeof(float));
+        return;
+    }
+
+    float toUnit = 1.0f / layout.dequantScale;
+    for (size_t v = 0; v < count; v++)
+    {
+        const float* src = vertices + v * 8;
+        unsigned char* dst = out + v * layout.stride;
+
+        if (layout.format == VertexFormat::PackedQuantised)
+        {
+            short position[4] = { 0, 0, 0, 0 };
+            for (int i = 0; i < 3; i++)
+            {
+                float q = (src[i] - layout.dequantOffset[i]) * toUnit;
+                position[i] = (short)lround(std::max(-1.0f, std::min(1.0f, q)) * 32767.0f);
+            }
+            memcpy(dst, position, sizeof(position));
+        }
+        else
+            memcpy(dst, src, 3 * sizeof(float));
+
+        unsigned int normal = packNormal(src[3], src[4], src[5]);
+        memcpy(dst + layout.normalOffset, &normal, sizeof(normal));
+
+        unsigned short texCoords[2] = { floatToHalf(src[6]), floatToHalf(src[7]) };
+        memcpy(dst + layout.texCoordOffset, texCoords, sizeof(texCoords));
+    }
+}
+
+// creates and fills the VBO and EBO in the given format. the caller's VAO must be
+// bound so that it records the EBO; the VBO is left bound for setVertexAttributes()
+inline VertexLayout uploadVertexData(const float* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount,
+    GlBuffer& vbo, GlBuffer& ebo, VertexFormat format = defaultVertexFormat(), GLenum usage = GL_STATIC_DRAW)
+{
+    VertexLayout layout = chooseVertexLayout(vertices, vertexCount, format);
+
+    // float data is already in its GPU layout and goes up as it is
+    std::vector<unsigned char> vertexBytes;
+    const void* vertexData = vertices;
+    size_t vertexSize = vertexCount * layout.stride;
+    if (layout.format != VertexFormat::Float)
+    {
+        vertexBytes.resize(vertexSize);
+        packVertices(layout, vertices, vertexCount, vertexBytes.data());
+        vertexData = vertexBytes.data();
+    }
+
+    std::vector<unsigned short> shortIndices;
+    const void* indexData = indices;
+    if (layout.indexType == GL_UNSIGNED_SHORT)
+    {
+        shortIndices.assign(indices, indices + indexCount);
+        indexData = shortIndices.data();
+    }
+    size_t indexBytes = indexCount * layout.indexSize();
+
+    vbo = GlBuffer::create();
+    glBindBuffer(GL_ARRAY_BUFFER, vbo.get());
+    glBufferData(GL_ARRAY_BUFFER, vertexSize, vertexData, usage);
+
+    ebo = GlBuffer::create();
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo.get());
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes, indexData, GL_STATIC_DRAW);
+
+    vbo.chargeMemory(MemoryCategory::Meshes, vertexSize);
+    ebo.chargeMemory(MemoryCategory::Meshes, indexBytes);
+    return layout;
+}
+
+inline VertexLayout uploadVertexData(const std::vector<float>& vertices, const std::vector<unsigned int>& indices,
+    GlBuffer& vbo, GlBuffer& ebo, VertexFormat format = defaultVertexFormat(), GLenum usage = GL_STATIC_DRAW)
+{
+    return uploadVertexData(vertices.data(), vertices.size() / 8, indices.data(), indices.size(), vbo, ebo, format, usage);
+}
+
+// points attributes 0 (position), 1 (normal) and 2 (uv) of the bound VAO at the bound
+// VBO; attributeCount drops the trailing ones for shaders that do not read them
+inline void setVertexAttributes(const VertexLayout& layout, int attributeCount = 3)
+{
+    if (layout.format == VertexFormat::PackedQuantised)
+        glVertexAttribPointer(0, 3, GL_SHORT, GL_TRUE, layout.stride, (void*)0);
+    else
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, layout.stride, (void*)0);
+    glEnableVertexAttribArray(0);
+
+    if (attributeCount > 1)
+    {
+        if (layout.format == VertexFormat::Float)
+            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, layout.stride, (void*)(size_t)layout.normalOffset);
+        else
+            glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, layout.stride, (void*)(size_t)layout.normalOffset);
+        glEnableVertexAttribArray(1);
+    }
+
+    if (attributeCount > 2)
+    {
+        if (layout.format == VertexFormat::Float)
+            glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, layout.stride, (void*)(size_t)layout.texCoordOffset);
+        else
+            glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, layout.stride, (void*)(size_t)layout.texCoordOffset);
+        glEnableVertexAttribArray(2);
+    }
+}
+
+#endif /* vertexFormat_h */
@@ -0,0 +1,12 @@
+#version 400 core
+layout (location = 0) in vec2 aControlPoint;   // (radius, height) of one profile control point
+
+out vec2 vControlPoint;
+flat out int vSector;
+
+void main()
+{
+    // every instance of the patch is one angular sector of the surface of revolution
+    vControlPoint = aControlPoint;
+    vSector = gl_InstanceID;
+}
@@ -0,0 +1,31 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec4 aPlacement;   // xyz position, w yaw
+layout (location = 2) in vec4 aVariation;   // x scale, y sway phase, z tint, w archetype
+
+out vec3 vColor;
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform vec3 color;
+uniform float time;
+uniform float swayAmplitude;
+uniform float treeHeight;
+
+void main()
+{
+    vec3 p = aPos * aVariation.x;
+
+    // the bend grows with the square of the height, so the trunk stays planted
+    float bend = aPos.y / treeHeight;
+    bend *= bend * swayAmplitude * aVariation.x;
+    p.x += bend * sin(1.3 * time + aVariation.y);
+    p.z += 0.5 * bend * sin(0.9 * time + 1.7 * aVariation.y);
+
+    float c = cos(aPlacement.w);
+    float s = sin(aPlacement.w);
+    vec3 world = vec3(c * p.x + s * p.z, p.y, -s * p.x + c * p.z) + aPlacement.xyz;
+
+    gl_Position = projection * view * vec4(world, 1.0);
+    vColor = color * aVariation.z;
+}
@@ -0,0 +1,42 @@
+#version 330 core
+layout (location = 0) in vec2 aCorner;      // card corner in [0, 1]
+layout (location = 1) in vec4 aPlacement;   // xyz position, w yaw
+layout (location = 2) in vec4 aVariation;   // x scale, y sway phase, z tint, w archetype
+
+out vec2 TexCoords;
+out float vTint;
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform float time;
+uniform float swayAmplitude;
+uniform vec4 cardBounds[4];     // minX, maxX, minY, maxY of each archetype
+uniform vec4 atlasRects[4];     // u0, v0, u1, v1 of each archetype's atlas cell
+
+void main()
+{
+    int archetype = int(aVariation.w + 0.5);
+    vec4 bounds = cardBounds[archetype];
+    vec4 rect = atlasRects[archetype];
+
+    // the card turns about the vertical axis to face the camera
+    vec3 right = normalize(vec3(view[0][0], 0.0, view[2][0]));
+    float height = mix(bounds.z, bounds.w, aCorner.y);
+    float x = mix(bounds.x, bounds.y, aCorner.x) * aVariation.x;
+    float y = height * aVariation.x;
+
+    // same sway as the full tree so the switch at the impostor distance does not pop:
+    // the bend by height over the tree's height (bounds.w), turned by the tree's yaw
+    float bend = height / bounds.w;
+    bend *= bend * swayAmplitude * aVariation.x;
+    vec2 sway = vec2(bend * sin(1.3 * time + aVariation.y), 0.5 * bend * sin(0.9 * time + 1.7 * aVariation.y));
+    float c = cos(aPlacement.w);
+    float s = sin(aPlacement.w);
+    vec3 world = aPlacement.xyz + right * x + vec3(0.0, y, 0.0);
+    world.x += c * sway.x + s * sway.y;
+    world.z += -s * sway.x + c * sway.y;
+
+    gl_Position = projection * view * vec4(world, 1.0);
+    TexCoords = mix(rect.xy, rect.zw, aCorner);
+    vTint = aVariation.z;
+}
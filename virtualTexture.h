@@ -0,0 +1,407 @@
+#ifndef virtualTexture_h
+#define virtualTexture_h
+
+#include <glad/glad.h>
+
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include "shader.h"
+#include "mappedFile.h"
+#include "glResource.h"
+#include "threadPool.h"
+#include "textureCache.h"
+#include "textureFeedback.h"
+#include "virtualTextureFile.h"
+
+// one very large texture of which only the pages in view are on the GPU, for
+// surfaces with unique detail all over, like the floor. the whole mip chain lives
+// in a tiled file (see virtualTextureFile.h), baked from a VirtualTextureSource on
+// the workers the first time and memory-mapped from then on.
+//
+// the GPU holds a physical cache of slotsPerSide x slotsPerSide pages in one
+// texture, plus a page table with a texel per virtual page at every level, holding
+// the slot of that page or, while it is not resident, of its nearest resident
+// ancestor. the shader (fragmentShaderForVirtualTexture.fs) picks a level from its
+// derivatives, looks the page up and samples the cache. the feedback pass reports
+// the pages it saw; update() copies missing ones out of the file on the workers,
+// coarsest first, and uploads a few per frame into the least recently seen slots.
+// the single page of the coarsest level stays in slot 0 for good, so every texel
+// always has something to show.
+//
+// the cache's size is fixed, so texel density can grow with the file while VRAM
+// stays the same
+class VirtualTexture
+{
+public:
+    static const int slotsPerSide = 16;
+    int uploadsPerFrame = 8;
+    int loadsInFlight = 16;
+
+    VirtualTexture(ThreadPool& workers, const std::string& path, int pageSize, int pagesPerSide,
+        const std::string& sourceStamp, VirtualTextureSource source)
+        : workers(workers), path(path), stamp(sourceStamp)
+    {
+        layout = VirtualTextureLayout(textureCompressionSupported() ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_RGBA8, pageSize, pagesPerSide);
+        int atlasSize = slotsPerSide * layout.getPaddedSize();
+        slots.resize(slotsPerSide * slotsPerSide);
+
+        // grey until the coarsest page arrives
+        cache = GlTexture::create();
+        glBindTexture(GL_TEXTURE_2D, cache.get());
+        if (layout.internalFormat == GL_RGBA8)
+        {
+            std::vector<unsigned char> grey((size_t)atlasSize * atlasSize * 4, 128);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, atlasSize, atlasSize, 0, GL_RGBA, GL_UNSIGNED_BYTE, grey.data());
+        }
+        else
+        {
+            const unsigned char greyBlock[8] = { 0x10, 0x84, 0x10, 0x84, 0, 0, 0, 0 };
+            std::vector<unsigned char> grey(textureLevelSize(layout.internalFormat, atlasSize, atlasSize));
+            for (size_t i = 0; i < grey.size(); i += 8)
+                memcpy(&grey[i], greyBlock, 8);
+            glCompressedTexImage2D(GL_TEXTURE_2D, 0, layout.internalFormat, atlasSize, atlasSize, 0, (GLsizei)grey.size(), grey.data());
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        cache.chargeMemory(MemoryCategory::Textures, textureLevelSize(layout.internalFormat, atlasSize, atlasSize));
+
+        // one texel per page at each level, RGBA8 as slot x, slot y and the level of
+        // the page the slot holds
+        pageTable = GlTexture::create();
+        glBindTexture(GL_TEXTURE_2D, pageTable.get());
+        size_t tableBytes = 0;
+        for (int level = 0; level < layout.levelCount; level++)
+        {
+            int pages = layout.getPagesAt(level);
+            glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, pages, pages, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+            table.emplace_back((size_t)pages * pages * 4);
+            tableBytes += (size_t)pages * pages * 4;
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, layout.levelCount - 1);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        pageTable.chargeMemory(MemoryCategory::Textures, tableBytes);
+        uploadPageTable();
+
+        textureFeedbackLog().addVirtualTexture(cache.get(), layout.pagesPerSide, layout.getVirtualSize(), layout.levelCount);
+
+        if (!openFile())
+            bake(source);
+    }
+
+    ~VirtualTexture()
+    {
+        textureFeedbackLog().removeVirtualTexture(cache.get());
+        // the workers may still be reading the mapping or writing the file
+        for (Load& load : loads)
+            load.pixels.wait();
+        if (baked.valid())
+            baked.wait();
+    }
+
+    VirtualTexture(const VirtualTexture&) = delete;
+    VirtualTexture& operator=(const VirtualTexture&) = delete;
+
+    // the physical cache; bound as the diffuse map of the meshes drawn with it, and
+    // the name the feedback pass knows the virtual texture by
+    const GlTexture& getCacheTexture() const
+    {
+        return cache;
+    }
+
+    // binds the page table to texture unit 2 and sets what the shader needs to know
+    // of the page grid
+    void bind(Shader& shader) const
+    {
+        shader.use();
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_2D, pageTable.get());
+        glActiveTexture(GL_TEXTURE0);
+        shader.setInt("virtualTexture.pageTable", 2);
+        shader.setFloat("virtualTexture.pagesPerSide", (float)layout.pagesPerSide);
+        shader.setFloat("virtualTexture.pageSize", (float)layout.pageSize);
+        shader.setFloat("virtualTexture.border", (float)virtualPageBorder);
+        shader.setFloat("virtualTexture.maxLevel", (float)(layout.levelCount - 1));
+        shader.setFloat("virtualTexture.cacheSize", (float)(slotsPerSide * layout.getPaddedSize()));
+    }
+
+    // the pages the last feedback pass saw replace the ones still waiting to be
+    // loaded. resident ones, and their ancestors which stand in until the finer
+    // pages arrive, count as recently seen
+    void applyFeedback(const std::vector<FeedbackPage>& pages)
+    {
+        feedbackPass++;
+        wanted.clear();
+        for (const FeedbackPage& page : pages)
+        {
+            if (page.texture != cache.get() || page.level >= layout.levelCount ||
+                page.x >= layout.getPagesAt(page.level) || page.y >= layout.getPagesAt(page.level))
+                continue;
+            uint32_t key = pageKey(page.level, page.x, page.y);
+            if (!touch(key) && !isLoading(key))
+                wanted.push_back(key);
+            for (int level = page.level + 1; level < layout.levelCount; level++)
+                touch(pageKey(level, page.x >> (level - page.level), page.y >> (level - page.level)));
+        }
+        // coarsest at the back, to be loaded first
+        std::sort(wanted.begin(), wanted.end(), [](uint32_t a, uint32_t b) { return a >> 16 < b >> 16; });
+    }
+
+    // once a frame: uploads pages that have been read, starts reading wanted ones
+    // and brings the page table up to date
+    void update()
+    {
+        if (!file.isOpen())
+        {
+            if (!baked.valid() || baked.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+                return;
+            if (!baked.get() || !openFile())
+            {
+                std::cout << "Virtual texture failed to bake at path: " << path << std::endl;
+                return;
+            }
+        }
+
+        int uploaded = 0;
+        for (auto load = loads.begin(); load != loads.end() && uploaded < uploadsPerFrame;)
+        {
+            if (load->pixels.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            {
+                ++load;
+                continue;
+            }
+            upload(load->key, load->pixels.get());
+            load = loads.erase(load);
+            uploaded++;
+        }
+
+        uint32_t root = pageKey(layout.levelCount - 1, 0, 0);
+        if (slots[0].key != root && !isLoading(root))
+            startLoad(root);
+        while ((int)loads.size() < loadsInFlight && !wanted.empty())
+        {
+            uint32_t key = wanted.back();
+            wanted.pop_back();
+            if (resident.find(key) == resident.end() && !isLoading(key))
+                startLoad(key);
+        }
+
+        if (tableChanged)
+            uploadPageTable();
+    }
+
+    void printReport() const
+    {
+        std::cout << "virtual texture " << path << ": " << resident.size() << " of " << slots.size() << " cache pages in use, " <<
+            loadedPages << " pages loaded, " << evictedPages << " evicted, " << droppedPages << " dropped with every page in view" << std::endl;
+    }
+
+private:
+    struct Slot
+    {
+        uint32_t key = noPage;
+        unsigned int lastSeen = 0;          // feedback pass that last needed the page
+    };
+
+    struct Load
+    {
+        uint32_t key;
+        std::future<std::vector<unsigned char>> pixels;
+    };
+
+    static const uint32_t noPage = 0xffffffff;
+
+    ThreadPool& workers;
+    std::string path, stamp;
+    VirtualTextureLayout layout;
+    MappedFile file;
+    std::future<bool> baked;                // while the file is being written
+
+    GlTexture cache, pageTable;
+    std::vector<std::vector<unsigned char>> table;      // per level, as uploaded
+    bool tableChanged = false;
+
+    std::vector<Slot> slots;
+    std::unordered_map<uint32_t, int> resident;         // page key to slot
+    std::deque<Load> loads;
+    std::vector<uint32_t> wanted;
+    unsigned int feedbackPass = 0;
+    int loadedPages = 0, evictedPages = 0, droppedPages = 0;
+
+    // level, then y and x, 8 bits each as pagesPerSide is at most 256
+    static uint32_t pageKey(int level, int x, int y)
+    {
+        return (uint32_t)level << 16 | (uint32_t)y << 8 | (uint32_t)x;
+    }
+
+    // marks a resident page as seen; false if it is not resident
+    bool touch(uint32_t key)
+    {
+        auto found = resident.find(key);
+        if (found == resident.end())
+            return false;
+        slots[found->second].lastSeen = feedbackPass;
+        return true;
+    }
+
+    bool isLoading(uint32_t key) const
+    {
+        for (const Load& load : loads)
+            if (load.key == key)
+                return true;
+        return false;
+    }
+
+    bool openFile()
+    {
+        if (!file.open(path))
+            return false;
+        if (matchesVirtualTexture(file.data(), file.size(), layout, stamp))
+            return true;
+        file.close();
+        return false;
+    }
+
+    // every page of every level on the workers, a row of pages per task, then the
+    // file written by one more task once they are done. tasks run in the order they
+    // are queued, so the last one only ever waits for rows that are already running
+    void bake(const VirtualTextureSource& source)
+    {
+        auto blob = std::make_shared<std::vector<unsigned char>>(layout.getFileSize());
+        VirtualTextureHeader header = makeVirtualTextureHeader(layout, stamp);
+        memcpy(blob->data(), &header, sizeof(header));
+
+        auto rows = std::make_shared<std::vector<std::future<void>>>();
+        for (int level = 0; level < layout.levelCount; level++)
+            for (int y = 0; y < layout.getPagesAt(level); y++)
+                rows->push_back(workers.submit([blob, layout = layout, source, level, y] {
+                    for (int x = 0; x < layout.getPagesAt(level); x++)
+                        bakeVirtualPage(layout, source, level, x, y, blob->data() + layout.getPageOffset(level, x, y));
+                }));
+
+        // written next to the old file and swapped in, as the texture cache does
+        baked = workers.submit([blob, rows, path = path] {
+            for (std::future<void>& row : *rows)
+                row.wait();
+            std::string temporary = path + ".tmp";
+            FILE* out = fopen(temporary.c_str(), "wb");
+            if (!out)
+                return false;
+            bool written = fwrite(blob->data(), 1, blob->size(), out) == blob->size();
+            written = fclose(out) == 0 && written;
+            if (!written)
+            {
+                std::remove(temporary.c_str());
+                return false;
+            }
+            std::remove(path.c_str());
+            return std::rename(temporary.c_str(), path.c_str()) == 0;
+        });
+    }
+
+    // copies the page out of the mapping on a worker, which is where it is read
+    // from disk if it is not in the page cache yet
+    void startLoad(uint32_t key)
+    {
+        const unsigned char* bytes = file.data() + layout.getPageOffset(key >> 16, key & 255, (key >> 8) & 255);
+        size_t size = layout.pageBytes;
+        loads.push_back({ key, workers.submit([bytes, size] {
+            return std::vector<unsigned char>(bytes, bytes + size);
+        }) });
+    }
+
+    // the slot for a page: slot 0 for the coarsest, otherwise a free one or the one
+    // seen longest ago, as long as the last feedback did not need it; -1 if none
+    int chooseSlot(uint32_t key) const
+    {
+        if (key >> 16 == (uint32_t)layout.levelCount - 1)
+            return 0;
+        int chosen = -1;
+        for (int s = 1; s < (int)slots.size(); s++)
+        {
+            if (slots[s].key == noPage)
+                return s;
+            if (slots[s].lastSeen < feedbackPass && (chosen < 0 || slots[s].lastSeen < slots[chosen].lastSeen))
+                chosen = s;
+        }
+        return chosen;
+    }
+
+    void upload(uint32_t key, const std::vector<unsigned char>& pixels)
+    {
+        int s = chooseSlot(key);
+        if (s < 0)
+        {
+            droppedPages++;
+            return;
+        }
+        if (slots[s].key != noPage)
+        {
+            resident.erase(slots[s].key);
+            evictedPages++;
+        }
+        slots[s].key = key;
+        slots[s].lastSeen = feedbackPass;
+        resident[key] = s;
+        loadedPages++;
+        tableChanged = true;
+
+        int padded = layout.getPaddedSize();
+        int x = s % slotsPerSide * padded, y = s / slotsPerSide * padded;
+        glBindTexture(GL_TEXTURE_2D, cache.get());
+        if (layout.internalFormat == GL_RGBA8)
+            glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, padded, padded, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+        else
+            glCompressedTexSubImage2D(GL_TEXTURE_2D, 0, x, y, padded, padded, layout.internalFormat, (GLsizei)pixels.size(), pixels.data());
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    // every page's entry is its own slot if it is resident and its parent's entry
+    // otherwise, so the table is filled from the coarsest level down
+    void uploadPageTable()
+    {
+        glBindTexture(GL_TEXTURE_2D, pageTable.get());
+        for (int level = layout.levelCount - 1; level >= 0; level--)
+        {
+            int pages = layout.getPagesAt(level);
+            for (int y = 0; y < pages; y++)
+                for (int x = 0; x < pages; x++)
+                {
+                    unsigned char* entry = &table[level][((size_t)y * pages + x) * 4];
+                    auto found = resident.find(pageKey(level, x, y));
+                    if (found != resident.end())
+                    {
+                        entry[0] = (unsigned char)(found->second % slotsPerSide);
+                        entry[1] = (unsigned char)(found->second / slotsPerSide);
+                        entry[2] = (unsigned char)level;
+                        entry[3] = 255;
+                    }
+                    else if (level == layout.levelCount - 1)
+                    {
+                        // slot 0, grey until the coarsest page is there
+                        entry[0] = entry[1] = 0;
+                        entry[2] = (unsigned char)level;
+                        entry[3] = 255;
+                    }
+                    else
+                        memcpy(entry, &table[level + 1][((size_t)(y / 2) * (pages / 2) + x / 2) * 4], 4);
+                }
+            glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, pages, pages, GL_RGBA, GL_UNSIGNED_BYTE, table[level].data());
+        }
+        glBindTexture(GL_TEXTURE_2D, 0);
+        tableChanged = false;
+    }
+};
+
+#endif /* virtualTexture_h */
@@ -0,0 +1,137 @@
+#ifndef virtualTextureFile_h
+#define virtualTextureFile_h
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <functional>
+#include <algorithm>
+#include "textureCache.h"
+#include "textureCompressor.h"
+
+// on-disk layout of a virtual texture (see virtualTexture.h): every mip level cut
+// into square pages of pageSize texels, from the full-size level 0 down to a level
+// that is a single page. each page is stored with a border of virtualPageBorder
+// texels taken from its neighbours, so the physical cache can filter bilinearly up
+// to a page's edge. pages all take the same number of bytes and lie level by level,
+// row by row, so where one is follows from its level and position; there is no index.
+//
+// pages are BC1, or RGBA8 without the S3TC extension. no GL calls, safe on any thread
+
+const uint32_t virtualTextureVersion = 1;
+const int virtualPageBorder = 4;
+const char virtualTextureIdentifier[8] = { 'A', 'U', 'D', 'V', 'T', 'E', 'X', '\0' };
+
+struct VirtualTextureHeader
+{
+    char identifier[8];
+    uint32_t version;               // virtualTextureVersion
+    uint32_t internalFormat;
+    uint32_t pageSize;              // texels per side, without the border
+    uint32_t border;
+    uint32_t pagesPerSide;          // at level 0
+    uint32_t levelCount;
+    uint32_t pageBytes;
+    char source[64];                // stamp of what it was baked from
+};
+
+// fills size x size texels of a level, starting at texel (x, y), with RGBA8 rows
+// running upwards as GL stores them. for the pages at a level's edges x and y reach
+// outside it; the source clamps them. called on several workers at once
+typedef std::function<void(int level, int x, int y, int size, unsigned char* rgba)> VirtualTextureSource;
+
+struct VirtualTextureLayout
+{
+    GLenum internalFormat = 0;
+    int pageSize = 0;
+    int pagesPerSide = 0;
+    int levelCount = 0;
+    size_t pageBytes = 0;
+
+    VirtualTextureLayout() {}
+
+    // pagesPerSide is a power of two of at most 256 and pageSize a multiple of 4,
+    // so that bordered pages are whole compressed blocks
+    VirtualTextureLayout(GLenum internalFormat, int pageSize, int pagesPerSide)
+        : internalFormat(internalFormat), pageSize(pageSize), pagesPerSide(pagesPerSide)
+    {
+        while ((pagesPerSide >> levelCount) > 0)
+            levelCount++;
+        pageBytes = textureLevelSize(internalFormat, getPaddedSize(), getPaddedSize());
+    }
+
+    int getPaddedSize() const
+    {
+        return pageSize + 2 * virtualPageBorder;
+    }
+
+    int getPagesAt(int level) const
+    {
+        return pagesPerSide >> level;
+    }
+
+    // texels per side of level 0
+    int getVirtualSize() const
+    {
+        return pageSize * pagesPerSide;
+    }
+
+    size_t getPageOffset(int level, int x, int y) const
+    {
+        size_t pages = 0;
+        for (int l = 0; l < level; l++)
+            pages += (size_t)getPagesAt(l) * getPagesAt(l);
+        pages += (size_t)y * getPagesAt(level) + x;
+        return sizeof(VirtualTextureHeader) + pages * pageBytes;
+    }
+
+    size_t getFileSize() const
+    {
+        return getPageOffset(levelCount, 0, 0);
+    }
+};
+
+inline VirtualTextureHeader makeVirtualTextureHeader(const VirtualTextureLayout& layout, const std::string& stamp)
+{
+    VirtualTextureHeader header = {};
+    memcpy(header.identifier, virtualTextureIdentifier, sizeof(virtualTextureIdentifier));
+    header.version = virtualTextureVersion;
+    header.internalFormat = layout.internalFormat;
+    header.pageSize = (uint32_t)layout.pageSize;
+    header.border = (uint32_t)virtualPageBorder;
+    header.pagesPerSide = (uint32_t)layout.pagesPerSide;
+    header.levelCount = (uint32_t)layout.levelCount;
+    header.pageBytes = (uint32_t)layout.pageBytes;
+    strncpy(header.source, stamp.c_str(), sizeof(header.source) - 1);
+    return header;
+}
+
+// whether data holds a whole file of exactly this layout baked from stamp
+inline bool matchesVirtualTexture(const unsigned char* data, size_t size, const VirtualTextureLayout& layout, const std::string& stamp)
+{
+    VirtualTextureHeader expected = makeVirtualTextureHeader(layout, stamp);
+    return size == layout.getFileSize() && memcmp(data, &expected, sizeof(expected)) == 0;
+}
+
+// one bordered page from the source, encoded as it is stored
+inline void bakeVirtualPage(const VirtualTextureLayout& layout, const VirtualTextureSource& source, int level, int x, int y, unsigned char* out)
+{
+    RgbaImage page;
+    page.width = page.height = layout.getPaddedSize();
+    page.pixels.resize((size_t)page.width * page.height * 4);
+    source(level, x * layout.pageSize - virtualPageBorder, y * layout.pageSize - virtualPageBorder, page.width, page.pixels.data());
+
+    if (layout.internalFormat == GL_RGBA8)
+    {
+        memcpy(out, page.pixels.data(), page.pixels.size());
+        return;
+    }
+    std::vector<unsigned char> blocks;
+    compressLevel(page, false, blocks);
+    memcpy(out, blocks.data(), blocks.size());
+}
+
+#endif /* virtualTextureFile_h */